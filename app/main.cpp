@@ -106,6 +106,11 @@ int parseParams (
 	Option dprintf{ "-dprintf", 0 };			options.push_back(dprintf);
 	Option compilerIndex{ "-compiler", 1 };		options.push_back(compilerIndex);
 	Option compilerList{ "-compiler-list", 0 };	options.push_back(compilerList);
+	Option spvCache{ "-spvcache", 1 };			options.push_back(spvCache);
+	Option noPipeCache{ "-nopipecache", 0 };	options.push_back(noPipeCache);
+	Option noObjCache{ "-noobjcache", 0 };		options.push_back(noObjCache);
+	Option headless{ "-headless", 1 };			options.push_back(headless);
+	Option headlessDump{ "-headless-dump", 1 };	options.push_back(headlessDump);
 	Option optVtfVersion21{ "-v", 0 };			options.push_back(optVtfVersion21);
 	Option optVtfVersion1{ "-vv", 0 };			options.push_back(optVtfVersion1);
 	Option optVtfVersion0{ "-vvv", 0 };			options.push_back(optVtfVersion0);
@@ -239,6 +244,31 @@ int parseParams (
 		}
 	}
 
+	if (cmd.consumeOptions(spvCache, options, sink, allTestNames) > 0)
+	{
+		globalAppFlags.spirvCacheSize = fromText(sink.back(), globalAppFlags.spirvCacheSize, status);
+		if (!status)
+		{
+			std::cout << "WARNING: Unable to parse SPIR-V cache size, default "
+				<< globalAppFlags.spirvCacheSize << " MiB will be used" << std::endl;
+		}
+	}
+
+	if (cmd.consumeOptions(headless, options, sink, allTestNames) > 0)
+	{
+		globalAppFlags.headlessFrames = fromText(sink.back(), 0u, status);
+		if (!status || 0u == globalAppFlags.headlessFrames)
+		{
+			std::cout << "ERROR: Unable to parse headless frame count" << std::endl;
+			return 1;
+		}
+	}
+
+	if (cmd.consumeOptions(headlessDump, options, sink, allTestNames) > 0)
+	{
+		globalAppFlags.headlessDumpDir = sink.back();
+	}
+
 	if (cmd.consumeOptions(compilerList, options, sink, allTestNames) > 0)
 	{
 		printCompilerList(std::cout);
@@ -439,6 +469,8 @@ int parseParams (
 	globalAppFlags.nowerror = (cmd.consumeOptions(nowerror, options, sink, allTestNames) > 0);
 	globalAppFlags.noWarning_VUID_Undefined = (cmd.consumeOptions(optLayNoVuid, options, sink, allTestNames) > 0);
 	globalAppFlags.assertWait = cmd.consumeOptions(optAssertWait, options, sink, allTestNames) > 0;
+	globalAppFlags.pipelineCache = (cmd.consumeOptions(noPipeCache, options, sink, allTestNames) <= 0);
+	globalAppFlags.objectCache = (cmd.consumeOptions(noObjCache, options, sink, allTestNames) <= 0);
 	cmd.consumeOptions(excludeDevExt, options, globalAppFlags.excludedDevExtensions, allTestNames);
 	cmd.consumeOptions(optSuppressVUID, options, globalAppFlags.suppressedVUIDs, allTestNames);
 
@@ -645,6 +677,9 @@ void printUsage (std::ostream& str)
 	str << "  -tmp <temp_dir>           change temp directory, default is system's temp directory" << std::endl;
 	str << "  -verbose <level>          enable application diagnostic messages, default is 0 that means disabled" << std::endl;
 	str << "  -assert-wait              wait for any key after exception occurence" << std::endl;
+	str << "  -headless <frames>        windowed tests render the given number of frames to VK_EXT_headless_surface\n"
+		   "                            without creating a window, then print the frame rate" << std::endl;
+	str << "  -headless-dump <dir>      saves each headless frame to <dir>/frameNNNNN.ppm" << std::endl;
 	str << "  -dprintf:                 enable Debug Printf feature" << std::endl;
 	str << "                            #extension GL_EXT_debug_printf : enable and debugPrintfEXT(...)" << std::endl;
 	str << "  -bt:                      enable backtrace" << std::endl;
@@ -675,6 +710,13 @@ void printUsage (std::ostream& str)
 	str << "  -compiler <index>:        set compiler index from looking it on the operating system, default is 0.\n"
 		<< "                            If index is negative value then statically glslang compiler will be used,\n"
 		<< "                            and project needs to be configured with OFFLINE_SHADER_COMPILER enabled." << std::endl;
+	str << "  -spvcache <MiB>:          maximum size of SPIR-V binaries cache kept in the temp directory,\n"
+		<< "                            default is 256, 0 disables the cache" << std::endl;
+	str << "  -nopipecache:             disables the pipeline cache and the shader object binary cache kept in\n"
+		<< "                            the temp directory per device and driver, pipelines given no cache explicitly\n"
+		<< "                            and shader objects are then compiled from scratch" << std::endl;
+	str << "  -noobjcache:              every sampler, image view, render pass and framebuffer gets its own handle,\n"
+		<< "                            by default those created from identical create infos share one" << std::endl;
 	str << "  -nowerror:                allows warnig(s) from external compilators\n" << std::endl;
 	str << "  NOTE: The app internally uses some of the Vulkan SDK tools e.g. glslangValidator or spirv-val\n"
 		<< "        so these have to be visible to it. In order to find where certain tool sits the app\n"
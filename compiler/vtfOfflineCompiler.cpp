@@ -3,6 +3,45 @@
 namespace vtf
 {
 
+struct OfflineCompilerSession::Impl
+{
+};
+
+add_ref<OfflineCompilerSession> OfflineCompilerSession::forThisThread ()
+{
+    thread_local OfflineCompilerSession session;
+    return session;
+}
+
+OfflineCompilerSession::OfflineCompilerSession ()
+    : m_impl(nullptr)
+{
+}
+
+OfflineCompilerSession::~OfflineCompilerSession () = default;
+
+std::vector<char> OfflineCompilerSession::compile (
+    add_cref<std::string>           /*shaderCode*/,
+    VkShaderStageFlagBits           /*shaderStage*/,
+    add_cref<std::string>           /*entryPoint*/,
+    bool                            /*isGlsl*/,
+    bool                            /*enableValidation*/,
+    add_cref<std::string>           /*validationOptions*/,
+    bool                            /*genDisassmebly*/,
+    add_cref<vtf::Version>          /*vulkanVer*/,
+    add_cref<vtf::Version>          /*spirvVer*/,
+    add_cref<fs::path>              /*binPath*/,
+    add_cref<fs::path>              /*asmPath*/,
+    add_ref<std::vector<char>>      /*disassembly*/,
+    add_ref<std::stringstream>      /*errorCollection*/,
+    add_ref<vtf::ProgressRecorder>  /*progressRecorder*/,
+    add_ref<bool>                   /*status*/)
+{
+    ASSERTFALSE("Offline glslang compiler is unavailable, "
+        "rebuilt your project width OFFLINE_SHADER_COMPILER enabled");
+	return {};
+}
+
 std::vector<char> compileShader(
     add_cref<std::string>           /*shaderCode*/,
     VkShaderStageFlagBits           /*shaderStage*/,
@@ -25,4 +64,9 @@ std::vector<char> compileShader(
 	return {};
 }
 
+std::string getOfflineCompilerSignature ()
+{
+    return "unavailable";
+}
+
 } // namespace vtf
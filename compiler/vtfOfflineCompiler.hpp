@@ -1,6 +1,7 @@
 #ifndef __VTF_OFFLINE_COMPILER_HPP_INCLUDED__
 #define __VTF_OFFLINE_COMPILER_HPP_INCLUDED__
 
+#include <memory>
 #include <sstream>
 #include "vtfVkUtils.hpp"
 #include "vtfFilesystem.hpp"
@@ -9,6 +10,41 @@
 namespace vtf
 {
 
+// Long-lived compiler state: glslang is initialized once per process and SPIRV-Tools
+// contexts are created once per target environment, instead of for every shader.
+// A session must not be shared between threads, each thread gets its own one
+// from forThisThread() so concurrent builds never contend for it.
+struct OfflineCompilerSession
+{
+	static add_ref<OfflineCompilerSession> forThisThread ();
+
+	OfflineCompilerSession ();
+	OfflineCompilerSession (add_cref<OfflineCompilerSession>) = delete;
+	~OfflineCompilerSession ();
+
+	std::vector<char> compile (
+		add_cref<std::string>			shaderCode,
+		VkShaderStageFlagBits			shaderStage,
+		add_cref<std::string>			entryPoint,
+		bool							isGlsl,
+		bool							enableValidation,
+		add_cref<std::string>           validationOptions,
+		bool							genDisassmebly,
+		add_cref<Version>				vulkanVer,
+		add_cref<Version>				spirvVer,
+		add_cref<fs::path>				binPath,
+		add_cref<fs::path>				asmPath,
+		add_ref<std::vector<char>>		disassembled,
+		add_ref<std::stringstream>		errorCollection,
+		add_ref<vtf::ProgressRecorder>	progressRecorder,
+		add_ref<bool>					status);
+
+	struct Impl;
+private:
+	std::unique_ptr<Impl>	m_impl;
+};
+
+// Compiles with the session of the calling thread
 std::vector<char> compileShader (
 	add_cref<std::string>			shaderCode,
 	VkShaderStageFlagBits			shaderStage,
@@ -25,6 +61,10 @@ std::vector<char> compileShader (
 	add_ref<std::stringstream>		errorCollection,
 	add_ref<vtf::ProgressRecorder>	progressRecorder,
 	add_ref<bool>					status);
+
+// Identifies statically linked glslang and SPIRV-Tools, e.g. for keying cached binaries
+std::string getOfflineCompilerSignature ();
+
 } // namespace vtf
 
 #endif // __VTF_OFFLINE_COMPILER_HPP_INCLUDED__
@@ -4,6 +4,7 @@
 #include "spirv-tools/libspirv.hpp"
 #include "vtfOfflineCompiler.hpp"
 #include <vector>
+#include <map>
 #include <fstream>
 #include <iostream>
 
@@ -114,19 +115,15 @@ static add_cptr<TBuiltInResource> getDefaultTBuiltInResource ();
 
 static bool validateSpirv (
     add_cref<std::vector<uint32_t>> binary,
-    add_cref<vtf::Version>          vulkanVer,
-    add_cref<vtf::Version>          spirvVer,
+    add_ref<spvtools::SpirvTools>   tools,
     add_cref<std::string>           validationOptions,
-    add_ref<std::stringstream>      errorCollection,
     add_ref<vtf::ProgressRecorder>  progressRecorder);
 
 static bool generateDisassembly (
     add_cref<std::vector<uint32_t>> binary,
     add_cref<fs::path>              asmPath,
-    add_cref<vtf::Version>          vulkanVer,
-    add_cref<vtf::Version>          spirvVer,
+    add_ref<spvtools::SpirvTools>   tools,
     add_ref<std::vector<char>>      disassembled,
-    add_ref<std::stringstream>      errorCollection,
     add_ref<vtf::ProgressRecorder>  progressRecorder);
 
 static int parseGlVersion (add_cref<std::string> shaderCode)
@@ -149,16 +146,72 @@ static int parseGlVersion (add_cref<std::string> shaderCode)
 
 static bool compileSpvShader (
     add_cref<std::string>           shaderCode,
-    add_cref<vtf::Version>          vulkanVer,
-    add_cref<vtf::Version>          spirvVer,
-    add_ref<std::stringstream>      errorCollection,
+    add_ref<spvtools::SpirvTools>   tools,
     add_ref<vtf::ProgressRecorder>  progressRecorder,
     add_ref<std::vector<uint32_t>>  binary);
 
 namespace vtf
 {
 
-std::vector<char> compileShader (
+// glslang::InitializeProcess() and FinalizeProcess() are costly and touch global state,
+// so they are called exactly once, the first session to be created does the former
+// and the latter happens at the application exit, after all the sessions are gone.
+static void initializeGlslangProcess ()
+{
+    struct GlslangProcess
+    {
+        GlslangProcess  () { glslang::InitializeProcess(); }
+        ~GlslangProcess () { glslang::FinalizeProcess(); }
+    };
+    static GlslangProcess process;
+}
+
+struct OfflineCompilerSession::Impl
+{
+    // Messages are directed to the collection and prefixed with the operation currently in progress
+    add_ref<spvtools::SpirvTools> getTools (spv_target_env env, add_ref<std::stringstream> errorCollection,
+                                            add_cptr<char> operation);
+
+    std::map<spv_target_env, std::unique_ptr<spvtools::SpirvTools>> m_tools;
+    add_ptr<std::stringstream>  m_errorCollection   = nullptr;
+    add_cptr<char>              m_operation         = nullptr;
+};
+
+add_ref<spvtools::SpirvTools> OfflineCompilerSession::Impl::getTools (spv_target_env env,
+    add_ref<std::stringstream> errorCollection, add_cptr<char> operation)
+{
+    m_errorCollection = &errorCollection;
+    m_operation = operation;
+
+    std::unique_ptr<spvtools::SpirvTools>& tools = m_tools[env];
+    if (!tools)
+    {
+        tools = std::make_unique<spvtools::SpirvTools>(env);
+        tools->SetMessageConsumer([this](spv_message_level_t level, add_cptr<char>,
+            add_cref<spv_position_t> position, add_cptr<char> message) {
+                UNREF(level);
+                *m_errorCollection << "SPIR-V " << m_operation << ": " << message
+                    << " at line " << position.index << std::endl;
+            });
+    }
+    return *tools;
+}
+
+add_ref<OfflineCompilerSession> OfflineCompilerSession::forThisThread ()
+{
+    thread_local OfflineCompilerSession session;
+    return session;
+}
+
+OfflineCompilerSession::OfflineCompilerSession ()
+    : m_impl(std::make_unique<Impl>())
+{
+    initializeGlslangProcess();
+}
+
+OfflineCompilerSession::~OfflineCompilerSession () = default;
+
+std::vector<char> OfflineCompilerSession::compile (
     add_cref<std::string>           shaderCode,
     VkShaderStageFlagBits           shaderStage,
     add_cref<std::string>           entryPoint,
@@ -176,11 +229,10 @@ std::vector<char> compileShader (
     add_ref<bool>                   status)
 {
     std::vector<uint32_t> ispirv;
+    const spv_target_env targetEnv = makeSpvTargetEnv(vulkanVer, spirvVer);
 
     if (isGlsl)
     {
-        glslang::InitializeProcess();
-
         const EShLanguage lang = shaderStageToShLanguage(shaderStage);
         const int codeVersion = parseGlVersion(shaderCode);
         const EShMessages messages = EShMsgDefault;
@@ -214,25 +266,25 @@ std::vector<char> compileShader (
         progressRecorder.stamp("After glslang::TProgram::link()");
 
         glslang::GlslangToSpv(*program.getIntermediate(lang), ispirv);
-
-        glslang::FinalizeProcess();
     }
     else
     {
-        if (status = compileSpvShader(shaderCode, vulkanVer, spirvVer,
-                        errorCollection, progressRecorder, ispirv); false == status)
+        add_ref<spvtools::SpirvTools> tools = m_impl->getTools(targetEnv, errorCollection, "Assemble");
+        if (status = compileSpvShader(shaderCode, tools, progressRecorder, ispirv); false == status)
             return {};
     }
 
     if (genDisassmebly)
     {
-        if (status = generateDisassembly(ispirv, asmPath, vulkanVer, spirvVer, disassembled, errorCollection, progressRecorder),
+        add_ref<spvtools::SpirvTools> tools = m_impl->getTools(targetEnv, errorCollection, "disassembly");
+        if (status = generateDisassembly(ispirv, asmPath, tools, disassembled, progressRecorder),
             false == status) return {};
     }
 
     if (enableValidation)
     {
-        if (status = validateSpirv(ispirv, vulkanVer, spirvVer, validationOptions, errorCollection, progressRecorder), false == status)
+        add_ref<spvtools::SpirvTools> tools = m_impl->getTools(targetEnv, errorCollection, "validation");
+        if (status = validateSpirv(ispirv, tools, validationOptions, progressRecorder), false == status)
             return {};
     }
 
@@ -247,24 +299,45 @@ std::vector<char> compileShader (
     return cspirv;
 }
 
+std::vector<char> compileShader (
+    add_cref<std::string>           shaderCode,
+    VkShaderStageFlagBits           shaderStage,
+    add_cref<std::string>           entryPoint,
+    bool                            isGlsl,
+    bool                            enableValidation,
+    add_cref<std::string>           validationOptions,
+    bool                            genDisassmebly,
+    add_cref<Version>               vulkanVer,
+    add_cref<Version>               spirvVer,
+    add_cref<fs::path>              binPath,
+    add_cref<fs::path>              asmPath,
+    add_ref<std::vector<char>>      disassembled,
+    add_ref<std::stringstream>      errorCollection,
+    add_ref<vtf::ProgressRecorder>  progressRecorder,
+    add_ref<bool>                   status)
+{
+    return OfflineCompilerSession::forThisThread().compile(shaderCode, shaderStage, entryPoint, isGlsl,
+                enableValidation, validationOptions, genDisassmebly, vulkanVer, spirvVer, binPath, asmPath,
+                disassembled, errorCollection, progressRecorder, status);
+}
+
+std::string getOfflineCompilerSignature ()
+{
+    const glslang::Version version = glslang::GetVersion();
+    std::ostringstream ss;
+    ss << "glslang " << version.major << '.' << version.minor << '.' << version.patch << version.flavor
+       << ", " << spvSoftwareVersionString();
+    return ss.str();
+}
+
 } // namespace vtf
 
 static bool compileSpvShader (
     add_cref<std::string>           shaderCode,
-    add_cref<vtf::Version>          vulkanVer,
-    add_cref<vtf::Version>          spirvVer,
-    add_ref<std::stringstream>      errorCollection,
+    add_ref<spvtools::SpirvTools>   tools,
     add_ref<vtf::ProgressRecorder>  progressRecorder,
     add_ref<std::vector<uint32_t>>  binary)
 {
-    spvtools::SpirvTools tools(makeSpvTargetEnv(vulkanVer, spirvVer));
-    tools.SetMessageConsumer([&](spv_message_level_t level, add_cptr<char>,
-        add_cref<spv_position_t> position, add_cptr<char>message) {
-            UNREF(level);
-            errorCollection << "SPIR-V Assemble: " << message
-                << " at line " << position.index << std::endl;
-        });
-
     progressRecorder.stamp("Before spvtools::SpirvTools::Assemble()");
     const bool result = tools.Assemble(shaderCode, &binary);
     progressRecorder.stamp("After spvtools::SpirvTools::Assemble()");
@@ -274,20 +347,10 @@ static bool compileSpvShader (
 
 static bool validateSpirv (
     add_cref<std::vector<uint32_t>> binary,
-    add_cref<vtf::Version>          vulkanVer,
-    add_cref<vtf::Version>          spirvVer,
+    add_ref<spvtools::SpirvTools>   tools,
     add_cref<std::string>           validationOptions,
-    add_ref<std::stringstream>      errorCollection,
     add_ref<vtf::ProgressRecorder>  progressRecorder)
 {
-    spvtools::SpirvTools tools(makeSpvTargetEnv(vulkanVer, spirvVer));
-    tools.SetMessageConsumer([&](spv_message_level_t level, add_cptr<char>,
-        add_cref<spv_position_t> position, add_cptr<char>message) {
-            UNREF(level);
-            errorCollection << "SPIR-V validation: " << message
-                << " at line " << position.index << std::endl;
-        });
-
     spv_validator_options options = spvValidatorOptionsCreate();
     if (validationOptions.find("--scalar-block-layout") != std::string::npos)
     {
@@ -298,26 +361,18 @@ static bool validateSpirv (
     const bool result =  tools.Validate(binary.data(), binary.size(), options);
     progressRecorder.stamp("After spvtools::SpirvTools::Validate()");
 
+    spvValidatorOptionsDestroy(options);
+
     return result;
 }
 
 static bool generateDisassembly (
     add_cref<std::vector<uint32_t>> binary,
     add_cref<fs::path>              asmPath,
-    add_cref<vtf::Version>          vulkanVer,
-    add_cref<vtf::Version>          spirvVer,
+    add_ref<spvtools::SpirvTools>   tools,
     add_ref<std::vector<char>>      disassembled,
-    add_ref<std::stringstream>      errorCollection,
     add_ref<vtf::ProgressRecorder>  progressRecorder)
 {
-    spvtools::SpirvTools tools(makeSpvTargetEnv(vulkanVer, spirvVer));
-    tools.SetMessageConsumer([&](spv_message_level_t level, add_cptr<char>,
-        add_cref<spv_position_t> position, add_cptr<char>message) {
-            UNREF(level);
-            errorCollection << "SPIR-V disassembly: " << message
-                << " at line " << position.index << std::endl;
-        });
-
     std::string disassemble;
     progressRecorder.stamp("Before spvtools::SpirvTools::Disassemble()");
     const bool result = tools.Disassemble(binary, &disassemble);
@@ -148,18 +148,23 @@ GlobalAppFlags::GlobalAppFlags()
 	, vtfAsDllInstance			(0)
 	, verbose					(0)
 	, compilerIndex				(0)
+	, spirvCacheSize			(256)
+	, headlessFrames			(0)
 	, tmpDir					()
 	, cmdSignature				()
 	, assetsPath				()
 	, thisAppPath				()
 	, vulkanDriver				()
 	, spirvValArgs				()
+	, headlessDumpDir			()
 	, spirvValidate				(false)
 	, genSpirvDisassembly		(false)
 	, nowerror					(false)
     , debugPrintfEnabled        (false)
     , noWarning_VUID_Undefined  (false)
 	, assertWait				(false)
+	, pipelineCache				(true)
+	, objectCache				(true)
 {
 }
 
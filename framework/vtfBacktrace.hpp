@@ -45,18 +45,23 @@ struct GlobalAppFlags
 	uint32_t		vtfAsDllInstance;
 	uint32_t		verbose;
 	uint32_t		compilerIndex;
+	uint32_t		spirvCacheSize; // in MiB, 0 disables SPIR-V cache
+	uint32_t		headlessFrames; // Canvas renders that many frames without a window, 0 means windowed
 	char			tmpDir[_MAX_PATH];
 	std::string		cmdSignature; // filled in main.cpp::parseParams
 	std::string		assetsPath;
 	std::string		thisAppPath;
 	std::string		vulkanDriver;
 	std::string		spirvValArgs;
+	std::string		headlessDumpDir; // headless frames are saved there if not empty
 	bool			spirvValidate;
 	bool			genSpirvDisassembly;
 	bool			nowerror;
 	bool			debugPrintfEnabled;
 	bool			noWarning_VUID_Undefined;
 	bool			assertWait;
+	bool			pipelineCache; // persistent pipeline cache of the device and shader object binary cache
+	bool			objectCache; // samplers, views, render passes and framebuffers shared per create info
 
 	GlobalAppFlags ();
 };
@@ -1,9 +1,13 @@
+#include <algorithm>
 #include <array>
 #include <functional>
 #include <thread>
 #include <chrono>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <optional>
+#include <sstream>
 #include <vulkan/vulkan.h>
 #include "GLFW/glfw3.h"
 #include "vtfCUtils.hpp"
@@ -15,7 +19,10 @@
 #include "vtfBacktrace.hpp"
 #include "vtfThreadSafeLogger.hpp"
 #include "vtfFormatUtils.hpp"
+#include "vtfStructUtils.hpp"
 #include "vtfVulkanDriver.hpp"
+#include "vtfTexelConversion.hpp"
+#include "vtfFilesystem.hpp"
 
 #if 0
 #if SYSTEM_OS_WINDOWS == 1
@@ -90,7 +97,9 @@ void closeWindow(ZGLFWwindowPtr window);
 
 void CanvasContext::closeWindow ()
 {
-	::vtf::closeWindow(*cc_window);
+	if (cc_headless)
+		cc_closeRequested = true;
+	else ::vtf::closeWindow(*cc_window);
 }
 
 Canvas::~Canvas	()
@@ -114,12 +123,20 @@ const CanvasStyle Canvas::DefaultStyle
 	0,		// surfaceFormatFlags
 	3,		// acquirableImageCount
 	true,	// submitRenderWithFence
+	2,		// framesInFlight
+	false,	// busyLoop
+	10,		// idleTimeoutMS
+	0,		// maxFrameRate
 };
 
 strings			getGlfwRequiredInstanceExtensions ();
 void			closeWindow (ZGLFWwindowPtr window);
 ZGLFWwindowPtr	createWindow (const CanvasStyle& style, const char* title, add_ptr<void> windowUserPointer);
 ZSurfaceKHR		createSurface (ZInstance instance, VkAllocationCallbacksPtr callbacks, ZGLFWwindowPtr window);
+ZGLFWwindowPtr	createCanvasWindow (bool headless, const CanvasStyle& style, const char* title, add_ptr<void> windowUserPointer);
+ZSurfaceKHR		createCanvasSurface (bool headless, ZInstance instance, VkAllocationCallbacksPtr callbacks, ZGLFWwindowPtr window);
+strings			getCanvasRequiredInstanceExtensions (bool headless);
+bool			deviceTimelineSemaphoreEnabled (ZDevice device);
 ZGLFWwindowPtr	updateWindow (ZGLFWwindowPtr window, const CanvasStyle& style, const char* title, add_ptr<void> windowUserPointer);
 
 CanvasContext::CanvasContext (add_cptr<char>		appName,
@@ -131,15 +148,17 @@ CanvasContext::CanvasContext (add_cptr<char>		appName,
 							  bool					enableDebugPrintf,
 							  add_cref<CanvasStyle>	style,
 							  add_ptr<Canvas>		canvas)
-	: cc_callbacks		(getAllocationCallbacks())
-	, cc_glfw			(ZInstance())
+	: cc_headless		(getGlobalAppFlags().headlessFrames != 0u)
+	, cc_closeRequested	(false)
+	, cc_callbacks		(getAllocationCallbacks())
+	, cc_glfw			(ZInstance(), !cc_headless)
 	, cc_instance		(getSharedInstance() | ([&,this]() -> ZInstance {
 							return createInstance(appName, cc_callbacks, instanceLayers,
-												  mergeStringsDistinct(getGlfwRequiredInstanceExtensions(), instanceExtensions),
+												  mergeStringsDistinct(getCanvasRequiredInstanceExtensions(cc_headless), instanceExtensions),
 												  apiVersion, enableDebugPrintf);
 							 }))
-	, cc_window			(createWindow(style, appName, canvas))
-	, cc_surface		(createSurface(cc_instance, cc_callbacks, cc_window))
+	, cc_window			(createCanvasWindow(cc_headless, style, appName, canvas))
+	, cc_surface		(createCanvasSurface(cc_headless, cc_instance, cc_callbacks, cc_window))
 	, cc_physicalDevice	(getSharedInstance().select(getSharedPhysicalDevice(), ([&,this]() -> ZPhysicalDevice {
 								return selectPhysicalDevice(make_signed(getGlobalAppFlags().physicalDeviceIndex),
 															cc_instance, deviceExtensions, cc_surface);
@@ -155,11 +174,13 @@ CanvasContext::CanvasContext	(ZPhysicalDevice		physicalDevice,
 								 bool					enableDebugPrintf,
 								 add_cref<CanvasStyle>	style,
 								 add_ptr<Canvas>		canvas)
-	: cc_callbacks(physicalDevice.getParam<VkAllocationCallbacksPtr>())
-	, cc_glfw(physicalDevice.getParam<ZInstance>())
+	: cc_headless(getGlobalAppFlags().headlessFrames != 0u)
+	, cc_closeRequested(false)
+	, cc_callbacks(physicalDevice.getParam<VkAllocationCallbacksPtr>())
+	, cc_glfw(physicalDevice.getParam<ZInstance>(), !cc_headless)
 	, cc_instance(physicalDevice.getParam<ZInstance>())
-	, cc_window(createWindow(style, cc_instance.getParamRef<std::string>().c_str(), canvas))
-	, cc_surface(createSurface(cc_instance, cc_callbacks, cc_window))
+	, cc_window(createCanvasWindow(cc_headless, style, cc_instance.getParamRef<std::string>().c_str(), canvas))
+	, cc_surface(createCanvasSurface(cc_headless, cc_instance, cc_callbacks, cc_window))
 	, cc_physicalDevice(physicalDevice)
 	, cc_device(createLogicalDevice(cc_physicalDevice, onEnablingFeatures, cc_surface, enableDebugPrintf))
 {
@@ -192,6 +213,7 @@ Canvas::Canvas	(add_cptr<char>			appName,
 	, width						(m_width)
 	, height					(m_height)
 	, presentQueue				(m_presentQueue)
+	, frameStats				(m_frameStats)
 	// end of references initialization
 	, m_surfaceDetails			()
 	, m_surfaceFormatIndex		(INVALID_UINT32)
@@ -199,12 +221,17 @@ Canvas::Canvas	(add_cptr<char>			appName,
 	, m_width					(style.width)
 	, m_height					(style.height)
 	, m_currentFrame			(0u)
+	, m_renderedFrames			(0u)
 	, m_presentQueue			(queueSupportSwapchain(graphicsQueue)
 									? graphicsQueue
 									: deviceGetNextQueue(device, VK_QUEUE_GRAPHICS_BIT, true))
+	, m_frameStats				()
+	, m_framesInFlight			()
+	, m_timeline				()
+	, m_timelineValue			(0u)
+	, m_timestampMask			(0u)
 	, m_events					(new GLFWEvents(*this))
-	, m_timerUserData			(nullptr)
-	, m_timerPeriodMS			(0)
+	, m_wakeUps					(!cc_headless)
 {
 	construct();
 }
@@ -225,6 +252,7 @@ Canvas::Canvas	(ZPhysicalDevice		physicalDevice,
 	, width					(m_width)
 	, height				(m_height)
 	, presentQueue			(m_presentQueue)
+	, frameStats			(m_frameStats)
 	// end of references initialization
 	, m_surfaceDetails		()
 	, m_surfaceFormatIndex	(INVALID_UINT32)
@@ -232,12 +260,17 @@ Canvas::Canvas	(ZPhysicalDevice		physicalDevice,
 	, m_width				(style.width)
 	, m_height				(style.height)
 	, m_currentFrame		(0u)
+	, m_renderedFrames		(0u)
 	, m_presentQueue		(queueSupportSwapchain(graphicsQueue)
 								? graphicsQueue
 								: deviceGetNextQueue(device, VK_QUEUE_GRAPHICS_BIT, true))
+	, m_frameStats			()
+	, m_framesInFlight		()
+	, m_timeline			()
+	, m_timelineValue		(0u)
+	, m_timestampMask		(0u)
 	, m_events				(new GLFWEvents(*this))
-	, m_timerUserData		(nullptr)
-	, m_timerPeriodMS		(0)
+	, m_wakeUps				(!cc_headless)
 {
 	construct();
 }
@@ -296,6 +329,20 @@ ZGLFWwindowPtr createWindow (const CanvasStyle& style, const char* title, add_pt
 	return window;
 }
 
+strings getCanvasRequiredInstanceExtensions (bool headless)
+{
+	if (headless)
+	{
+		return { VK_KHR_SURFACE_EXTENSION_NAME, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME };
+	}
+	return getGlfwRequiredInstanceExtensions();
+}
+
+ZGLFWwindowPtr createCanvasWindow (bool headless, const CanvasStyle& style, const char* title, add_ptr<void> windowUserPointer)
+{
+	return headless ? ZGLFWwindowPtr() : createWindow(style, title, windowUserPointer);
+}
+
 ZGLFWwindowPtr updateWindow (ZGLFWwindowPtr window, const CanvasStyle& style, const char* title, add_ptr<void> windowUserPointer)
 {
 	const char* caption = title ? title : "Vulkan";
@@ -327,6 +374,26 @@ ZSurfaceKHR	createSurface (ZInstance instance, VkAllocationCallbacksPtr callback
 	return ZSurfaceKHR::create(surface, instance, callbacks, window.asSharedPtr());
 }
 
+// Headless surfaces have no extent of their own, swapchains take the one from CanvasStyle
+ZSurfaceKHR createCanvasSurface (bool headless, ZInstance instance, VkAllocationCallbacksPtr callbacks, ZGLFWwindowPtr window)
+{
+	if (false == headless)
+	{
+		return createSurface(instance, callbacks, window);
+	}
+
+	add_cref<ZInstanceInterface> ii = instance.getInterface();
+	VkHeadlessSurfaceCreateInfoEXT createInfo = makeVkStruct();
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
+	VKASSERTMSG(VTF_CALL_CHECK(ii.vkCreateHeadlessSurfaceEXT, *instance, &createInfo, callbacks, &surface),
+				"Unable to create headless surface, is " VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME " available?");
+	if (getGlobalAppFlags().verbose)
+	{
+		std::cout << "[INFO] " << __func__ << ' ' << surface << " (headless)" << std::endl;
+	}
+	return ZSurfaceKHR::create(surface, instance, callbacks, std::weak_ptr<ZGLFWwindowPtr::AnObject>());
+}
+
 Canvas::SurfaceDetails::SurfaceDetails ()
 	: caps		()
 	, formats	()
@@ -640,10 +707,192 @@ void Canvas::updateExtent ()
 	VkSurfaceCapabilitiesKHR caps;
 	add_cref<ZInstanceInterface> ii = physicalDevice.getParam<ZInstance>().getInterface();
 	VKASSERT(VTF_CALL_CHECK(ii.vkGetPhysicalDeviceSurfaceCapabilitiesKHR, *physicalDevice, *surface, &caps));
+	// Surfaces whose extent is determined by the swapchain, e.g. headless ones
+	if (caps.currentExtent.width == INVALID_UINT32 || caps.currentExtent.height == INVALID_UINT32)
+	{
+		return;
+	}
 	m_width = caps.currentExtent.width;
 	m_height = caps.currentExtent.height;
 }
 
+bool Canvas::shouldClose () const
+{
+	if (cc_headless)
+	{
+		return cc_closeRequested || m_renderedFrames >= getGlobalAppFlags().headlessFrames;
+	}
+	return glfwWindowShouldClose(*window) != GLFW_FALSE;
+}
+
+void Canvas::postTask (OnWakeUp task)
+{
+	m_wakeUps.postTask([this, task]() { task(*this); });
+}
+
+void Canvas::wakeUp ()
+{
+	m_wakeUps.wakeUp();
+}
+
+void Canvas::setTimer (uint32_t periodMS, OnWakeUp onTimer)
+{
+	if (onTimer)
+		m_wakeUps.setTimer(periodMS, [this, onTimer]() { onTimer(*this); });
+	else
+		m_wakeUps.setTimer(0u, {});
+}
+
+void Canvas::watchFile (add_cref<std::string> fileName, OnWakeUp onChange)
+{
+	m_wakeUps.watchFile(fileName, [this, onChange]() { onChange(*this); });
+}
+
+// The image comes from a presentation render pass so it is expected in PRESENT_SRC_KHR layout,
+// it is saved as binary PPM, components the format lacks are written as 0, alpha is dropped.
+void Canvas::dumpFrame (ZImage image, ZCommandPool commandPool) const
+{
+	const VkImageLayout presentLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	add_cref<VkImageCreateInfo> createInfo = imageGetCreateInfo(image);
+	ZBuffer storage = createBuffer(image, ZBufferUsageFlags(VK_BUFFER_USAGE_TRANSFER_DST_BIT), ZMemoryPropertyHostFlags);
+	imageResetLayout(image, presentLayout);
+	{
+		auto shotCommand = createOneShotCommandBuffer(commandPool);
+		imageCopyToBuffer(shotCommand->commandBuffer, image, storage,
+						  VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_NONE,
+						  VK_ACCESS_NONE, VK_ACCESS_HOST_READ_BIT,
+						  VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+						  presentLayout);
+	}
+	imageResetLayout(image, VK_IMAGE_LAYOUT_UNDEFINED);
+
+	const uint32_t		texelCount	= createInfo.extent.width * createInfo.extent.height;
+	std::vector<uint8_t> texels;
+	bufferRead(storage, texels);
+	std::vector<float>	values		(std::size_t(texelCount) * 4u);
+	formatConvertToFloat4(createInfo.format, texels.data(), texelCount, values.data());
+
+	std::vector<uint8_t> rgb(std::size_t(texelCount) * 3u);
+	for (uint32_t t = 0u; t < texelCount; ++t)
+	{
+		for (uint32_t c = 0u; c < 3u; ++c)
+		{
+			const float value = std::clamp(values[t * 4u + c], 0.0f, 1.0f);
+			rgb[t * 3u + c] = static_cast<uint8_t>(value * 255.0f + 0.5f);
+		}
+	}
+
+	const fs::path directory(getGlobalAppFlags().headlessDumpDir);
+	fs::create_directories(directory);
+	std::ostringstream name;
+	name << "frame" << std::setw(5) << std::setfill('0') << m_renderedFrames << ".ppm";
+	std::ofstream file((directory / name.str()).string(), std::ios::binary);
+	ASSERTMSG(file.is_open(), "Unable to create ", (directory / name.str()).string());
+	file << "P6\n" << createInfo.extent.width << ' ' << createInfo.extent.height << "\n255\n";
+	file.write(reinterpret_cast<add_cptr<char>>(rgb.data()), std::streamsize(rgb.size()));
+}
+
+void Canvas::FrameStats::Value::add (double value)
+{
+	min		= count ? std::min(min, value) : value;
+	max		= count ? std::max(max, value) : value;
+	total	+= value;
+	last	= value;
+	count	+= 1u;
+}
+
+// createLogicalDevice() enables the extension only together with the feature
+bool deviceTimelineSemaphoreEnabled (ZDevice device)
+{
+	add_cref<strings> extensions = device.getParamRef<ZDistType<EnabledDeviceExtensions, strings>>().get();
+	if (false == containsString(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, extensions))
+		return false;
+	VkPhysicalDeviceTimelineSemaphoreFeatures features = makeVkStruct();
+	deviceGetPhysicalFeatures2(device.getParam<ZPhysicalDevice>(), &features);
+	return VK_FALSE != features.timelineSemaphore;
+}
+
+void Canvas::createFramesInFlight (ZCommandPool commandPool, uint32_t frameCount)
+{
+	m_frameStats				= FrameStats();
+	m_frameStats.framesInFlight	= style.submitRenderWithFence ? 1u : frameCount;
+	m_frameStats.timeline		= deviceTimelineSemaphoreEnabled(device);
+	m_timeline					= m_frameStats.timeline ? createTimelineSemaphore(device, m_timelineValue) : ZSemaphore();
+
+	const uint32_t queueFamilyIndex = queueGetFamilyIndex(commandPool.getParam<ZQueue>());
+	add_cref<ZInstanceInterface> ii = instance.getInterface();
+	uint32_t queueFamilyCount = 0u;
+	VTF_CALL_CHECK(ii.vkGetPhysicalDeviceQueueFamilyProperties, *physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	VTF_CALL_CHECK(ii.vkGetPhysicalDeviceQueueFamilyProperties, *physicalDevice, &queueFamilyCount, queueFamilies.data());
+	const uint32_t timestampBits = queueFamilies.at(queueFamilyIndex).timestampValidBits;
+	m_timestampMask = (timestampBits >= 64u) ? INVALID_UINT64 : ((uint64_t(1) << timestampBits) - 1u);
+
+	add_cref<ZDeviceInterface> di = device.getInterface();
+	m_framesInFlight.resize(frameCount);
+	for (add_ref<FrameInFlight> frame : m_framesInFlight)
+	{
+		frame.submitValue	= 0u;
+		frame.fence			= m_frameStats.timeline ? ZFence() : createFence(device);
+		if (timestampBits)
+		{
+			// Recorded once, submitted around the render command buffer of each frame
+			frame.timestamps	= createQueryPool(device, VK_QUERY_TYPE_TIMESTAMP, 0u, 2u);
+			frame.beginStamp	= createCommandBuffer(commandPool);
+			frame.endStamp		= createCommandBuffer(commandPool);
+			commandBufferBegin(frame.beginStamp, VkCommandBufferUsageFlags(0));
+				commandBufferResetQueryPool(frame.beginStamp, frame.timestamps);
+				VTF_CALL_CHECK(di.vkCmdWriteTimestamp, *frame.beginStamp, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, *frame.timestamps, 0u);
+			commandBufferEnd(frame.beginStamp);
+			commandBufferBegin(frame.endStamp, VkCommandBufferUsageFlags(0));
+				VTF_CALL_CHECK(di.vkCmdWriteTimestamp, *frame.endStamp, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, *frame.timestamps, 1u);
+			commandBufferEnd(frame.endStamp);
+		}
+	}
+}
+
+bool Canvas::retireFrameInFlight (uint32_t frameIndex, bool wait)
+{
+	add_ref<FrameInFlight> frame = m_framesInFlight.at(frameIndex);
+	if (0u == frame.submitValue)
+		return true;
+
+	if (m_timeline.has_handle())
+	{
+		if (wait)
+			semaphoreWait(m_timeline, frame.submitValue);
+		else if (semaphoreGetCounterValue(m_timeline) < frame.submitValue)
+			return false;
+	}
+	else
+	{
+		if (wait)
+			waitForFence(frame.fence);
+		else if (false == fenceStatus(frame.fence))
+			return false;
+		resetFence(frame.fence);
+	}
+	frame.submitValue = 0u;
+
+	const std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - frame.acquired;
+	m_frameStats.latency.add(latency.count());
+
+	if (frame.timestamps.has_handle())
+	{
+		uint64_t ticks[2]{};
+		add_cref<ZDeviceInterface> di = device.getInterface();
+		const VkResult res = VTF_CALL_CHECK(di.vkGetQueryPoolResults, *device, *frame.timestamps, 0u, 2u,
+											sizeof(ticks), ticks, VkDeviceSize(sizeof(uint64_t)), VK_QUERY_RESULT_64_BIT);
+		if (VK_SUCCESS == res)
+		{
+			const double period = double(deviceGetPhysicalLimits(device).timestampPeriod);
+			m_frameStats.gpu.add(double((ticks[1] - ticks[0]) & m_timestampMask) * period / 1000000.0);
+		}
+	}
+
+	return true;
+}
+
 add_ptr<Canvas::BackBuffer> Canvas::acquireBackBuffer (
 	add_ref<std::vector<BackBuffer>>	buffers,
 	add_ptr<std::mutex>				buffersMutex,
@@ -681,6 +930,12 @@ add_ptr<Canvas::BackBuffer> Canvas::acquireBackBuffer (
 	{
 		m_currentFrame = (m_currentFrame + 1u) % data_count(buffers);
 		buffer = &buffers.data()[m_currentFrame];
+		// Its acquire semaphore and command buffer are still in use until the frame completes
+		if (m_currentFrame < data_count(m_framesInFlight))
+		{
+			retireFrameInFlight(m_currentFrame, true);
+			m_framesInFlight[m_currentFrame].acquired = std::chrono::steady_clock::now();
+		}
 	}
 
 	add_cref<ZDeviceInterface> di = device.getInterface();
@@ -861,22 +1116,41 @@ void Canvas::render	(add_ref<Swapchain>					swapchain,
 	}
 	else
 	{
+		const uint32_t				frameIndex		= m_currentFrame;
+		add_ref<FrameInFlight>		frame			= m_framesInFlight.at(frameIndex);
+		const bool					stamps			= frame.timestamps.has_handle();
+		const bool					timeline		= m_timeline.has_handle();
+		const VkCommandBuffer		commandBuffers[3] { (stamps ? *frame.beginStamp : VK_NULL_HANDLE),
+														*buffer.renderCommand,
+														(stamps ? *frame.endStamp : VK_NULL_HANDLE) };
+		const VkSemaphore			signalSemaphores[2] { *buffer.renderSemaphore, (timeline ? *m_timeline : VK_NULL_HANDLE) };
+		const uint64_t				waitValues[1] { 0u };
+		const uint64_t				signalValues[2] { 0u, (m_timelineValue + 1u) };
+		VkTimelineSemaphoreSubmitInfo timelineInfo = makeVkStruct();
+		timelineInfo.waitSemaphoreValueCount	= 1u;
+		timelineInfo.pWaitSemaphoreValues		= waitValues;
+		timelineInfo.signalSemaphoreValueCount	= 2u;
+		timelineInfo.pSignalSemaphoreValues		= signalValues;
+
 		VkSubmitInfo renderSubmitInfo{};
 		singleRenderStageMask	= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
 		renderSubmitInfo.sType					= VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		renderSubmitInfo.pNext					= nullptr;
-		renderSubmitInfo.commandBufferCount		= 1;
-		renderSubmitInfo.pCommandBuffers		= buffer.renderCommand.ptr();
+		renderSubmitInfo.pNext					= timeline ? &timelineInfo : nullptr;
+		renderSubmitInfo.commandBufferCount		= stamps ? 3u : 1u;
+		renderSubmitInfo.pCommandBuffers		= stamps ? commandBuffers : buffer.renderCommand.ptr();
 		renderSubmitInfo.pWaitDstStageMask		= &singleRenderStageMask;
 		renderSubmitInfo.waitSemaphoreCount		= 1;
 		renderSubmitInfo.pWaitSemaphores		= buffer.acquireSemaphore.ptr();
-		renderSubmitInfo.signalSemaphoreCount	= 1;
-		renderSubmitInfo.pSignalSemaphores		= buffer.renderSemaphore.ptr();
+		renderSubmitInfo.signalSemaphoreCount	= timeline ? 2u : 1u;
+		renderSubmitInfo.pSignalSemaphores		= signalSemaphores;
 
 		ZFramebuffer framebuffer(swapchain.framebuffers[buffer.imageIndex]);
 		commandBufferReset(buffer.renderCommand);
+		const auto recordStart = std::chrono::steady_clock::now();
 		onCommandRecording(std::ref(*this), swapchain, buffer.renderCommand, framebuffer);
+		const std::chrono::duration<double, std::milli> recordTime = std::chrono::steady_clock::now() - recordStart;
+		m_frameStats.cpuRecord.add(recordTime.count());
 		imageResetLayout(framebufferGetImage(framebuffer), VK_IMAGE_LAYOUT_UNDEFINED);
 
 		if (getGlobalAppFlags().verbose > 9)
@@ -887,12 +1161,23 @@ void Canvas::render	(add_ref<Swapchain>					swapchain,
 					  << std::endl;
 		}
 		ZQueue queue = buffer.renderCommand.getParam<ZCommandPool>().getParam<ZQueue>();
-		VkFence submitFence = style.submitRenderWithFence ? *buffer.renderFence : VK_NULL_HANDLE;
-		VKASSERT(VTF_CALL_CHECK(di.vkQueueSubmit, *queue, 1u, &renderSubmitInfo, submitFence));
-		if (style.submitRenderWithFence)
+		VKASSERT(VTF_CALL_CHECK(di.vkQueueSubmit, *queue, 1u, &renderSubmitInfo, (frame.fence.has_handle() ? *frame.fence : VK_NULL_HANDLE)));
+		frame.submitValue = ++m_timelineValue;
+
+		// Frames that completed meanwhile are accounted as soon as possible to keep their latency precise
+		for (uint32_t i = 1u; i < data_count(m_framesInFlight); ++i)
+		{
+			retireFrameInFlight(((frameIndex + i) % data_count(m_framesInFlight)), false);
+		}
+
+		if (style.submitRenderWithFence || (cc_headless && false == getGlobalAppFlags().headlessDumpDir.empty()))
 		{
-			VKASSERT(VTF_CALL_CHECK(di.vkWaitForFences, *device, 1u, buffer.renderFence.ptr(), VK_TRUE, INVALID_UINT64));
-			resetFence(buffer.renderFence);
+			retireFrameInFlight(frameIndex, true);
+		}
+
+		if (cc_headless && false == getGlobalAppFlags().headlessDumpDir.empty())
+		{
+			dumpFrame(framebufferGetImage(framebuffer), buffer.renderCommand.getParam<ZCommandPool>());
 		}
 	}
 
@@ -902,6 +1187,7 @@ void Canvas::render	(add_ref<Swapchain>					swapchain,
 	}
 
 	presentBackBuffer(buffer, swapchain, readyBuffersStack, readyBuffersStackMutex, readyBufferCondition, backBuffers, false);
+	m_renderedFrames += 1u;
 }
 
 void thread_body	(add_ref<std::queue<Canvas::BackBuffer>>	readyBufferStack,
@@ -1102,31 +1388,63 @@ int Canvas::run (OnCommandRecording				onCommandRecording,
 													? renderPass
 													: createSinglePresentationRenderPass();
 
-	swapchain.recreate(rp, backBufferCount, 0, 0, true);
-	for (uint32_t i = 0; i < backBufferCount; ++i)
+	// Serialized frames rotate through as many back buffers as before, they are always idle when reused
+	const uint32_t			frameCount			= style.submitRenderWithFence
+													? backBufferCount
+													: std::max(1u, style.framesInFlight);
+
+	swapchain.recreate(rp, backBufferCount, m_width, m_height, true);
+	for (uint32_t i = 0; i < frameCount; ++i)
 	{
 		backBuffers.emplace_back(graphicsPool, graphicsPool);
 	}
+	createFramesInFlight(graphicsPool, frameCount);
 
-	if (style.visible) glfwShowWindow(*cc_window);
+	if (style.visible && !cc_headless) glfwShowWindow(*cc_window);
+
+	typedef WakeUpQueue::clock clock;
+	const bool				continuous			= (&m_drawTrigger == &drawTrigger.get());
+	const clock::duration	framePeriod			= style.maxFrameRate
+													? std::chrono::duration_cast<clock::duration>(
+														std::chrono::duration<double>(1.0 / double(style.maxFrameRate)))
+													: clock::duration::zero();
+	clock::time_point		nextFrame			= clock::now();
 
-	while (!glfwWindowShouldClose(*window))
+	const auto startTime = clock::now();
+	while (!shouldClose())
 	{
-		glfwPollEvents();
+		if (!cc_headless)
+		{
+			// Sleep only if there is nothing to draw, a pending draw or the busy loop just polls
+			if (style.busyLoop || continuous || drawTrigger > 0)
+				glfwPollEvents();
+			else
+				m_wakeUps.wait(onIdle ? style.idleTimeoutMS : WakeUpQueue::NoTimeout);
+		}
 
-		if (&m_drawTrigger != &drawTrigger.get())
+		m_wakeUps.dispatch();
+
+		if (!continuous)
 		{
 			if (onIdle)
 			{
 				onIdle(*this, drawTrigger);
 			}
 
-			if (drawTrigger <= 0)
+			// Without events nothing would trigger a draw
+			if (drawTrigger <= 0 && !cc_headless)
 			{
-				std::this_thread::yield();
+				if (style.busyLoop) std::this_thread::yield();
 				continue;
 			}
-			--drawTrigger;
+			if (drawTrigger > 0) --drawTrigger;
+		}
+
+		if (style.maxFrameRate)
+		{
+			// Events are still handled while the next frame slot is awaited
+			if (false == m_wakeUps.sleepUntil(nextFrame, [&]() { return shouldClose(); })) continue;
+			nextFrame = clock::now() + framePeriod;
 		}
 
 		render	(swapchain,
@@ -1146,6 +1464,25 @@ int Canvas::run (OnCommandRecording				onCommandRecording,
 
 	add_cref<ZDeviceInterface> di = device.getInterface();
 	VTF_CALL_CHECK(di.vkQueueWaitIdle, *presentQueue);
+	for (uint32_t i = 0u; i < frameCount; ++i)
+	{
+		retireFrameInFlight(i, true);
+	}
+
+	if (cc_headless)
+	{
+		const std::chrono::duration<double, std::milli> duration = clock::now() - startTime;
+		logger << "[INFO] Headless: " << m_renderedFrames << " frames in " << duration.count() << " ms, "
+			   << (duration.count() > 0.0 ? (m_renderedFrames * 1000.0 / duration.count()) : 0.0) << " fps" << std::endl;
+	}
+	if (cc_headless || getGlobalAppFlags().verbose)
+	{
+		logger << "[INFO] Frames in flight: " << m_frameStats.framesInFlight
+			   << (m_frameStats.timeline ? " (timeline semaphore)" : " (fences)")
+			   << ", average cpu record: " << m_frameStats.cpuRecord.average() << " ms"
+			   << ", gpu: " << m_frameStats.gpu.average() << " ms"
+			   << ", latency: " << m_frameStats.latency.average() << " ms" << std::endl;
+	}
 
 	/*
 	* Depends on VK_KHR_PRESENT_WAIT_EXTENSION_NAME, "VK_KHR_present_wait"
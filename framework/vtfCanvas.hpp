@@ -7,7 +7,9 @@
 #include "vtfZImage.hpp"
 #include "vtfThreadSafeLogger.hpp"
 #include "vtfTemplateUtils.hpp"
+#include "vtfWakeUpQueue.hpp"
 
+#include <chrono>
 #include <condition_variable>
 #include <thread>
 #include <mutex>
@@ -39,11 +41,23 @@ struct CanvasStyle
 	bool					decorated;
 	VkFormatFeatureFlags	surfaceFormatFlags;
 	uint32_t				acquirableImageCount;
+	// If set then every frame is waited for right after its submission, otherwise up to
+	// framesInFlight frames are recorded ahead and each waits only before its resources are reused
 	bool					submitRenderWithFence;
+	uint32_t				framesInFlight;
+	// If set then events are polled and onIdle is called over and over even if there is nothing
+	// to draw, otherwise run() sleeps in glfwWaitEventsTimeout until an event, a posted task, the
+	// timer or a watched file wakes it up, with onIdle given it sleeps at most idleTimeoutMS
+	bool					busyLoop;
+	uint32_t				idleTimeoutMS;
+	uint32_t				maxFrameRate;	// frames per second, 0 means no cap
 };
 
 struct CanvasContext
 {
+	// Set with -headless, the surface comes from VK_EXT_headless_surface and there is no window
+	const bool					cc_headless;
+	bool						cc_closeRequested;
 	VkAllocationCallbacksPtr	cc_callbacks;
 	GlfwInitializerFinalizer	cc_glfw;
 	ZInstance					cc_instance;
@@ -165,6 +179,26 @@ public:
 
 	static const CanvasStyle DefaultStyle; // 800,600,0,1,true,true
 
+	// All times are in milliseconds, gathered by run(OnCommandRecording,...) since it has started
+	struct FrameStats
+	{
+		struct Value
+		{
+			uint32_t	count;
+			double		total;
+			double		min;
+			double		max;
+			double		last;
+			void		add		(double value);
+			double		average	() const { return count ? (total / double(count)) : 0.0; }
+		};
+		uint32_t	framesInFlight;
+		bool		timeline;	// pacing with a timeline semaphore, otherwise with fences
+		Value		cpuRecord;	// time spent in onCommandRecording
+		Value		gpu;		// from the beginning to the end of the frame commands, empty if the queue has no timestamps
+		Value		latency;	// from the acquisition of a back buffer until the frame is seen completed
+	};
+
 public:
 	// By default all device features are disabled so if you want to enable any of them, these must be
 	// known before logical device is created. To express the features you can use OnEnablingFeatures
@@ -205,6 +239,7 @@ public:
 	add_cref<uint32_t>			width;
 	add_cref<uint32_t>			height;
 	add_cref<ZQueue>			presentQueue;
+	add_cref<FrameStats>		frameStats;
 	uint32_t					getPresentQueueFamilyIndex () const;
 	ZRenderPass					createSinglePresentationRenderPass (add_cref<VkClearValue> = {}) const;
 	inline add_ref<GLFWEvents>	events () { return *m_events; }
@@ -215,7 +250,24 @@ public:
 	typedef std::function<void (add_ref<Canvas>, add_ref<int> drawTrigger)> OnIdle;
 	typedef std::function<void (add_ref<Canvas>, add_cref<Swapchain>, ZCommandBuffer, ZFramebuffer)> OnCommandRecording;
 	typedef std::function<ZImage (add_ref<Canvas>, add_cref<Swapchain>, ZCommandBuffer, uint32_t threadID)> OnSubcommandRecordingThenBlit;
-	int						run					(OnCommandRecording				onCommandRecording,
+	typedef std::function<void (add_ref<Canvas>)> OnWakeUp;
+
+	// Thread safe, the task is called from the thread of run() before the next frame
+	void	postTask	(OnWakeUp task);
+	// Thread safe, breaks waiting for events in run()
+	void	wakeUp		();
+	// Calls onTimer from run() every periodMS milliseconds, zero period removes the timer,
+	// unlike the above this and watchFile() must be called from the thread of run()
+	void	setTimer	(uint32_t periodMS, OnWakeUp onTimer);
+	// Calls onChange from run() whenever the modification time of the file changes,
+	// files are polled every WakeUpQueue::WatchPeriodMS milliseconds because GLFW has no such events
+	void	watchFile	(add_cref<std::string> fileName, OnWakeUp onChange);
+
+	// If drawTrigger is not positive after events and wake ups have been dispatched and onIdle has been
+	// called then nothing is drawn and the loop waits as CanvasStyle::busyLoop says, maxFrameRate caps draws.
+	// In headless mode there are no events, onIdle is still called but every iteration draws a frame
+	// until -headless <frames> are rendered or closeWindow() is called, -headless-dump saves them.
+	int						run				(OnCommandRecording				onCommandRecording,
 												 ZRenderPass					renderPass,
 												 std::reference_wrapper<int>	drawTrigger,
 												 OnIdle							onIdle = {},
@@ -232,6 +284,20 @@ public:
 
 protected:
 
+	// Per frame bookkeeping of run(OnCommandRecording,...) kept aside of the back buffer with the same index
+	struct FrameInFlight
+	{
+		uint64_t		submitValue;	// timeline value signaled by the last submission, 0 if nothing is pending
+		ZFence			fence;			// only if there is no timeline semaphore
+		ZQueryPool		timestamps;
+		ZCommandBuffer	beginStamp;
+		ZCommandBuffer	endStamp;
+		std::chrono::steady_clock::time_point	acquired;
+	};
+	void				createFramesInFlight	(ZCommandPool commandPool, uint32_t frameCount);
+	// Gathers statistics of the frame if it has completed, waits for that if wait is true
+	bool				retireFrameInFlight		(uint32_t frameIndex, bool wait);
+
 	add_ptr<BackBuffer>	acquireBackBuffer	(add_ref<std::vector<BackBuffer>>	buffers,
 											 add_ptr<std::mutex>				buffersMutex,
 											 add_ref<Swapchain>					swapchain,
@@ -252,6 +318,8 @@ protected:
 											 add_ptr<std::condition_variable>	readyBufferCondition,
 											 OnCommandRecording					onCommandRecording);
 	void				construct			();
+	bool				shouldClose			() const;
+	void				dumpFrame			(ZImage image, ZCommandPool commandPool) const;
 
 	friend struct GLFWEvents;
 
@@ -261,10 +329,15 @@ protected:
 	uint32_t						m_width;
 	uint32_t						m_height;
 	uint32_t						m_currentFrame;
+	uint32_t						m_renderedFrames;
 	ZQueue							m_presentQueue;
+	FrameStats						m_frameStats;
+	std::vector<FrameInFlight>		m_framesInFlight;
+	ZSemaphore						m_timeline;
+	uint64_t						m_timelineValue;
+	uint64_t						m_timestampMask;
 	std::unique_ptr<GLFWEvents>		m_events;
-	void*							m_timerUserData;
-	uint64_t						m_timerPeriodMS;
+	WakeUpQueue						m_wakeUps;
 	static int						m_drawTrigger;
 };
 
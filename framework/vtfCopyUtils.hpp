@@ -2,6 +2,7 @@
 #define __VTF_COPY_UTILS_HPP_INCLUDED__
 
 #include "vtfZCommandBuffer.hpp"
+#include "vtfUploadEngine.hpp"
 
 namespace vtf
 {
@@ -36,6 +37,11 @@ void				bufferCopyToImage	(ZCommandBuffer cmdBuffer, ZBuffer buffer, ZImage imag
 										 VkImageLayout finalImageLayout = VK_IMAGE_LAYOUT_GENERAL,
 										 uint32_t baseLevel = 0u, uint32_t levelCount = 1u,
 										 uint32_t baseLayer = 0u, uint32_t layerCount = 1u);
+// Records the copy into the engine, so it is submitted along with other uploads instead of on its own
+void				bufferCopyToImage	(add_ref<UploadEngine> engine, ZBuffer buffer, ZImage image,
+										 VkImageLayout finalImageLayout = VK_IMAGE_LAYOUT_GENERAL,
+										 uint32_t baseLevel = 0u, uint32_t levelCount = 1u,
+										 uint32_t baseLayer = 0u, uint32_t layerCount = 1u);
 void				imageCopyToImage	(ZCommandBuffer cmdBuffer, ZImage srcImage, ZImage dstImage,
 										 uint32_t srcArrayLayer, uint32_t arrayLayers, uint32_t dstArrayLayer,
 										 uint32_t srcMipLevel, uint32_t mipLevels, uint32_t dstMipLevel,
@@ -7,8 +7,10 @@
 #include "vtfTemplateUtils.hpp"
 #include "vtfZCommandBuffer.hpp"
 #include "vtfCopyUtils.hpp"
+#include "vtfDigest.hpp"
 #include <vulkan/vulkan_to_string.hpp>
 #include <iostream>
+#include <mutex>
 
 [[maybe_unused]] static std::pair<VkDescriptorType, VkBufferUsageFlagBits>
 const DescriptorTypeToBufferUsage[]
@@ -21,6 +23,166 @@ const DescriptorTypeToBufferUsage[]
 	{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT	},
 };
 
+namespace
+{
+using namespace vtf;
+
+constexpr uint32_t descriptorPageSetCount = 64u;
+
+// Mirrors ZSubAllocatedMemory, the handle belongs to the layout kept in the last parameter,
+// so the same VkDescriptorSetLayout may be shared while each layout carries its own descriptor set.
+struct ZSharedDescriptorSetLayout : ZDescriptorSetLayout
+{
+	ZSharedDescriptorSetLayout (ZDescriptorSetLayout owner, uint32_t identifier)
+		: ZDescriptorSetLayout(*owner, owner.getParam<ZDevice>(), owner.getParam<VkAllocationCallbacksPtr>(),
+							   owner.getParam<VkDescriptorSetLayoutCreateFlags>(), ZDescriptorSet(),
+							   ZDistType<LayoutIdentifier, uint32_t>(identifier), ZDistType<SomeOne, std::any>(owner))
+	{
+		super::get()->routine = nullptr;
+	}
+};
+
+struct ZSharedPipelineLayout : ZPipelineLayout
+{
+	ZSharedPipelineLayout (ZPipelineLayout owner, add_cref<std::vector<ZDescriptorSetLayout>> dsLayouts,
+						   add_cref<std::vector<type_index_with_default>> types)
+		: ZPipelineLayout(*owner, owner.getParam<ZDevice>(), owner.getParam<VkAllocationCallbacksPtr>(),
+						  owner.getParam<VkPipelineLayoutCreateFlags>(), dsLayouts,
+						  owner.getParam<std::vector<VkPushConstantRange>>(), types,
+						  owner.getParam<bool>(), ZDistType<SomeOne, std::any>(owner))
+	{
+		super::get()->routine = nullptr;
+	}
+};
+
+// Sets from pools without VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT go away along with their pool
+struct ZPooledDescriptorSet : ZDescriptorSet
+{
+	ZPooledDescriptorSet (ZDevice device, ZDescriptorPool pool, bool freeable)
+		: ZDescriptorSet(VK_NULL_HANDLE, device, pool)
+	{
+		if (false == freeable)
+		{
+			super::get()->routine = nullptr;
+		}
+	}
+};
+
+/**
+ * Per device cache of layouts and pages of descriptor sets. Layouts are keyed by a digest
+ * of their create info, pages are descriptor pools of many sets, their sizes follow the
+ * proportions of descriptor types requested so far. Everything is referenced weakly,
+ * so a layout or a page is destroyed along with the last object which uses it.
+ */
+struct DescriptorCache
+{
+	struct Pages
+	{
+		std::weak_ptr<ZDescriptorPool::AnObject>	current;
+		std::map<VkDescriptorType, uint64_t>		observedCounts;
+		uint64_t									observedSets = 0u;
+	};
+
+	std::mutex														mutex;
+	std::weak_ptr<ZDevice::AnObject>								device;
+	std::map<Digest::value_type, std::weak_ptr<ZDescriptorSetLayout::AnObject>>	setLayouts;
+	std::map<Digest::value_type, std::weak_ptr<ZPipelineLayout::AnObject>>		pipelineLayouts;
+	std::map<VkDescriptorPoolCreateFlags, Pages>					pages;
+	DescriptorCacheStats											stats{};
+};
+
+std::mutex descriptorCachesMutex;
+std::map<VkDevice, std::shared_ptr<DescriptorCache>> descriptorCaches;
+
+std::shared_ptr<DescriptorCache> getDescriptorCache (ZDevice device)
+{
+	std::lock_guard<std::mutex> lock(descriptorCachesMutex);
+	std::shared_ptr<DescriptorCache>& cache = descriptorCaches[*device];
+	if (!cache || cache->device.expired())
+	{
+		cache = std::make_shared<DescriptorCache>();
+		cache->device = device.asSharedPtr();
+	}
+	return cache;
+}
+
+ZDescriptorPool createDescriptorPool (ZDevice device, VkDescriptorPoolCreateFlags flags, uint32_t maxSets,
+									  add_cref<std::map<VkDescriptorType, uint32_t>> typesNsizes)
+{
+	add_cref<ZDeviceInterface>			di			= device.getInterface();
+	VkAllocationCallbacksPtr			callbacks	= device.getParam<VkAllocationCallbacksPtr>();
+	ZDescriptorPool						pool		(VK_NULL_HANDLE, device, callbacks);
+	std::vector<VkDescriptorPoolSize>	poolSizes;
+
+	for (const auto& typeNsize : typesNsizes)
+		poolSizes.push_back({ typeNsize.first, typeNsize.second });
+
+	VkDescriptorPoolCreateInfo		poolCreateInfo = makeVkStruct();
+	poolCreateInfo.flags = flags;
+	poolCreateInfo.maxSets = maxSets;
+	poolCreateInfo.poolSizeCount = data_count(poolSizes);
+	poolCreateInfo.pPoolSizes = data_or_null(poolSizes);
+	VKASSERTMSG(VTF_CALL_CHECK(di.vkCreateDescriptorPool,
+					*device, &poolCreateInfo, callbacks, pool.setter()),
+					"Unable to create descriptor pool");
+	return pool;
+}
+
+// Allocates from the current page of pools with the same flags, a new page is started when it runs out
+ZDescriptorSet allocatePooledDescriptorSet (ZDevice device, VkDescriptorPoolCreateFlags flags, VkDescriptorSetLayout layout,
+											add_cref<std::map<VkDescriptorType, uint32_t>> typesNsizes)
+{
+	add_cref<ZDeviceInterface>			di		= device.getInterface();
+	std::shared_ptr<DescriptorCache>	cache	= getDescriptorCache(device);
+	std::lock_guard<std::mutex>			lock	(cache->mutex);
+	add_ref<DescriptorCache::Pages>		pages	= cache->pages[flags];
+	const bool							freeable	= (flags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT) != 0;
+
+	pages.observedSets += 1u;
+	for (const auto& typeNsize : typesNsizes)
+		pages.observedCounts[typeNsize.first] += typeNsize.second;
+
+	VkDescriptorSetAllocateInfo		allocInfo = makeVkStruct();
+	allocInfo.descriptorSetCount	= 1u;
+	allocInfo.pSetLayouts			= &layout;
+
+	if (auto current = pages.current.lock())
+	{
+		ZDescriptorPool pool(current);
+		ZPooledDescriptorSet descriptorSet(device, pool, freeable);
+		allocInfo.descriptorPool = *pool;
+		const VkResult result = VTF_CALL_CHECK(di.vkAllocateDescriptorSets, *device, &allocInfo, descriptorSet.setter());
+		if (VK_SUCCESS == result)
+		{
+			cache->stats.descriptorSets += 1u;
+			return descriptorSet;
+		}
+		ASSERTMSG(VK_ERROR_OUT_OF_POOL_MEMORY == result || VK_ERROR_FRAGMENTED_POOL == result,
+				  "Failed to allocate descriptor set");
+	}
+
+	// Every type seen so far gets its share of the page, the set being allocated must fit in any case
+	std::map<VkDescriptorType, uint32_t> pageSizes;
+	for (add_cref<std::pair<const VkDescriptorType, uint64_t>> observed : pages.observedCounts)
+	{
+		const uint64_t share = MULTIPLERUP((observed.second * descriptorPageSetCount), pages.observedSets);
+		const auto required = typesNsizes.find(observed.first);
+		pageSizes[observed.first] = std::max(uint32_t(share), (required != typesNsizes.end() ? required->second : 1u));
+	}
+
+	ZDescriptorPool pool = createDescriptorPool(device, flags, descriptorPageSetCount, pageSizes);
+	ZPooledDescriptorSet descriptorSet(device, pool, freeable);
+	allocInfo.descriptorPool = *pool;
+	VKASSERTMSG(VTF_CALL_CHECK(di.vkAllocateDescriptorSets, *device, &allocInfo, descriptorSet.setter()),
+				"Failed to allocate descriptor set");
+	pages.current = pool.asSharedPtr();
+	cache->stats.descriptorPools += 1u;
+	cache->stats.descriptorSets += 1u;
+	return descriptorSet;
+}
+
+} // unnamed namespace
+
 namespace vtf
 {
 
@@ -32,6 +194,14 @@ DescriptorSetBindingManager::DescriptorSetBindingManager (ZDevice device_)
 	, cmdPool		()
 	, m_extbindings	()
 	, m_identifier	(m_counter++)
+	, m_descriptorBufferProperties()
+	, m_frequentlyUpdated(false)
+	, m_templateData()
+	, m_setTemplate	()
+	, m_pushTemplates()
+	, m_framePools	(2u)
+	, m_frame		(0u)
+	, m_frameSetSizes()
 {
 	ASSERTMSG(device.has_handle(), "Device must have a handle");
 	m_extbindings.reserve(maxBindingCount);
@@ -43,6 +213,14 @@ DescriptorSetBindingManager::DescriptorSetBindingManager (ZDevice device_, ZQueu
 	, cmdPool		(device && queue ? createCommandPool(device, queue) : ZCommandPool())
 	, m_extbindings	()
 	, m_identifier	(m_counter++)
+	, m_descriptorBufferProperties()
+	, m_frequentlyUpdated(false)
+	, m_templateData()
+	, m_setTemplate	()
+	, m_pushTemplates()
+	, m_framePools	(2u)
+	, m_frame		(0u)
+	, m_frameSetSizes()
 {
 	ASSERTMSG(device.has_handle(), "Device must have a handle");
 	ASSERTMSG(queue.has_handle(), "Queue must have a handle");
@@ -55,6 +233,14 @@ DescriptorSetBindingManager::DescriptorSetBindingManager(ZDevice device_, ZComma
 	, cmdPool		(cmdPool_)
 	, m_extbindings	()
 	, m_identifier	(m_counter++)
+	, m_descriptorBufferProperties()
+	, m_frequentlyUpdated(false)
+	, m_templateData()
+	, m_setTemplate	()
+	, m_pushTemplates()
+	, m_framePools	(2u)
+	, m_frame		(0u)
+	, m_frameSetSizes()
 {
 	m_extbindings.reserve(maxBindingCount);
 	ASSERTMSG(device.has_handle(), "Device must have a handle");
@@ -240,6 +426,48 @@ uint32_t DescriptorSetBindingManager::addBinding (uint32_t suggestedBinding,
 						type, false, stageFlags, bindingFlags, imageLayout, mutableTypes);
 }
 
+uint32_t DescriptorSetBindingManager::addReflectedBindings (add_cref<SpirvInterface> iface, uint32_t set)
+{
+	uint32_t added = 0u;
+	auto index = std::type_index(typeid(typename add_extent<VkDescriptorType>::type));
+	for (add_cref<SpirvBinding> rb : iface.setBindings(set))
+	{
+		ASSERTMSG(rb.descriptorCount, "Binding ", rb.binding, " of set ", set,
+				  " is a runtime array, add it with addArrayBinding() and a count instead");
+		auto b = std::find_if(m_extbindings.begin(), m_extbindings.end(),
+							  [&](add_cref<ExtBinding> eb) { return eb.binding == rb.binding; });
+		if (b != m_extbindings.end())
+		{
+			ASSERTMSG(b->descriptorType == rb.descriptorType, "Binding ", rb.binding, " of set ", set, " is ",
+				vk::to_string(static_cast<vk::DescriptorType>(b->descriptorType)), " but shaders declare ",
+				vk::to_string(static_cast<vk::DescriptorType>(rb.descriptorType)));
+			b->stageFlags |= rb.stages;
+			continue;
+		}
+		addBinding_(rb.binding, index, {/*buffer*/}, {/*view*/}, {/*sampler*/}, rb.descriptorType, false,
+					rb.stages, 0u, VK_IMAGE_LAYOUT_GENERAL, {/*mutableTypes*/}, rb.descriptorCount);
+		added += 1u;
+	}
+	return added;
+}
+
+void DescriptorSetBindingManager::verifyReflectedBindings (add_cref<SpirvInterface> iface, uint32_t set) const
+{
+	for (add_cref<SpirvBinding> rb : iface.setBindings(set))
+	{
+		auto b = std::find_if(m_extbindings.begin(), m_extbindings.end(),
+							  [&](add_cref<ExtBinding> eb) { return eb.binding == rb.binding; });
+		ASSERTMSG(b != m_extbindings.end(), "Shaders use binding ", rb.binding, " of set ", set, " which is not added");
+		ASSERTMSG(b->descriptorType == rb.descriptorType, "Binding ", rb.binding, " of set ", set, " is ",
+			vk::to_string(static_cast<vk::DescriptorType>(b->descriptorType)), " but shaders declare ",
+			vk::to_string(static_cast<vk::DescriptorType>(rb.descriptorType)));
+		ASSERTMSG(b->descriptorCount >= rb.descriptorCount, "Binding ", rb.binding, " of set ", set,
+				  " has ", b->descriptorCount, " descriptors but shaders declare ", rb.descriptorCount);
+		ASSERTMSG((b->stageFlags & rb.stages) == rb.stages, "Binding ", rb.binding, " of set ", set,
+				  " is not visible to all the stages that use it");
+	}
+}
+
 uint32_t DescriptorSetBindingManager::addBinding(
 	std::nullptr_t nullValue, VkDescriptorType type,
 	VkShaderStageFlags stageFlags, VkDescriptorBindingFlags bindingFlags)
@@ -281,113 +509,158 @@ ZDescriptorSetLayout DescriptorSetBindingManager::createDescriptorSetLayout (
 
 	add_cref<ZDeviceInterface>					di					= device.getInterface();
 	VkAllocationCallbacksPtr					callbacks			= device.getParam<VkAllocationCallbacksPtr>();
-	ZDescriptorPool								descriptorPool		(VK_NULL_HANDLE, device, callbacks);
-	ZDescriptorSetLayout						descriptorSetLayout	(VK_NULL_HANDLE, device, callbacks, layoutCreateFlags, ZDescriptorSet(), getIdentifier());
 	std::vector<VkDescriptorSetLayoutBinding>	bindings			(m_extbindings.size());
 	const bool									descriptorBuffer	= layoutCreateFlags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
 	std::vector<VkDescriptorBindingFlags>		bindingsFlags		(m_extbindings.size());
+	std::map<VkDescriptorType, uint32_t>		typesNsizes;
+	Digest										digest;
 
 	std::vector<VkMutableDescriptorTypeListEXT> mutableBindingLists	(m_extbindings.size());
 	uint32_t									mutableBindingCount	= 0u;
 
-	if (descriptorBuffer)
+	digest.update(layoutCreateFlags).update(data_count(m_extbindings));
+	for (uint32_t ii = 0u; ii < data_count(m_extbindings); ++ii)
 	{
-		for (auto begin = m_extbindings.begin(), b = begin; b != m_extbindings.end(); ++b)
-		{
-			const auto ii = make_unsigned(std::distance(begin, b));
-			bindings[ii] = *b;
-			bindingsFlags[ii] = b->bindingFlags;
-		}
-	}
-	else
-	// build descriptor pool
-	{
-		std::vector<VkDescriptorPoolSize>		poolSizes;
-		std::map<VkDescriptorType, uint32_t>	typesNsizes;
+		add_cref<ExtBinding> b = m_extbindings[ii];
+		bindings[ii] = b;
+		bindingsFlags[ii] = b.bindingFlags;
+		digest.update(b.binding).update(b.descriptorType).update(b.descriptorCount)
+			  .update(b.stageFlags).update(b.bindingFlags).update(b.mutableTypes);
 
-		for (uint32_t ii = 0u; ii < data_count(m_extbindings); ++ii)
+		if (false == descriptorBuffer)
 		{
-			add_cref<ExtBinding> b = m_extbindings[ii];
 			typesNsizes[b.descriptorType] += b.descriptorCount;
-			bindings[ii] = b;
-			bindingsFlags[ii] = b.bindingFlags;
-
 			mutableBindingCount += (b.descriptorType == VK_DESCRIPTOR_TYPE_MUTABLE_EXT);
 			mutableBindingLists[ii].descriptorTypeCount = data_count(b.mutableTypes);
 			mutableBindingLists[ii].pDescriptorTypes = data_or_null(b.mutableTypes);
 		}
-
-		for (const auto& typeNsize : typesNsizes)
-			poolSizes.push_back({ typeNsize.first, typeNsize.second });
-
-		VkDescriptorPoolCreateInfo		poolCreateInfo = makeVkStruct();
-		poolCreateInfo.flags = poolCreateFlags;
-		poolCreateInfo.maxSets = 1u;
-		poolCreateInfo.poolSizeCount = data_count(poolSizes);
-		poolCreateInfo.pPoolSizes = data_or_null(poolSizes);
-		VKASSERTMSG(VTF_CALL_CHECK(di.vkCreateDescriptorPool,
-						*device, &poolCreateInfo, callbacks, descriptorPool.setter()),
-						"Unable to create descriptor pool");
 	}
 
-	void_ptr descriptorSetLayoutPNext = nullptr;
-	add_ptr<void_ptr> pDescriptorSetLayoutPNext = &descriptorSetLayoutPNext;
-
 	const bool anyNonZeroBindingFlag = std::any_of(bindingsFlags.begin(), bindingsFlags.end(),
 										[](add_cref<VkDescriptorBindingFlags> bindingFlag) { return bindingFlag != 0u; });
-	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCI = makeVkStruct();
-	if (anyNonZeroBindingFlag)
+
+	// Frequently updated sets become push descriptors when nothing special is required from them
+	const bool templatable = m_frequentlyUpdated && (false == descriptorBuffer) && isTemplatable_();
+	bool pushDescriptors = templatable && (0u == layoutCreateFlags) && (false == anyNonZeroBindingFlag);
+	if (pushDescriptors)
+	{
+		add_cref<strings> extensions = device.getParamRef<ZDistType<EnabledDeviceExtensions, strings>>().get();
+		VkPhysicalDevicePushDescriptorPropertiesKHR pdp = makeVkStruct();
+		deviceGetPhysicalProperties2(device.getParam<ZPhysicalDevice>(), &pdp);
+		uint32_t descriptorCount = 0u;
+		for (add_cref<ExtBinding> b : m_extbindings)
+		{
+			descriptorCount += b.descriptorCount;
+		}
+		pushDescriptors = containsString(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME, extensions)
+			&& descriptorCount <= pdp.maxPushDescriptors;
+	}
+	if (pushDescriptors)
 	{
-		bindingFlagsCI.bindingCount = data_count(m_extbindings);
-		bindingFlagsCI.pBindingFlags = bindingsFlags.data();
-		bindingFlagsCI.pNext = *pDescriptorSetLayoutPNext;
-		*pDescriptorSetLayoutPNext = &bindingFlagsCI;
+		layoutCreateFlags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+		digest.update(layoutCreateFlags);
 	}
 
-	VkMutableDescriptorTypeCreateInfoEXT mutableTypesCI = makeVkStruct();
-	if (mutableBindingCount)
+	// Layouts created from the same bindings share one VkDescriptorSetLayout
+	std::shared_ptr<DescriptorCache>	cache			= getDescriptorCache(device);
+	std::unique_lock<std::mutex>		cacheLock		(cache->mutex);
+	auto&								cacheEntry		= cache->setLayouts[digest.finish()];
+	ZDescriptorSetLayout				sharedLayout	(VK_NULL_HANDLE, device, callbacks, layoutCreateFlags,
+														 ZDescriptorSet(), getIdentifier(), ZDistType<SomeOne, std::any>());
+	if (auto existing = cacheEntry.lock())
 	{
-		mutableTypesCI.pMutableDescriptorTypeLists = data_or_null(mutableBindingLists);
-		mutableTypesCI.mutableDescriptorTypeListCount = data_count(mutableBindingLists);
-		mutableTypesCI.pNext = *pDescriptorSetLayoutPNext;
-		*pDescriptorSetLayoutPNext = &mutableTypesCI;
+		sharedLayout = ZDescriptorSetLayout(existing);
+		cache->stats.setLayoutHits += 1u;
+	}
+	else
+	{
+		void_ptr descriptorSetLayoutPNext = nullptr;
+		add_ptr<void_ptr> pDescriptorSetLayoutPNext = &descriptorSetLayoutPNext;
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCI = makeVkStruct();
+		if (anyNonZeroBindingFlag)
+		{
+			bindingFlagsCI.bindingCount = data_count(m_extbindings);
+			bindingFlagsCI.pBindingFlags = bindingsFlags.data();
+			bindingFlagsCI.pNext = *pDescriptorSetLayoutPNext;
+			*pDescriptorSetLayoutPNext = &bindingFlagsCI;
+		}
+
+		VkMutableDescriptorTypeCreateInfoEXT mutableTypesCI = makeVkStruct();
+		if (mutableBindingCount)
+		{
+			mutableTypesCI.pMutableDescriptorTypeLists = data_or_null(mutableBindingLists);
+			mutableTypesCI.mutableDescriptorTypeListCount = data_count(mutableBindingLists);
+			mutableTypesCI.pNext = *pDescriptorSetLayoutPNext;
+			*pDescriptorSetLayoutPNext = &mutableTypesCI;
+		}
+
+		VkDescriptorSetLayoutCreateInfo		setLayoutCreateInfo = makeVkStruct(*pDescriptorSetLayoutPNext);
+		setLayoutCreateInfo.flags			= layoutCreateFlags;
+		setLayoutCreateInfo.bindingCount	= data_count(bindings);
+		setLayoutCreateInfo.pBindings		= data_or_null(bindings);
+		VKASSERTMSG(VTF_CALL_CHECK(di.vkCreateDescriptorSetLayout,
+					*device, &setLayoutCreateInfo, callbacks, sharedLayout.setter()),
+					"Failed to create descriptor set layout");
+
+		cacheEntry = sharedLayout.asSharedPtr();
+		cache->stats.setLayouts += 1u;
 	}
+	cacheLock.unlock();
 
-	VkDescriptorSetLayoutCreateInfo		setLayoutCreateInfo = makeVkStruct(*pDescriptorSetLayoutPNext);
-	setLayoutCreateInfo.flags			= layoutCreateFlags;
-	setLayoutCreateInfo.bindingCount	= data_count(bindings);
-	setLayoutCreateInfo.pBindings		= data_or_null(bindings);
-	VKASSERTMSG(VTF_CALL_CHECK(di.vkCreateDescriptorSetLayout,
-				*device, &setLayoutCreateInfo, callbacks, descriptorSetLayout.setter()),
-				"Failed to create descriptor set layout");
+	ZDescriptorSetLayout descriptorSetLayout = ZSharedDescriptorSetLayout(sharedLayout, getIdentifier());
 
-	if (false == descriptorBuffer)
+	m_setTemplate = (templatable && (false == pushDescriptors))
+		? createUpdateTemplate_(descriptorSetLayout, ZPipelineLayout(), 0u, VK_PIPELINE_BIND_POINT_MAX_ENUM)
+		: ZDescriptorUpdateTemplate();
+	// Sets of frames are plain ones, anything special would need its own allocation info
+	m_frameSetSizes.reset();
+	if (m_frequentlyUpdated && (false == pushDescriptors)
+		&& (0u == mutableBindingCount) && (false == anyNonZeroBindingFlag) && (0u == layoutCreateFlags))
 	{
-		void_ptr allocNext = nullptr;
-		std::vector<uint32_t> descriptorCounts(data_count(m_extbindings));
-		VkDescriptorSetVariableDescriptorCountAllocateInfo variableInfo{};
-		if (anyNonZeroBindingFlag)
+		m_frameSetSizes = typesNsizes;
+	}
+
+	if ((false == descriptorBuffer) && (false == pushDescriptors))
+	{
+		// Plain sets are taken from shared pages, the ones that need anything special get their own pool
+		const bool pooled = (0u == mutableBindingCount) && (false == anyNonZeroBindingFlag) && (0u == layoutCreateFlags)
+			&& (0u == (poolCreateFlags & ~VkDescriptorPoolCreateFlags(VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT)));
+
+		ZDescriptorSet descriptorSet;
+		if (pooled)
 		{
-			variableInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
-			variableInfo.pDescriptorCounts = descriptorCounts.data();
-			variableInfo.descriptorSetCount = 1u;
-			allocNext = &variableInfo;
-			// VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT
-			for (uint32_t ii = 0u; ii < data_count(m_extbindings); ++ii)
+			descriptorSet = allocatePooledDescriptorSet(device, poolCreateFlags, *descriptorSetLayout, typesNsizes);
+		}
+		else
+		{
+			void_ptr allocNext = nullptr;
+			std::vector<uint32_t> descriptorCounts(data_count(m_extbindings));
+			VkDescriptorSetVariableDescriptorCountAllocateInfo variableInfo{};
+			if (anyNonZeroBindingFlag)
 			{
-				add_cref<ExtBinding> b = m_extbindings[ii];
-				descriptorCounts[ii] = b.descriptorCount;
+				variableInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+				variableInfo.pDescriptorCounts = descriptorCounts.data();
+				variableInfo.descriptorSetCount = 1u;
+				allocNext = &variableInfo;
+				// VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT
+				for (uint32_t ii = 0u; ii < data_count(m_extbindings); ++ii)
+				{
+					add_cref<ExtBinding> b = m_extbindings[ii];
+					descriptorCounts[ii] = b.descriptorCount;
+				}
 			}
-		}
 
-		ZDescriptorSet					descriptorSet(VK_NULL_HANDLE, device, descriptorPool);
-		VkDescriptorSetAllocateInfo		allocInfo = makeVkStruct(allocNext);
-		allocInfo.descriptorPool		= *descriptorPool;
-		allocInfo.descriptorSetCount	= 1u;
-		allocInfo.pSetLayouts			= descriptorSetLayout.ptr();
-		VKASSERTMSG(VTF_CALL_CHECK(di.vkAllocateDescriptorSets,
-					*device, &allocInfo, descriptorSet.setter()),
-					"Failed to allocate descriptor set");
+			ZDescriptorPool					descriptorPool = createDescriptorPool(device, poolCreateFlags, 1u, typesNsizes);
+			descriptorSet = ZDescriptorSet(VK_NULL_HANDLE, device, descriptorPool);
+			VkDescriptorSetAllocateInfo		allocInfo = makeVkStruct(allocNext);
+			allocInfo.descriptorPool		= *descriptorPool;
+			allocInfo.descriptorSetCount	= 1u;
+			allocInfo.pSetLayouts			= descriptorSetLayout.ptr();
+			VKASSERTMSG(VTF_CALL_CHECK(di.vkAllocateDescriptorSets,
+						*device, &allocInfo, descriptorSet.setter()),
+						"Failed to allocate descriptor set");
+		}
 
 		if (performUpdateDescriptorSets)
 		{
@@ -412,6 +685,13 @@ void DescriptorSetBindingManager::updateDescriptorSet (
 	ASSERTMSG(buffer.has_handle(), "Buffer must have a handle");
 	ASSERTMSG(false == bool(mutableVariant) || descriptorTypeOnVector(*mutableVariant, b.mutableTypes), "???");
 
+	if (m_frequentlyUpdated)
+	{
+		b.buffer = buffer;
+		// Written later by pushDescriptorSet() or updateDescriptorSet(ds)
+		if (m_setTemplate.has_handle() || (false == ds.has_handle())) return;
+	}
+
 	std::vector<VkDescriptorBufferInfo>	bufferInfos(b.descriptorCount);
 
 	VkWriteDescriptorSet	writeParams = makeVkStruct();
@@ -474,6 +754,14 @@ void DescriptorSetBindingManager::updateDescriptorSet (
 	imageInfo.imageView		= b.isNull ? VK_NULL_HANDLE : *view;
 	imageInfo.sampler		= VK_NULL_HANDLE;
 
+	if (m_frequentlyUpdated)
+	{
+		b.view = view;
+		b.imageLayout = imageInfo.imageLayout;
+		// Written later by pushDescriptorSet() or updateDescriptorSet(ds)
+		if (m_setTemplate.has_handle() || (false == ds.has_handle())) return;
+	}
+
 	VkWriteDescriptorSet	writeParams = makeVkStruct();
 	writeParams.dstSet				= *ds;
 	writeParams.dstBinding			= b.binding;
@@ -512,6 +800,13 @@ void DescriptorSetBindingManager::updateDescriptorSet (ZDescriptorSet ds, uint32
 	imageInfo.sampler		= b.isNull ? VK_NULL_HANDLE : *sampler;
 	imageInfo.imageView		= VK_NULL_HANDLE;
 
+	if (m_frequentlyUpdated)
+	{
+		b.sampler = sampler;
+		// Written later by pushDescriptorSet() or updateDescriptorSet(ds)
+		if (m_setTemplate.has_handle() || (false == ds.has_handle())) return;
+	}
+
 	VkWriteDescriptorSet	writeParams = makeVkStruct();
 	writeParams.dstSet				= *ds;
 	writeParams.dstBinding			= b.binding;
@@ -553,6 +848,15 @@ void DescriptorSetBindingManager::updateDescriptorSet (
 	imageInfo.imageView = b.isNull ? VK_NULL_HANDLE : *view;
 	imageInfo.sampler	= b.isNull ? VK_NULL_HANDLE : *sampler;
 
+	if (m_frequentlyUpdated)
+	{
+		b.view = view;
+		b.sampler = sampler;
+		b.imageLayout = imageInfo.imageLayout;
+		// Written later by pushDescriptorSet() or updateDescriptorSet(ds)
+		if (m_setTemplate.has_handle() || (false == ds.has_handle())) return;
+	}
+
 	VkWriteDescriptorSet	writeParams = makeVkStruct();
 	writeParams.dstSet				= *ds;
 	writeParams.dstBinding			= b.binding;
@@ -595,6 +899,14 @@ bool DescriptorSetBindingManager::isDescryptorTypeSupported(VkDescriptorType typ
 }
 void DescriptorSetBindingManager::updateDescriptorSet (ZDescriptorSet descriptorSet)
 {
+	if (m_setTemplate.has_handle())
+	{
+		fillTemplateData_();
+		add_cref<ZDeviceInterface> di = device.getInterface();
+		VTF_CALL_CHECK(di.vkUpdateDescriptorSetWithTemplate, *device, *descriptorSet, *m_setTemplate, m_templateData.data());
+		return;
+	}
+
 	for (add_cref<ExtBinding> b : m_extbindings)
 	{
 		if (b.descriptorType == VK_DESCRIPTOR_TYPE_MUTABLE_EXT) continue;
@@ -623,6 +935,180 @@ void DescriptorSetBindingManager::updateDescriptorSet (ZDescriptorSet descriptor
 		}
 	}
 }
+void DescriptorSetBindingManager::setFrequentlyUpdated (bool frequentlyUpdated, uint32_t framesInFlight)
+{
+	ASSERTMSG(framesInFlight != 0u, "Frame count must not be zero");
+	m_frequentlyUpdated = frequentlyUpdated;
+	m_framePools.resize(framesInFlight);
+	m_frame = 0u;
+}
+bool DescriptorSetBindingManager::isTemplatable_ () const
+{
+	return std::all_of(m_extbindings.begin(), m_extbindings.end(), [](add_cref<ExtBinding> b)
+	{
+		return (false == b.isNull) && descriptorTypeOnList(b.descriptorType,
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+			  VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			  VK_DESCRIPTOR_TYPE_SAMPLER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER });
+	});
+}
+auto DescriptorSetBindingManager::makeTemplateEntries_ () const -> std::vector<VkDescriptorUpdateTemplateEntry>
+{
+	std::vector<VkDescriptorUpdateTemplateEntry> entries(m_extbindings.size());
+	std::size_t offset = 0u;
+	for (uint32_t ii = 0u; ii < data_count(m_extbindings); ++ii)
+	{
+		add_cref<ExtBinding> b = m_extbindings[ii];
+		add_ref<VkDescriptorUpdateTemplateEntry> entry = entries[ii];
+		entry.dstBinding		= b.binding;
+		entry.dstArrayElement	= 0u;
+		// Only buffers are written as arrays, the same as updateDescriptorSet() does
+		entry.descriptorCount	= descriptorTypeOnList(b.descriptorType,
+									{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER })
+									? b.descriptorCount : 1u;
+		entry.descriptorType	= b.descriptorType;
+		entry.offset			= offset;
+		entry.stride			= sizeof(TemplateElement);
+		offset += entry.descriptorCount * sizeof(TemplateElement);
+	}
+	return entries;
+}
+void DescriptorSetBindingManager::fillTemplateData_ ()
+{
+	// Mirrors makeTemplateEntries_(), the vector keeps its capacity between the draws
+	m_templateData.clear();
+	for (add_cref<ExtBinding> b : m_extbindings)
+	{
+		TemplateElement element{};
+		if (descriptorTypeOnList(b.descriptorType, { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER }))
+		{
+			ZBuffer buffer = b.buffer;
+			const VkDeviceSize bufferSize = buffer.has_handle() ? bufferGetSize(buffer) : 0u;
+			const VkDeviceSize arrayElementSize = (b.descriptorCount == 1u) ? bufferSize : b.stride;
+			for (uint32_t arrayElement = 0u; arrayElement < b.descriptorCount; ++arrayElement)
+			{
+				element.buffer.buffer	= *buffer;
+				element.buffer.offset	= arrayElement * arrayElementSize;
+				element.buffer.range	= arrayElementSize;
+				if (b.descriptorCount > 1u && arrayElement == (b.descriptorCount - 1u))
+				{
+					element.buffer.range += (bufferSize % b.stride);
+				}
+				m_templateData.push_back(element);
+			}
+		}
+		else
+		{
+			element.image.imageView		= *b.view;
+			element.image.sampler		= *b.sampler;
+			element.image.imageLayout	= b.imageLayout;
+			m_templateData.push_back(element);
+		}
+	}
+}
+auto DescriptorSetBindingManager::createUpdateTemplate_ (
+	ZDescriptorSetLayout dsLayout, ZPipelineLayout layout,
+	uint32_t set, VkPipelineBindPoint bindPoint) -> ZDescriptorUpdateTemplate
+{
+	add_cref<ZDeviceInterface>	di			= device.getInterface();
+	VkAllocationCallbacksPtr	callbacks	= device.getParam<VkAllocationCallbacksPtr>();
+	const bool					push		= layout.has_handle();
+	const auto					entries		= makeTemplateEntries_();
+
+	VkDescriptorUpdateTemplateCreateInfo createInfo = makeVkStruct();
+	createInfo.flags						= 0u;
+	createInfo.descriptorUpdateEntryCount	= data_count(entries);
+	createInfo.pDescriptorUpdateEntries		= data_or_null(entries);
+	createInfo.templateType					= push ? VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR
+													: VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+	createInfo.descriptorSetLayout			= *dsLayout;
+	createInfo.pipelineBindPoint			= bindPoint;
+	createInfo.pipelineLayout				= *layout;
+	createInfo.set							= set;
+
+	ZDescriptorUpdateTemplate updateTemplate(VK_NULL_HANDLE, device, callbacks, createInfo.templateType);
+	VKASSERTMSG(VTF_CALL_CHECK(di.vkCreateDescriptorUpdateTemplate,
+				*device, &createInfo, callbacks, updateTemplate.setter()),
+				"Failed to create descriptor update template");
+	return updateTemplate;
+}
+void DescriptorSetBindingManager::pushDescriptorSet (ZCommandBuffer cmd, ZPipeline pipeline, uint32_t set)
+{
+	ZPipelineLayout				layout		= pipeline.getParam<ZPipelineLayout>();
+	const VkPipelineBindPoint	bindPoint	= pipeline.getParam<VkPipelineBindPoint>();
+	ZDescriptorSetLayout		dsLayout	= getDescriptorSetLayout(layout, set);
+	add_cref<ZDeviceInterface>	di			= device.getInterface();
+	ASSERTMSG(m_frequentlyUpdated, "Set must be marked as frequently updated");
+	ASSERTMSG(getIdentifier() == dsLayout.getParam<ZDistType<LayoutIdentifier, uint32_t>>(),
+		"Descriptor set layout ", set, " doesn't come from DescriptorSetBindingManager ", getIdentifier());
+
+	if (dsLayout.getParam<VkDescriptorSetLayoutCreateFlags>() & VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR)
+	{
+		auto match = std::find_if(m_pushTemplates.begin(), m_pushTemplates.end(), [&](const auto& t)
+		{
+			return *std::get<0>(t) == *layout && std::get<1>(t) == set && std::get<2>(t) == bindPoint;
+		});
+		if (match == m_pushTemplates.end())
+		{
+			m_pushTemplates.emplace_back(layout, set, bindPoint, createUpdateTemplate_(dsLayout, layout, set, bindPoint));
+			match = std::prev(m_pushTemplates.end());
+		}
+		fillTemplateData_();
+		VTF_CALL_CHECK(di.vkCmdPushDescriptorSetWithTemplateKHR,
+			*cmd, *std::get<3>(*match), *layout, set, m_templateData.data());
+	}
+	else
+	{
+		// Earlier draws may have bound the previous set already, so it is never rewritten
+		ZDescriptorSet descriptorSet = allocateFrameSet_(dsLayout);
+		updateDescriptorSet(descriptorSet);
+		VTF_CALL_CHECK(di.vkCmdBindDescriptorSets, *cmd, bindPoint, *layout, set, 1u, descriptorSet.ptr(), 0u, nullptr);
+	}
+}
+ZDescriptorSet DescriptorSetBindingManager::allocateFrameSet_ (ZDescriptorSetLayout dsLayout)
+{
+	ASSERTMSG(m_frameSetSizes, "Sets with mutable descriptors, binding flags or layout flags "
+							   "can be written per draw only with VK_KHR_push_descriptor");
+	add_cref<ZDeviceInterface>	di		= device.getInterface();
+	add_ref<FramePools>			frame	= m_framePools.at(m_frame);
+
+	VkDescriptorSetAllocateInfo		allocInfo = makeVkStruct();
+	allocInfo.descriptorSetCount	= 1u;
+	allocInfo.pSetLayouts			= dsLayout.ptr();
+
+	for (;; ++frame.current)
+	{
+		const bool fresh = (frame.current == data_count(frame.pools));
+		if (fresh)
+		{
+			std::map<VkDescriptorType, uint32_t> poolSizes;
+			for (add_cref<std::pair<const VkDescriptorType, uint32_t>> typeNsize : *m_frameSetSizes)
+				poolSizes[typeNsize.first] = typeNsize.second * descriptorPageSetCount;
+			frame.pools.push_back(createDescriptorPool(device, VkDescriptorPoolCreateFlags(0), descriptorPageSetCount, poolSizes));
+		}
+		// Sets are never freed one by one, beginFrame() resets their pools
+		ZPooledDescriptorSet descriptorSet(device, frame.pools[frame.current], false);
+		allocInfo.descriptorPool = *frame.pools[frame.current];
+		const VkResult result = VTF_CALL_CHECK(di.vkAllocateDescriptorSets, *device, &allocInfo, descriptorSet.setter());
+		if (VK_SUCCESS == result)
+		{
+			return descriptorSet;
+		}
+		ASSERTMSG((false == fresh) && (VK_ERROR_OUT_OF_POOL_MEMORY == result || VK_ERROR_FRAGMENTED_POOL == result),
+				  "Failed to allocate descriptor set");
+	}
+}
+void DescriptorSetBindingManager::beginFrame ()
+{
+	m_frame = (m_frame + 1u) % data_count(m_framePools);
+	add_ref<FramePools> frame = m_framePools[m_frame];
+	add_cref<ZDeviceInterface> di = device.getInterface();
+	for (uint32_t i = 0u; i < data_count(frame.pools) && i <= frame.current; ++i)
+	{
+		VKASSERT(VTF_CALL_CHECK(di.vkResetDescriptorPool, *device, *frame.pools[i], VkDescriptorPoolResetFlags(0)));
+	}
+	frame.current = 0u;
+}
 void assertPushConstantSizeMax (ZDevice dev, const uint32_t size)
 {
 	const uint32_t maxPushConstantsSize = deviceGetPhysicalLimits(dev).maxPushConstantsSize;
@@ -642,22 +1128,39 @@ ZPipelineLayout DescriptorSetBindingManager::createPipelineLayout (
 {
 	return createPipelineLayout_(pushConstants, dsLayouts);
 }
+ZPipelineLayout DescriptorSetBindingManager::createReflectedPipelineLayout (
+	add_cref<SpirvInterface>	iface,
+	add_cref<ZPushConstants>	pushConstants)
+{
+	ASSERTMSG(iface.setCount() <= 1u, "Shaders use ", iface.setCount(), " sets, a manager describes only one of them");
+	ASSERTMSG(pushConstants.size() >= iface.pushConstantSize, "Push constants take ", pushConstants.size(),
+			  " bytes but shaders declare a block of ", iface.pushConstantSize, " bytes");
+	VkShaderStageFlags pushStages = 0u;
+	for (add_cref<VkPushConstantRange> range : pushConstants.ranges())
+	{
+		pushStages |= range.stageFlags;
+	}
+	ASSERTMSG((pushStages & iface.pushConstantStages) == iface.pushConstantStages,
+			  "Push constants are not visible to all the stages that use them");
+
+	// Bindings that came from reflection have nothing to be written yet
+	const bool performUpdateDescriptorSets = (0u == addReflectedBindings(iface, 0u));
+	if (m_extbindings.empty())
+	{
+		return createPipelineLayout_(pushConstants, {});
+	}
+	return createPipelineLayout_(pushConstants, { createDescriptorSetLayout(performUpdateDescriptorSets) });
+}
 ZPipelineLayout DescriptorSetBindingManager::createPipelineLayout_ (add_cref<ZPushConstants> pushConstants,
 													  std::initializer_list<ZDescriptorSetLayout> dsLayouts)
 {
 	assertPushConstantSizeMax(device, pushConstants.size());
 
-	const VkPipelineLayoutCreateFlags flags		(0);
-	VkAllocationCallbacksPtr	callbacks		= device.getParam<VkAllocationCallbacksPtr>();
-	ZPipelineLayout				pipelineLayout	(VK_NULL_HANDLE, device, callbacks,
-												 flags,
-												 std::vector<ZDescriptorSetLayout>(dsLayouts.size()),
-												 pushConstants.ranges(),
-												 pushConstants.types(), false);
-
-	add_ref<std::vector<ZDescriptorSetLayout>>	zLayouts	= pipelineLayout.getParamRef<std::vector<ZDescriptorSetLayout>>();
-	std::vector<VkDescriptorSetLayout>			vkLayouts	(dsLayouts.size());
-	bool							enableDescriptorBuffer	= false;
+	const VkPipelineLayoutCreateFlags	flags		(0);
+	VkAllocationCallbacksPtr			callbacks	= device.getParam<VkAllocationCallbacksPtr>();
+	std::vector<ZDescriptorSetLayout>	zLayouts	(dsLayouts.size());
+	std::vector<VkDescriptorSetLayout>	vkLayouts	(dsLayouts.size());
+	bool								enableDescriptorBuffer	= false;
 
 	for (auto i = dsLayouts.begin(); i != dsLayouts.end(); ++i)
 	{
@@ -676,29 +1179,71 @@ ZPipelineLayout DescriptorSetBindingManager::createPipelineLayout_ (add_cref<ZPu
 		vkLayouts[j] = **i;
 	}
 
-	add_cref<std::vector<VkPushConstantRange>> ranges =
-		pipelineLayout.getParamRef<std::vector<VkPushConstantRange>>();
+	const std::vector<VkPushConstantRange> ranges = pushConstants.ranges();
 
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo = makeVkStruct();
-	pipelineLayoutInfo.flags					= flags;
-	pipelineLayoutInfo.setLayoutCount			= data_count(vkLayouts);
-	pipelineLayoutInfo.pSetLayouts				= data_or_null(vkLayouts);
-	pipelineLayoutInfo.pushConstantRangeCount	= data_count(ranges);
-	pipelineLayoutInfo.pPushConstantRanges		= data_or_null(ranges);
-
-	add_cref<ZDeviceInterface> di = device.getInterface();
-	VKASSERTMSG(VTF_CALL_CHECK(di.vkCreatePipelineLayout,
-									*device, &pipelineLayoutInfo, callbacks, pipelineLayout.setter()),
-									"failed to create pipeline layout!");
+	// Set layouts are shared already, so their handles identify the pipeline layout along with push constants
+	Digest digest;
+	digest.update(flags).update(vkLayouts).update(ranges);
 
-	pipelineLayout.getParamRef<bool>() = enableDescriptorBuffer;
+	std::shared_ptr<DescriptorCache>	cache			= getDescriptorCache(device);
+	std::lock_guard<std::mutex>			cacheLock		(cache->mutex);
+	auto&								cacheEntry		= cache->pipelineLayouts[digest.finish()];
+	ZPipelineLayout						sharedLayout	(VK_NULL_HANDLE, device, callbacks, flags,
+														 std::vector<ZDescriptorSetLayout>(), ranges,
+														 pushConstants.types(), enableDescriptorBuffer,
+														 ZDistType<SomeOne, std::any>());
+	if (auto existing = cacheEntry.lock())
+	{
+		sharedLayout = ZPipelineLayout(existing);
+		cache->stats.pipelineLayoutHits += 1u;
+	}
+	else
+	{
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = makeVkStruct();
+		pipelineLayoutInfo.flags					= flags;
+		pipelineLayoutInfo.setLayoutCount			= data_count(vkLayouts);
+		pipelineLayoutInfo.pSetLayouts				= data_or_null(vkLayouts);
+		pipelineLayoutInfo.pushConstantRangeCount	= data_count(ranges);
+		pipelineLayoutInfo.pPushConstantRanges		= data_or_null(ranges);
+
+		add_cref<ZDeviceInterface> di = device.getInterface();
+		VKASSERTMSG(VTF_CALL_CHECK(di.vkCreatePipelineLayout,
+										*device, &pipelineLayoutInfo, callbacks, sharedLayout.setter()),
+										"failed to create pipeline layout!");
+
+		cacheEntry = sharedLayout.asSharedPtr();
+		cache->stats.pipelineLayouts += 1u;
+	}
 
-	return pipelineLayout;
+	// Each pipeline layout refers to the set layouts it has been created with, they carry their own descriptor sets
+	return ZSharedPipelineLayout(sharedLayout, zLayouts, pushConstants.types());
+}
+DescriptorCacheStats getDescriptorCacheStats (ZDevice device)
+{
+	std::shared_ptr<DescriptorCache> cache = getDescriptorCache(device);
+	std::lock_guard<std::mutex> lock(cache->mutex);
+	return cache->stats;
+}
+auto descriptorSetLayoutGetDigest (ZDescriptorSetLayout layout) -> std::array<uint8_t, 32>
+{
+	std::shared_ptr<DescriptorCache> cache = getDescriptorCache(layout.getParam<ZDevice>());
+	std::lock_guard<std::mutex> lock(cache->mutex);
+	for (add_cref<std::pair<const Digest::value_type, std::weak_ptr<ZDescriptorSetLayout::AnObject>>> entry : cache->setLayouts)
+	{
+		if (auto existing = entry.second.lock(); existing && *ZDescriptorSetLayout(existing) == *layout)
+		{
+			return entry.first;
+		}
+	}
+	return {};
 }
+
 ZDescriptorSet DescriptorSetBindingManager::getDescriptorSet (ZDescriptorSetLayout layout)
 {
 	ZDescriptorSet ds = layout.getParam<ZDescriptorSet>();
-	ASSERTION(ds.has_handle());
+	// Push descriptor layouts have no set, the empty one is accepted by updateDescriptorSet(ds, binding, ...)
+	ASSERTION(ds.has_handle() || (layout.getParam<VkDescriptorSetLayoutCreateFlags>()
+								   & VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR));
 	return ds;
 }
 DescriptorSetBindingManager::ExtBinding& DescriptorSetBindingManager::verifyGetExtBinding (uint32_t binding)
@@ -945,6 +1490,19 @@ bool DescriptorSetBindingManager::containsSamplers () const
 	return false;
 }
 
+add_cref<VkPhysicalDeviceDescriptorBufferPropertiesEXT> DescriptorSetBindingManager::getDescriptorBufferProperties_ ()
+{
+	// Queried once, descriptors may be rewritten every frame
+	if (false == m_descriptorBufferProperties.has_value())
+	{
+		VkPhysicalDeviceDescriptorBufferPropertiesEXT dbp = makeVkStruct();
+		deviceGetPhysicalProperties2(device.getParam<ZPhysicalDevice>(), &dbp);
+		dbp.pNext = nullptr;
+		m_descriptorBufferProperties = dbp;
+	}
+	return *m_descriptorBufferProperties;
+}
+
 ZBuffer DescriptorSetBindingManager::createDescriptorBuffer (ZDescriptorSetLayout dsLayout)
 {
 	assertDoubledBindings();
@@ -957,15 +1515,12 @@ ZBuffer DescriptorSetBindingManager::createDescriptorBuffer (ZDescriptorSetLayou
 	add_cref<ZDeviceInterface> di = device.getInterface();
 	ASSERTMSG(di.vkGetDescriptorEXT, "vkGetDescriptorEXT() must not be null");
 
-	VkPhysicalDeviceDescriptorBufferPropertiesEXT dbp = makeVkStruct();
-	deviceGetPhysicalProperties2(device.getParam<ZPhysicalDevice>(), &dbp);
+	add_cref<VkPhysicalDeviceDescriptorBufferPropertiesEXT> dbp = getDescriptorBufferProperties_();
 
 	VkDeviceSize layoutSize = 0u;
 	VTF_CALL_CHECK(di.vkGetDescriptorSetLayoutSizeEXT, *device, *dsLayout, &layoutSize);
 	ASSERTMSG(layoutSize, "vkGetDescriptorSetLayoutSizeEXT - layout size must not be zero");
 	layoutSize = ROUNDUP(layoutSize, dbp.descriptorBufferOffsetAlignment);
-	//const uint32_t bindingSize = uint32_t(layoutSize);
-	//layoutSize *= m_extbindings.size();
 
 	ZBufferUsageFlags usage(VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
 							VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT,
@@ -974,109 +1529,195 @@ ZBuffer DescriptorSetBindingManager::createDescriptorBuffer (ZDescriptorSetLayou
 								: VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT);
 	ZBuffer descBuffer = createBuffer(device, layoutSize, usage, ZMemoryPropertyHostFlags);
 
-	uint8_t* data = nullptr;
 	ZDeviceMemory memory = bufferGetMemory(descBuffer, 0);
-	VKASSERT(VTF_CALL_CHECK(di.vkMapMemory,
-                            *device, *memory, 0u, layoutSize, (VkMemoryMapFlags)0, reinterpret_cast<void**>(&data)));
-	std::fill_n(data, layoutSize, '\0');
+	std::fill_n(mapMemory(memory), layoutSize, '\0');
 
-	for (add_cref<VkDescriptorSetLayoutBindingAndType> b : m_extbindings)
+	for (add_cref<ExtBinding> b : m_extbindings)
 	{
-		ASSERTMSG(b.descriptorType != VK_DESCRIPTOR_TYPE_MUTABLE_EXT,
-			"In the descriptor-buffer model, none of the binding can be MUTABLE_EXT");
+		writeDescriptorBuffer_(descBuffer, dsLayout, b);
+	}
 
-		VkDescriptorAddressInfoEXT	addressInfo			= makeVkStruct();
-		VkDescriptorGetInfoEXT		getInfo				= makeVkStruct();
-		VkDescriptorImageInfo		imageInfo			{};
-		VkDeviceSize				descriptorOffset	= 0;
-		size_t						writeDescriptorSize	= 0;
+	unmapMemory(memory);
 
-		getInfo.type = b.descriptorType;
-		VTF_CALL_CHECK(di.vkGetDescriptorSetLayoutBindingOffsetEXT, *device, *dsLayout, b.binding, &descriptorOffset);
+	return descBuffer;
+}
 
-		if (descriptorTypeOnList(b.descriptorType, {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER}))
+void DescriptorSetBindingManager::writeDescriptorBuffer_ (ZBuffer descBuffer, ZDescriptorSetLayout dsLayout, add_cref<ExtBinding> b)
+{
+	ASSERTMSG(b.descriptorType != VK_DESCRIPTOR_TYPE_MUTABLE_EXT,
+		"In the descriptor-buffer model, none of the binding can be MUTABLE_EXT");
+
+	add_cref<ZDeviceInterface>	di					= device.getInterface();
+	add_cref<VkPhysicalDeviceDescriptorBufferPropertiesEXT> dbp = getDescriptorBufferProperties_();
+	const VkDeviceSize			bufferSize			= bufferGetSize(descBuffer);
+	ZDeviceMemory				memory				= bufferGetMemory(descBuffer, 0);
+	add_ptr<uint8_t>			data				= mapMemory(memory);
+	VkDescriptorAddressInfoEXT	addressInfo			= makeVkStruct();
+	VkDescriptorGetInfoEXT		getInfo				= makeVkStruct();
+	VkDescriptorImageInfo		imageInfo			{};
+	VkDeviceSize				descriptorOffset	= 0;
+	size_t						writeDescriptorSize	= 0;
+	uint32_t					descriptorCount		= 1u;
+	const bool					isBuffer			= descriptorTypeOnList(b.descriptorType,
+															{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER });
+
+	getInfo.type = b.descriptorType;
+	VTF_CALL_CHECK(di.vkGetDescriptorSetLayoutBindingOffsetEXT, *device, *dsLayout, b.binding, &descriptorOffset);
+
+	if (isBuffer)
+	{
+		if (b.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+		{
+			getInfo.data.pUniformBuffer = b.isNull ? nullptr : &addressInfo;
+			writeDescriptorSize = dbp.uniformBufferDescriptorSize;
+		}
+		else
+		{
+			getInfo.data.pStorageBuffer = b.isNull ? nullptr : &addressInfo;
+			writeDescriptorSize = dbp.storageBufferDescriptorSize;
+		}
+		// Array elements split the buffer the same way updateDescriptorSet() does
+		descriptorCount = b.isNull ? 1u : b.descriptorCount;
+	}
+	else
+	{
+		switch (b.descriptorType)
+		{
+		case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+		case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+		case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
 		{
 			if (false == b.isNull)
 			{
-				ZBuffer buffer = b.buffer;
-				addressInfo.address = bufferGetAddress(buffer, b.binding, b.descriptorType);
-				addressInfo.range = bufferGetSize(buffer);
-				addressInfo.format = buffer.getParam<VkFormat>();
+				ZImageView	view = b.view;
+				imageInfo.imageView = *view;
+				imageInfo.imageLayout = b.imageLayout;
+			}
+			if (b.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE)
+			{
+				getInfo.data.pStorageImage = &imageInfo;
+				writeDescriptorSize = dbp.storageImageDescriptorSize;
 			}
-			if (b.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+			else if (b.descriptorType == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT)
 			{
-				getInfo.data.pUniformBuffer = &addressInfo;
-				writeDescriptorSize = dbp.uniformBufferDescriptorSize;
+				getInfo.data.pInputAttachmentImage = &imageInfo;
+				writeDescriptorSize = dbp.inputAttachmentDescriptorSize;
 			}
 			else
 			{
-				getInfo.data.pStorageBuffer = &addressInfo;
-				writeDescriptorSize = dbp.storageBufferDescriptorSize;
+				getInfo.data.pSampledImage = &imageInfo;
+				writeDescriptorSize = dbp.sampledImageDescriptorSize;
 			}
 		}
-		else
+		break;
+		case VK_DESCRIPTOR_TYPE_SAMPLER:
 		{
-			switch (b.descriptorType)
-			{
-			case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
-			case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
-			case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
-			{
-				if (false == b.isNull)
-				{
-					ZImageView	view = b.view;
-					imageInfo.imageView = *view;
-					imageInfo.imageLayout = b.imageLayout;
-				}
-				if (b.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE)
-				{
-					getInfo.data.pStorageImage = &imageInfo;
-					writeDescriptorSize = dbp.storageImageDescriptorSize;
-				}
-				else
-				{
-					getInfo.data.pSampledImage = &imageInfo;
-					writeDescriptorSize = dbp.sampledImageDescriptorSize;
-				}
-			}
-			break;
-			case VK_DESCRIPTOR_TYPE_SAMPLER:
+			getInfo.data.pSampler = b.isNull ? nullptr : b.sampler.ptr();
+			writeDescriptorSize = dbp.samplerDescriptorSize;
+		}
+		break;
+		case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+		{
+			if (false == b.isNull)
 			{
-				getInfo.data.pSampler = b.isNull ? nullptr : b.sampler.ptr();
-				writeDescriptorSize = dbp.samplerDescriptorSize;
+				ZImageView	view = b.view;
+				ZSampler	samp = b.sampler;
+				imageInfo.sampler = *samp;
+				imageInfo.imageView = *view;
+				imageInfo.imageLayout = b.imageLayout;
 			}
-			break;
-			case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+			getInfo.data.pCombinedImageSampler = &imageInfo;
+			writeDescriptorSize = dbp.combinedImageSamplerDescriptorSize;
+		}
+		break;
+		default:
+			ASSERTFALSE("Unsupported descryptor type: ",
+				vk::to_string(static_cast<vk::DescriptorType>(b.descriptorType)));
+		}
+	}
+
+	ASSERTMSG((descriptorOffset + descriptorCount * writeDescriptorSize) <= bufferSize,
+		"Descriptor buffer is too small for binding ", b.binding);
+
+	ZBuffer			buffer				= b.buffer;
+	VkDeviceSize	arrayElementSize	= 0u;
+	VkDeviceAddress	bufferAddress		= 0u;
+	if (isBuffer && false == b.isNull)
+	{
+		arrayElementSize	= (descriptorCount == 1u) ? bufferGetSize(buffer) : b.stride;
+		bufferAddress		= bufferGetAddress(buffer, b.binding, b.descriptorType);
+		addressInfo.range	= arrayElementSize;
+		addressInfo.format	= buffer.getParam<VkFormat>();
+	}
+	for (uint32_t arrayElement = 0u; arrayElement < descriptorCount; ++arrayElement)
+	{
+		if (isBuffer && false == b.isNull)
+		{
+			addressInfo.address = bufferAddress + arrayElement * arrayElementSize;
+			if (descriptorCount > 1u && arrayElement == (descriptorCount - 1u))
 			{
-				if (false == b.isNull)
-				{
-					ZImageView	view = b.view;
-					ZSampler	samp = b.sampler;
-					if (dbp.combinedImageSamplerDescriptorSingleArray)
-					{
-						// TODO
-					}
-					imageInfo.sampler = *samp;
-					imageInfo.imageView = *view;
-					imageInfo.imageLayout = b.imageLayout;
-				}
-				getInfo.data.pCombinedImageSampler = &imageInfo;
-				writeDescriptorSize = dbp.combinedImageSamplerDescriptorSize;
-			}
-			break;
-			default:
-				ASSERTFALSE("Unsupported descryptor type: ",
-					vk::to_string(static_cast<vk::DescriptorType>(b.descriptorType)));
+				addressInfo.range += (bufferGetSize(buffer) % b.stride);
 			}
 		}
-
-		ASSERTMSG((descriptorOffset + writeDescriptorSize) <= layoutSize, "");
-		VTF_CALL_CHECK(di.vkGetDescriptorEXT, *device, &getInfo, writeDescriptorSize, (data + descriptorOffset));
+		VTF_CALL_CHECK(di.vkGetDescriptorEXT, *device, &getInfo, writeDescriptorSize,
+			(data + descriptorOffset + arrayElement * writeDescriptorSize));
 	}
 
-	VTF_CALL_CHECK(di.vkUnmapMemory, *device, *memory);
+	unmapMemory(memory);
+}
 
-	return descBuffer;
+void DescriptorSetBindingManager::updateDescriptorBuffer (
+	ZBuffer descBuffer, ZDescriptorSetLayout dsLayout, uint32_t binding, ZBuffer buffer)
+{
+	ExtBinding b = verifyGetExtBinding(binding);
+	ASSERTMSG(descriptorTypeOnList(b.descriptorType, { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER }),
+		"Binding ", binding, " is not a buffer");
+	ASSERTMSG(buffer.has_handle(), "Buffer must have a handle");
+	b.buffer = buffer;
+	writeDescriptorBuffer_(descBuffer, dsLayout, b);
+}
+
+void DescriptorSetBindingManager::updateDescriptorBuffer (
+	ZBuffer descBuffer, ZDescriptorSetLayout dsLayout, uint32_t binding, ZSampler sampler)
+{
+	ExtBinding b = verifyGetExtBinding(binding);
+	ASSERTMSG(VK_DESCRIPTOR_TYPE_SAMPLER == b.descriptorType, "Binding ", binding, " is not a sampler");
+	ASSERTMSG(sampler.has_handle(), "Sampler must have a handle");
+	b.sampler = sampler;
+	writeDescriptorBuffer_(descBuffer, dsLayout, b);
+}
+
+void DescriptorSetBindingManager::updateDescriptorBuffer (
+	ZBuffer descBuffer, ZDescriptorSetLayout dsLayout, uint32_t binding, ZImageView view, VkImageLayout imageLayout)
+{
+	ExtBinding b = verifyGetExtBinding(binding);
+	ASSERTMSG(descriptorTypeOnList(b.descriptorType,
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT }),
+		"Binding ", binding, " is not an image");
+	ASSERTMSG(view.has_handle(), "View must have a handle");
+	b.view = view;
+	if (VK_IMAGE_LAYOUT_UNDEFINED != imageLayout)
+	{
+		b.imageLayout = (VK_IMAGE_LAYOUT_MAX_ENUM == imageLayout) ? imageGetLayout(imageViewGetImage(view)) : imageLayout;
+	}
+	writeDescriptorBuffer_(descBuffer, dsLayout, b);
+}
+
+void DescriptorSetBindingManager::updateDescriptorBuffer (
+	ZBuffer descBuffer, ZDescriptorSetLayout dsLayout, uint32_t binding, ZImageView view,
+	ZSampler sampler, VkImageLayout imageLayout)
+{
+	ExtBinding b = verifyGetExtBinding(binding);
+	ASSERTMSG(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER == b.descriptorType,
+		"Binding ", binding, " is not a combined image sampler");
+	ASSERTMSG(view.has_handle() && sampler.has_handle(), "View and Sampler must have a handle");
+	b.view = view;
+	b.sampler = sampler;
+	if (VK_IMAGE_LAYOUT_UNDEFINED != imageLayout)
+	{
+		b.imageLayout = (VK_IMAGE_LAYOUT_MAX_ENUM == imageLayout) ? imageGetLayout(imageViewGetImage(view)) : imageLayout;
+	}
+	writeDescriptorBuffer_(descBuffer, dsLayout, b);
 }
 
 } // namespace vtf
@@ -2,15 +2,18 @@
 #define __VTF_PIPELINE_LAYOUT_HPP_INCLUDED__
 
 #include <algorithm>
+#include <array>
 #include <map>
 #include <memory>
 #include <optional>
+#include <tuple>
 #include <typeindex>
 #include <type_traits>
 #include <variant>
 #include "vtfZDeletable.hpp"
 #include "vtfContext.hpp"
 #include "vtfZPushConstants.hpp"
+#include "vtfSpirvReflection.hpp"
 
 /*
  * +===========================================+=====================+==============================+
@@ -56,6 +59,23 @@ struct DescriptorBufferInfo
 };
 typedef std::variant<std::monostate, DescriptorBufferInfo, DescriptorImageInfo>	VarDescriptorInfo;
 
+/**
+ * Descriptor set layouts and pipeline layouts created from the same create info share one
+ * Vulkan object, descriptor sets are allocated from pools of many sets. Counters are per device.
+ */
+struct DescriptorCacheStats
+{
+	uint32_t	setLayouts;				// VkDescriptorSetLayout objects created
+	uint32_t	setLayoutHits;			// layouts that have reused an existing one
+	uint32_t	pipelineLayouts;
+	uint32_t	pipelineLayoutHits;
+	uint32_t	descriptorPools;		// pages of descriptor sets created
+	uint32_t	descriptorSets;			// sets allocated from the pages
+};
+DescriptorCacheStats getDescriptorCacheStats (ZDevice device);
+// Digest of the bindings a layout has been created from, all zeros for a layout created elsewhere
+auto descriptorSetLayoutGetDigest (ZDescriptorSetLayout layout) -> std::array<uint8_t, 32>;
+
 class DescriptorSetBindingManager
 {
 	friend class RTLayoutManager;
@@ -123,6 +143,16 @@ public:
 	uint32_t	addArrayBinding	(ZBuffer, VkDescriptorType, uint32_t elemCount, uint32_t stride,
 							VkShaderStageFlags = VK_SHADER_STAGE_ALL, VkDescriptorBindingFlags = 0);
 
+	/**
+	 * Adds the bindings the shaders declare in the given set, see ProgramCollection::reflect().
+	 * Bindings added earlier with their resources are kept, their type must match the declared one.
+	 * Reflected bindings have no resources, they are written with updateDescriptorSet(ds, binding, ...).
+	 * Returns the number of bindings added.
+	 */
+	uint32_t	addReflectedBindings	(add_cref<SpirvInterface> iface, uint32_t set = 0u);
+	// Throws if a binding the shaders declare in the given set is missing or has a different type or count
+	void		verifyReflectedBindings	(add_cref<SpirvInterface> iface, uint32_t set = 0u) const;
+
 	/**
 	 * Allows to write data directly to an associated data buffer.
 	 * A type of Data_ is veryfied before read, if doesn't match then throws an exception.
@@ -158,6 +188,7 @@ public:
 																		 VkDescriptorSetLayoutCreateFlags = VkDescriptorSetLayoutCreateFlags(0),
 																		 VkDescriptorPoolCreateFlags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT);
 	static ZDescriptorSetLayout				getDescriptorSetLayout		(ZPipelineLayout layout, uint32_t index = 0u);
+	// Empty for a push descriptor layout, see setFrequentlyUpdated()
 	static ZDescriptorSet					getDescriptorSet			(ZDescriptorSetLayout dsLayout);
 	/**
 	 * Updates descriptor set bindings. Descriptor set must match a descriptor
@@ -176,13 +207,57 @@ public:
 	virtual void updateDescriptorSet (ZDescriptorSet descriptorSet);
 	virtual bool isDescryptorTypeSupported (VkDescriptorType type) const;
 
+	/**
+	 * Marks the set as updated frequently, e.g. before every draw, must be called before createDescriptorSetLayout().
+	 * The layout becomes a push descriptor layout if VK_KHR_push_descriptor is enabled and the bindings allow it,
+	 * otherwise a regular set written through a descriptor update template. updateDescriptorSet(ds, binding, ...)
+	 * then only remembers the resources and pushDescriptorSet() writes all of them from one packed array,
+	 * no VkWriteDescriptorSet is built per draw. framesInFlight is the number of frames whose sets
+	 * pushDescriptorSet() keeps apart when it has to fall back to regular sets, see beginFrame(). Call it
+	 * before anything is recorded.
+	 */
+	void	setFrequentlyUpdated	(bool frequentlyUpdated = true, uint32_t framesInFlight = 2u);
+	/**
+	 * Pushes the remembered resources with vkCmdPushDescriptorSetWithTemplateKHR. Without push descriptors
+	 * a fresh set is written and bound on every call instead, because a set that has been bound must not
+	 * be updated until the commands which use it complete. The layout at the given index of the pipeline's
+	 * layout must come from this manager.
+	 */
+	void	pushDescriptorSet		(ZCommandBuffer cmd, ZPipeline pipeline, uint32_t set = 0u);
+	/**
+	 * Moves to the next of framesInFlight frames and recycles the sets pushDescriptorSet() has written
+	 * in it before, so it must be called once per frame when that frame has completed, e.g. at the
+	 * beginning of command recording. Does nothing if push descriptors are used.
+	 */
+	void	beginFrame				();
+
 	ZPipelineLayout				 createPipelineLayout ();
 	ZPipelineLayout				 createPipelineLayout (add_cref<ZPushConstants> pushConstants);
 	ZPipelineLayout				 createPipelineLayout (std::initializer_list<ZDescriptorSetLayout>, add_cref<ZPushConstants>);
 	template<class... PC__>	auto createPipelineLayout (const ZPushRange<PC__>&...) -> ZPipelineLayout;
 	template<class... PC__>	auto createPipelineLayout (std::initializer_list<ZDescriptorSetLayout>, const ZPushRange<PC__>&...) -> ZPipelineLayout;
+	/**
+	 * Pipeline layout of shaders that use at most one set: adds the reflected bindings, creates the set layout
+	 * and a pipeline layout with the given push constants, which must cover the shaders' push constant block.
+	 * The set is updated only if all the bindings had been added with their resources before.
+	 * The layouts are shared through the cache like the ones created explicitly.
+	 */
+	ZPipelineLayout				 createReflectedPipelineLayout (add_cref<SpirvInterface> iface,
+																add_cref<ZPushConstants> pushConstants = {});
 
-	ZBuffer						 createDescriptorBuffer (ZDescriptorSetLayout dsLayout);
+	/**
+	 * Creates a buffer for the descriptor-buffer model (VK_EXT_descriptor_buffer) and writes all the bindings
+	 * into it with vkGetDescriptorEXT. The layout must have been created with DESCRIPTOR_BUFFER_BIT_EXT.
+	 * The buffer stays mapped, updateDescriptorBuffer(...) are the counterparts of updateDescriptorSet(...)
+	 * and write the descriptors of a single binding straight into it.
+	 */
+	ZBuffer		createDescriptorBuffer	(ZDescriptorSetLayout dsLayout);
+	void		updateDescriptorBuffer	(ZBuffer descBuffer, ZDescriptorSetLayout dsLayout, uint32_t binding, ZBuffer buffer);
+	void		updateDescriptorBuffer	(ZBuffer descBuffer, ZDescriptorSetLayout dsLayout, uint32_t binding, ZSampler sampler);
+	void		updateDescriptorBuffer	(ZBuffer descBuffer, ZDescriptorSetLayout dsLayout, uint32_t binding, ZImageView view,
+										 VkImageLayout layout = VK_IMAGE_LAYOUT_MAX_ENUM);
+	void		updateDescriptorBuffer	(ZBuffer descBuffer, ZDescriptorSetLayout dsLayout, uint32_t binding, ZImageView view,
+										 ZSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_MAX_ENUM);
 
 protected:	
 	typedef struct VkDescriptorSetLayoutBindingAndType : VkDescriptorSetLayoutBinding
@@ -261,9 +336,39 @@ protected:
 
 	ZPipelineLayout		createPipelineLayout_	(add_cref<ZPushConstants> pushConstants,
 												 std::initializer_list<ZDescriptorSetLayout> dsLayouts);
+	void				writeDescriptorBuffer_	(ZBuffer descBuffer, ZDescriptorSetLayout dsLayout, add_cref<ExtBinding> b);
+
+	// Template data, every descriptor takes one element regardless of its type
+	union TemplateElement
+	{
+		VkDescriptorImageInfo	image;
+		VkDescriptorBufferInfo	buffer;
+	};
+	bool				isTemplatable_			() const;
+	auto				makeTemplateEntries_	() const -> std::vector<VkDescriptorUpdateTemplateEntry>;
+	void				fillTemplateData_		();
+	auto				createUpdateTemplate_	(ZDescriptorSetLayout dsLayout, ZPipelineLayout layout,
+												 uint32_t set, VkPipelineBindPoint bindPoint) -> ZDescriptorUpdateTemplate;
+	ZDescriptorSet		allocateFrameSet_		(ZDescriptorSetLayout dsLayout);
+	add_cref<VkPhysicalDeviceDescriptorBufferPropertiesEXT> getDescriptorBufferProperties_ ();
 private:
 	ExtBindings											m_extbindings;
 	uint32_t											m_identifier;
+	std::optional<VkPhysicalDeviceDescriptorBufferPropertiesEXT>	m_descriptorBufferProperties;
+	bool												m_frequentlyUpdated;
+	std::vector<TemplateElement>						m_templateData;
+	ZDescriptorUpdateTemplate							m_setTemplate;
+	// Push templates are made for a pipeline layout and a set index
+	std::vector<std::tuple<ZPipelineLayout, uint32_t, VkPipelineBindPoint, ZDescriptorUpdateTemplate>>	m_pushTemplates;
+	// Pools of the sets pushDescriptorSet() writes without push descriptors, reset per frame by beginFrame()
+	struct FramePools
+	{
+		std::vector<ZDescriptorPool>	pools;
+		uint32_t						current;
+	};
+	std::vector<FramePools>								m_framePools;
+	uint32_t											m_frame;
+	std::optional<std::map<VkDescriptorType, uint32_t>>	m_frameSetSizes;	// empty if the set can't come from them
 	static uint32_t										m_counter;
 };
 // just most friendly name and shorter :)
@@ -0,0 +1,150 @@
+#include "vtfDigest.hpp"
+
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+
+constexpr uint32_t K[64]
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+constexpr uint32_t rotr (uint32_t x, uint32_t n)
+{
+	return (x >> n) | (x << (32u - n));
+}
+
+} // unnamed namespace
+
+namespace vtf
+{
+
+Digest::Digest ()
+{
+	reset();
+}
+
+void Digest::reset ()
+{
+	m_state[0] = 0x6a09e667; m_state[1] = 0xbb67ae85; m_state[2] = 0x3c6ef372; m_state[3] = 0xa54ff53a;
+	m_state[4] = 0x510e527f; m_state[5] = 0x9b05688c; m_state[6] = 0x1f83d9ab; m_state[7] = 0x5be0cd19;
+	m_chunkSize = 0u;
+	m_totalSize = 0u;
+}
+
+void Digest::transform (add_cptr<uint8_t> chunk)
+{
+	uint32_t w[64];
+	for (uint32_t i = 0u; i < 16u; ++i)
+	{
+		w[i] = (uint32_t(chunk[i * 4u]) << 24) | (uint32_t(chunk[i * 4u + 1u]) << 16)
+			 | (uint32_t(chunk[i * 4u + 2u]) << 8) | uint32_t(chunk[i * 4u + 3u]);
+	}
+	for (uint32_t i = 16u; i < 64u; ++i)
+	{
+		const uint32_t s0 = rotr(w[i - 15u], 7u) ^ rotr(w[i - 15u], 18u) ^ (w[i - 15u] >> 3);
+		const uint32_t s1 = rotr(w[i - 2u], 17u) ^ rotr(w[i - 2u], 19u) ^ (w[i - 2u] >> 10);
+		w[i] = w[i - 16u] + s0 + w[i - 7u] + s1;
+	}
+
+	uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+	uint32_t e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+
+	for (uint32_t i = 0u; i < 64u; ++i)
+	{
+		const uint32_t S1 = rotr(e, 6u) ^ rotr(e, 11u) ^ rotr(e, 25u);
+		const uint32_t ch = (e & f) ^ ((~e) & g);
+		const uint32_t t1 = h + S1 + ch + K[i] + w[i];
+		const uint32_t S0 = rotr(a, 2u) ^ rotr(a, 13u) ^ rotr(a, 22u);
+		const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+		const uint32_t t2 = S0 + maj;
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+
+	m_state[0] += a; m_state[1] += b; m_state[2] += c; m_state[3] += d;
+	m_state[4] += e; m_state[5] += f; m_state[6] += g; m_state[7] += h;
+}
+
+add_ref<Digest> Digest::update (add_cptr<void> data, std::size_t size)
+{
+	add_cptr<uint8_t> bytes = static_cast<add_cptr<uint8_t>>(data);
+	m_totalSize += size;
+	while (size)
+	{
+		const std::size_t n = std::min(size, std::size_t(64u - m_chunkSize));
+		std::memcpy(&m_chunk[m_chunkSize], bytes, n);
+		m_chunkSize += uint32_t(n);
+		bytes += n;
+		size -= n;
+		if (m_chunkSize == 64u)
+		{
+			transform(m_chunk);
+			m_chunkSize = 0u;
+		}
+	}
+	return *this;
+}
+
+add_ref<Digest> Digest::update (add_cref<std::string> text)
+{
+	update(uint64_t(text.length()));
+	return update(text.data(), text.length());
+}
+
+Digest::value_type Digest::finish ()
+{
+	const uint64_t totalBits = m_totalSize * 8u;
+	const uint8_t pad = 0x80;
+	const uint8_t zero = 0x00;
+	update(&pad, 1u);
+	while (m_chunkSize != 56u)
+	{
+		update(&zero, 1u);
+	}
+	uint8_t length[8];
+	for (uint32_t i = 0u; i < 8u; ++i)
+	{
+		length[i] = uint8_t(totalBits >> (56u - i * 8u));
+	}
+	update(length, sizeof(length));
+
+	value_type result;
+	for (uint32_t i = 0u; i < 8u; ++i)
+	{
+		result[i * 4u + 0u] = uint8_t(m_state[i] >> 24);
+		result[i * 4u + 1u] = uint8_t(m_state[i] >> 16);
+		result[i * 4u + 2u] = uint8_t(m_state[i] >> 8);
+		result[i * 4u + 3u] = uint8_t(m_state[i]);
+	}
+	reset();
+	return result;
+}
+
+std::string Digest::toString (add_cref<value_type> digest)
+{
+	std::ostringstream ss;
+	ss << std::hex << std::setfill('0');
+	for (const uint8_t byte : digest)
+	{
+		ss << std::setw(2) << uint32_t(byte);
+	}
+	return ss.str();
+}
+
+Digest::value_type Digest::make (add_cptr<void> data, std::size_t size)
+{
+	return Digest().update(data, size).finish();
+}
+
+} // namespace vtf
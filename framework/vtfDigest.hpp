@@ -0,0 +1,59 @@
+#ifndef __VTF_DIGEST_HPP_INCLUDED__
+#define __VTF_DIGEST_HPP_INCLUDED__
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vtfZDeletable.hpp"
+
+namespace vtf
+{
+
+// SHA-256 message digest, used everywhere a content must be identified
+// regardless of its name, e.g. shader sources or SPIR-V binaries.
+struct Digest
+{
+	typedef std::array<uint8_t, 32> value_type;
+
+	Digest ();
+	add_ref<Digest>	update	(add_cptr<void> data, std::size_t size);
+	add_ref<Digest>	update	(add_cref<std::string> text);
+	template<class X>
+	add_ref<Digest>	update	(const std::vector<X>& data);
+	template<class X, std::enable_if_t<std::is_arithmetic_v<X> || std::is_enum_v<X>, int> = 0>
+	add_ref<Digest>	update	(const X& value);
+	// Completes calculation, after that the object is reset and is ready to calculate a new one
+	value_type		finish	();
+
+	static std::string toString (add_cref<value_type> digest);
+	static value_type make (add_cptr<void> data, std::size_t size);
+
+private:
+	void			transform	(add_cptr<uint8_t> chunk);
+	void			reset		();
+	uint32_t		m_state[8];
+	uint8_t			m_chunk[64];
+	uint32_t		m_chunkSize;
+	uint64_t		m_totalSize;
+};
+
+template<class X>
+add_ref<Digest> Digest::update (const std::vector<X>& data)
+{
+	static_assert(std::is_trivially_copyable_v<X>, "Only trivially copyable types are allowed");
+	// The size goes first, so consecutive vectors do not produce the same stream
+	update(uint64_t(data.size()));
+	return update(data.data(), data.size() * sizeof(X));
+}
+
+template<class X, std::enable_if_t<std::is_arithmetic_v<X> || std::is_enum_v<X>, int>>
+add_ref<Digest> Digest::update (const X& value)
+{
+	return update(&value, sizeof(X));
+}
+
+} // namespace vtf
+
+#endif // __VTF_DIGEST_HPP_INCLUDED__
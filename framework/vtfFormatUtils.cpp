@@ -3,6 +3,9 @@
 #include "vtfZDeletable.hpp"
 #include "vtfCUtils.hpp"
 
+#include <unordered_map>
+#include <vector>
+
 namespace
 {
 using namespace vtf;
@@ -137,6 +140,8 @@ const formatAndNames[]
 	MKFN(VK_FORMAT_R64G64B64A64_SINT),
 	MKFN(VK_FORMAT_R64G64B64A64_SFLOAT),
 	MKFN(VK_FORMAT_B10G11R11_UFLOAT_PACK32),
+	MKFN(VK_FORMAT_A4R4G4B4_UNORM_PACK16),
+	MKFN(VK_FORMAT_A4B4G4R4_UNORM_PACK16),
 
 	MKFN(VK_FORMAT_D16_UNORM),
 	MKFN(VK_FORMAT_D32_SFLOAT),
@@ -389,21 +394,72 @@ static ZFormatInfo makeFormatInfoDS (VkFormat format, const char* name)
 		i.integral = true;
 		i.stencil = true;
 		break;
+	case VK_FORMAT_S8_UINT:
+		i.componentBitSizes[1] = 8;
+		i.componentByteSizes[1] = 1;
+		i.integral = true;
+		i.stencil = true;
+		i.pixelByteSize = 1;
+		break;
 	default: ASSERTFALSE("Unknown DS format ", format);
 	}
 	return i;
 }
 
-static add_cptr<FormatAndName> findFormatAndName (VkFormat format)
+// All the format infos are made once, core formats are indexed directly by their values,
+// formats that come from extensions have huge values so they are hashed instead.
+struct FormatTable
 {
-	add_cptr<FormatAndName> pFan = nullptr;
-	for (const FormatAndName& fan : formatAndNames) {
-		if (fan.format == format) {
-			pFan = &fan;
-			break;
+	std::vector<ZFormatInfo>					infos;			// in formatAndNames order
+	std::vector<uint32_t>						coreIndices;	// VkFormat -> index of infos
+	std::unordered_map<uint32_t, uint32_t>	extensionIndices;
+
+	FormatTable ();
+	static add_cref<FormatTable> instance ();
+	add_cptr<ZFormatInfo> find (VkFormat format) const;
+};
+
+FormatTable::FormatTable ()
+	: infos				()
+	, coreIndices		()
+	, extensionIndices	()
+{
+	constexpr uint32_t firstExtensionFormat = 1000000000u;
+	const uint32_t count = ARRAY_LENGTH_CAST(formatAndNames, uint32_t);
+	infos.reserve(count);
+	for (uint32_t i = 0u; i < count; ++i)
+	{
+		add_cref<FormatAndName> fan = formatAndNames[i];
+		const bool depthStencil = formatIsDepthStencil(ZPhysicalDevice(), fan.format, false).first
+									|| fan.format == VK_FORMAT_S8_UINT;
+		infos.push_back(depthStencil ? makeFormatInfoDS(fan.format, fan.name) : makeFormatInfo(&fan));
+		infos.back().format = fan.format;
+
+		const uint32_t value = uint32_t(fan.format);
+		if (value < firstExtensionFormat)
+		{
+			if (value >= coreIndices.size()) coreIndices.resize((value + 1u), INVALID_UINT32);
+			coreIndices[value] = i;
 		}
+		else extensionIndices[value] = i;
 	}
-	return pFan;
+}
+
+add_cref<FormatTable> FormatTable::instance ()
+{
+	static const FormatTable table;
+	return table;
+}
+
+add_cptr<ZFormatInfo> FormatTable::find (VkFormat format) const
+{
+	const uint32_t value = uint32_t(format);
+	uint32_t index = INVALID_UINT32;
+	if (value < coreIndices.size())
+		index = coreIndices[value];
+	else if (auto i = extensionIndices.find(value); i != extensionIndices.end())
+		index = i->second;
+	return (INVALID_UINT32 != index) ? &infos[index] : nullptr;
 }
 
 } // unnamed namespace
@@ -437,23 +493,21 @@ ZFormatInfo::ZFormatInfo ()
 
 const char* formatGetString (VkFormat format)
 {
-	const FormatAndName* pFan = findFormatAndName(format);
-	return pFan ? pFan->name : nullptr;
+	add_cptr<ZFormatInfo> pInfo = FormatTable::instance().find(format);
+	return pInfo ? pInfo->name : nullptr;
 }
 
 
 ZFormatInfo	formatGetInfo (VkFormat format)
 {
-	add_cptr<FormatAndName> pFormatAndName = findFormatAndName(format);
-	ASSERTMSG(pFormatAndName, "Format not implemented ", uint64_t(format));
-	if (nullptr == pFormatAndName) {
+	add_cptr<ZFormatInfo> pInfo = FormatTable::instance().find(format);
+	ASSERTMSG(pInfo, "Format not implemented ", uint64_t(format));
+	if (nullptr == pInfo) {
 		ZFormatInfo	res{};
 		res.format	= VK_FORMAT_UNDEFINED;
 		return res;
 	}
-	return formatIsDepthStencil(ZPhysicalDevice(), format, false).first
-			? makeFormatInfoDS(format, pFormatAndName->name)
-			: makeFormatInfo(pFormatAndName);
+	return *pInfo;
 }
 
 VkImageAspectFlags formatGetAspectMask (VkFormat format)
@@ -567,7 +621,7 @@ bool ZFormatInfoIterator::next ()
 {
 	if ((m_current + 1) < ARRAY_LENGTH_CAST(formatAndNames, int))
 	{
-		*(static_cast<add_ptr<ZFormatInfo>>(this)) = makeFormatInfo(&formatAndNames[++m_current]);
+		*(static_cast<add_ptr<ZFormatInfo>>(this)) = FormatTable::instance().infos.at(make_unsigned(++m_current));
 		return true;
 	}
 	return false;
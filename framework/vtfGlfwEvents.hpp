@@ -41,13 +41,16 @@ struct CanvasEvent
 		m_callback	= aCallback;
 		m_userData	= anUserData;
 		m_enabled	= true;
-		(*m_setCallback)(*m_canvas.window, m_callCallback);
+		// Headless canvas has no window, the callback is kept but never called
+		if (m_canvas.window.has_handle())
+			(*m_setCallback)(*m_canvas.window, m_callCallback);
 	}
 	void enable (bool activate)
 	{
 		ASSERTION(m_callback);
 		m_enabled = activate;
-		(*m_setCallback)(*m_canvas.window, (activate ? m_callCallback : nullptr));
+		if (m_canvas.window.has_handle())
+			(*m_setCallback)(*m_canvas.window, (activate ? m_callCallback : nullptr));
 	}
 
 private:
@@ -0,0 +1,198 @@
+#include "vtfGpuProfiler.hpp"
+#include "vtfBacktrace.hpp"
+#include "vtfCUtils.hpp"
+#include "vtfZUtils.hpp"
+#include "vtfZCommandBuffer.hpp"
+#include "vtfProgressRecorder.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iterator>
+
+namespace vtf
+{
+
+GpuProfiler::GpuProfiler (ZDevice device, uint32_t framesInFlight, uint32_t maxRegions, bool synchronization2)
+	: m_device				(device)
+	, m_maxRegions			(maxRegions)
+	, m_synchronization2	(synchronization2)
+	, m_period				(double(deviceGetPhysicalLimits(device).timestampPeriod))
+	, m_validMask			(0u)
+	, m_frames				(framesInFlight)
+	, m_current				(INVALID_UINT32)
+	, m_stack				()
+	, m_stats				()
+	, m_collectedFrames		(0u)
+	, m_skippedFrames		(0u)
+{
+	ASSERTMSG(framesInFlight != 0u && maxRegions != 0u, "Frame and region count must not be zero");
+	for (add_ref<Frame> frame : m_frames)
+	{
+		frame.pool			= createQueryPool(device, VK_QUERY_TYPE_TIMESTAMP, 0u, (maxRegions * 2u));
+		frame.queryCount	= 0u;
+		frame.pending		= false;
+	}
+}
+
+void GpuProfiler::beginFrame (ZCommandBuffer cmd)
+{
+	ASSERTMSG(m_stack.empty(), "Previous frame has ", m_stack.size(), " unclosed region(s)");
+
+	if (0u == m_validMask)
+	{
+		ZPhysicalDevice		physDevice	= m_device.getParam<ZPhysicalDevice>();
+		add_cref<ZInstanceInterface> ii = physDevice.getParam<ZInstance>().getInterface();
+		const uint32_t		family		= queueGetFamilyIndex(cmd.getParam<ZCommandPool>().getParam<ZQueue>());
+		uint32_t			familyCount	= 0u;
+		VTF_CALL_CHECK(ii.vkGetPhysicalDeviceQueueFamilyProperties, *physDevice, &familyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> families(familyCount);
+		VTF_CALL_CHECK(ii.vkGetPhysicalDeviceQueueFamilyProperties, *physDevice, &familyCount, families.data());
+		const uint32_t validBits = families.at(family).timestampValidBits;
+		ASSERTMSG(validBits != 0u, "Queue family ", family, " does not support timestamps");
+		m_validMask = (validBits >= 64u) ? INVALID_UINT64 : ((uint64_t(1) << validBits) - 1u);
+	}
+
+	m_current = (m_current + 1u) % uint32_t(m_frames.size());
+	add_ref<Frame> frame = m_frames[m_current];
+	if (frame.pending && false == collectFrame(frame, false))
+	{
+		m_skippedFrames += 1u;
+	}
+	frame.regions.clear();
+	frame.queryCount = 0u;
+	frame.pending = true;
+	commandBufferResetQueryPool(cmd, frame.pool);
+}
+
+uint32_t GpuProfiler::writeTimestamp (ZCommandBuffer cmd, bool begin)
+{
+	add_ref<Frame>	frame	= m_frames[m_current];
+	const uint32_t	query	= frame.queryCount++;
+	add_cref<ZDeviceInterface> di = cmd.getParam<ZDevice>().getInterface();
+	if (m_synchronization2)
+	{
+		const VkPipelineStageFlags2 stage = begin ? VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		// core since 1.3, otherwise only VK_KHR_synchronization2 provides it
+		const auto writeTimestamp2 = di.vkCmdWriteTimestamp2 ? di.vkCmdWriteTimestamp2 : di.vkCmdWriteTimestamp2KHR;
+		VTF_CALL_CHECK(writeTimestamp2, *cmd, stage, *frame.pool, query);
+	}
+	else
+	{
+		const VkPipelineStageFlagBits stage = begin ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		VTF_CALL_CHECK(di.vkCmdWriteTimestamp, *cmd, stage, *frame.pool, query);
+	}
+	return query;
+}
+
+void GpuProfiler::beginRegion (ZCommandBuffer cmd, add_cref<std::string> name)
+{
+	ASSERTMSG(m_current != INVALID_UINT32, "beginFrame() must be called before any region");
+	add_ref<Frame> frame = m_frames[m_current];
+	ASSERTMSG(frame.regions.size() < m_maxRegions, "Too many regions in one frame, max is ", m_maxRegions);
+
+	const std::string path = m_stack.empty() ? name : (m_stats[frame.regions[m_stack.back()].statIndex].name + '/' + name);
+	auto stat = std::find_if(m_stats.begin(), m_stats.end(), [&](add_cref<Stats> s) { return s.name == path; });
+	if (stat == m_stats.end())
+	{
+		m_stats.push_back({ path, uint32_t(m_stack.size()), 0u, 0.0, 0.0, 0.0, 0.0 });
+		stat = std::prev(m_stats.end());
+	}
+
+	m_stack.push_back(uint32_t(frame.regions.size()));
+	frame.regions.push_back({ uint32_t(std::distance(m_stats.begin(), stat)), writeTimestamp(cmd, true), INVALID_UINT32 });
+}
+
+void GpuProfiler::endRegion (ZCommandBuffer cmd)
+{
+	ASSERTMSG(false == m_stack.empty(), "There is no region to end");
+	m_frames[m_current].regions[m_stack.back()].endQuery = writeTimestamp(cmd, false);
+	m_stack.pop_back();
+}
+
+GpuProfiler::Scope::Scope (add_ref<GpuProfiler> profiler, ZCommandBuffer cmd, add_cref<std::string> name)
+	: m_profiler	(profiler)
+	, m_cmd			(cmd)
+{
+	m_profiler.beginRegion(m_cmd, name);
+}
+
+GpuProfiler::Scope::~Scope ()
+{
+	m_profiler.endRegion(m_cmd);
+}
+
+bool GpuProfiler::collectFrame (add_ref<Frame> frame, bool wait)
+{
+	if (frame.queryCount)
+	{
+		std::vector<uint64_t> ticks(frame.queryCount);
+		const VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | (wait ? VK_QUERY_RESULT_WAIT_BIT : 0u);
+		add_cref<ZDeviceInterface> di = m_device.getInterface();
+		const VkResult result = VTF_CALL_CHECK(di.vkGetQueryPoolResults, *m_device, *frame.pool, 0u, frame.queryCount,
+								 (ticks.size() * sizeof(uint64_t)), ticks.data(), VkDeviceSize(sizeof(uint64_t)), flags);
+		if (VK_NOT_READY == result)
+		{
+			frame.pending = false;
+			return false;
+		}
+		VKASSERT(result);
+
+		for (add_cref<Region> region : frame.regions)
+		{
+			ASSERTMSG(region.endQuery != INVALID_UINT32, "Region ", m_stats[region.statIndex].name, " has not been ended");
+			const uint64_t begin	= ticks[region.beginQuery] & m_validMask;
+			const uint64_t end		= ticks[region.endQuery] & m_validMask;
+			const double ms = double((end - begin) & m_validMask) * m_period / 1000000.0;
+			add_ref<Stats> stat = m_stats[region.statIndex];
+			stat.min	= stat.count ? std::min(stat.min, ms) : ms;
+			stat.max	= stat.count ? std::max(stat.max, ms) : ms;
+			stat.total	+= ms;
+			stat.last	= ms;
+			stat.count	+= 1u;
+		}
+		m_collectedFrames += 1u;
+	}
+	frame.pending = false;
+	return true;
+}
+
+void GpuProfiler::collect (bool wait)
+{
+	ASSERTMSG(m_stack.empty(), "Results cannot be collected while a region is open");
+	const uint32_t frameCount = uint32_t(m_frames.size());
+	for (uint32_t i = 1u; m_current != INVALID_UINT32 && i <= frameCount; ++i)
+	{
+		// oldest frame first, the current one as the last
+		add_ref<Frame> frame = m_frames[(m_current + i) % frameCount];
+		if (frame.pending && false == collectFrame(frame, wait))
+		{
+			m_skippedFrames += 1u;
+		}
+	}
+}
+
+auto GpuProfiler::stats () const -> std::vector<Stats>
+{
+	return m_stats;
+}
+
+void GpuProfiler::print (std::ostream& stream) const
+{
+	stream << "GPU regions, frames: " << m_collectedFrames << ", skipped: " << m_skippedFrames << std::endl;
+	for (add_cref<Stats> s : m_stats)
+	{
+		stream << std::string((s.depth + 1u) * 2u, ' ') << s.name << std::fixed << std::setprecision(3)
+			<< " - avg: " << s.average() << " ms, min: " << s.min << " ms, max: " << s.max
+			<< " ms, count: " << s.count << std::defaultfloat << std::endl;
+	}
+}
+
+void GpuProfiler::report (add_ref<ProgressRecorder> recorder) const
+{
+	for (add_cref<Stats> s : m_stats)
+	{
+		recorder.stampGpu(s.name, s.average());
+	}
+}
+
+} // namespace vtf
@@ -0,0 +1,103 @@
+#ifndef __VTF_GPU_PROFILER_HPP_INCLUDED__
+#define __VTF_GPU_PROFILER_HPP_INCLUDED__
+
+#include "vtfZDeletable.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace vtf
+{
+
+struct ProgressRecorder;
+
+/**
+ * @brief Measures GPU time of named, possibly nested regions of command buffers.
+ * @note  Every frame gets its own timestamp query pool from a ring of framesInFlight pools.
+ *        beginFrame() moves to the next pool, reads back the results of the frame that used
+ *        it before and resets it, so results are always at least framesInFlight-1 frames old
+ *        and the host never waits for them. If that frame has not completed yet its results
+ *        are dropped and counted as skipped, a bigger ring solves that. Regions are written with
+ *        vkCmdWriteTimestamp2 if synchronization2 has been enabled on the device, otherwise with
+ *        vkCmdWriteTimestamp. Ticks are converted to milliseconds with timestampPeriod and
+ *        masked with timestampValidBits of the queue family. The profiler is not thread safe.
+ */
+class GpuProfiler
+{
+public:
+	struct Stats
+	{
+		std::string	name;		// names of the enclosing regions joined with '/'
+		uint32_t	depth;
+		uint32_t	count;
+		double		total;		// all times are in milliseconds
+		double		min;
+		double		max;
+		double		last;
+		double		average () const { return count ? (total / double(count)) : 0.0; }
+	};
+
+	GpuProfiler		(ZDevice device, uint32_t framesInFlight = 3u, uint32_t maxRegions = 64u, bool synchronization2 = false);
+	GpuProfiler		(const GpuProfiler&) = delete;
+	GpuProfiler&	operator=(const GpuProfiler&) = delete;
+
+	// Must be recorded into cmd before any region, the command buffer must be in the recording state
+	void beginFrame		(ZCommandBuffer cmd);
+	void beginRegion	(ZCommandBuffer cmd, add_cref<std::string> name);
+	void endRegion		(ZCommandBuffer cmd);
+
+	class Scope
+	{
+	public:
+		Scope	(add_ref<GpuProfiler> profiler, ZCommandBuffer cmd, add_cref<std::string> name);
+		Scope	(const Scope&) = delete;
+		~Scope	();
+	private:
+		add_ref<GpuProfiler>	m_profiler;
+		ZCommandBuffer			m_cmd;
+	};
+
+	// Reads back every frame that has been recorded, wait must be true only if all of them have been submitted
+	void	collect		(bool wait = false);
+	auto	stats		() const -> std::vector<Stats>;
+	void	print		(std::ostream& stream) const;
+	// Adds average time of each region to the recorder
+	void	report		(add_ref<ProgressRecorder> recorder) const;
+
+	uint32_t	collectedFrames	() const { return m_collectedFrames; }
+	uint32_t	skippedFrames	() const { return m_skippedFrames; }
+
+private:
+	struct Region
+	{
+		uint32_t	statIndex;
+		uint32_t	beginQuery;
+		uint32_t	endQuery;
+	};
+	struct Frame
+	{
+		ZQueryPool			pool;
+		std::vector<Region>	regions;
+		uint32_t			queryCount;
+		bool				pending;
+	};
+	bool		collectFrame	(add_ref<Frame> frame, bool wait);
+	uint32_t	writeTimestamp	(ZCommandBuffer cmd, bool begin);
+
+	const ZDevice				m_device;
+	const uint32_t				m_maxRegions;
+	const bool					m_synchronization2;
+	const double				m_period;
+	uint64_t					m_validMask;
+	std::vector<Frame>			m_frames;
+	uint32_t					m_current;
+	std::vector<uint32_t>		m_stack;
+	std::vector<Stats>			m_stats;
+	uint32_t					m_collectedFrames;
+	uint32_t					m_skippedFrames;
+};
+
+} // namespace vtf
+
+#endif // __VTF_GPU_PROFILER_HPP_INCLUDED__
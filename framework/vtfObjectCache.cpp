@@ -0,0 +1,96 @@
+#include "vtfObjectCache.hpp"
+#include "vtfBacktrace.hpp"
+
+#include <map>
+#include <mutex>
+
+namespace vtf
+{
+
+namespace
+{
+
+struct ObjectCache
+{
+	std::mutex											mutex;
+	std::weak_ptr<ZDevice::AnObject>					device;
+	std::map<Digest::value_type, std::weak_ptr<void>>	objects;
+	std::size_t											pruneSize = 64u;
+	bool												enabled = true;
+	ObjectCacheStats									stats{};
+};
+
+std::mutex objectCachesMutex;
+std::map<VkDevice, std::shared_ptr<ObjectCache>> objectCaches;
+
+std::shared_ptr<ObjectCache> getObjectCache (ZDevice device)
+{
+	std::lock_guard<std::mutex> lock(objectCachesMutex);
+	std::shared_ptr<ObjectCache>& cache = objectCaches[*device];
+	if (!cache || cache->device.expired())
+	{
+		cache = std::make_shared<ObjectCache>();
+		cache->device = device.asSharedPtr();
+		cache->enabled = getGlobalAppFlags().objectCache;
+	}
+	return cache;
+}
+
+} // unnamed namespace
+
+ObjectCacheStats getObjectCacheStats (ZDevice device)
+{
+	std::shared_ptr<ObjectCache> cache = getObjectCache(device);
+	std::lock_guard<std::mutex> lock(cache->mutex);
+	return cache->stats;
+}
+
+void deviceEnableObjectCache (ZDevice device, bool enable)
+{
+	std::shared_ptr<ObjectCache> cache = getObjectCache(device);
+	std::lock_guard<std::mutex> lock(cache->mutex);
+	cache->enabled = enable;
+}
+
+bool deviceIsObjectCacheEnabled (ZDevice device)
+{
+	std::shared_ptr<ObjectCache> cache = getObjectCache(device);
+	std::lock_guard<std::mutex> lock(cache->mutex);
+	return cache->enabled;
+}
+
+namespace details
+{
+
+std::shared_ptr<void> objectCacheFind (ZDevice device, add_cref<Digest::value_type> key)
+{
+	std::shared_ptr<ObjectCache> cache = getObjectCache(device);
+	std::lock_guard<std::mutex> lock(cache->mutex);
+	auto entry = cache->objects.find(key);
+	std::shared_ptr<void> object = (entry != cache->objects.end()) ? entry->second.lock() : nullptr;
+	if (object)
+	{
+		cache->stats.hits += 1u;
+	}
+	return object;
+}
+
+void objectCacheInsert (ZDevice device, add_cref<Digest::value_type> key, std::shared_ptr<void> object)
+{
+	std::shared_ptr<ObjectCache> cache = getObjectCache(device);
+	std::lock_guard<std::mutex> lock(cache->mutex);
+	cache->objects[key] = object;
+	cache->stats.created += 1u;
+	if (cache->objects.size() >= cache->pruneSize)
+	{
+		for (auto i = cache->objects.begin(); i != cache->objects.end();)
+		{
+			i = i->second.expired() ? cache->objects.erase(i) : std::next(i);
+		}
+		cache->pruneSize = std::max(std::size_t(64u), (cache->objects.size() * 2u));
+	}
+}
+
+} // namespace details
+
+} // namespace vtf
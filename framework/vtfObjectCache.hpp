@@ -0,0 +1,53 @@
+#ifndef __VTF_OBJECT_CACHE_HPP_INCLUDED__
+#define __VTF_OBJECT_CACHE_HPP_INCLUDED__
+
+#include "vtfZDeletable.hpp"
+#include "vtfDigest.hpp"
+
+#include <memory>
+
+namespace vtf
+{
+
+/**
+ * Samplers, image views, render passes and framebuffers created from identical create infos
+ * share one Vulkan object per device. Entries are weak, an object is destroyed as soon as
+ * the last user releases it. Keys start with the VkObjectType of the object, the rest is up
+ * to the creating function. Disabled for all devices with -noobjcache, tests that need
+ * distinct handles can disable it for their device only.
+ */
+struct ObjectCacheStats
+{
+	uint32_t	created;	// objects created and registered
+	uint32_t	hits;		// requests satisfied by an existing object
+};
+ObjectCacheStats	getObjectCacheStats			(ZDevice device);
+void				deviceEnableObjectCache		(ZDevice device, bool enable);
+bool				deviceIsObjectCacheEnabled	(ZDevice device);
+
+namespace details
+{
+std::shared_ptr<void>	objectCacheFind		(ZDevice device, add_cref<Digest::value_type> key);
+void					objectCacheInsert	(ZDevice device, add_cref<Digest::value_type> key, std::shared_ptr<void> object);
+} // namespace details
+
+template<class Z, class Create>
+Z objectCacheFindOrCreate (ZDevice device, add_cref<Digest::value_type> key, Create&& create)
+{
+	if (false == deviceIsObjectCacheEnabled(device))
+	{
+		return create();
+	}
+	if (std::shared_ptr<void> existing = details::objectCacheFind(device, key); existing)
+	{
+		return Z(std::static_pointer_cast<typename Z::AnObject>(existing));
+	}
+	// Created outside of the lock, the worst case is the same object created twice in parallel
+	Z object = create();
+	details::objectCacheInsert(device, key, object.asSharedPtr());
+	return object;
+}
+
+} // namespace vtf
+
+#endif // __VTF_OBJECT_CACHE_HPP_INCLUDED__
@@ -0,0 +1,114 @@
+#include "vtfParallelCommandRecorder.hpp"
+#include "vtfTaskScheduler.hpp"
+#include "vtfZCommandBuffer.hpp"
+#include "vtfBacktrace.hpp"
+#include "vtfCUtils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+namespace vtf
+{
+
+ParallelCommandRecorder::ParallelCommandRecorder (ZDevice device, ZQueue queue, uint32_t framesInFlight)
+	: ParallelCommandRecorder(device, queue, framesInFlight, TaskScheduler::instance())
+{
+}
+
+ParallelCommandRecorder::ParallelCommandRecorder (ZDevice device, ZQueue queue, uint32_t framesInFlight,
+												  add_ref<TaskScheduler> scheduler)
+	: m_device		(device)
+	, m_scheduler	(scheduler)
+	, m_frames		(framesInFlight)
+	, m_current		(0u)
+	, m_stats		()
+{
+	ASSERTMSG(framesInFlight != 0u, "Frame count must not be zero");
+	// The last pool of each frame belongs to the thread that calls record()
+	const uint32_t threadCount = scheduler.workerCount() + 1u;
+	for (add_ref<std::vector<ThreadPool>> frame : m_frames)
+	{
+		frame.resize(threadCount);
+		for (add_ref<ThreadPool> thread : frame)
+		{
+			thread.pool = createCommandPool(device, queue, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+			thread.used = 0u;
+		}
+	}
+}
+
+void ParallelCommandRecorder::beginFrame ()
+{
+	m_current = (m_current + 1u) % data_count(m_frames);
+	add_cref<ZDeviceInterface> di = m_device.getInterface();
+	for (add_ref<ThreadPool> thread : m_frames[m_current])
+	{
+		if (thread.used)
+		{
+			VKASSERT(VTF_CALL_CHECK(di.vkResetCommandPool, *m_device, *thread.pool, VkCommandPoolResetFlags(0)));
+			thread.used = 0u;
+		}
+	}
+	m_stats.frames += 1u;
+}
+
+ZCommandBuffer ParallelCommandRecorder::acquire (uint32_t threadSlot)
+{
+	add_ref<ThreadPool> thread = m_frames[m_current].at(threadSlot);
+	if (thread.used == data_count(thread.buffers))
+	{
+		thread.buffers.push_back(createCommandBuffer(thread.pool, false));
+	}
+	return thread.buffers[thread.used++];
+}
+
+void ParallelCommandRecorder::record (add_cref<ZRenderPassBeginInfo> renderPassBegin, uint32_t chunkCount,
+									  OnChunkRecording onChunkRecording, uint32_t maxThreads)
+{
+	ASSERTMSG(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS == renderPassBegin.getContents(),
+			  "Render pass must be begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS");
+	if (0u == chunkCount) return;
+
+	typedef std::chrono::steady_clock clock;
+	const ZFramebuffer			framebuffer		= renderPassBegin.getFramebuffer();
+	const ZRenderPass			renderPass		= renderPassBegin.getRenderPass();
+	const uint32_t				subpass			= renderPassBegin.getSubpass();
+	const uint32_t				callerSlot		= m_scheduler.workerCount();
+	std::vector<ZCommandBuffer>	secondaries		(chunkCount);
+	std::vector<double>			chunkTimes		(chunkCount);
+	std::vector<uint32_t>		usedBefore		(m_frames[m_current].size());
+	for (uint32_t i = 0u; i < data_count(usedBefore); ++i)
+		usedBefore[i] = m_frames[m_current][i].used;
+
+	const auto start = clock::now();
+	m_scheduler.parallelFor(0u, chunkCount, 1u, [&](uint32_t first, uint32_t last)
+	{
+		const uint32_t worker = m_scheduler.workerIndex();
+		const uint32_t slot = (worker == INVALID_UINT32) ? callerSlot : worker;
+		for (uint32_t chunk = first; chunk < last; ++chunk)
+		{
+			const auto chunkStart = clock::now();
+			ZCommandBuffer cmd = acquire(slot);
+			commandBufferBegin(cmd, framebuffer, renderPass, subpass);
+				onChunkRecording(cmd, chunk);
+			commandBufferEnd(cmd);
+			secondaries[chunk] = cmd;
+			chunkTimes[chunk] = std::chrono::duration<double, std::milli>(clock::now() - chunkStart).count();
+		}
+	}, maxThreads);
+	const std::chrono::duration<double, std::milli> wall = clock::now() - start;
+
+	commandBufferExecuteCommands(renderPassBegin.getCommandBuffer(), secondaries);
+
+	uint32_t threads = 0u;
+	for (uint32_t i = 0u; i < data_count(usedBefore); ++i)
+		threads += (m_frames[m_current][i].used != usedBefore[i]) ? 1u : 0u;
+
+	m_stats.chunks				+= chunkCount;
+	m_stats.maxThreads			= std::max(m_stats.maxThreads, threads);
+	m_stats.wallMilliseconds	+= wall.count();
+	m_stats.chunkMilliseconds	+= std::accumulate(chunkTimes.begin(), chunkTimes.end(), 0.0);
+}
+
+} // namespace vtf
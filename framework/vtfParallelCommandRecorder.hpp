@@ -0,0 +1,72 @@
+#ifndef __VTF_PARALLEL_COMMAND_RECORDER_HPP_INCLUDED__
+#define __VTF_PARALLEL_COMMAND_RECORDER_HPP_INCLUDED__
+
+#include "vtfZDeletable.hpp"
+#include "vtfZUtils.hpp"
+
+#include <functional>
+#include <vector>
+
+namespace vtf
+{
+
+class TaskScheduler;
+
+/**
+ * @brief Records a subpass as secondary command buffers concurrently on the TaskScheduler.
+ * @note  The subpass is split into chunks, each chunk is recorded into its own secondary
+ *        command buffer by whichever thread picks it up and all of them are executed from
+ *        the primary in chunk order, so the result does not depend on the thread count.
+ *        Every thread (workers plus the calling one) has its own command pool per frame,
+ *        beginFrame() moves to the next frame and resets all its pools at once, command
+ *        buffers are reused rather than freed. The frame count must cover all frames whose
+ *        commands may still be pending, e.g. CanvasStyle::framesInFlight.
+ *        record() must not be called from more threads at the same time.
+ */
+class ParallelCommandRecorder
+{
+public:
+	typedef std::function<void (ZCommandBuffer secondary, uint32_t chunk)> OnChunkRecording;
+
+	struct Stats
+	{
+		uint32_t	frames;
+		uint32_t	chunks;
+		uint32_t	maxThreads;			// most threads that took part in a single record()
+		double		wallMilliseconds;	// from the beginning to the end of record() calls
+		double		chunkMilliseconds;	// sum of the times spent recording particular chunks
+		double		speedup () const { return (wallMilliseconds > 0.0) ? (chunkMilliseconds / wallMilliseconds) : 0.0; }
+	};
+
+	ParallelCommandRecorder		(ZDevice device, ZQueue queue, uint32_t framesInFlight = 2u);
+	ParallelCommandRecorder		(ZDevice device, ZQueue queue, uint32_t framesInFlight, add_ref<TaskScheduler> scheduler);
+	ParallelCommandRecorder		(const ParallelCommandRecorder&) = delete;
+	ParallelCommandRecorder&	operator=(const ParallelCommandRecorder&) = delete;
+
+	void	beginFrame	();
+	// The render pass must have been begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS,
+	// secondaries continue its current subpass, maxThreads includes the calling thread, 0 means all
+	void	record		(add_cref<ZRenderPassBeginInfo> renderPassBegin, uint32_t chunkCount,
+						 OnChunkRecording onChunkRecording, uint32_t maxThreads = 0u);
+
+	add_cref<Stats>	stats	() const { return m_stats; }
+
+private:
+	struct ThreadPool
+	{
+		ZCommandPool				pool;
+		std::vector<ZCommandBuffer>	buffers;
+		uint32_t					used;
+	};
+	ZCommandBuffer	acquire		(uint32_t threadSlot);
+
+	const ZDevice							m_device;
+	add_ref<TaskScheduler>					m_scheduler;
+	std::vector<std::vector<ThreadPool>>	m_frames;
+	uint32_t								m_current;
+	Stats									m_stats;
+};
+
+} // namespace vtf
+
+#endif // __VTF_PARALLEL_COMMAND_RECORDER_HPP_INCLUDED__
@@ -20,6 +20,9 @@
 #include <iostream>
 #include <regex>
 #include <numeric>
+#include <exception>
+#include <mutex>
+#include <set>
 
 #include "vtfBacktrace.hpp"
 #include "vtfZUtils.hpp"
@@ -29,6 +32,8 @@
 #include "vtfStructUtils.hpp"
 #include "vtfOfflineCompiler.hpp"
 #include "vtfProgressRecorder.hpp"
+#include "vtfTaskScheduler.hpp"
+#include "vtfSpirvCache.hpp"
 
 #ifdef ENABLE_GL
 
@@ -322,6 +327,8 @@ static std::string makeFileName (uint32_t shaderIndex, VkShaderStageFlagBits sta
 	{
 		std::ostringstream ss;
 		ss << shaderIndex;
+		// Different stages may be built from the same file at the same time
+		ss << shaderStageToCommand(stage);
 		UNREF(entryName);
 		//ss << entryName;
 		ss << (codeAndEntryAndIncludes.at(ProgramCollection::StageToCode::fileName).empty()
@@ -426,7 +433,7 @@ static std::string makeCompilerListFromPATH (const char* compiler)
 	return compilerWithExt;
 }
 
-static std::vector<std::pair<std::string, std::string>> makeCompilerSignature (bool glslangValidator)
+static std::vector<std::pair<std::string, std::string>> queryCompilerSignature (bool glslangValidator)
 {
 	bool status = false;
 	// As far I know glslangValidator is an alias to glslang utility
@@ -457,7 +464,21 @@ static std::vector<std::pair<std::string, std::string>> makeCompilerSignature (b
 	return compilers;
 }
 
-static std::string getCompilerExecutable ()
+// Compilers available on the PATH don't change while the app is running,
+// so they are queried once instead of for every single shader.
+static std::vector<std::pair<std::string, std::string>> makeCompilerSignature (bool glslangValidator)
+{
+	static std::mutex mutex;
+	static std::map<bool, std::vector<std::pair<std::string, std::string>>> signatures;
+	std::lock_guard<std::mutex> lock(mutex);
+	if (auto signature = signatures.find(glslangValidator); signature != signatures.end())
+	{
+		return signature->second;
+	}
+	return signatures[glslangValidator] = queryCompilerSignature(glslangValidator);
+}
+
+static std::pair<std::string, std::string> getCompilerSignature ()
 {
 	const auto compilers = makeCompilerSignature(true);
 	ASSERTMSG(data_count(compilers) > 0u,
@@ -474,7 +495,12 @@ static std::string getCompilerExecutable ()
 			std::cout << "[APP WARNING] Compiler index exceeds compilers list, index 0 will be used\n";
 		}
 	}
-	return compilers.at(compilerIndex).first;
+	return compilers.at(compilerIndex);
+}
+
+static std::string getCompilerExecutable ()
+{
+	return getCompilerSignature().first;
 }
 
 std::vector<std::pair<std::string, std::string>>
@@ -613,6 +639,93 @@ static auto makeValidateCommand (add_cref<Version> vulkanVer, add_cref<Version>
 	return cmd.str();
 }
 
+// Feeds the digest with the source and with contents of all the files it includes,
+// includer's directory is searched first, followed by the include paths in order.
+static void digestSourceAndIncludes (add_ref<Digest> digest, add_cref<std::string> source,
+									 add_cref<fs::path> includerDir, add_cref<strings> codeAndEntryAndIncludes,
+									 add_ref<std::set<std::string>> visited)
+{
+	digest.update(source);
+
+	const std::regex rInclude(R"(^\s*#\s*include\s*[<"]([^>"]+)[>"])");
+	std::istringstream iss(source);
+	std::string line;
+	while (std::getline(iss, line))
+	{
+		std::smatch sm;
+		if (line.find("include") == std::string::npos || false == std::regex_search(line, sm, rInclude))
+		{
+			continue;
+		}
+		const std::string name = sm[1].str();
+		digest.update(name);
+
+		std::vector<fs::path> candidates;
+		if (false == includerDir.empty())
+		{
+			candidates.push_back(includerDir / name);
+		}
+		for (size_t j = ProgramCollection::StageToCode::includePaths; j < codeAndEntryAndIncludes.size(); ++j)
+		{
+			candidates.push_back(fs::path(codeAndEntryAndIncludes.at(j)) / name);
+		}
+		for (add_cref<fs::path> candidate : candidates)
+		{
+			std::error_code ec;
+			if (false == fs::is_regular_file(candidate, ec))
+			{
+				continue;
+			}
+			const std::string canonical = fs::weakly_canonical(candidate, ec).string();
+			if (visited.insert(canonical).second)
+			{
+				bool status = true;
+				const std::string content = readFile(candidate.string(), &status);
+				digestSourceAndIncludes(digest, content, candidate.parent_path(), codeAndEntryAndIncludes, visited);
+			}
+			break;
+		}
+	}
+}
+
+// Everything that influences the compilation result takes part in the key, so once
+// the source, any included file or the compiler changes the cache entry is no longer found.
+static SpirvCache::Key makeCacheKey (VkShaderStageFlagBits stage, add_cref<std::string> source,
+									 add_cref<strings> codeAndEntryAndIncludes,
+									 add_cref<Version> vulkanVer, add_cref<Version> spirvVer,
+									 bool isGlsl, bool enableValidation, add_cref<std::string> spirvValArgs,
+									 bool genDisassmebly)
+{
+	add_cref<GlobalAppFlags> gf(getGlobalAppFlags());
+	add_cref<std::string> codeFileName = codeAndEntryAndIncludes[ProgramCollection::StageToCode::fileName];
+
+	Digest digest;
+	digest.update(stage);
+	digest.update(codeAndEntryAndIncludes[ProgramCollection::StageToCode::entryName]);
+	digest.update(codeAndEntryAndIncludes[ProgramCollection::StageToCode::header]);
+	digest.update(vulkanVer.nmajor).update(vulkanVer.nminor);
+	digest.update(spirvVer.nmajor).update(spirvVer.nminor);
+	digest.update(isGlsl).update(enableValidation).update(genDisassmebly).update(gf.nowerror);
+	digest.update(enableValidation ? spirvValArgs : std::string());
+	// Texts of older entries were not tagged with the field they came from
+	digest.update(std::string("text-tag"));
+	if (make_signed(gf.compilerIndex) < 0)
+	{
+		digest.update(getOfflineCompilerSignature());
+	}
+	else
+	{
+		const auto compiler = getCompilerSignature();
+		digest.update(compiler.first).update(compiler.second);
+	}
+
+	std::set<std::string> visited;
+	const fs::path includerDir = codeFileName.empty() ? fs::path() : fs::path(codeFileName).parent_path();
+	digestSourceAndIncludes(digest, source, includerDir, codeAndEntryAndIncludes, visited);
+
+	return digest.finish();
+}
+
 bool verifyShaderCode (uint32_t shaderIndex, VkShaderStageFlagBits stage,
 					   add_cref<Version> vulkanVer, add_cref<Version> spirvVer,
 					   add_cref<strings> codeAndEntryAndIncludes,
@@ -682,7 +795,38 @@ bool verifyShaderCode (uint32_t shaderIndex, VkShaderStageFlagBits stage,
 		std::transform(shaderOriginalCode.begin(), shaderOriginalCode.end(),
 			assembly.begin(), [](const char c) { return uint8_t(c); });
 	};
-	if (!buildAlways && (!genBinary || fs::exists(binPath)))
+
+	add_ref<SpirvCache> cache = SpirvCache::instance();
+	const bool useCache = genBinary && cache.enabled();
+	SpirvCache::Key cacheKey{};
+	if (useCache)
+	{
+		bool readStatus = true;
+		cacheKey = makeCacheKey(stage, shaderOriginalCode.empty() ? readFile(codeFileName, &readStatus) : shaderOriginalCode,
+								codeAndEntryAndIncludes, vulkanVer, spirvVer, isGlsl, enableValidation, spirvValArgs,
+								genDisassmebly);
+	}
+
+	// The cached text starts with a tag of the field it has been built into, the built-in compiler fills
+	// the disassembly, the external one the assembly, so a warm build gives the same as a cold one
+	constexpr char assemblyTag = 'A';
+	constexpr char disassemblyTag = 'D';
+	std::vector<char> cachedText;
+	if (!buildAlways && useCache && cache.lookup(cacheKey, binary, cachedText))
+	{
+		if (false == cachedText.empty())
+		{
+			add_ref<std::vector<char>> field = (cachedText.front() == assemblyTag) ? assembly : disassembly;
+			field.assign(std::next(cachedText.begin()), cachedText.end());
+		}
+		if (gf.verbose)
+		{
+			std::cout << "[APP] Shader " << std::quoted(shaderFileName) << " taken from the cache, key: "
+					  << Digest::toString(cacheKey) << std::endl;
+		}
+		status = true;
+	}
+	else if (!buildAlways && !genBinary)
 	{
 		if (readFile(asmPath, assembly) == INVALID_UINT32)
 		{
@@ -729,9 +873,10 @@ bool verifyShaderCode (uint32_t shaderIndex, VkShaderStageFlagBits stage,
 			}
 			add_cref<std::string> offShaderCode(shaderOriginalCode.empty() ? tmpShaderCode : shaderOriginalCode);
 			add_cref<std::string> entryPoint = codeAndEntryAndIncludes[ProgramCollection::StageToCode::entryName];
-			binary = compileShader(offShaderCode, stage, entryPoint, isGlsl, enableValidation, spirvValArgs,
-									genDisassmebly,	vulkanVer, spirvVer, binPath, asmPath, disassembly, errorCollection,
-									progressRecorder, status);
+			// Every builder thread has its own session, so glslang is not re-initialized for each shader
+			binary = OfflineCompilerSession::forThisThread().compile(offShaderCode, stage, entryPoint, isGlsl,
+									enableValidation, spirvValArgs, genDisassmebly,	vulkanVer, spirvVer, binPath, asmPath,
+									disassembly, errorCollection, progressRecorder, status);
 		}
 		else
 		{
@@ -831,12 +976,104 @@ bool verifyShaderCode (uint32_t shaderIndex, VkShaderStageFlagBits stage,
 		}
 	}
 
+	if (status && useCache)
+	{
+		// At most one of them has been filled, see the lookup above
+		std::vector<char> text;
+		if (false == assembly.empty() || false == disassembly.empty())
+		{
+			const bool fromAssembly = (false == assembly.empty());
+			add_cref<std::vector<char>> field = fromAssembly ? assembly : disassembly;
+			text.reserve(field.size() + 1u);
+			text.push_back(fromAssembly ? assemblyTag : disassemblyTag);
+			text.insert(text.end(), field.begin(), field.end());
+		}
+		cache.store(cacheKey, binary, text);
+	}
+
 	errorCollection.flush();
 	errors = errorCollection.str();
 
 	return status;
 }
 
+// Holds the input and the output of a single shader build, the results
+// are moved to the collection maps on the calling thread after all builds finish.
+struct ShaderBuildTask
+{
+	_GlSpvProgramCollection::StageAndIndex	key;
+	add_cptr<strings>						codeAndEntryAndIncludes;
+	bool									status;
+	std::string								shaderFileName;
+	std::string								errors;
+	std::vector<char>						binary;
+	std::vector<char>						assembly;
+	std::vector<char>						disassembly;
+	std::exception_ptr						exception;
+};
+
+struct ShaderBuilder
+{
+	ShaderBuilder (add_ref<std::vector<ShaderBuildTask>> tasks,
+				   add_cref<Version> vulkanVer, add_cref<Version> spirvVer,
+				   bool enableValidation, bool genDisassembly, bool buildAlways,
+				   add_cref<std::string> spirvValArgs, add_ref<ProgressRecorder> progressRecorder)
+		: m_tasks				(tasks)
+		, m_vulkanVer			(vulkanVer)
+		, m_spirvVer			(spirvVer)
+		, m_enableValidation	(enableValidation)
+		, m_genDisassembly		(genDisassembly)
+		, m_buildAlways			(buildAlways)
+		, m_spirvValArgs		(spirvValArgs)
+		, m_progressRecorder	(progressRecorder) {}
+
+	// Called by the scheduler for chunks of tasks, chunks are handed out one by one
+	// so long-lasting shaders don't stall the ones waiting behind them.
+	void build (uint32_t first, uint32_t last)
+	{
+		for (uint32_t t = first; t < last; ++t)
+		{
+			run(m_tasks.at(t));
+		}
+	}
+
+private:
+	void run (add_ref<ShaderBuildTask> task)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		try
+		{
+			task.status = verifyShaderCode(task.key.second, task.key.first, m_vulkanVer, m_spirvVer,
+				*task.codeAndEntryAndIncludes, task.shaderFileName, task.binary, task.assembly, task.disassembly,
+				task.errors, m_progressRecorder, m_enableValidation, m_spirvValArgs, m_genDisassembly,
+				m_buildAlways, true);
+		}
+		catch (...)
+		{
+			// Exceptions must not escape the worker thread, they are rethrown by the caller
+			task.status = false;
+			task.exception = std::current_exception();
+		}
+		const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::high_resolution_clock::now() - start).count();
+
+		std::ostringstream ss;
+		ss << "Build shader " << shaderStageToString(task.key.first) << '[' << task.key.second << "] "
+		   << std::quoted(task.shaderFileName) << " in " << duration << " ms"
+		   << (task.status ? "" : " (failed)");
+		m_progressRecorder.stamp(ss.str());
+	}
+
+	add_ref<std::vector<ShaderBuildTask>>	m_tasks;
+	add_cref<Version>						m_vulkanVer;
+	add_cref<Version>						m_spirvVer;
+	const bool								m_enableValidation;
+	const bool								m_genDisassembly;
+	const bool								m_buildAlways;
+	add_cref<std::string>					m_spirvValArgs;
+	add_ref<ProgressRecorder>				m_progressRecorder;
+};
+
 uint32_t _GlSpvProgramCollection::m_collectionID; // static
 uint32_t _GlSpvProgramCollection::collectionID () const { return m_collectionID; }
 
@@ -925,6 +1162,23 @@ add_cref<std::string> _GlSpvProgramCollection::getShaderFile (VkShaderStageFlagB
 	return m_stageToFileName.at({ stage, index });
 }
 
+auto _GlSpvProgramCollection::reflect (VkShaderStageFlagBits stage, uint32_t index) const -> SpirvInterface
+{
+	auto binary = m_stageToBinary.find({ stage, index });
+	ASSERTMSG(binary != m_stageToBinary.end(), "Unable to find ", shaderStageToString(stage), " shader at index ", index);
+	return spirvReflect(binary->second, stage);
+}
+
+auto _GlSpvProgramCollection::reflect () const -> SpirvInterface
+{
+	SpirvInterface result;
+	for (add_cref<std::pair<const StageAndIndex, std::vector<char>>> binary : m_stageToBinary)
+	{
+		spirvMergeInterfaces(result, spirvReflect(binary.second, binary.first.first));
+	}
+	return result;
+}
+
 add_ptr<_GlSpvProgramCollection::ShaderLink> _GlSpvProgramCollection::ShaderLink::head ()
 {
 	add_ptr<ShaderLink> link = this;
@@ -987,8 +1241,6 @@ void _GlSpvProgramCollection::_buildAndVerify (add_cref<Version> vulkanVer, add_
 												bool enableValidation, bool genDisassembly, bool buildAlways,
 												add_cref<std::string> spirvValArgs, uint32_t threads)
 {
-	UNREF(threads); // Unimplemented yet
-
 	add_ref<ProgressRecorder> progressRecorder =
 		m_device.getParamRef<ZPhysicalDevice>().getParamRef<ZInstance>().getParamRef<ProgressRecorder>();
 
@@ -1033,7 +1285,27 @@ void _GlSpvProgramCollection::_buildAndVerify (add_cref<Version> vulkanVer, add_
 		}
 	}
 
-	const bool genBinary = true;
+	// Only unique shaders are built, duplicates are copied from them afterwards
+	std::vector<ShaderBuildTask> tasks;
+	std::vector<uint32_t> stageToTask(stageToCount2, INVALID_UINT32);
+	for (uint32_t j = 0u; j < stageToCount2; ++j)
+	{
+		if (std::get<2>(stageToCounts[j]) == j)
+		{
+			const auto key = std::make_pair(std::get<0>(stageToCounts[j]), std::get<1>(stageToCounts[j]));
+			stageToTask[j] = data_count(tasks);
+			tasks.push_back(ShaderBuildTask{ key, &m_stageToCode[key], false, {}, {}, {}, {}, {}, {} });
+		}
+	}
+
+	{
+		ShaderBuilder builder(tasks, vulkanVer, spirvVer, enableValidation, genDisassembly,
+							  buildAlways, spirvValArgs, progressRecorder);
+		// The calling thread takes part in the build as well
+		TaskScheduler::instance().parallelFor(0u, data_count(tasks), 1u,
+			[&](uint32_t first, uint32_t last) { builder.build(first, last); }, threads);
+	}
+
 	for (uint32_t stcc = 0u; stcc < stageToCount2; ++stcc)
 	{
 		const uint32_t j =  stcc;
@@ -1041,26 +1313,19 @@ void _GlSpvProgramCollection::_buildAndVerify (add_cref<Version> vulkanVer, add_
 		const auto k = std::get<1>(stageToCounts[j]);
 		const auto key = std::make_pair(stage, k);
 
-		/*
-		add_cref<strings> params = m_stageToCode[key];
-		add_cref<std::string> sShaderOriginalCode = params[shaderOriginalCode];
-		add_cref<std::string> sHeader = params[header];
-		add_cref<std::string> sEntryName = params[entryName];
-		add_cref<std::string> sFileName = params[fileName];
-		*/
 		if (const uint32_t k2 = std::get<2>(stageToCounts[j]); k2 == j)
 		{
-			std::string shaderFileName, errors;
-			std::vector<char> binary, assembly, disassembly;
-			const bool status = verifyShaderCode(k, stage, vulkanVer, spirvVer,
-				m_stageToCode[key], shaderFileName, binary, assembly, disassembly,
-				errors, progressRecorder, enableValidation, spirvValArgs, genDisassembly, buildAlways, genBinary);
-			if (status)
+			add_ref<ShaderBuildTask> task = tasks.at(stageToTask[j]);
+			if (task.exception)
 			{
-				m_stageToDisassembly[key] = std::move(disassembly);
-				m_stageToFileName[key] = std::move(shaderFileName);
-				m_stageToAssembly[key] = std::move(assembly);
-				m_stageToBinary[key] = std::move(binary);
+				std::rethrow_exception(task.exception);
+			}
+			if (task.status)
+			{
+				m_stageToDisassembly[key] = std::move(task.disassembly);
+				m_stageToFileName[key] = std::move(task.shaderFileName);
+				m_stageToAssembly[key] = std::move(task.assembly);
+				m_stageToBinary[key] = std::move(task.binary);
 			}
 			else
 			{
@@ -1076,7 +1341,7 @@ void _GlSpvProgramCollection::_buildAndVerify (add_cref<Version> vulkanVer, add_
 						codeWidthLines << num << ": " << std::move(line) << std::endl;
 					}
 				}
-				ASSERTFALSE(errors, codeWidthLines.str());
+				ASSERTFALSE(task.errors, codeWidthLines.str());
 			}
 		}
 		else
@@ -1093,6 +1358,8 @@ void _GlSpvProgramCollection::_buildAndVerify (add_cref<Version> vulkanVer, add_
 			m_stageToBinary[key] = m_stageToBinary[key2];
 		}
 	}
+
+	SpirvCache::instance().flush();
 }
 
 void ProgramCollection::buildAndVerify (bool buildAlways, uint32_t threads)
@@ -7,6 +7,7 @@
 #include "vtfZDeletable.hpp"
 #include "vtfVkUtils.hpp"
 #include "vtfCUtils.hpp"
+#include "vtfSpirvReflection.hpp"
 
 namespace vtf
 {
@@ -45,6 +46,10 @@ struct _GlSpvProgramCollection
     auto getShaderCode (VkShaderStageFlagBits stage, uint32_t index, bool binORasm = true) const -> add_cref<std::vector<char>>;
 	auto getShaderFile (VkShaderStageFlagBits stage, uint32_t index, bool inOrout = false) const -> add_cref<std::string>;
 	auto getShaderEntry (VkShaderStageFlagBits stage, uint32_t index) const -> add_cref<std::string>;
+	// Descriptor bindings, push constants and specialization constants declared by the built binary
+	auto reflect (VkShaderStageFlagBits stage, uint32_t index = 0) const -> SpirvInterface;
+	// Merged interface of all built shaders, meant for collections that hold the stages of one pipeline
+	auto reflect () const -> SpirvInterface;
 
 protected:
 	class RTShaderGroup
@@ -98,6 +103,8 @@ struct ProgramCollection : _GlSpvProgramCollection
 	bool addFromFile (VkShaderStageFlagBits type,
 					  add_cref<std::string> fileName, add_cref<strings> includePaths = {},
 					  add_cref<std::string> entryName = "main", bool verbose = true);
+	// Unique shaders are built concurrently on the given number of threads,
+	// 0 means as many as the hardware supports, 1 (default) builds them one by one.
 	void buildAndVerify (add_cref<Version> vulkanVer = Version(1,0), add_cref<Version> spirvVer = Version(1,0),
 						 bool enableValidation = false, bool genDisassembly = false, bool buildAlways = false,
 						 add_cref<std::string> spirvValArgs = {}, uint32_t threads = 1u);
@@ -9,17 +9,39 @@ ProgressRecorder::ProgressRecorder ()
 {
 }
 
+ProgressRecorder::ProgressRecorder (const ProgressRecorder& other)
+	: m_start	(other.m_start)
+	, m_entries	()
+	, m_mutex	()
+{
+	std::lock_guard<std::mutex> lock(other.m_mutex);
+	m_entries = other.m_entries;
+}
+
 void ProgressRecorder::stamp (const std::string& text, bool label)
 {
-	m_entries.emplace_back(Entry{ std::chrono::high_resolution_clock::now(), text, label });
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.emplace_back(Entry{ std::chrono::high_resolution_clock::now(), text, label, -1.0 });
+}
+
+void ProgressRecorder::stampGpu (const std::string& text, double milliseconds)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.emplace_back(Entry{ std::chrono::high_resolution_clock::now(), text, false, milliseconds });
 }
 
 void ProgressRecorder::print(std::ostream& stream, bool newLineAtEnd) const
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	auto start = m_start;
 	stream << "Start application:";
 	for (add_cref<Entry> e : m_entries)
 	{
+		if (e.gpuMilliseconds >= 0.0)
+		{
+			stream << std::endl << e.text << " - gpu: " << e.gpuMilliseconds << " ms";
+			continue;
+		}
 		const auto between = std::chrono::duration_cast<std::chrono::milliseconds>(e.when - start).count();
 		const auto fromstart = std::chrono::duration_cast<std::chrono::milliseconds>(e.when - m_start).count();
 		stream << std::endl << e.text << " - duration: " << between << " ms, total: " << fromstart << " ms";
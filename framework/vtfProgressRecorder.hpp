@@ -3,6 +3,7 @@
 
 #include <chrono>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -18,15 +19,21 @@ struct ProgressRecorder
 		time_point when;
 		std::string text;
 		bool label;
+		double gpuMilliseconds;	// negative if the entry is not a GPU measurement
 	};
 
 	ProgressRecorder ();
+	ProgressRecorder (const ProgressRecorder& other);
+	// Thread-safe, might be called from worker threads e.g. while shaders are being built in parallel.
 	void stamp (const std::string& text, bool label = false);
+	// GPU time measured elsewhere e.g. by GpuProfiler, does not split the durations between CPU entries.
+	void stampGpu (const std::string& text, double milliseconds);
 	void print (std::ostream& stream, bool newLineAtEnd = true) const;
 
 private:
 	const time_point	m_start;
 	std::vector<Entry>	m_entries;
+	mutable std::mutex	m_mutex;
 };
 
 } // namespace vtf
@@ -3,6 +3,12 @@
 #include "vtfZUtils.hpp"
 #include "vtfProgressRecorder.hpp"
 #include "vtfBacktrace.hpp"
+#include "vtfDSBMgr.hpp"
+#include "vtfDigest.hpp"
+#include "vtfSpirvCache.hpp"
+
+#include <cstring>
+#include <iostream>
 
 namespace vtf
 {
@@ -293,6 +299,108 @@ struct ShaderObjectCollection::ZShaderCreateInfoEXT : VkShaderCreateInfoEXT
 	}
 };
 
+namespace
+{
+
+// Content-addressed like SPIR-V binaries, in a directory of its own and under the same size limit.
+// Runs sharing the directory merge their indices in SpirvCache::flush().
+add_ref<SpirvCache> getShaderBinaryCache ()
+{
+	add_cref<GlobalAppFlags> gf = getGlobalAppFlags();
+	static SpirvCache cache((std::strlen(gf.tmpDir) ? fs::path(gf.tmpDir) : fs::temp_directory_path()) / "vtf-shader-binary-cache",
+							(gf.pipelineCache ? (uint64_t(gf.spirvCacheSize) * 1024u * 1024u) : 0u), (gf.verbose != 0u));
+	return cache;
+}
+
+// Binaries are only valid for the same shaderBinaryUUID and shaderBinaryVersion and for the very same
+// create infos, linked stages are created together so the whole group is stored under one key.
+SpirvCache::Key makeShaderBinaryKey (ZDevice device, add_cref<std::vector<VkShaderCreateInfoEXT>> createInfos,
+									 add_cref<std::vector<std::vector<ZDescriptorSetLayout>>> setLayouts)
+{
+	VkPhysicalDeviceShaderObjectPropertiesEXT props = makeVkStruct();
+	deviceGetPhysicalProperties2(device.getParam<ZPhysicalDevice>(), &props);
+
+	Digest digest;
+	digest.update(props.shaderBinaryUUID, VK_UUID_SIZE).update(props.shaderBinaryVersion).update(data_count(createInfos));
+	for (std::size_t index = 0u; index < createInfos.size(); ++index)
+	{
+		add_cref<VkShaderCreateInfoEXT> info = createInfos[index];
+		digest.update(info.flags).update(info.stage).update(info.nextStage).update(std::string(info.pName))
+			  .update(info.codeSize).update(info.pCode, info.codeSize);
+		// Handles differ from run to run, the bindings they have been created from do not
+		digest.update(data_count(setLayouts.at(index)));
+		for (ZDescriptorSetLayout layout : setLayouts.at(index))
+		{
+			const Digest::value_type layoutDigest = descriptorSetLayoutGetDigest(layout);
+			digest.update(layoutDigest.data(), layoutDigest.size());
+		}
+		digest.update(info.pushConstantRangeCount)
+			  .update(info.pPushConstantRanges, (info.pushConstantRangeCount * sizeof(VkPushConstantRange)));
+		if (add_cptr<VkSpecializationInfo> spec = info.pSpecializationInfo; spec)
+		{
+			digest.update(spec->mapEntryCount).update(spec->pMapEntries, (spec->mapEntryCount * sizeof(VkSpecializationMapEntry)));
+			digest.update(spec->dataSize).update(spec->pData, spec->dataSize);
+		}
+		else digest.update(0u);
+	}
+	return digest.finish();
+}
+
+// Stored as the size of each binary followed by its data, padded to whole words the cache expects
+std::vector<char> packShaderBinaries (add_cref<std::vector<std::vector<char>>> binaries)
+{
+	std::vector<char> blob;
+	for (add_cref<std::vector<char>> binary : binaries)
+	{
+		const uint64_t size = binary.size();
+		blob.insert(blob.end(), reinterpret_cast<add_cptr<char>>(&size), reinterpret_cast<add_cptr<char>>(&size + 1));
+		blob.insert(blob.end(), binary.begin(), binary.end());
+	}
+	blob.resize(((blob.size() + 3u) / 4u) * 4u, 0);
+	return blob;
+}
+
+bool unpackShaderBinaries (add_cref<std::vector<char>> blob, std::size_t count, add_ref<std::vector<std::vector<char>>> binaries)
+{
+	binaries.resize(count);
+	std::size_t offset = 0u;
+	for (add_ref<std::vector<char>> binary : binaries)
+	{
+		uint64_t size = 0u;
+		if (blob.size() < offset + sizeof(size)) return false;
+		std::memcpy(&size, blob.data() + offset, sizeof(size));
+		offset += sizeof(size);
+		if (0u == size || (blob.size() - offset) < size) return false;
+		binary.assign(blob.begin() + std::ptrdiff_t(offset), blob.begin() + std::ptrdiff_t(offset + size));
+		offset += std::size_t(size);
+	}
+	return true;
+}
+
+bool getShaderBinaries (ZDevice device, add_cref<std::vector<VkShaderEXT>> handles,
+						add_ref<std::vector<std::vector<char>>> binaries)
+{
+	add_cref<ZDeviceInterface> di = device.getInterface();
+	binaries.resize(handles.size());
+	for (std::size_t i = 0u; i < handles.size(); ++i)
+	{
+		std::size_t size = 0u;
+		if (VK_SUCCESS != di.vkGetShaderBinaryDataEXT(*device, handles[i], &size, nullptr) || 0u == size)
+		{
+			return false;
+		}
+		binaries[i].resize(size);
+		if (VK_SUCCESS != di.vkGetShaderBinaryDataEXT(*device, handles[i], &size, binaries[i].data()))
+		{
+			return false;
+		}
+		binaries[i].resize(size);
+	}
+	return true;
+}
+
+} // unnamed namespace
+
 int ShaderObjectCollection::create (add_cref<Version> vulkanVer, add_cref<Version> spirvVer,
 									add_ref<std::vector<IntShaderLink>> links, const bool package)
 {
@@ -350,13 +458,68 @@ int ShaderObjectCollection::create (add_cref<Version> vulkanVer, add_cref<Versio
 	std::transform(zInfos.begin(), zInfos.end(), createInfos.begin(),
 		[](add_cref<ZShaderCreateInfoEXT> ric) { return ric(); });
 
-	VKASSERTMSG(di.vkCreateShadersEXT(
-						*m_device,
-						data_count(createInfos),
-						data_or_null(createInfos),
-						m_device.getParam<VkAllocationCallbacksPtr>(),
-						handles.data()),
-			"Failed to create shader object(s)");
+	std::vector<std::vector<ZDescriptorSetLayout>> setLayouts;
+	for (add_ref<IntShaderLink> link : links)
+	{
+		setLayouts.push_back(link.data->shader.getParam<std::vector<ZDescriptorSetLayout>>());
+	}
+
+	add_ref<SpirvCache>				binaryCache	= getShaderBinaryCache();
+	const VkAllocationCallbacksPtr	callbacks	= m_device.getParam<VkAllocationCallbacksPtr>();
+	const SpirvCache::Key			binaryKey	= binaryCache.enabled()
+													? makeShaderBinaryKey(m_device, createInfos, setLayouts)
+													: SpirvCache::Key();
+	std::vector<std::vector<char>>	binaries;
+	std::vector<char>				blob, unused;
+	bool							created		= false;
+
+	if (binaryCache.lookup(binaryKey, blob, unused) && unpackShaderBinaries(blob, createInfos.size(), binaries))
+	{
+		std::vector<VkShaderCreateInfoEXT> binaryInfos(createInfos);
+		for (std::size_t i = 0u; i < binaryInfos.size(); ++i)
+		{
+			binaryInfos[i].codeType	= VK_SHADER_CODE_TYPE_BINARY_EXT;
+			binaryInfos[i].codeSize	= binaries[i].size();
+			binaryInfos[i].pCode	= binaries[i].data();
+		}
+		created = (VK_SUCCESS == di.vkCreateShadersEXT(*m_device, data_count(binaryInfos), binaryInfos.data(),
+													   callbacks, handles.data()));
+		if (false == created)
+		{
+			// Rejected binaries leave null handles, the others are destroyed and all is created from SPIR-V
+			for (add_ref<VkShaderEXT> handle : handles)
+			{
+				if (VK_NULL_HANDLE != handle)
+				{
+					di.vkDestroyShaderEXT(*m_device, handle, callbacks);
+					handle = VK_NULL_HANDLE;
+				}
+			}
+			if (getGlobalAppFlags().verbose)
+			{
+				std::cout << "[INFO] Cached shader binary " << Digest::toString(binaryKey)
+						  << " rejected by the driver, created from SPIR-V" << std::endl;
+			}
+		}
+	}
+
+	if (false == created)
+	{
+		VKASSERTMSG(di.vkCreateShadersEXT(
+							*m_device,
+							data_count(createInfos),
+							data_or_null(createInfos),
+							callbacks,
+							handles.data()),
+				"Failed to create shader object(s)");
+
+		if (binaryCache.enabled() && getShaderBinaries(m_device, handles, binaries))
+		{
+			binaryCache.store(binaryKey, packShaderBinaries(binaries), {});
+		}
+	}
+	// Like ProgramCollection after a build, so other runs see the entries before this one exits
+	binaryCache.flush();
 
 	auto updateHandle = [&](uint32_t index, add_ptr<VkShaderEXT> handle)
 	{
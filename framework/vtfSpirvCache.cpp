@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "vtfSpirvCache.hpp"
+#include "vtfBacktrace.hpp"
+#include "vtfCUtils.hpp"
+
+namespace vtf
+{
+
+static const char indexFileName[] = "index";
+static const char indexSignature[] = "vtf-spirv-cache-1";
+static const char lockFileName[] = "index.lock";
+// A lock older than that has been left by a run that crashed while it was saving the index
+static constexpr std::chrono::seconds	staleLockAge	(10);
+static constexpr std::chrono::seconds	lockTimeout		(5);
+
+add_ref<SpirvCache> SpirvCache::instance ()
+{
+	add_cref<GlobalAppFlags> gf = getGlobalAppFlags();
+	static SpirvCache cache((std::strlen(gf.tmpDir) ? fs::path(gf.tmpDir) : fs::temp_directory_path()) / "vtf-spirv-cache",
+							uint64_t(gf.spirvCacheSize) * 1024u * 1024u, (gf.verbose != 0u));
+	return cache;
+}
+
+SpirvCache::SpirvCache (add_cref<fs::path> directory, uint64_t maxSize, bool verbose)
+	: m_directory	(directory)
+	, m_maxSize		(maxSize)
+	, m_verbose		(verbose)
+	, m_mutex		()
+	, m_entries		()
+	, m_totalSize	(0u)
+	, m_tick		(0u)
+	, m_dirty		(false)
+	, m_hits		(0u)
+	, m_misses		(0u)
+	, m_evictions	(0u)
+{
+	if (enabled())
+	{
+		std::error_code ec;
+		fs::create_directories(m_directory, ec);
+		load();
+	}
+}
+
+SpirvCache::~SpirvCache ()
+{
+	flush();
+}
+
+bool SpirvCache::enabled () const
+{
+	return m_maxSize != 0u;
+}
+
+fs::path SpirvCache::binPath (add_cref<std::string> name) const
+{
+	return m_directory / (name + ".spvbin");
+}
+
+fs::path SpirvCache::textPath (add_cref<std::string> name) const
+{
+	return m_directory / (name + ".spvasm");
+}
+
+bool SpirvCache::readIndex (add_ref<Entries> entries) const
+{
+	std::ifstream index(m_directory / indexFileName);
+	std::string signature;
+	if (!(index >> signature) || signature != indexSignature)
+	{
+		return false;
+	}
+	std::string name;
+	Entry entry{};
+	while (index >> name >> entry.size >> entry.tick >> entry.hasText)
+	{
+		entries[name] = entry;
+	}
+	return true;
+}
+
+void SpirvCache::load ()
+{
+	readIndex(m_entries);
+	for (add_cref<std::pair<const std::string, Entry>> entry : m_entries)
+	{
+		m_totalSize += entry.second.size;
+		m_tick = std::max(m_tick, entry.second.tick);
+	}
+}
+
+void SpirvCache::merge ()
+{
+	Entries merged;
+	readIndex(merged);
+
+	for (add_cref<std::pair<const std::string, Entry>> entry : m_entries)
+	{
+		auto saved = merged.find(entry.first);
+		if (saved != merged.end())
+		{
+			if (entry.second.tick > saved->second.tick) saved->second = entry.second;
+		}
+		// Not on disk either because it is new or because another run has evicted it
+		else if (fs::exists(binPath(entry.first)))
+		{
+			merged.insert(entry);
+		}
+	}
+
+	// Files of entries whose index has been overwritten are adopted, so eviction still counts them
+	std::error_code ec;
+	for (fs::directory_iterator file(m_directory, ec), end; !ec && file != end; file.increment(ec))
+	{
+		const fs::path path = file->path();
+		const std::string name = path.stem().string();
+		if (merged.count(name)) continue;
+		if (path.extension() == ".spvbin")
+		{
+			std::error_code sizeEc;
+			const uint64_t binSize = fs::file_size(path, sizeEc);
+			if (sizeEc) continue;
+			const uint64_t textSize = fs::file_size(textPath(name), sizeEc);
+			merged[name] = Entry{ binSize + (sizeEc ? 0u : textSize), 0u, (!sizeEc) };
+		}
+		// Entries are stored binary first, so a text alone is the rest of an evicted entry
+		else if (path.extension() == ".spvasm" && false == fs::exists(binPath(name)))
+		{
+			std::error_code removeEc;
+			fs::remove(path, removeEc);
+		}
+	}
+
+	m_entries.swap(merged);
+	m_totalSize = 0u;
+	for (add_cref<std::pair<const std::string, Entry>> entry : m_entries)
+	{
+		m_totalSize += entry.second.size;
+		m_tick = std::max(m_tick, entry.second.tick);
+	}
+}
+
+bool SpirvCache::lockIndex () const
+{
+	// Creating a directory is atomic on every platform, it fails if another run holds the lock
+	const fs::path path(m_directory / lockFileName);
+	const auto deadline = std::chrono::steady_clock::now() + lockTimeout;
+	while (true)
+	{
+		std::error_code ec;
+		if (fs::create_directory(path, ec)) return true;
+
+		const fs::file_time_type created = fs::last_write_time(path, ec);
+		if (!ec && (fs::file_time_type::clock::now() - created) > staleLockAge)
+		{
+			fs::remove(path, ec);
+			continue;
+		}
+		if (std::chrono::steady_clock::now() > deadline) return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+}
+
+void SpirvCache::unlockIndex () const
+{
+	std::error_code ec;
+	fs::remove(m_directory / lockFileName, ec);
+}
+
+bool SpirvCache::lookup (add_cref<Key> key, add_ref<std::vector<char>> binary, add_ref<std::vector<char>> text)
+{
+	if (false == enabled()) return false;
+
+	const std::string name = Digest::toString(key);
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto entry = m_entries.find(name);
+	if (entry == m_entries.end())
+	{
+		m_misses += 1u;
+		return false;
+	}
+
+	std::vector<char> tmpBinary, tmpText;
+	const uint32_t readBin = readFile(binPath(name), tmpBinary);
+	const bool textValid = (false == entry->second.hasText) || readFile(textPath(name), tmpText) != INVALID_UINT32;
+	if (readBin == INVALID_UINT32 || readBin == 0u || (readBin % 4u) != 0u || false == textValid)
+	{
+		// The file has been removed or damaged outside, forget about it
+		m_totalSize -= entry->second.size;
+		m_entries.erase(entry);
+		m_misses += 1u;
+		m_dirty = true;
+		return false;
+	}
+
+	entry->second.tick = ++m_tick;
+	m_hits += 1u;
+	m_dirty = true;
+	binary = std::move(tmpBinary);
+	text = std::move(tmpText);
+	return true;
+}
+
+void SpirvCache::store (add_cref<Key> key, add_cref<std::vector<char>> binary, add_cref<std::vector<char>> text)
+{
+	if (false == enabled() || binary.empty()) return;
+
+	const std::string name = Digest::toString(key);
+	std::ostringstream suffix;
+	suffix << '.' << std::this_thread::get_id() << '.'
+		   << std::chrono::high_resolution_clock::now().time_since_epoch().count() << ".tmp";
+
+	// Files are renamed after they have been completely written, so the other
+	// processes sharing the same directory never see half of an entry.
+	auto writeFile = [&](add_cref<fs::path> path, add_cref<std::vector<char>> data) -> bool
+	{
+		const fs::path tmpPath(path.string() + suffix.str());
+		{
+			std::ofstream file(tmpPath, std::ios::binary);
+			if (false == file.is_open()) return false;
+			file.write(data.data(), std::streamsize(data.size()));
+			if (false == file.good()) return false;
+		}
+		std::error_code ec;
+		fs::rename(tmpPath, path, ec);
+		if (ec) fs::remove(tmpPath, ec);
+		return !ec;
+	};
+
+	if (false == writeFile(binPath(name), binary)
+		|| (false == text.empty() && false == writeFile(textPath(name), text)))
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (auto old = m_entries.find(name); old != m_entries.end())
+	{
+		m_totalSize -= old->second.size;
+	}
+	const Entry entry{ uint64_t(binary.size() + text.size()), ++m_tick, (false == text.empty()) };
+	m_entries[name] = entry;
+	m_totalSize += entry.size;
+	m_dirty = true;
+
+	evict();
+}
+
+void SpirvCache::evict ()
+{
+	if (m_totalSize <= m_maxSize) return;
+
+	std::vector<std::pair<uint64_t, std::string>> byAge;
+	byAge.reserve(m_entries.size());
+	for (add_cref<std::pair<const std::string, Entry>> entry : m_entries)
+	{
+		byAge.emplace_back(entry.second.tick, entry.first);
+	}
+	std::sort(byAge.begin(), byAge.end());
+
+	std::error_code ec;
+	for (add_cref<std::pair<uint64_t, std::string>> item : byAge)
+	{
+		if (m_totalSize <= m_maxSize) break;
+		add_cref<Entry> entry = m_entries.at(item.second);
+		fs::remove(binPath(item.second), ec);
+		if (entry.hasText) fs::remove(textPath(item.second), ec);
+		m_totalSize -= entry.size;
+		m_entries.erase(item.second);
+		m_evictions += 1u;
+	}
+}
+
+void SpirvCache::flush ()
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+	if (false == enabled() || false == m_dirty) return;
+
+	// Without the lock the index stays dirty and the next flush tries again
+	if (false == lockIndex()) return;
+	merge();
+	evict();
+
+	std::ostringstream suffix;
+	suffix << '.' << std::this_thread::get_id() << '.'
+		   << std::chrono::high_resolution_clock::now().time_since_epoch().count() << ".tmp";
+	const fs::path indexPath(m_directory / indexFileName);
+	const fs::path tmpPath(indexPath.string() + suffix.str());
+	{
+		std::ofstream index(tmpPath);
+		if (false == index.is_open())
+		{
+			unlockIndex();
+			return;
+		}
+		index << indexSignature << '\n';
+		for (add_cref<std::pair<const std::string, Entry>> entry : m_entries)
+		{
+			index << entry.first << ' ' << entry.second.size << ' '
+				  << entry.second.tick << ' ' << entry.second.hasText << '\n';
+		}
+	}
+	std::error_code ec;
+	fs::rename(tmpPath, indexPath, ec);
+	if (ec) fs::remove(tmpPath, ec);
+	unlockIndex();
+	m_dirty = false;
+
+	if (m_verbose)
+	{
+		std::cout << "[APP] SPIR-V cache " << m_directory << ": " << m_entries.size() << " entries, "
+				  << m_totalSize << " bytes, hits: " << m_hits << ", misses: " << m_misses
+				  << ", evictions: " << m_evictions << std::endl;
+	}
+}
+
+SpirvCache::Stats SpirvCache::stats () const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return Stats{ uint32_t(m_entries.size()), m_totalSize, m_hits, m_misses, m_evictions };
+}
+
+} // namespace vtf
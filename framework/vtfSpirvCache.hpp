@@ -0,0 +1,79 @@
+#ifndef __VTF_SPIRV_CACHE_HPP_INCLUDED__
+#define __VTF_SPIRV_CACHE_HPP_INCLUDED__
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vtfDigest.hpp"
+#include "vtfFilesystem.hpp"
+
+namespace vtf
+{
+
+// Persistent, content-addressed storage of compiled shaders shared by all the collections.
+// Each entry is identified by a digest of everything that affects the compilation result,
+// so stale binaries are never returned. An index file keeps entry sizes along with their
+// last use, when the total size exceeds the limit the least recently used entries are removed.
+// Concurrent runs may share the directory, each of them merges its entries with the index
+// on disk under a lock file, entry files that no index knows about are adopted as the oldest.
+struct SpirvCache
+{
+	typedef Digest::value_type Key;
+
+	// Placed in <tmpDir>/vtf-spirv-cache, limited to GlobalAppFlags::spirvCacheSize MiB
+	static add_ref<SpirvCache> instance ();
+
+	SpirvCache (add_cref<fs::path> directory, uint64_t maxSize, bool verbose = false);
+	~SpirvCache ();
+
+	bool enabled	() const;
+	bool lookup		(add_cref<Key> key, add_ref<std::vector<char>> binary, add_ref<std::vector<char>> text);
+	void store		(add_cref<Key> key, add_cref<std::vector<char>> binary, add_cref<std::vector<char>> text);
+	// Merges the index with the one on disk and saves it if anything has changed since the last call
+	void flush		();
+
+	struct Stats
+	{
+		uint32_t	entries;
+		uint64_t	bytes;
+		uint32_t	hits;
+		uint32_t	misses;
+		uint32_t	evictions;
+	};
+	Stats stats () const;
+
+private:
+	struct Entry
+	{
+		uint64_t	size;
+		uint64_t	tick;
+		bool		hasText;
+	};
+	typedef std::unordered_map<std::string, Entry> Entries;
+	bool		readIndex	(add_ref<Entries> entries) const;
+	void		load		();
+	void		merge		();
+	void		evict		();
+	bool		lockIndex	() const;
+	void		unlockIndex	() const;
+	fs::path	binPath		(add_cref<std::string> name) const;
+	fs::path	textPath	(add_cref<std::string> name) const;
+
+	const fs::path							m_directory;
+	const uint64_t							m_maxSize;
+	const bool								m_verbose;
+	mutable std::mutex						m_mutex;
+	Entries									m_entries;
+	uint64_t								m_totalSize;
+	uint64_t								m_tick;
+	bool									m_dirty;
+	uint32_t								m_hits;
+	uint32_t								m_misses;
+	uint32_t								m_evictions;
+};
+
+} // namespace vtf
+
+#endif // __VTF_SPIRV_CACHE_HPP_INCLUDED__
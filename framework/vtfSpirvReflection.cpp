@@ -0,0 +1,373 @@
+#include <algorithm>
+
+#include "vtfSpirvReflection.hpp"
+#include "vtfZDeletable.hpp"
+
+namespace vtf
+{
+
+namespace
+{
+
+// Subset of the SPIR-V grammar the reflection needs
+constexpr uint32_t magicNumber = 0x07230203u;
+enum Op : uint32_t
+{
+	OpTypeBool				= 20,
+	OpTypeInt				= 21,
+	OpTypeFloat				= 22,
+	OpTypeVector			= 23,
+	OpTypeMatrix			= 24,
+	OpTypeImage				= 25,
+	OpTypeSampler			= 26,
+	OpTypeSampledImage		= 27,
+	OpTypeArray				= 28,
+	OpTypeRuntimeArray		= 29,
+	OpTypeStruct			= 30,
+	OpTypePointer			= 32,
+	OpConstant				= 43,
+	OpSpecConstantTrue		= 48,
+	OpSpecConstantFalse		= 49,
+	OpSpecConstant			= 50,
+	OpVariable				= 59,
+	OpDecorate				= 71,
+	OpMemberDecorate		= 72,
+	OpTypeAccelerationStructureKHR = 5341
+};
+enum Decoration : uint32_t
+{
+	SpecId			= 1,
+	BufferBlock		= 3,
+	ArrayStride		= 6,
+	MatrixStride	= 7,
+	Binding			= 33,
+	DescriptorSet	= 34,
+	Offset			= 35
+};
+enum StorageClass : uint32_t
+{
+	UniformConstant	= 0,
+	Uniform			= 2,
+	PushConstant	= 9,
+	StorageBuffer	= 12
+};
+enum Dim : uint32_t
+{
+	DimBuffer		= 5,
+	DimSubpassData	= 6
+};
+
+struct Id
+{
+	uint32_t				opcode		= 0u;
+	uint32_t				type		= 0u;		// result type of constants and variables
+	std::vector<uint32_t>	operands;				// words that follow the result id
+	uint32_t				set			= INVALID_UINT32;
+	uint32_t				binding		= INVALID_UINT32;
+	uint32_t				specId		= INVALID_UINT32;
+	uint32_t				arrayStride	= 0u;
+	bool					bufferBlock	= false;
+	std::vector<uint32_t>	memberOffsets;
+	std::vector<uint32_t>	memberMatrixStrides;
+};
+
+struct Module
+{
+	std::vector<Id> ids;
+
+	add_cref<Id> at (uint32_t id) const
+	{
+		ASSERTMSG(id < ids.size(), "SPIR-V id ", id, " out of bound ", ids.size());
+		return ids[id];
+	}
+
+	uint32_t constantValue (uint32_t id) const
+	{
+		add_cref<Id> constant = at(id);
+		ASSERTMSG((constant.opcode == OpConstant || constant.opcode == OpSpecConstant) && constant.operands.size(),
+			"Array length ", id, " is not a constant");
+		return constant.operands[0];
+	}
+
+	uint32_t typeSize (uint32_t typeId, uint32_t matrixStride = 0u) const
+	{
+		add_cref<Id> type = at(typeId);
+		switch (type.opcode)
+		{
+		case OpTypeBool:
+			return uint32_t(sizeof(VkBool32));
+		case OpTypeInt:
+		case OpTypeFloat:
+			return type.operands.at(0) / 8u;
+		case OpTypeVector:
+			return type.operands.at(1) * typeSize(type.operands.at(0));
+		case OpTypeMatrix:
+			return type.operands.at(1) * (matrixStride ? matrixStride : typeSize(type.operands.at(0)));
+		case OpTypeArray:
+			return constantValue(type.operands.at(1))
+				* (type.arrayStride ? type.arrayStride : typeSize(type.operands.at(0)));
+		case OpTypeRuntimeArray:
+			return 0u;
+		case OpTypePointer:
+			// Physical storage buffer pointers
+			return uint32_t(sizeof(VkDeviceAddress));
+		case OpTypeStruct:
+		{
+			uint32_t size = 0u;
+			for (uint32_t m = 0u; m < data_count(type.operands); ++m)
+			{
+				const uint32_t offset = (m < type.memberOffsets.size()) ? type.memberOffsets[m] : size;
+				const uint32_t stride = (m < type.memberMatrixStrides.size()) ? type.memberMatrixStrides[m] : 0u;
+				size = std::max(size, (offset + typeSize(type.operands[m], stride)));
+			}
+			return size;
+		}
+		}
+		ASSERTFALSE("Unexpected SPIR-V type ", typeId, " (opcode ", type.opcode, ")");
+		return 0u;
+	}
+
+	VkDescriptorType descriptorType (uint32_t storageClass, uint32_t typeId) const
+	{
+		add_cref<Id> type = at(typeId);
+		if (StorageBuffer == storageClass)
+		{
+			return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		}
+		if (Uniform == storageClass)
+		{
+			return type.bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		}
+		switch (type.opcode)
+		{
+		case OpTypeSampler:
+			return VK_DESCRIPTOR_TYPE_SAMPLER;
+		case OpTypeSampledImage:
+			return (DimBuffer == at(type.operands.at(0)).operands.at(1))
+				? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		case OpTypeImage:
+		{
+			// Sampled == 2 means the image is used without a sampler
+			const bool storage = (2u == type.operands.at(5));
+			switch (type.operands.at(1))
+			{
+			case DimSubpassData:
+				return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			case DimBuffer:
+				return storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+			}
+			return storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		}
+		case OpTypeAccelerationStructureKHR:
+			return VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+		}
+		ASSERTFALSE("Unexpected SPIR-V resource type ", typeId, " (opcode ", type.opcode, ")");
+		return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+	}
+};
+
+void insertBinding (add_ref<std::vector<SpirvBinding>> bindings, add_cref<SpirvBinding> binding)
+{
+	auto less = [](add_cref<SpirvBinding> lhs, add_cref<SpirvBinding> rhs)
+	{
+		return std::make_pair(lhs.set, lhs.binding) < std::make_pair(rhs.set, rhs.binding);
+	};
+	auto pos = std::lower_bound(bindings.begin(), bindings.end(), binding, less);
+	if (pos != bindings.end() && false == less(binding, *pos))
+	{
+		ASSERTMSG(pos->descriptorType == binding.descriptorType,
+			"Binding ", binding.binding, " of set ", binding.set, " is declared with different descriptor types");
+		pos->stages |= binding.stages;
+		// Runtime arrays win, otherwise the largest array is taken
+		pos->descriptorCount = (0u == pos->descriptorCount || 0u == binding.descriptorCount)
+			? 0u : std::max(pos->descriptorCount, binding.descriptorCount);
+	}
+	else
+	{
+		bindings.insert(pos, binding);
+	}
+}
+
+void insertSpecConstant (add_ref<std::vector<SpirvSpecConstant>> constants, add_cref<SpirvSpecConstant> constant)
+{
+	auto less = [](add_cref<SpirvSpecConstant> lhs, add_cref<SpirvSpecConstant> rhs)
+	{
+		return lhs.constantID < rhs.constantID;
+	};
+	auto pos = std::lower_bound(constants.begin(), constants.end(), constant, less);
+	if (pos != constants.end() && pos->constantID == constant.constantID)
+	{
+		pos->size = std::max(pos->size, constant.size);
+	}
+	else
+	{
+		constants.insert(pos, constant);
+	}
+}
+
+} // unnamed namespace
+
+uint32_t SpirvInterface::setCount () const
+{
+	return bindings.empty() ? 0u : (bindings.back().set + 1u);
+}
+
+auto SpirvInterface::setBindings (uint32_t set) const -> std::vector<SpirvBinding>
+{
+	std::vector<SpirvBinding> result;
+	std::copy_if(bindings.begin(), bindings.end(), std::back_inserter(result),
+				 [&](add_cref<SpirvBinding> b) { return b.set == set; });
+	return result;
+}
+
+auto spirvReflect (add_cref<std::vector<char>> binary, VkShaderStageFlagBits stage) -> SpirvInterface
+{
+	ASSERTMSG(0u == (binary.size() % sizeof(uint32_t)), "SPIR-V binary size must be a multiple of 4");
+	std::vector<uint32_t> code(binary.size() / sizeof(uint32_t));
+	std::copy(binary.begin(), binary.end(), reinterpret_cast<add_ptr<char>>(code.data()));
+	return spirvReflect(code.data(), code.size(), stage);
+}
+
+auto spirvReflect (add_cptr<uint32_t> code, std::size_t wordCount, VkShaderStageFlagBits stage) -> SpirvInterface
+{
+	ASSERTMSG(wordCount >= 5u && magicNumber == code[0], "Not a SPIR-V module");
+
+	Module module;
+	module.ids.resize(code[3]);
+	auto id = [&](uint32_t index) -> add_ref<Id>
+	{
+		ASSERTMSG(index < module.ids.size(), "SPIR-V id ", index, " out of bound ", module.ids.size());
+		return module.ids[index];
+	};
+
+	for (std::size_t pos = 5u; pos < wordCount; )
+	{
+		add_cptr<uint32_t>	words	= code + pos;
+		const uint32_t		count	= words[0] >> 16;
+		const uint32_t		opcode	= words[0] & 0xFFFFu;
+		ASSERTMSG(count && (pos + count) <= wordCount, "Malformed SPIR-V instruction at word ", pos);
+
+		switch (opcode)
+		{
+		case OpDecorate:
+			if (count >= 3u)
+			{
+				add_ref<Id> target = id(words[1]);
+				const uint32_t literal = (count > 3u) ? words[3] : 0u;
+				switch (words[2])
+				{
+				case SpecId:		target.specId		= literal;	break;
+				case BufferBlock:	target.bufferBlock	= true;		break;
+				case ArrayStride:	target.arrayStride	= literal;	break;
+				case Binding:		target.binding		= literal;	break;
+				case DescriptorSet:	target.set			= literal;	break;
+				}
+			}
+			break;
+		case OpMemberDecorate:
+			if (count >= 5u && (Offset == words[3] || MatrixStride == words[3]))
+			{
+				add_ref<Id> target = id(words[1]);
+				add_ref<std::vector<uint32_t>> values = (Offset == words[3]) ? target.memberOffsets : target.memberMatrixStrides;
+				if (values.size() <= words[2]) values.resize(words[2] + 1u, 0u);
+				values[words[2]] = words[4];
+			}
+			break;
+		case OpTypeBool:		case OpTypeInt:			case OpTypeFloat:
+		case OpTypeVector:		case OpTypeMatrix:		case OpTypeImage:
+		case OpTypeSampler:		case OpTypeSampledImage:
+		case OpTypeArray:		case OpTypeRuntimeArray:
+		case OpTypeStruct:		case OpTypePointer:
+		case OpTypeAccelerationStructureKHR:
+			if (count >= 2u)
+			{
+				add_ref<Id> type = id(words[1]);
+				type.opcode = opcode;
+				type.operands.assign(words + 2, words + count);
+			}
+			break;
+		case OpConstant:		case OpSpecConstant:
+		case OpSpecConstantTrue:	case OpSpecConstantFalse:
+		case OpVariable:
+			if (count >= 3u)
+			{
+				add_ref<Id> value = id(words[2]);
+				value.opcode = opcode;
+				value.type = words[1];
+				value.operands.assign(words + 3, words + count);
+			}
+			break;
+		}
+
+		pos += count;
+	}
+
+	SpirvInterface result;
+	result.stages = VkShaderStageFlags(stage);
+
+	for (add_cref<Id> value : module.ids)
+	{
+		if (OpSpecConstant == value.opcode || OpSpecConstantTrue == value.opcode || OpSpecConstantFalse == value.opcode)
+		{
+			if (INVALID_UINT32 != value.specId)
+			{
+				insertSpecConstant(result.specConstants, { value.specId, module.typeSize(value.type) });
+			}
+			continue;
+		}
+		if (OpVariable != value.opcode || value.operands.empty()) continue;
+
+		const uint32_t storageClass = value.operands[0];
+		add_cref<Id> pointer = module.at(value.type);
+		ASSERTMSG(OpTypePointer == pointer.opcode && pointer.operands.size() == 2u, "Variable type must be a pointer");
+		uint32_t typeId = pointer.operands[1];
+
+		if (PushConstant == storageClass)
+		{
+			result.pushConstantSize = std::max(result.pushConstantSize, module.typeSize(typeId));
+			result.pushConstantStages |= VkShaderStageFlags(stage);
+			continue;
+		}
+		if (UniformConstant != storageClass && Uniform != storageClass && StorageBuffer != storageClass) continue;
+		// Plain uniforms of UniformConstant class are not allowed in Vulkan, so anything decorated is a resource
+		if (INVALID_UINT32 == value.binding) continue;
+
+		uint32_t descriptorCount = 1u;
+		for (add_cptr<Id> type = &module.at(typeId); ; type = &module.at(typeId))
+		{
+			if (OpTypeArray == type->opcode)
+				descriptorCount *= module.constantValue(type->operands.at(1));
+			else if (OpTypeRuntimeArray == type->opcode)
+				descriptorCount = 0u;
+			else break;
+			typeId = type->operands.at(0);
+		}
+
+		SpirvBinding binding;
+		binding.set				= (INVALID_UINT32 == value.set) ? 0u : value.set;
+		binding.binding			= value.binding;
+		binding.descriptorType	= module.descriptorType(storageClass, typeId);
+		binding.descriptorCount	= descriptorCount;
+		binding.stages			= VkShaderStageFlags(stage);
+		insertBinding(result.bindings, binding);
+	}
+
+	return result;
+}
+
+void spirvMergeInterfaces (add_ref<SpirvInterface> dst, add_cref<SpirvInterface> src)
+{
+	dst.stages |= src.stages;
+	for (add_cref<SpirvBinding> binding : src.bindings)
+	{
+		insertBinding(dst.bindings, binding);
+	}
+	dst.pushConstantSize = std::max(dst.pushConstantSize, src.pushConstantSize);
+	dst.pushConstantStages |= src.pushConstantStages;
+	for (add_cref<SpirvSpecConstant> constant : src.specConstants)
+	{
+		insertSpecConstant(dst.specConstants, constant);
+	}
+}
+
+} // namespace vtf
@@ -0,0 +1,51 @@
+#ifndef __VTF_SPIRV_REFLECTION_HPP_INCLUDED__
+#define __VTF_SPIRV_REFLECTION_HPP_INCLUDED__
+
+#include <vector>
+
+#include "vtfVkUtils.hpp"
+
+namespace vtf
+{
+
+struct SpirvBinding
+{
+	uint32_t			set;
+	uint32_t			binding;
+	VkDescriptorType	descriptorType;
+	uint32_t			descriptorCount;	// 0 for runtime arrays
+	VkShaderStageFlags	stages;
+};
+
+struct SpirvSpecConstant
+{
+	uint32_t	constantID;
+	uint32_t	size;						// booleans take sizeof(VkBool32) as in VkSpecializationMapEntry
+};
+
+/**
+ * Resources a shader module declares, found by walking its decorations, types and variables.
+ * Only module-scope variables are taken into account, whether an entry point actually uses
+ * them is not examined, so the interface may be wider than the one of a single entry point.
+ */
+struct SpirvInterface
+{
+	VkShaderStageFlags				stages				= 0u;
+	std::vector<SpirvBinding>		bindings;			// ordered by set and binding
+	uint32_t						pushConstantSize	= 0u;
+	VkShaderStageFlags				pushConstantStages	= 0u;
+	std::vector<SpirvSpecConstant>	specConstants;		// ordered by constantID
+
+	uint32_t	setCount		() const;
+	auto		setBindings		(uint32_t set) const -> std::vector<SpirvBinding>;
+};
+
+// Binary as kept by ProgramCollection, malformed modules are reported with an exception
+auto	spirvReflect			(add_cref<std::vector<char>> binary, VkShaderStageFlagBits stage) -> SpirvInterface;
+auto	spirvReflect			(add_cptr<uint32_t> code, std::size_t wordCount, VkShaderStageFlagBits stage) -> SpirvInterface;
+// Interfaces of the stages of one pipeline, a binding declared by more of them must have the same type
+void	spirvMergeInterfaces	(add_ref<SpirvInterface> dst, add_cref<SpirvInterface> src);
+
+} // namespace vtf
+
+#endif // __VTF_SPIRV_REFLECTION_HPP_INCLUDED__
@@ -55,6 +55,7 @@ APPLY(DEF, VkPhysicalDeviceMaintenance4Features, VK_STRUCTURE_TYPE_PHYSICAL_DEVI
 APPLY(DEF, VkPhysicalDeviceShaderObjectFeaturesEXT, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT) \
 APPLY(DEF, VkPhysicalDeviceDynamicRenderingFeatures, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES) \
 APPLY(DEF, VkPhysicalDeviceSynchronization2Features, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES) \
+APPLY(DEF, VkPhysicalDeviceTimelineSemaphoreFeatures, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES) \
 APPLY(DEF, VkPhysicalDeviceSubgroupSizeControlFeatures, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_FEATURES) \
 APPLY(DEF, VkPhysicalDeviceExtendedDynamicStateFeaturesEXT,	VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT) \
 APPLY(DEF, VkPhysicalDeviceExtendedDynamicState2FeaturesEXT,	VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT) \
@@ -81,7 +82,8 @@ APPLY(DEF, VkPhysicalDeviceVertexInputDynamicStateFeaturesEXT, VK_STRUCTURE_TYPE
 APPLY(DEF, VkPhysicalDeviceTransformFeedbackFeaturesEXT, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TRANSFORM_FEEDBACK_FEATURES_EXT) \
 APPLY(DEF, VkPhysicalDeviceDynamicRenderingLocalReadFeatures, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_LOCAL_READ_FEATURES) \
 APPLY(DEF, VkPhysicalDeviceAccelerationStructureFeaturesKHR, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR) \
-APPLY(DEF, VkPhysicalDeviceRayTracingPipelineFeaturesKHR, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR)
+APPLY(DEF, VkPhysicalDeviceRayTracingPipelineFeaturesKHR, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR) \
+APPLY(DEF, VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT)
 
 //APPLY(DEF, VkPhysicalDeviceFeatures, VK_STRUCTURE_TYPE_MAX_ENUM)
 MKSTYPE(VkPhysicalDeviceFeatures, VK_STRUCTURE_TYPE_MAX_ENUM);
@@ -131,6 +133,9 @@ MKSTYPE(VkDeviceQueueCreateInfo,					VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO)
 MKSTYPE(VkDeviceCreateInfo,							VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO);
 MKSTYPE(VkFenceCreateInfo,							VK_STRUCTURE_TYPE_FENCE_CREATE_INFO);
 MKSTYPE(VkSemaphoreCreateInfo,						VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO);
+MKSTYPE(VkSemaphoreTypeCreateInfo,					VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO);
+MKSTYPE(VkSemaphoreWaitInfo,						VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO);
+MKSTYPE(VkTimelineSemaphoreSubmitInfo,				VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO);
 MKSTYPE(VkInstanceCreateInfo,						VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO);
 MKSTYPE(VkDebugUtilsMessengerCreateInfoEXT,			VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT);
 MKSTYPE(VkDebugReportCallbackCreateInfoEXT,			VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT);
@@ -174,10 +179,13 @@ MKSTYPE(VkCooperativeMatrixPropertiesKHR,			VK_STRUCTURE_TYPE_COOPERATIVE_MATRIX
 MKSTYPE(VkPipelineRenderingCreateInfo,				VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO);
 MKSTYPE(VkRenderingAttachmentLocationInfo,			VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_LOCATION_INFO);
 MKSTYPE(VkRenderingInputAttachmentIndexInfo,		VK_STRUCTURE_TYPE_RENDERING_INPUT_ATTACHMENT_INDEX_INFO);
+MKSTYPE(VkGraphicsPipelineLibraryCreateInfoEXT,		VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT);
+MKSTYPE(VkPipelineLibraryCreateInfoKHR,				VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR);
 MKSTYPE(VkMutableDescriptorTypeCreateInfoEXT,		VK_STRUCTURE_TYPE_MUTABLE_DESCRIPTOR_TYPE_CREATE_INFO_EXT);
 MKSTYPE(VkAttachmentDescription2,					VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2);
 MKSTYPE(VkAttachmentReference2,						VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2);
 MKSTYPE(VkSubpassDescription2,						VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2);
+MKSTYPE(VkHeadlessSurfaceCreateInfoEXT,			VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT);
 
 struct makeVkStruct
 {
@@ -0,0 +1,213 @@
+#include "vtfTaskScheduler.hpp"
+#include "vtfVkUtils.hpp"
+
+#include <iostream>
+
+namespace vtf
+{
+
+// Scheduler the calling thread works for and its index there
+static thread_local std::pair<add_cptr<TaskScheduler>, uint32_t> currentWorker(nullptr, INVALID_UINT32);
+
+TaskScheduler::TaskScheduler (uint32_t workerCount)
+	: m_workers		()
+	, m_threads		()
+	, m_pending		(0u)
+	, m_nextWorker	(0u)
+	, m_sleepMutex	()
+	, m_sleep		()
+	, m_stop		(false)
+{
+	// There must be at least one worker, otherwise futures would never be satisfied
+	const uint32_t hardwareThreads = std::max(2u, std::thread::hardware_concurrency());
+	const uint32_t count = (workerCount == 0u) ? (hardwareThreads - 1u) : workerCount;
+
+	m_workers.reserve(count);
+	for (uint32_t index = 0u; index < count; ++index)
+	{
+		m_workers.emplace_back(std::make_unique<Worker>());
+	}
+	m_threads.reserve(count);
+	for (uint32_t index = 0u; index < count; ++index)
+	{
+		m_threads.emplace_back(&TaskScheduler::work, this, index);
+	}
+}
+
+TaskScheduler::~TaskScheduler ()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stop = true;
+	}
+	m_sleep.notify_all();
+	for (add_ref<std::thread> thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+add_ref<TaskScheduler> TaskScheduler::instance ()
+{
+	static TaskScheduler scheduler;
+	return scheduler;
+}
+
+uint32_t TaskScheduler::workerIndex () const
+{
+	return (currentWorker.first == this) ? currentWorker.second : INVALID_UINT32;
+}
+
+void TaskScheduler::enqueue (Task&& task)
+{
+	uint32_t index = workerIndex();
+	if (INVALID_UINT32 == index)
+	{
+		index = m_nextWorker++ % workerCount();
+	}
+	{
+		add_ref<Worker> worker = *m_workers.at(index);
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.tasks.push_back(std::move(task));
+	}
+	// The counter is changed under the lock, so a worker that has just found nothing
+	// to do either sees the new task in its predicate or receives the notification.
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_pending.fetch_add(1u);
+	}
+	m_sleep.notify_one();
+}
+
+bool TaskScheduler::pop (uint32_t index, add_ref<Task> task)
+{
+	add_ref<Worker> worker = *m_workers.at(index);
+	std::lock_guard<std::mutex> lock(worker.mutex);
+	if (worker.tasks.empty()) return false;
+	// Own tasks are taken in LIFO order while their data is still in the cache
+	task = std::move(worker.tasks.back());
+	worker.tasks.pop_back();
+	m_pending.fetch_sub(1u);
+	return true;
+}
+
+bool TaskScheduler::steal (uint32_t index, add_ref<Task> task)
+{
+	const uint32_t count = workerCount();
+	const uint32_t start = (INVALID_UINT32 == index) ? (m_nextWorker.load() % count) : (index + 1u);
+	for (uint32_t i = 0u; i < count; ++i)
+	{
+		const uint32_t victim = (start + i) % count;
+		if (victim == index) continue;
+
+		add_ref<Worker> worker = *m_workers.at(victim);
+		// Locked unconditionally, waiting groups rely on not missing any queued task
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		if (worker.tasks.empty()) continue;
+		// The oldest task is taken, it is the most likely one to spawn further work
+		task = std::move(worker.tasks.front());
+		worker.tasks.pop_front();
+		m_pending.fetch_sub(1u);
+		return true;
+	}
+	return false;
+}
+
+bool TaskScheduler::runOne ()
+{
+	const uint32_t index = workerIndex();
+	Task task;
+	if ((INVALID_UINT32 != index && pop(index, task)) || steal(index, task))
+	{
+		task();
+		return true;
+	}
+	return false;
+}
+
+void TaskScheduler::work (uint32_t index)
+{
+	currentWorker = std::make_pair(this, index);
+	Task task;
+	while (true)
+	{
+		if (pop(index, task) || steal(index, task))
+		{
+			try
+			{
+				task();
+			}
+			catch (add_cref<std::exception> e)
+			{
+				// Tasks from submit() and TaskGroup catch their exceptions, only bare ones may end up here
+				std::cout << "[APP] Unhandled exception in task: " << e.what() << std::endl;
+			}
+			task = nullptr;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		if (m_stop && 0u == m_pending.load()) break;
+		m_sleep.wait(lock, [&] { return m_stop || 0u != m_pending.load(); });
+	}
+}
+
+TaskGroup::TaskGroup (add_ref<TaskScheduler> scheduler)
+	: m_scheduler	(scheduler)
+	, m_running		(0u)
+	, m_mutex		()
+	, m_done		()
+	, m_exception	()
+{
+}
+
+TaskGroup::~TaskGroup ()
+{
+	try
+	{
+		wait();
+	}
+	catch (add_cref<std::exception> e)
+	{
+		std::cout << e.what() << std::endl;
+	}
+}
+
+void TaskGroup::finish (std::exception_ptr exception)
+{
+	// Everything is done under the lock, once it is released the group may already be gone
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (exception && !m_exception)
+	{
+		m_exception = exception;
+	}
+	if (1u == m_running.fetch_sub(1u))
+	{
+		m_done.notify_all();
+	}
+}
+
+void TaskGroup::wait ()
+{
+	while (0u != m_running.load())
+	{
+		if (false == m_scheduler.runOne())
+		{
+			// Nothing left to help with, the remaining tasks are being executed by others
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_done.wait(lock, [&] { return 0u == m_running.load(); });
+		}
+	}
+
+	std::exception_ptr exception;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::swap(exception, m_exception);
+	}
+	if (exception)
+	{
+		std::rethrow_exception(exception);
+	}
+}
+
+} // namespace vtf
@@ -0,0 +1,189 @@
+#ifndef __VTF_TASK_SCHEDULER_HPP_INCLUDED__
+#define __VTF_TASK_SCHEDULER_HPP_INCLUDED__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "vtfThreadPoolHelpers.hpp"
+
+namespace vtf
+{
+
+/**
+ * @brief General purpose task scheduler shared by the whole application.
+ * @note  Every worker owns a deque of tasks, it pushes and pops its own tasks at the back
+ *        and steals from the front of the others' deques when its own one is empty.
+ *        Tasks submitted from threads outside of the scheduler are spread over the workers
+ *        in turns. Idle workers sleep on a condition variable instead of spinning.
+ *        A thread waiting on a TaskGroup executes pending tasks in the meantime, so groups
+ *        may be nested and waited inside tasks without starving the scheduler.
+ *        ThreadPool is still there for code that wants every thread to call the same routine.
+ */
+class TaskScheduler
+{
+public:
+	typedef std::function<void()> Task;
+
+	// Zero means one worker less than the hardware has, the calling thread is expected to help
+	TaskScheduler	(uint32_t workerCount = 0u);
+	TaskScheduler	(const TaskScheduler&) = delete;
+	TaskScheduler&	operator=(const TaskScheduler&) = delete;
+	// Pending tasks are executed before the workers are joined
+	~TaskScheduler	();
+
+	static add_ref<TaskScheduler> instance ();
+
+	uint32_t	workerCount	() const { return data_count(m_workers); }
+	// Index of the worker the calling thread is, INVALID_UINT32 for threads outside of this scheduler
+	uint32_t	workerIndex	() const;
+
+	void		enqueue		(Task&& task);
+	// Executes one pending task on the calling thread, returns false if there was nothing to do
+	bool		runOne		();
+
+	template<class Fn>
+	auto		submit		(Fn&& fn) -> std::future<std::invoke_result_t<std::decay_t<Fn>>>;
+
+	// Calls fn(first, last) for consecutive chunks of at most grain indices in [begin, end).
+	// At most maxThreads threads (including the calling one) take part, 0 means all of them.
+	template<class Fn>
+	void		parallelFor	(uint32_t begin, uint32_t end, uint32_t grain, Fn&& fn, uint32_t maxThreads = 0u);
+
+private:
+	struct Worker
+	{
+		std::mutex			mutex;
+		std::deque<Task>	tasks;
+	};
+	bool		pop			(uint32_t index, add_ref<Task> task);
+	bool		steal		(uint32_t index, add_ref<Task> task);
+	void		work		(uint32_t index);
+
+	std::vector<std::unique_ptr<Worker>>	m_workers;
+	std::vector<std::thread>				m_threads;
+	std::atomic<uint32_t>					m_pending;
+	std::atomic<uint32_t>					m_nextWorker;
+	std::mutex								m_sleepMutex;
+	std::condition_variable					m_sleep;
+	bool									m_stop;
+};
+
+/**
+ * @brief Set of tasks that can be waited for together.
+ * @note  The first exception thrown by any of the tasks is rethrown by wait(),
+ *        the destructor waits as well but swallows the exception.
+ */
+class TaskGroup
+{
+public:
+	TaskGroup	(add_ref<TaskScheduler> scheduler = TaskScheduler::instance());
+	TaskGroup	(const TaskGroup&) = delete;
+	TaskGroup&	operator=(const TaskGroup&) = delete;
+	~TaskGroup	();
+
+	template<class Fn>
+	void run	(Fn&& fn);
+	// Helps executing pending tasks until all tasks of the group have finished
+	void wait	();
+
+	add_ref<TaskScheduler> scheduler () const { return m_scheduler; }
+
+private:
+	void finish	(std::exception_ptr exception);
+
+	add_ref<TaskScheduler>		m_scheduler;
+	std::atomic<uint32_t>		m_running;
+	std::mutex					m_mutex;
+	std::condition_variable		m_done;
+	std::exception_ptr			m_exception;
+};
+
+template<class Fn>
+auto TaskScheduler::submit (Fn&& fn) -> std::future<std::invoke_result_t<std::decay_t<Fn>>>
+{
+	typedef std::invoke_result_t<std::decay_t<Fn>> R;
+	// std::function requires a copyable callable, hence the packaged task is shared
+	auto task = std::make_shared<std::packaged_task<R()>>(std::forward<Fn>(fn));
+	std::future<R> future = task->get_future();
+	enqueue([task]() { (*task)(); });
+	return future;
+}
+
+template<class Fn>
+void TaskGroup::run (Fn&& fn)
+{
+	m_running.fetch_add(1u);
+	m_scheduler.enqueue([this, fn = std::forward<Fn>(fn)]() mutable
+	{
+		std::exception_ptr exception;
+		try
+		{
+			fn();
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+		finish(exception);
+	});
+}
+
+template<class Fn>
+void TaskScheduler::parallelFor (uint32_t begin, uint32_t end, uint32_t grain, Fn&& fn, uint32_t maxThreads)
+{
+	if (end <= begin) return;
+
+	grain = std::max(1u, grain);
+	const uint32_t chunkCount = (end - begin - 1u) / grain + 1u;
+	const uint32_t threadCount = std::min(chunkCount,
+		std::min(((maxThreads == 0u) ? (workerCount() + 1u) : maxThreads), (workerCount() + 1u)));
+
+	// Chunks are handed out dynamically so long-lasting ones don't stall the others
+	std::atomic<uint32_t> next(0u);
+	auto loop = [&]()
+	{
+		for (uint32_t chunk = next++; chunk < chunkCount; chunk = next++)
+		{
+			const uint32_t first = begin + chunk * grain;
+			fn(first, std::min(end, (first + grain)));
+		}
+	};
+
+	if (threadCount > 1u)
+	{
+		TaskGroup group(*this);
+		for (uint32_t t = 1u; t < threadCount; ++t)
+		{
+			group.run(loop);
+		}
+		try
+		{
+			loop();
+		}
+		catch (...)
+		{
+			// Let the others stop and wait for them, the captured state lives on this stack
+			next = chunkCount;
+			try { group.wait(); } catch (...) { }
+			throw;
+		}
+		group.wait();
+	}
+	else
+	{
+		loop();
+	}
+}
+
+} // namespace vtf
+
+#endif // __VTF_TASK_SCHEDULER_HPP_INCLUDED__
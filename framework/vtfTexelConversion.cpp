@@ -0,0 +1,496 @@
+#include "vtfTexelConversion.hpp"
+#include "vtfFormatUtils.hpp"
+#include "vtfFloat16.hpp"
+#include "vtfTaskScheduler.hpp"
+#include "vtfBacktrace.hpp"
+#include "vtfCUtils.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string_view>
+
+namespace
+{
+using namespace vtf;
+
+enum class Encoding { UNorm, SNorm, UInt, SInt, Float, UFloat };
+
+struct TexelLayout
+{
+	uint32_t	texelSize;
+	uint32_t	componentCount;
+	uint32_t	rgba[4];		// RGBA index of each component in memory order
+	uint32_t	bits[4];		// in memory order
+	uint32_t	shifts[4];		// packed formats only
+	uint32_t	width;			// common width of components, unpacked formats only
+	bool		packed;
+	bool		identity;		// four components in RGBA order
+	Encoding	encoding;
+};
+
+TexelLayout makeTexelLayout (VkFormat format)
+{
+	const ZFormatInfo	info	= formatGetInfo(format);
+	TexelLayout			l		{};
+
+	if (false == info.color)
+	{
+		ASSERTMSG((VK_FORMAT_D16_UNORM == format || VK_FORMAT_D32_SFLOAT == format),
+				  "Format ", info.name, " can not be converted");
+		l.texelSize			= info.pixelByteSize;
+		l.componentCount	= 1u;
+		l.bits[0]			= info.componentBitSizes[0];
+		l.width				= l.bits[0];
+		l.encoding			= info.floating ? Encoding::Float : Encoding::UNorm;
+		return l;
+	}
+
+	l.componentCount = info.componentCount;
+	for (uint32_t c = 0u; c < 4u; ++c)
+	{
+		if (info.swizzling[c] >= 0)
+		{
+			const uint32_t p = uint32_t(info.swizzling[c]);
+			l.rgba[p] = c;
+			l.bits[p] = info.componentBitSizes[c];
+		}
+	}
+
+	l.packed	= (info.pack != 0u);
+	l.texelSize	= l.packed ? (info.pack / 8u) : info.pixelByteSize;
+	if (l.packed)
+	{
+		// The first component of the name occupies the most significant bits
+		for (uint32_t p = l.componentCount, shift = 0u; p-- > 0u; shift += l.bits[p])
+		{
+			l.shifts[p] = shift;
+		}
+	}
+	else
+	{
+		l.width = l.bits[0];
+		for (uint32_t p = 1u; p < l.componentCount; ++p)
+		{
+			ASSERTMSG(l.bits[p] == l.width, "Format ", info.name, " can not be converted");
+		}
+	}
+
+	l.identity = (4u == l.componentCount)
+					&& l.rgba[0] == 0u && l.rgba[1] == 1u && l.rgba[2] == 2u && l.rgba[3] == 3u;
+
+	const bool srgb = std::string_view(info.name).find("SRGB") != std::string_view::npos;
+	if (info.floating)
+		l.encoding = info.isSigned ? Encoding::Float : Encoding::UFloat;
+	else if (info.normalized || srgb)
+		l.encoding = (info.isSigned && false == srgb) ? Encoding::SNorm : Encoding::UNorm;
+	else
+		l.encoding = info.isSigned ? Encoding::SInt : Encoding::UInt;
+
+	ASSERTMSG((l.packed || Encoding::UFloat != l.encoding)
+			&& (l.packed || Encoding::Float != l.encoding || 8u != l.width),
+			"Format ", info.name, " can not be converted");
+
+	return l;
+}
+
+template<class T> T clampCast (double value)
+{
+	if (value <= double(std::numeric_limits<T>::lowest())) return std::numeric_limits<T>::lowest();
+	if (value >= double(std::numeric_limits<T>::max())) return std::numeric_limits<T>::max();
+	return static_cast<T>(value);
+}
+
+template<class T, Encoding E> inline float toFloat (T value)
+{
+	if constexpr (E == Encoding::UNorm || E == Encoding::SNorm)
+	{
+		float res = 0.0f;
+		if constexpr (sizeof(T) <= 2u)
+			res = float(value) * (1.0f / float(std::numeric_limits<T>::max()));
+		else res = float(double(value) / double(std::numeric_limits<T>::max()));
+		if constexpr (E == Encoding::SNorm)
+			res = std::max(res, -1.0f);
+		return res;
+	}
+	else if constexpr (E == Encoding::Float && std::is_same_v<T, uint16_t>)
+		return float16ToFloat32(Float16::construct(value));
+	else return float(value);
+}
+
+template<class T, Encoding E> inline T fromFloat (float value)
+{
+	if constexpr (E == Encoding::UNorm)
+		return clampCast<T>(std::round(double(std::clamp(value, 0.0f, 1.0f)) * double(std::numeric_limits<T>::max())));
+	else if constexpr (E == Encoding::SNorm)
+		return clampCast<T>(std::round(double(std::clamp(value, -1.0f, 1.0f)) * double(std::numeric_limits<T>::max())));
+	else if constexpr (E == Encoding::Float && std::is_same_v<T, uint16_t>)
+		return float32ToFloat16(value).getData();
+	else if constexpr (E == Encoding::Float)
+		return static_cast<T>(value);
+	else return clampCast<T>(std::round(double(value)));
+}
+
+template<class T> inline uint32_t toUint (T value)
+{
+	if constexpr (std::is_signed_v<T>)
+		return static_cast<uint32_t>(static_cast<int64_t>(value));
+	else return static_cast<uint32_t>(value);
+}
+
+inline int32_t signExtend (uint32_t raw, uint32_t bits)
+{
+	const uint32_t sign = 1u << (bits - 1u);
+	return int32_t(raw ^ sign) - int32_t(sign);
+}
+
+// Unsigned floats of packed formats have 5 bits of exponent and no sign
+float unsignedFloatToFloat32 (uint32_t raw, uint32_t mantissaBits)
+{
+	const uint32_t e = raw >> mantissaBits;
+	const uint32_t m = raw & ((1u << mantissaBits) - 1u);
+	if (0u == e)
+		return std::ldexp(float(m), (-14 - int(mantissaBits)));
+	if (31u == e)
+		return m ? std::numeric_limits<float>::quiet_NaN() : std::numeric_limits<float>::infinity();
+	return std::ldexp(float(m | (1u << mantissaBits)), (int(e) - 15 - int(mantissaBits)));
+}
+
+uint32_t float32ToUnsignedFloat (float value, uint32_t mantissaBits)
+{
+	if (std::isnan(value))	return (31u << mantissaBits) | 1u;
+	if (value <= 0.0f)		return 0u;
+	if (std::isinf(value))	return (31u << mantissaBits);
+
+	int exponent = 0;
+	const float fraction = std::frexp(value, &exponent);
+	int biased = exponent - 1 + 15;
+	if (biased <= 0)
+	{
+		// Rounding up to 1 << mantissaBits gives the smallest normal number, which is fine
+		return uint32_t(std::round(std::ldexp(value, (14 + int(mantissaBits)))));
+	}
+	uint32_t m = uint32_t(std::round(std::ldexp((fraction * 2.0f - 1.0f), int(mantissaBits))));
+	if (m == (1u << mantissaBits))
+	{
+		m = 0u;
+		biased += 1;
+	}
+	if (biased >= 31)
+		return (30u << mantissaBits) | ((1u << mantissaBits) - 1u);
+	return (uint32_t(biased) << mantissaBits) | m;
+}
+
+template<Encoding E> inline float unpackComponent (uint32_t raw, uint32_t bits)
+{
+	if constexpr (E == Encoding::UNorm)
+		return float(raw) / float((1u << bits) - 1u);
+	else if constexpr (E == Encoding::SNorm)
+		return std::max(float(signExtend(raw, bits)) / float((1u << (bits - 1u)) - 1u), -1.0f);
+	else if constexpr (E == Encoding::SInt)
+		return float(signExtend(raw, bits));
+	else if constexpr (E == Encoding::UFloat)
+		return unsignedFloatToFloat32(raw, (bits - 5u));
+	else return float(raw);
+}
+
+template<Encoding E> inline uint32_t packComponent (float value, uint32_t bits)
+{
+	const uint32_t mask = (1u << bits) - 1u;
+	if constexpr (E == Encoding::UNorm)
+		return uint32_t(std::round(std::clamp(value, 0.0f, 1.0f) * float(mask)));
+	else if constexpr (E == Encoding::SNorm)
+		return uint32_t(int32_t(std::round(std::clamp(value, -1.0f, 1.0f) * float(mask >> 1)))) & mask;
+	else if constexpr (E == Encoding::SInt)
+	{
+		const float limit = float(mask >> 1);
+		return uint32_t(int32_t(std::round(std::clamp(value, (-limit - 1.0f), limit)))) & mask;
+	}
+	else if constexpr (E == Encoding::UFloat)
+		return float32ToUnsignedFloat(value, (bits - 5u));
+	else return uint32_t(std::round(std::clamp(value, 0.0f, float(mask))));
+}
+
+inline void setDefaults (add_ptr<float> texel)
+{
+	texel[0] = texel[1] = texel[2] = 0.0f;
+	texel[3] = 1.0f;
+}
+
+inline void setDefaults (add_ptr<uint32_t> texel)
+{
+	texel[0] = texel[1] = texel[2] = 0u;
+	texel[3] = 1u;
+}
+
+struct ToFloat4
+{
+	typedef add_cptr<uint8_t>	Bytes;
+	typedef add_ptr<float>		Values;
+	typedef void (*Kernel)(add_cref<TexelLayout>, Bytes, uint32_t, Values);
+
+	template<class T, Encoding E>
+	static void unpacked (add_cref<TexelLayout> l, Bytes src, uint32_t count, Values dst)
+	{
+		add_cptr<T> s = reinterpret_cast<add_cptr<T>>(src);
+		if (l.identity)
+		{
+			// A flat loop the compiler is able to vectorize
+			for (uint32_t i = 0u, n = (count * 4u); i < n; ++i)
+				dst[i] = toFloat<T, E>(s[i]);
+			return;
+		}
+		for (uint32_t t = 0u; t < count; ++t, s += l.componentCount, dst += 4)
+		{
+			setDefaults(dst);
+			for (uint32_t k = 0u; k < l.componentCount; ++k)
+				dst[l.rgba[k]] = toFloat<T, E>(s[k]);
+		}
+	}
+
+	template<Encoding E>
+	static void packed (add_cref<TexelLayout> l, Bytes src, uint32_t count, Values dst)
+	{
+		for (uint32_t t = 0u; t < count; ++t, src += l.texelSize, dst += 4)
+		{
+			uint32_t texel = 0u;
+			std::memcpy(&texel, src, l.texelSize);
+			setDefaults(dst);
+			for (uint32_t k = 0u; k < l.componentCount; ++k)
+				dst[l.rgba[k]] = unpackComponent<E>(((texel >> l.shifts[k]) & ((1u << l.bits[k]) - 1u)), l.bits[k]);
+		}
+	}
+};
+
+struct FromFloat4
+{
+	typedef add_ptr<uint8_t>	Bytes;
+	typedef add_cptr<float>		Values;
+	typedef void (*Kernel)(add_cref<TexelLayout>, Bytes, uint32_t, Values);
+
+	template<class T, Encoding E>
+	static void unpacked (add_cref<TexelLayout> l, Bytes dst, uint32_t count, Values src)
+	{
+		add_ptr<T> d = reinterpret_cast<add_ptr<T>>(dst);
+		if (l.identity)
+		{
+			for (uint32_t i = 0u, n = (count * 4u); i < n; ++i)
+				d[i] = fromFloat<T, E>(src[i]);
+			return;
+		}
+		for (uint32_t t = 0u; t < count; ++t, d += l.componentCount, src += 4)
+		{
+			for (uint32_t k = 0u; k < l.componentCount; ++k)
+				d[k] = fromFloat<T, E>(src[l.rgba[k]]);
+		}
+	}
+
+	template<Encoding E>
+	static void packed (add_cref<TexelLayout> l, Bytes dst, uint32_t count, Values src)
+	{
+		for (uint32_t t = 0u; t < count; ++t, dst += l.texelSize, src += 4)
+		{
+			uint32_t texel = 0u;
+			for (uint32_t k = 0u; k < l.componentCount; ++k)
+				texel |= packComponent<E>(src[l.rgba[k]], l.bits[k]) << l.shifts[k];
+			std::memcpy(dst, &texel, l.texelSize);
+		}
+	}
+};
+
+struct ToUint4
+{
+	typedef add_cptr<uint8_t>	Bytes;
+	typedef add_ptr<uint32_t>	Values;
+	typedef void (*Kernel)(add_cref<TexelLayout>, Bytes, uint32_t, Values);
+
+	template<class T, Encoding>
+	static void unpacked (add_cref<TexelLayout> l, Bytes src, uint32_t count, Values dst)
+	{
+		add_cptr<T> s = reinterpret_cast<add_cptr<T>>(src);
+		if (l.identity)
+		{
+			for (uint32_t i = 0u, n = (count * 4u); i < n; ++i)
+				dst[i] = toUint<T>(s[i]);
+			return;
+		}
+		for (uint32_t t = 0u; t < count; ++t, s += l.componentCount, dst += 4)
+		{
+			setDefaults(dst);
+			for (uint32_t k = 0u; k < l.componentCount; ++k)
+				dst[l.rgba[k]] = toUint<T>(s[k]);
+		}
+	}
+
+	template<Encoding E>
+	static void packed (add_cref<TexelLayout> l, Bytes src, uint32_t count, Values dst)
+	{
+		constexpr bool isSigned = (E == Encoding::SNorm || E == Encoding::SInt);
+		for (uint32_t t = 0u; t < count; ++t, src += l.texelSize, dst += 4)
+		{
+			uint32_t texel = 0u;
+			std::memcpy(&texel, src, l.texelSize);
+			setDefaults(dst);
+			for (uint32_t k = 0u; k < l.componentCount; ++k)
+			{
+				const uint32_t raw = (texel >> l.shifts[k]) & ((1u << l.bits[k]) - 1u);
+				dst[l.rgba[k]] = isSigned ? uint32_t(signExtend(raw, l.bits[k])) : raw;
+			}
+		}
+	}
+};
+
+template<class Family, Encoding E, class T8, class T16, class T32, class T64>
+typename Family::Kernel selectUnpacked (uint32_t width)
+{
+	switch (width)
+	{
+	case 8:		return &Family::template unpacked<T8, E>;
+	case 16:	return &Family::template unpacked<T16, E>;
+	case 32:	return &Family::template unpacked<T32, E>;
+	case 64:	return &Family::template unpacked<T64, E>;
+	}
+	ASSERTFALSE("Unsupported component width ", width);
+	return nullptr;
+}
+
+template<class Family>
+typename Family::Kernel selectKernel (add_cref<TexelLayout> l)
+{
+	if (l.packed)
+	{
+		switch (l.encoding)
+		{
+		case Encoding::UNorm:	return &Family::template packed<Encoding::UNorm>;
+		case Encoding::SNorm:	return &Family::template packed<Encoding::SNorm>;
+		case Encoding::UInt:	return &Family::template packed<Encoding::UInt>;
+		case Encoding::SInt:	return &Family::template packed<Encoding::SInt>;
+		case Encoding::UFloat:	return &Family::template packed<Encoding::UFloat>;
+		case Encoding::Float:	break;
+		}
+	}
+	else
+	{
+		switch (l.encoding)
+		{
+		case Encoding::UNorm:	return selectUnpacked<Family, Encoding::UNorm, uint8_t, uint16_t, uint32_t, uint64_t>(l.width);
+		case Encoding::SNorm:	return selectUnpacked<Family, Encoding::SNorm, int8_t, int16_t, int32_t, int64_t>(l.width);
+		case Encoding::UInt:	return selectUnpacked<Family, Encoding::UInt, uint8_t, uint16_t, uint32_t, uint64_t>(l.width);
+		case Encoding::SInt:	return selectUnpacked<Family, Encoding::SInt, int8_t, int16_t, int32_t, int64_t>(l.width);
+		case Encoding::Float:	return selectUnpacked<Family, Encoding::Float, uint8_t, uint16_t, float, double>(l.width);
+		case Encoding::UFloat:	break;
+		}
+	}
+	ASSERTFALSE("Unsupported texel layout");
+	return nullptr;
+}
+
+// Converts rows of texels, the scheduler hands out tiles of rows one by one
+template<class Family>
+struct RegionConverter
+{
+	RegionConverter (add_cref<TexelLayout> layout, typename Family::Bytes bytes, typename Family::Values values,
+					 uint32_t width, uint32_t height, uint32_t total, VkDeviceSize rowPitch)
+		: m_layout		(layout)
+		, m_kernel		(selectKernel<Family>(layout))
+		, m_bytes		(bytes)
+		, m_values		(values)
+		, m_width		(width)
+		, m_height		(height)
+		, m_total		(total)
+		, m_rowPitch	(rowPitch)
+		, m_tileRows	(std::max(1u, (65536u / std::max(1u, width)))) {}
+
+	void convert (uint32_t firstRow, uint32_t lastRow)
+	{
+		for (uint32_t row = firstRow; row < lastRow; ++row)
+		{
+			const uint32_t count = std::min(m_width, (m_total - row * m_width));
+			m_kernel(m_layout, (m_bytes + row * m_rowPitch), count, (m_values + std::size_t(row) * m_width * 4u));
+		}
+	}
+
+	void run (uint32_t threads)
+	{
+		if (1u == threads)
+		{
+			convert(0u, m_height);
+		}
+		else
+		{
+			// The calling thread converts as well
+			TaskScheduler::instance().parallelFor(0u, m_height, m_tileRows,
+				[this](uint32_t first, uint32_t last) { convert(first, last); }, threads);
+		}
+	}
+
+private:
+	const TexelLayout				m_layout;
+	const typename Family::Kernel	m_kernel;
+	const typename Family::Bytes	m_bytes;
+	const typename Family::Values	m_values;
+	const uint32_t					m_width;
+	const uint32_t					m_height;
+	const uint32_t					m_total;
+	const VkDeviceSize				m_rowPitch;
+	const uint32_t					m_tileRows;
+};
+
+} // unnamed namespace
+
+namespace vtf
+{
+
+void formatConvertToFloat4 (VkFormat format, add_cptr<void> src, uint32_t texelCount, add_ptr<float> dst)
+{
+	const TexelLayout layout = makeTexelLayout(format);
+	selectKernel<ToFloat4>(layout)(layout, static_cast<add_cptr<uint8_t>>(src), texelCount, dst);
+}
+
+void formatConvertFromFloat4 (VkFormat format, add_cptr<float> src, uint32_t texelCount, add_ptr<void> dst)
+{
+	const TexelLayout layout = makeTexelLayout(format);
+	selectKernel<FromFloat4>(layout)(layout, static_cast<add_ptr<uint8_t>>(dst), texelCount, src);
+}
+
+void formatConvertToUint4 (VkFormat format, add_cptr<void> src, uint32_t texelCount, add_ptr<uint32_t> dst)
+{
+	const TexelLayout layout = makeTexelLayout(format);
+	ASSERTMSG(layout.packed || Encoding::Float != layout.encoding, "Floating point formats have no integer values");
+	selectKernel<ToUint4>(layout)(layout, static_cast<add_cptr<uint8_t>>(src), texelCount, dst);
+}
+
+void formatConvertRegionToFloat4 (VkFormat format, add_cptr<void> src, uint32_t width, uint32_t height,
+								  VkDeviceSize rowPitch, add_ptr<float> dst, uint32_t threads)
+{
+	const TexelLayout layout = makeTexelLayout(format);
+	ASSERTMSG(rowPitch >= VkDeviceSize(width) * layout.texelSize, "Row pitch must fit a row of texels");
+	RegionConverter<ToFloat4>(layout, static_cast<add_cptr<uint8_t>>(src), dst,
+							  width, height, (width * height), rowPitch).run(threads);
+}
+
+void formatConvertRegionFromFloat4 (VkFormat format, add_cptr<float> src, uint32_t width, uint32_t height,
+									VkDeviceSize rowPitch, add_ptr<void> dst, uint32_t threads)
+{
+	const TexelLayout layout = makeTexelLayout(format);
+	ASSERTMSG(rowPitch >= VkDeviceSize(width) * layout.texelSize, "Row pitch must fit a row of texels");
+	RegionConverter<FromFloat4>(layout, static_cast<add_ptr<uint8_t>>(dst), src,
+								width, height, (width * height), rowPitch).run(threads);
+}
+
+std::vector<Vec4> formatConvertToVec4 (VkFormat format, add_cptr<void> src, uint32_t texelCount, uint32_t threads)
+{
+	static_assert(sizeof(Vec4) == 4u * sizeof(float), "Vec4 must be tightly packed");
+	std::vector<Vec4> result(texelCount);
+	if (0u == texelCount) return result;
+
+	// Consecutive texels are split into artificial rows, so they can be converted in tiles as well
+	const TexelLayout	layout	= makeTexelLayout(format);
+	const uint32_t		width	= std::min(texelCount, 4096u);
+	const uint32_t		height	= ROUNDUP(texelCount, width) / width;
+	RegionConverter<ToFloat4>(layout, static_cast<add_cptr<uint8_t>>(src), reinterpret_cast<add_ptr<float>>(result.data()),
+							  width, height, texelCount, (VkDeviceSize(width) * layout.texelSize)).run(threads);
+	return result;
+}
+
+} // namespace vtf
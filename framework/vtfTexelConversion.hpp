@@ -0,0 +1,40 @@
+#ifndef __VTF_TEXEL_CONVERSION_HPP_INCLUDED__
+#define __VTF_TEXEL_CONVERSION_HPP_INCLUDED__
+
+#include "vtfZDeletable.hpp"
+#include "vtfVector.hpp"
+
+#include <vector>
+
+namespace vtf
+{
+
+/**
+ * Bulk conversion of texels between a format and arrays of 4 values per texel in RGBA order.
+ * The format is examined once per call and a kernel specialized for its component type
+ * is selected, common 8, 16 and 32 bit formats whose components are in RGBA order are
+ * converted as flat arrays, which the compiler vectorizes.
+ * Normalized formats give [0,1] or [-1,1], integer and scaled formats give their values,
+ * sRGB formats are treated as UNORM (no linearization). Missing color components are 0,
+ * missing alpha is 1. Depth formats put depth into R, combined depth/stencil formats are
+ * not supported because their buffer layout depends on the aspect being copied.
+ */
+void	formatConvertToFloat4		(VkFormat format, add_cptr<void> src, uint32_t texelCount, add_ptr<float> dst);
+void	formatConvertFromFloat4		(VkFormat format, add_cptr<float> src, uint32_t texelCount, add_ptr<void> dst);
+// Raw component values of integer formats, signed ones are sign-extended
+void	formatConvertToUint4		(VkFormat format, add_cptr<void> src, uint32_t texelCount, add_ptr<uint32_t> dst);
+
+// Region of width x height texels whose rows start every rowPitch bytes, the other side is tightly packed.
+// Rows are split into tiles converted on the shared TaskScheduler by at most the given number of threads
+// including the calling one, 0 means all of them.
+void	formatConvertRegionToFloat4	(VkFormat format, add_cptr<void> src, uint32_t width, uint32_t height,
+									 VkDeviceSize rowPitch, add_ptr<float> dst, uint32_t threads = 1u);
+void	formatConvertRegionFromFloat4 (VkFormat format, add_cptr<float> src, uint32_t width, uint32_t height,
+									 VkDeviceSize rowPitch, add_ptr<void> dst, uint32_t threads = 1u);
+
+auto	formatConvertToVec4			(VkFormat format, add_cptr<void> src, uint32_t texelCount,
+									 uint32_t threads = 1u) -> std::vector<Vec4>;
+
+} // namespace vtf
+
+#endif // __VTF_TEXEL_CONVERSION_HPP_INCLUDED__
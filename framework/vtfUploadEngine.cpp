@@ -0,0 +1,271 @@
+#include "vtfUploadEngine.hpp"
+#include "vtfBacktrace.hpp"
+#include "vtfCUtils.hpp"
+#include "vtfZUtils.hpp"
+#include "vtfStructUtils.hpp"
+#include "vtfZCommandBuffer.hpp"
+
+#include <cstring>
+#include <iostream>
+
+namespace vtf
+{
+
+UploadEngine::UploadEngine (ZDevice device, ZQueue queue, VkDeviceSize slotSize, uint32_t slotCount)
+	: m_device			(device)
+	, m_commandPool		(createCommandPool(device, queue))
+	, m_slotSize		(slotSize)
+	, m_slots			(slotCount)
+	, m_current			(0u)
+	, m_batchBuffer		()
+	, m_batchImage		()
+	, m_bufferRegions	()
+	, m_imageRegions	()
+{
+	ASSERTMSG(slotSize != 0u && slotCount != 0u, "Slot size and count must not be zero");
+	for (add_ref<Slot> slot : m_slots)
+	{
+		slot.staging		= createBuffer(device, slotSize, ZBufferUsageFlags(VK_BUFFER_USAGE_TRANSFER_SRC_BIT));
+		slot.data			= mapMemory(bufferGetMemory(slot.staging, 0u));
+		slot.commandBuffer	= createCommandBuffer(m_commandPool);
+		slot.fence			= createFence(device);
+		slot.used			= 0u;
+		slot.recording		= false;
+		slot.pending		= false;
+	}
+}
+
+UploadEngine::~UploadEngine ()
+{
+	try
+	{
+		wait();
+	}
+	catch (add_cref<std::exception> e)
+	{
+		std::cout << e.what() << std::endl;
+	}
+}
+
+void UploadEngine::waitSlot (add_ref<Slot> slot)
+{
+	if (slot.pending)
+	{
+		waitForFence(slot.fence);
+		resetFence(slot.fence);
+		slot.pending = false;
+		slot.buffers.clear();
+		slot.images.clear();
+	}
+}
+
+add_ref<UploadEngine::Slot> UploadEngine::currentSlot ()
+{
+	add_ref<Slot> slot = m_slots.at(m_current);
+	if (false == slot.recording)
+	{
+		waitSlot(slot);
+		commandBufferBegin(slot.commandBuffer);
+		// Previous work might still use what is going to be overwritten
+		commandBufferPipelineBarriers(slot.commandBuffer,
+									  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+									  ZMemoryBarrier(VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+													 VK_ACCESS_TRANSFER_WRITE_BIT));
+		slot.used		= 0u;
+		slot.recording	= true;
+	}
+	return slot;
+}
+
+VkDeviceSize UploadEngine::reserve (add_ref<VkDeviceSize> size, VkDeviceSize granularity, VkDeviceSize alignment)
+{
+	VkDeviceSize offset = ROUNDUP(currentSlot().used, alignment);
+	VkDeviceSize fits = (offset < m_slotSize) ? ROUNDDOWN((m_slotSize - offset), granularity) : 0u;
+	if (0u == fits)
+	{
+		submit();
+		offset	= 0u;
+		fits	= ROUNDDOWN(m_slotSize, granularity);
+		ASSERTMSG(fits != 0u, "Slot size ", m_slotSize, " is too small to fit ", granularity, " bytes");
+	}
+	size = std::min(size, fits);
+	currentSlot().used = offset + size;
+	return offset;
+}
+
+void UploadEngine::recordBatch ()
+{
+	add_cref<Slot>				slot	= m_slots.at(m_current);
+	add_cref<ZDeviceInterface>	di		= m_device.getInterface();
+
+	if (false == m_bufferRegions.empty())
+	{
+		VTF_CALL_CHECK(di.vkCmdCopyBuffer, *slot.commandBuffer, *slot.staging, *m_batchBuffer,
+					   data_count(m_bufferRegions), m_bufferRegions.data());
+		m_bufferRegions.clear();
+	}
+	if (false == m_imageRegions.empty())
+	{
+		VTF_CALL_CHECK(di.vkCmdCopyBufferToImage, *slot.commandBuffer, *slot.staging, *m_batchImage,
+					   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, data_count(m_imageRegions), m_imageRegions.data());
+		m_imageRegions.clear();
+	}
+	m_batchBuffer	= ZBuffer();
+	m_batchImage	= ZImage();
+}
+
+void UploadEngine::upload (ZBuffer dst, VkDeviceSize dstOffset, add_cptr<void> src, VkDeviceSize size)
+{
+	ASSERTMSG((dstOffset + size) <= bufferGetSize(dst), "Too long data requested to upload to buffer");
+	add_cptr<uint8_t> bytes = static_cast<add_cptr<uint8_t>>(src);
+
+	while (size)
+	{
+		VkDeviceSize		chunk	= size;
+		const VkDeviceSize	offset	= reserve(chunk, 1u, 4u);
+		add_ref<Slot>		slot	= currentSlot();
+
+		std::memcpy(slot.data + offset, bytes, std::size_t(chunk));
+		if (false == m_batchBuffer.has_handle() || false == (m_batchBuffer == dst))
+		{
+			recordBatch();
+			m_batchBuffer = dst;
+			slot.buffers.push_back(dst);
+		}
+		m_bufferRegions.push_back({ offset, dstOffset, chunk });
+
+		bytes		+= chunk;
+		dstOffset	+= chunk;
+		size		-= chunk;
+	}
+}
+
+void UploadEngine::upload (ZImage dst, add_cptr<void> src, VkDeviceSize size, VkImageLayout finalLayout,
+						   uint32_t baseLevel, uint32_t levelCount, uint32_t baseLayer, uint32_t layerCount)
+{
+	add_cref<VkImageCreateInfo>	createInfo	= imageGetCreateInfo(dst);
+	ASSERTMSG((baseLevel + levelCount) <= createInfo.mipLevels, "Mip levels exceed available image mip levels");
+	ASSERTMSG((baseLayer + layerCount) <= createInfo.arrayLayers, "Layers exceed available image array layers");
+	ASSERTMSG((imageCalcMipLevelsSize(dst, baseLevel, levelCount) * layerCount) <= size, "Data must cover image levels and layers");
+
+	const VkDeviceSize			pixelSize	= computePixelByteSize(createInfo.format);
+	const VkImageAspectFlags	aspect		= formatGetAspectMask(createInfo.format);
+	// A buffer to image copy addresses exactly one aspect and packs depth and stencil differently than the image
+	ASSERTMSG(0u == (aspect & (aspect - 1u)), "Combined depth/stencil formats can't be uploaded at once");
+	const VkImageLayout			savedLayout	= imageGetLayout(dst);
+	add_cptr<uint8_t>			bytes		= static_cast<add_cptr<uint8_t>>(src);
+
+	recordBatch();
+	ZImageMemoryBarrier preBarrier = makeImageMemoryBarrier(dst,
+		VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	commandBufferPipelineBarriers(currentSlot().commandBuffer,
+								  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, preBarrier);
+
+	for (uint32_t layer = 0u; layer < layerCount; ++layer)
+	for (uint32_t level = 0u; level < levelCount; ++level)
+	{
+		uint32_t width = 0u, height = 0u;
+		std::tie(width, height) = computeMipLevelWidthAndHeight(createInfo.extent.width, createInfo.extent.height, baseLevel + level);
+		const uint32_t		depth	= std::max(1u, (createInfo.extent.depth >> (baseLevel + level)));
+		const VkDeviceSize	rowSize	= width * pixelSize;
+
+		// A region never crosses a slice, the rows of a slice may be split into several slots
+		for (uint32_t row = 0u; row < (height * depth);)
+		{
+			const uint32_t		y		= row % height;
+			VkDeviceSize		chunk	= (height - y) * rowSize;
+			const VkDeviceSize	offset	= reserve(chunk, rowSize, (pixelSize * 4u));
+			const uint32_t		rows	= uint32_t(chunk / rowSize);
+			add_ref<Slot>		slot	= currentSlot();
+
+			std::memcpy(slot.data + offset, bytes, std::size_t(chunk));
+			if (false == m_batchImage.has_handle() || false == (m_batchImage == dst))
+			{
+				recordBatch();
+				m_batchImage = dst;
+				slot.images.push_back(dst);
+			}
+
+			VkBufferImageCopy rgn{};
+			rgn.bufferOffset					= offset;
+			rgn.bufferRowLength					= 0u;
+			rgn.bufferImageHeight				= 0u;
+			rgn.imageSubresource.aspectMask		= aspect;
+			rgn.imageSubresource.mipLevel		= baseLevel + level;
+			rgn.imageSubresource.baseArrayLayer	= baseLayer + layer;
+			rgn.imageSubresource.layerCount		= 1u;
+			rgn.imageOffset						= { 0, int32_t(y), int32_t(row / height) };
+			rgn.imageExtent						= { width, rows, 1u };
+			m_imageRegions.push_back(rgn);
+
+			bytes	+= chunk;
+			row		+= rows;
+		}
+	}
+
+	recordBatch();
+	ZImageMemoryBarrier postBarrier = makeImageMemoryBarrier(dst,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+		(finalLayout == VK_IMAGE_LAYOUT_UNDEFINED) ? savedLayout : finalLayout);
+	commandBufferPipelineBarriers(currentSlot().commandBuffer,
+								  VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, postBarrier);
+}
+
+ZCommandBuffer UploadEngine::commandBuffer ()
+{
+	add_ref<Slot> slot = currentSlot();
+	recordBatch();
+	return slot.commandBuffer;
+}
+
+void UploadEngine::keepAlive (ZBuffer buffer)
+{
+	currentSlot().buffers.push_back(buffer);
+}
+
+void UploadEngine::keepAlive (ZImage image)
+{
+	currentSlot().images.push_back(image);
+}
+
+void UploadEngine::submit ()
+{
+	add_ref<Slot> slot = m_slots.at(m_current);
+	if (false == slot.recording) return;
+
+	recordBatch();
+	commandBufferPipelineBarriers(slot.commandBuffer,
+								  VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+								  ZMemoryBarrier(VK_ACCESS_TRANSFER_WRITE_BIT,
+												 VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT));
+	commandBufferEnd(slot.commandBuffer);
+
+	if (slot.used)
+	{
+		ZDeviceMemory memory = bufferGetMemory(slot.staging, 0u);
+		markMemoryDirty(memory, 0u, slot.used);
+		flushMemory(std::vector<ZDeviceMemory>{ memory });
+	}
+
+	VkSubmitInfo submitInfo = makeVkStruct();
+	submitInfo.commandBufferCount	= 1u;
+	submitInfo.pCommandBuffers		= slot.commandBuffer.ptr();
+
+	add_cref<ZDeviceInterface> di = m_device.getInterface();
+	VKASSERT(VTF_CALL_CHECK(di.vkQueueSubmit, *m_commandPool.getParam<ZQueue>(), 1u, &submitInfo, *slot.fence));
+
+	slot.recording	= false;
+	slot.pending	= true;
+	m_current		= (m_current + 1u) % data_count(m_slots);
+}
+
+void UploadEngine::wait ()
+{
+	submit();
+	for (add_ref<Slot> slot : m_slots)
+	{
+		waitSlot(slot);
+	}
+}
+
+} // namespace vtf
@@ -0,0 +1,96 @@
+#ifndef __VTF_UPLOAD_ENGINE_HPP_INCLUDED__
+#define __VTF_UPLOAD_ENGINE_HPP_INCLUDED__
+
+#include "vtfZDeletable.hpp"
+#include "vtfCUtils.hpp"
+#include "vtfZBuffer.hpp"
+#include "vtfZImage.hpp"
+
+#include <vector>
+
+namespace vtf
+{
+
+/**
+ * @brief Streams host data into device local buffers and images.
+ * @note  Data is written into a ring of host visible staging buffers (slots), each slot
+ *        has its own command buffer and fence. When a slot is full it is submitted without
+ *        waiting and the next one is filled in the meantime, the host waits only when it
+ *        wraps around to a slot whose copies have not completed yet. Consecutive regions
+ *        of the same destination are recorded with a single vkCmdCopyBuffer or
+ *        vkCmdCopyBufferToImage. Destinations are kept alive until their copies complete.
+ *        The engine is not thread safe, use one per thread.
+ */
+class UploadEngine
+{
+public:
+	UploadEngine	(ZDevice device, ZQueue queue, VkDeviceSize slotSize = 1048576u, uint32_t slotCount = 3u);
+	UploadEngine	(const UploadEngine&) = delete;
+	UploadEngine&	operator=(const UploadEngine&) = delete;
+	// Waits until everything has been copied
+	~UploadEngine	();
+
+	void upload (ZBuffer dst, VkDeviceSize dstOffset, add_cptr<void> src, VkDeviceSize size);
+	template<class X>
+	void upload (ZBuffer dst, add_cref<std::vector<X>> src, uint32_t dstIndex = 0u);
+	// Data is tightly packed texels of consecutive mip levels of each layer, the same as bufferCopyToImage() expects.
+	// The format must have a single aspect, combined depth/stencil images are not supported.
+	void upload (ZImage dst, add_cptr<void> src, VkDeviceSize size,
+				 VkImageLayout finalLayout = VK_IMAGE_LAYOUT_GENERAL,
+				 uint32_t baseLevel = 0u, uint32_t levelCount = 1u,
+				 uint32_t baseLayer = 0u, uint32_t layerCount = 1u);
+
+	// Command buffer of the current slot for recording own transfer commands, they are ordered
+	// after all the uploads made so far. Resources used by them must be retained by keepAlive().
+	ZCommandBuffer	commandBuffer	();
+	void			keepAlive		(ZBuffer buffer);
+	void			keepAlive		(ZImage image);
+
+	// Submits the recorded copies without waiting for them
+	void submit	();
+	// Submits the recorded copies and waits until all of them have completed
+	void wait	();
+
+	ZDevice			device		() const { return m_device; }
+	VkDeviceSize	slotSize	() const { return m_slotSize; }
+
+private:
+	struct Slot
+	{
+		ZBuffer				staging;
+		add_ptr<uint8_t>	data;
+		ZCommandBuffer		commandBuffer;
+		ZFence				fence;
+		VkDeviceSize		used;
+		bool				recording;
+		bool				pending;
+		std::vector<ZBuffer>	buffers;
+		std::vector<ZImage>		images;
+	};
+	add_ref<Slot>	currentSlot		();
+	// Returns an offset within the current slot and trims the size to a multiple of granularity
+	// that fits there, the current slot is submitted if not even one granule fits
+	VkDeviceSize	reserve			(add_ref<VkDeviceSize> size, VkDeviceSize granularity, VkDeviceSize alignment);
+	void			waitSlot		(add_ref<Slot> slot);
+	void			recordBatch		();
+
+	const ZDevice					m_device;
+	const ZCommandPool				m_commandPool;
+	const VkDeviceSize				m_slotSize;
+	std::vector<Slot>				m_slots;
+	uint32_t						m_current;
+	ZBuffer							m_batchBuffer;
+	ZImage							m_batchImage;
+	std::vector<VkBufferCopy>		m_bufferRegions;
+	std::vector<VkBufferImageCopy>	m_imageRegions;
+};
+
+template<class X>
+void UploadEngine::upload (ZBuffer dst, add_cref<std::vector<X>> src, uint32_t dstIndex)
+{
+	upload(dst, VkDeviceSize(dstIndex) * sizeof(X), src.data(), data_byte_length(src));
+}
+
+} // namespace vtf
+
+#endif // __VTF_UPLOAD_ENGINE_HPP_INCLUDED__
@@ -146,7 +146,6 @@ VertexBinding::Location VertexBinding::addAttributes_ (const AttrFwd* fwd, const
 	const ZBufferUsageFlags		usage		= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
 	const ZMemoryPropertyFlags	props		(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 	ZDevice						device		= vertexInput.device;
-	add_cref<ZDeviceInterface>	di			= device.getInterface();
 	const Location				location	= static_cast<Location>(m_descriptions.size());
 	uint32_t					offset		= m_descriptions.empty() ? 0 : (m_descriptions.back().offset + m_descriptions.back().sizeOf);
 
@@ -179,15 +178,12 @@ VertexBinding::Location VertexBinding::addAttributes_ (const AttrFwd* fwd, const
 	const uint8_t*		inputSource		= nullptr;
 
 	ZDeviceMemory	newMemory	= bufferGetMemory(newBuffer, 0u);
-	VKASSERT(VTF_CALL_CHECK(di.vkMapMemory,
-        *device, *newMemory, 0u, newBufferSize, (VkMemoryMapFlags)0, reinterpret_cast<void**>(&dst)));
+	dst = mapMemory(newMemory);
 
 	if (oldStride)
 	{
-		const VkDeviceSize	oldBufferSize	= elementCount * oldStride;
 		ZDeviceMemory oldMemory = bufferGetMemory(m_buffer, 0u);
-		VKASSERT(VTF_CALL_CHECK(di.vkMapMemory,
-            *device, *oldMemory, 0u, oldBufferSize, (VkMemoryMapFlags)0, reinterpret_cast<void**>(&bindingSource)));
+		bindingSource = mapMemory(oldMemory);
 
 		/*
 		VkMappedMemoryRange	range{};
@@ -234,12 +230,12 @@ VertexBinding::Location VertexBinding::addAttributes_ (const AttrFwd* fwd, const
 	range.size		= newBufferSize;
 	VKASSERT2(vkFlushMappedMemoryRanges(*device, 1, &range));
 	*/
-	VTF_CALL_CHECK(di.vkUnmapMemory, *device, *newMemory);
+	unmapMemory(newMemory);
 
 	if (oldStride)
 	{
 		ZDeviceMemory oldMemory = bufferGetMemory(m_buffer, 0u);
-		VTF_CALL_CHECK(di.vkUnmapMemory, *device, *oldMemory);
+		unmapMemory(oldMemory);
 	}
 
 	this->stride = newStride;
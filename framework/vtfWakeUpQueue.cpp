@@ -0,0 +1,142 @@
+#include "vtfWakeUpQueue.hpp"
+#include "GLFW/glfw3.h"
+
+#include <algorithm>
+#include <optional>
+#include <thread>
+
+namespace vtf
+{
+
+WakeUpQueue::WakeUpQueue (bool glfwEvents)
+	: m_glfwEvents		(glfwEvents)
+	, m_tasksMutex		()
+	, m_tasks			()
+	, m_onTimer			()
+	, m_timerPeriodMS	(0u)
+	, m_timerDeadline	()
+	, m_watchedFiles	()
+	, m_watchDeadline	()
+{
+}
+
+void WakeUpQueue::postTask (OnWakeUp task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_tasksMutex);
+		m_tasks.push_back(task);
+	}
+	wakeUp();
+}
+
+void WakeUpQueue::wakeUp ()
+{
+	// The empty event stays queued, so a loop which is just about to wait does not miss it
+	if (m_glfwEvents) glfwPostEmptyEvent();
+}
+
+void WakeUpQueue::setTimer (uint32_t periodMS, OnWakeUp onTimer)
+{
+	m_onTimer		= periodMS ? onTimer : OnWakeUp();
+	m_timerPeriodMS	= periodMS;
+	m_timerDeadline	= clock::now() + std::chrono::milliseconds(periodMS);
+}
+
+void WakeUpQueue::watchFile (const std::string& fileName, OnWakeUp onChange)
+{
+	std::error_code error;
+	const fs::file_time_type lastWrite = fs::last_write_time(fileName, error);
+	m_watchedFiles.push_back({ fileName, (error ? fs::file_time_type::min() : lastWrite), onChange });
+	m_watchDeadline = clock::now() + std::chrono::milliseconds(WatchPeriodMS);
+}
+
+bool WakeUpQueue::dispatch ()
+{
+	bool dispatched = false;
+	std::vector<OnWakeUp> tasks;
+	{
+		std::lock_guard<std::mutex> lock(m_tasksMutex);
+		tasks.swap(m_tasks);
+	}
+	for (const OnWakeUp& task : tasks)
+	{
+		task();
+		dispatched = true;
+	}
+
+	const clock::time_point now = clock::now();
+	if (m_onTimer && now >= m_timerDeadline)
+	{
+		do m_timerDeadline += std::chrono::milliseconds(m_timerPeriodMS);
+		while (m_timerDeadline <= now);
+		// The timer may replace itself
+		const OnWakeUp onTimer = m_onTimer;
+		onTimer();
+		dispatched = true;
+	}
+
+	if (false == m_watchedFiles.empty() && now >= m_watchDeadline)
+	{
+		m_watchDeadline = now + std::chrono::milliseconds(WatchPeriodMS);
+		// Callbacks may watch further files
+		for (std::size_t i = 0u; i < m_watchedFiles.size(); ++i)
+		{
+			std::error_code error;
+			const fs::file_time_type lastWrite = fs::last_write_time(m_watchedFiles[i].fileName, error);
+			if (!error && lastWrite != m_watchedFiles[i].lastWrite)
+			{
+				m_watchedFiles[i].lastWrite = lastWrite;
+				const OnWakeUp onChange = m_watchedFiles[i].onChange;
+				onChange();
+				dispatched = true;
+			}
+		}
+	}
+
+	return dispatched;
+}
+
+double WakeUpQueue::timeout (uint32_t idleTimeoutMS) const
+{
+	const clock::time_point now = clock::now();
+	std::optional<clock::time_point> deadline;
+	auto nearest = [&](clock::time_point point)
+	{
+		if (!deadline || point < *deadline) deadline = point;
+	};
+	if (idleTimeoutMS != NoTimeout) nearest(now + std::chrono::milliseconds(idleTimeoutMS));
+	if (m_onTimer) nearest(m_timerDeadline);
+	if (false == m_watchedFiles.empty()) nearest(m_watchDeadline);
+
+	return deadline ? std::max(0.0, std::chrono::duration<double>(*deadline - now).count()) : -1.0;
+}
+
+void WakeUpQueue::waitEvents (double seconds) const
+{
+	if (seconds < 0.0)
+		glfwWaitEvents();
+	else if (seconds > 0.0)
+		glfwWaitEventsTimeout(seconds);
+	else
+		glfwPollEvents();
+}
+
+void WakeUpQueue::wait (uint32_t idleTimeoutMS) const
+{
+	if (m_glfwEvents) waitEvents(timeout(idleTimeoutMS));
+}
+
+bool WakeUpQueue::sleepUntil (clock::time_point point, const std::function<bool ()>& stop) const
+{
+	for (clock::time_point now = clock::now(); now < point; now = clock::now())
+	{
+		if (stop()) return false;
+		if (m_glfwEvents)
+			waitEvents(std::chrono::duration<double>(point - now).count());
+		else
+			std::this_thread::sleep_until(point);
+	}
+	return false == stop();
+}
+
+} // namespace vtf
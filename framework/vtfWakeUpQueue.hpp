@@ -0,0 +1,73 @@
+#ifndef __VTF_WAKE_UP_QUEUE_HPP_INCLUDED__
+#define __VTF_WAKE_UP_QUEUE_HPP_INCLUDED__
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "vtfFilesystem.hpp"
+
+namespace vtf
+{
+
+/**
+ * @brief Everything besides GLFW events that wakes up an event loop which sleeps, see Canvas::run().
+ * @note  postTask() and wakeUp() may be called from any thread, they break waiting with
+ *        glfwPostEmptyEvent(). The timer and watched files belong to the thread of the loop.
+ *        GLFW has no file notifications, so watched files are polled by their modification
+ *        time every WatchPeriodMS. Without GLFW events (headless) nothing waits for events,
+ *        sleepUntil() just sleeps then.
+ */
+class WakeUpQueue
+{
+public:
+	typedef std::function<void ()>		OnWakeUp;
+	typedef std::chrono::steady_clock	clock;
+	static constexpr uint32_t			WatchPeriodMS	= 250u;
+	static constexpr uint32_t			NoTimeout		= UINT32_MAX;
+
+	WakeUpQueue		(bool glfwEvents);
+	WakeUpQueue		(const WakeUpQueue&) = delete;
+	WakeUpQueue&	operator=(const WakeUpQueue&) = delete;
+
+	void	postTask	(OnWakeUp task);
+	void	wakeUp		();
+	// Zero period removes the timer, missed periods are not caught up
+	void	setTimer	(uint32_t periodMS, OnWakeUp onTimer);
+	// A file that does not exist yet is reported once it appears
+	void	watchFile	(const std::string& fileName, OnWakeUp onChange);
+
+	// Calls posted tasks, the timer and watched files that are due, returns true if anything has been called
+	bool	dispatch	();
+	// Waits for GLFW events until the nearest wake up or idleTimeoutMS, whichever comes first
+	void	wait		(uint32_t idleTimeoutMS = NoTimeout) const;
+	// Handles GLFW events until the point in time, returns false if stop() has said so before
+	bool	sleepUntil	(clock::time_point point, const std::function<bool ()>& stop) const;
+
+private:
+	struct WatchedFile
+	{
+		std::string				fileName;
+		fs::file_time_type		lastWrite;
+		OnWakeUp				onChange;
+	};
+	// Seconds until the nearest wake up, negative if there is none
+	double	timeout		(uint32_t idleTimeoutMS) const;
+	void	waitEvents	(double timeout) const;
+
+	const bool					m_glfwEvents;
+	std::mutex					m_tasksMutex;
+	std::vector<OnWakeUp>		m_tasks;
+	OnWakeUp					m_onTimer;
+	uint32_t					m_timerPeriodMS;
+	clock::time_point			m_timerDeadline;
+	std::vector<WatchedFile>	m_watchedFiles;
+	clock::time_point			m_watchDeadline;
+};
+
+} // namespace vtf
+
+#endif // __VTF_WAKE_UP_QUEUE_HPP_INCLUDED__
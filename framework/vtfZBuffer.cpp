@@ -7,6 +7,8 @@
 #include "vtfZCommandBuffer.hpp"
 #include "vtfZImage.hpp"
 #include "vtfFilesystem.hpp"
+#include "vtfUploadEngine.hpp"
+#include "vtfTexelConversion.hpp"
 #include "vtfZBuffer.hpp"
 #include "vtfFormatUtils.hpp"
 #include "vtfCopyUtils.hpp"
@@ -61,7 +63,7 @@ static ZBuffer	createBuffer (ZDevice					device,
 	if (false == sparse)
 	{
 		for (add_ref<ZDeviceMemory> alloc : allocations)
-			VKASSERT(VTF_CALL_CHECK(di.vkBindBufferMemory, *device, handle, *alloc, 0u));
+			VKASSERT(VTF_CALL_CHECK(di.vkBindBufferMemory, *device, handle, *alloc, getMemoryOffset(alloc)));
 	}
 
 	return ZBuffer::create(handle, device, callbacks, bufferInfo, allocations, size, type, extent, format);
@@ -198,34 +200,26 @@ ZBuffer bufferDuplicate (ZBuffer buffer)
 
 void bufferWriteData (ZBuffer buffer, add_cptr<uint8_t> src, add_cref<VkBufferCopy> copy, bool flush)
 {
-	ZDevice					device = buffer.getParam<ZDevice>();
-	add_cref<ZDeviceInterface> di = device.getInterface();
 	ZDeviceMemory			memory = bufferGetMemory(buffer, 0);
-	VkMemoryPropertyFlags	props = memory.getParam<VkMemoryPropertyFlags>();
 	const VkDeviceSize		bufferSize = buffer.getParam<VkDeviceSize>();
 
 	ASSERTION(copy.size > 0);
 	ASSERTION(copy.dstOffset < bufferSize);
 	ASSERTION((copy.dstOffset + copy.size) <= bufferSize);
 
-	uint8_t* dst = nullptr;
-	VKASSERT(VTF_CALL_CHECK(di.vkMapMemory,
-		*device, *memory, copy.dstOffset, copy.size, (VkMemoryMapFlags)0, reinterpret_cast<void**>(&dst)));
+	// The memory stays mapped, if not flushed now the written range is remembered for bufferFlush()
+	uint8_t* dst = mapMemory(memory);
 	ASSERTION(dst != nullptr);
 
-	std::copy(src + copy.srcOffset, src + copy.srcOffset + copy.size, dst);
+	std::copy(src + copy.srcOffset, src + copy.srcOffset + copy.size, dst + copy.dstOffset);
 
-	if (flush && ((props & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+	if (false == isMemoryCoherent(memory))
 	{
-		VkMappedMemoryRange	range{};
-		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		range.memory = *memory;
-		range.offset = copy.dstOffset;
-		range.size = copy.size;
-        VKASSERT(VTF_CALL_CHECK(di.vkFlushMappedMemoryRanges, *device, 1u, &range));
+		if (flush)
+			flushMemory(memory, copy.dstOffset, copy.size);
+		else
+			markMemoryDirty(memory, copy.dstOffset, copy.size);
 	}
-
-	VTF_CALL_CHECK(di.vkUnmapMemory, *device, *memory);
 }
 
 VkDeviceSize bufferWriteData (
@@ -278,33 +272,46 @@ VkDeviceSize bufferWriteData (ZBuffer buffer, const uint8_t * src, VkDeviceSize
 	return size;
 }
 
-ZBuffer createBufferAndLoadFromImageFile (ZDevice device, add_cref<std::string> imageFileName,
-										  ZBufferUsageFlags usage, int desiredChannelCount)
+typedef std::unique_ptr<stbi_uc, void(*)(routine_res_t<decltype(stbi_load)>)> ImageFileData;
+static ImageFileData loadImageFile (add_cref<std::string> imageFileName, int desiredChannelCount,
+									add_ref<VkFormat> format, add_ref<uint32_t> width, add_ref<uint32_t> height)
 {
-	VkFormat	format;
-	uint32_t	width, height;
 	std::remove_pointer_t<routine_arg_t<decltype(stbi_load), 1>>	sinkWidth	= 0;
 	std::remove_pointer_t<routine_arg_t<decltype(stbi_load), 2>>	sinkHeight	= 0;
 	std::remove_pointer_t<routine_arg_t<decltype(stbi_load), 3>>	sinkNcomp	= 0;
 
 	ASSERTION(readImageFileMetadata(imageFileName, format, width, height, desiredChannelCount));
 
-	const uint32_t pixelCount = width * height;
+	routine_res_t<decltype(stbi_load)> data = stbi_load(imageFileName.c_str(), &sinkWidth, &sinkHeight, &sinkNcomp,
+														desiredChannelCount);
+	static_assert(std::is_pointer<decltype(data)>::value, "");
+	ASSERTION(make_unsigned(sinkWidth) <= width && make_unsigned(sinkHeight) <= height);
+	ASSERTION(data);
+	return ImageFileData(data, [](auto ptr){ stbi_image_free(ptr); });
+}
 
-	ZBuffer		buffer = createBuffer(device, format,
-									  pixelCount, usage, ZMemoryPropertyHostFlags, ZBufferCreateFlags());
+static void bufferSetImageExtent (ZBuffer buffer, uint32_t width, uint32_t height)
+{
 	buffer.setParam<type_index_with_default>(type_index_with_default::make<std::string>());
 	add_ref<VkExtent3D> extent = buffer.getParamRef<VkExtent3D>();
 	extent.width	= width;
 	extent.height	= height;
 	extent.depth	= 1u;
+}
+
+ZBuffer createBufferAndLoadFromImageFile (ZDevice device, add_cref<std::string> imageFileName,
+										  ZBufferUsageFlags usage, int desiredChannelCount)
+{
+	VkFormat	format;
+	uint32_t	width, height;
+	ImageFileData k = loadImageFile(imageFileName, desiredChannelCount, format, width, height);
+
+	const uint32_t pixelCount = width * height;
+
+	ZBuffer		buffer = createBuffer(device, format,
+									  pixelCount, usage, ZMemoryPropertyHostFlags, ZBufferCreateFlags());
+	bufferSetImageExtent(buffer, width, height);
 
-	routine_res_t<decltype(stbi_load)> data = stbi_load(imageFileName.c_str(), &sinkWidth, &sinkHeight, &sinkNcomp,
-														desiredChannelCount);
-	static_assert(std::is_pointer<decltype(data)>::value, "");
-	ASSERTION(make_unsigned(sinkWidth) <= width && make_unsigned(sinkHeight) <= height);
-	ASSERTION(data);
-	std::unique_ptr<stbi_uc, void(*)(routine_res_t<decltype(stbi_load)>)> k(data, [](auto ptr){ stbi_image_free(ptr); });
 	add_ptr<uint8_t> ptrData = static_cast<add_ptr<uint8_t>>(static_cast<add_ptr<void>>(k.get()));
 
 	bufferWriteData(buffer, ptrData, VK_WHOLE_SIZE);
@@ -313,6 +320,22 @@ ZBuffer createBufferAndLoadFromImageFile (ZDevice device, add_cref<std::string>
 	return buffer;
 }
 
+ZBuffer createBufferAndLoadFromImageFile (add_ref<UploadEngine> engine, add_cref<std::string> imageFileName,
+										  ZBufferUsageFlags usage, int desiredChannelCount)
+{
+	VkFormat	format;
+	uint32_t	width, height;
+	ImageFileData k = loadImageFile(imageFileName, desiredChannelCount, format, width, height);
+
+	ZBuffer		buffer = createBuffer(engine.device(), format, (width * height),
+									  usage, ZMemoryPropertyDeviceFlags, ZBufferCreateFlags());
+	bufferSetImageExtent(buffer, width, height);
+
+	engine.upload(buffer, 0u, k.get(), bufferGetSize(buffer));
+
+	return buffer;
+}
+
 VkDeviceSize bufferReadData (ZBuffer buffer, uint8_t* dst, VkDeviceSize size)
 {
 	const VkDeviceSize		bufferSize	= buffer.getParam<VkDeviceSize>();
@@ -333,58 +356,42 @@ VkDeviceSize bufferReadData (ZBuffer buffer, uint8_t* dst, const VkBufferCopy& c
 	if (copy.size == 0u) return copy.size;
 
 	ZDeviceMemory			memory		= bufferGetMemory(buffer, 0);
-	VkMemoryPropertyFlags	props		= memory.getParam<VkMemoryPropertyFlags>();
-	ZDevice					device		= buffer.getParam<ZDevice>();
-	add_cref<ZDeviceInterface> di		= device.getInterface();
 	const VkDeviceSize		bufferSize	= buffer.getParam<VkDeviceSize>();
 
 	ASSERTMSG(copy.srcOffset < bufferSize, "Too long data requested to copy from buffer");
 	ASSERTMSG((copy.srcOffset + copy.size) <= bufferSize, "Too long data requested to copy from buffer");
 
-	uint8_t* src = nullptr;
-	VKASSERT(VTF_CALL_CHECK(di.vkMapMemory,
-		*device, *memory, copy.srcOffset, copy.size, (VkMemoryMapFlags)0, reinterpret_cast<void**>(&src)));
+	uint8_t* src = mapMemory(memory) + copy.srcOffset;
 
-	if ((props & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	if (false == isMemoryCoherent(memory))
 	{
-		VkMappedMemoryRange	range{};
-		range.sType		= VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		range.memory	= *memory;
-		range.offset	= copy.srcOffset;
-		range.size		= copy.size;
-        VKASSERT(VTF_CALL_CHECK(di.vkInvalidateMappedMemoryRanges, *device, 1u, &range));
+		invalidateMemory(memory, copy.srcOffset, copy.size);
 	}
 
 	std::copy(src, std::next(src, make_signed(copy.size)), dst);
-	VTF_CALL_CHECK(di.vkUnmapMemory, *device, *memory);
 
 	return static_cast<uint32_t>(copy.size);
 }
 
 void bufferFlush (ZBuffer buffer)
 {
-	ZDevice					device		= buffer.getParam<ZDevice>();
-	add_cref<ZDeviceInterface> di		= device.getInterface();
-	ZDeviceMemory			memory		= bufferGetMemory(buffer, 0);
-	VkMemoryPropertyFlags	props		= memory.getParam<VkMemoryPropertyFlags>();
-	if (!(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT & props))
-	{
-		const VkDeviceSize	bufferSize	= buffer.getParam<VkDeviceSize>();
-
-		VkMappedMemoryRange	range{};
-		range.sType		= VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		range.memory	= *memory;
-		range.offset	= 0;
-		range.size		= VK_WHOLE_SIZE;
-
-		void* dst = nullptr;
-        VKASSERT(VTF_CALL_CHECK(di.vkMapMemory, *device, *memory, 0u, bufferSize, (VkMemoryMapFlags)0, &dst));
-		ASSERTION(dst != nullptr);
+	flushMemory(std::vector<ZDeviceMemory>{ bufferGetMemory(buffer, 0) });
+}
 
-        VKASSERT(VTF_CALL_CHECK(di.vkFlushMappedMemoryRanges, *device, 1u, &range));
+void bufferFlush (add_cref<std::vector<ZBuffer>> buffers)
+{
+	std::vector<ZDeviceMemory> memories(buffers.size());
+	std::transform(buffers.begin(), buffers.end(), memories.begin(),
+				   [](add_cref<ZBuffer> buffer) { return bufferGetMemory(buffer, 0); });
+	flushMemory(memories);
+}
 
-		VTF_CALL_CHECK(di.vkUnmapMemory, *device, *memory);
-	}
+void bufferInvalidate (add_cref<std::vector<ZBuffer>> buffers)
+{
+	std::vector<ZDeviceMemory> memories(buffers.size());
+	std::transform(buffers.begin(), buffers.end(), memories.begin(),
+				   [](add_cref<ZBuffer> buffer) { return bufferGetMemory(buffer, 0); });
+	invalidateMemory(memories);
 }
 
 VkDeviceSize bufferGetSize (ZBuffer buffer)
@@ -570,6 +577,21 @@ void	bufferCopyToImage	(ZCommandBuffer cmdBuffer, ZBuffer buffer, ZImage image,
 }
 
 
+void	bufferCopyToImage	(add_ref<UploadEngine> engine, ZBuffer buffer, ZImage image,
+							 VkImageLayout finalImageLayout,
+							 uint32_t baseLevel, uint32_t levelCount,
+							 uint32_t baseLayer, uint32_t layerCount)
+{
+	engine.keepAlive(buffer);
+	engine.keepAlive(image);
+	bufferCopyToImage(engine.commandBuffer(), buffer, image,
+					  (VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT), VK_ACCESS_NONE,
+					  (VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT),
+					  (VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT),
+					  (VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_ALL_COMMANDS_BIT), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+					  finalImageLayout, baseLevel, levelCount, baseLayer, layerCount);
+}
+
 namespace namespace_hidden
 {
 BufferTexelAccess_::BufferTexelAccess_ (ZBuffer buffer, uint32_t elementSize,
@@ -592,15 +614,21 @@ BufferTexelAccess_::BufferTexelAccess_ (ZBuffer buffer, uint32_t elementSize,
 	const VkMemoryPropertyFlags	flags = bufferGetMemory(buffer, 0u).getParam<VkMemoryPropertyFlags>();
 	ASSERTION(flags & (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
 
-	ZDevice device = buffer.getParam<ZDevice>();
-	add_cref<ZDeviceInterface> di = device.getInterface();
-	VKASSERT(VTF_CALL_CHECK(di.vkMapMemory, *device, *buffer.getParam<std::vector<ZDeviceMemory>>().front(),
-						  0u, bufferGetMemorySize(buffer), (VkMemoryMapFlags)0, reinterpret_cast<void**>(&m_data)));
+	ZDeviceMemory memory = bufferGetMemory(buffer, 0u);
+	m_data = mapMemory(memory);
+	if (false == isMemoryCoherent(memory))
+	{
+		invalidateMemory(memory);
+	}
 }
 BufferTexelAccess_::~BufferTexelAccess_ ()
 {
-	add_cref<ZDeviceInterface> di = m_buffer.getParam<ZDevice>().getInterface();
-	VTF_CALL_CHECK(di.vkUnmapMemory, *m_buffer.getParam<ZDevice>(), *m_buffer.getParam<std::vector<ZDeviceMemory>>().front());
+	ZDeviceMemory memory = bufferGetMemory(m_buffer, 0u);
+	if (false == isMemoryCoherent(memory))
+	{
+		markMemoryDirty(memory, 0u, VK_WHOLE_SIZE);
+		flushMemory(std::vector<ZDeviceMemory>{ memory });
+	}
 }
 add_ptr<void> BufferTexelAccess_::at (uint32_t x, uint32_t y, uint32_t z)
 {
@@ -725,6 +753,12 @@ Vec4 BufferTexelAccess_::asColor (VkFormat format, uint32_t x, uint32_t y, uint3
 	return result;
 }
 
+std::vector<Vec4> BufferTexelAccess_::asColors (VkFormat format, uint32_t threads) const
+{
+	ASSERTMSG(formatGetInfo(format).pixelByteSize == m_elementSize, "Format must match the element size");
+	return formatConvertToVec4(format, at(0u, 0u, 0u), m_size.prod(), threads);
+}
+
 } // namespace_hidden
 
 } // namespace vtf
@@ -13,6 +13,8 @@
 namespace vtf
 {
 
+class UploadEngine;
+
 /**
  * @brief Create a underlying VkBuffer object and bind it to memory
  * @param device		is the logical device that creates the buffer object
@@ -78,8 +80,15 @@ ZBuffer			createIndexBuffer (ZDevice device, uint32_t indexCount, VkIndexType in
 
 ZBuffer			createBufferAndLoadFromImageFile (ZDevice device, add_cref<std::string> imageFileName,
 												  ZBufferUsageFlags usage = {}, int desiredChannelCount = 0);
+// Creates device local buffer and streams the image file content into it through the engine
+ZBuffer			createBufferAndLoadFromImageFile (add_ref<UploadEngine> engine, add_cref<std::string> imageFileName,
+												  ZBufferUsageFlags usage = {}, int desiredChannelCount = 0);
 ZBuffer			bufferDuplicate (ZBuffer buffer);
+// Flushes only what has been written and not flushed yet, does nothing for coherent memory
 void			bufferFlush		(ZBuffer buffer);
+// Does the same with a single vkFlushMappedMemoryRanges() call for all the buffers
+void			bufferFlush		(add_cref<std::vector<ZBuffer>> buffers);
+void			bufferInvalidate(add_cref<std::vector<ZBuffer>> buffers);
 
 VkDeviceSize	bufferReadData	(ZBuffer buffer, uint8_t* dst, const VkBufferCopy& copy);
 VkDeviceSize	bufferReadData	(ZBuffer buffer, uint8_t* dst, VkDeviceSize size = VK_WHOLE_SIZE);
@@ -179,6 +188,8 @@ namespace namespace_hidden
 struct BufferTexelAccess_
 {
 	Vec4 asColor (VkFormat format, uint32_t x, uint32_t y, uint32_t z = 0) const;
+	// Converts all the texels at once, see formatConvertToFloat4() for details
+	auto asColors (VkFormat format, uint32_t threads = 0u) const -> std::vector<Vec4>;
 
 protected:
 	BufferTexelAccess_ (ZBuffer buffer, uint32_t elementSize,
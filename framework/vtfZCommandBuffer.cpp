@@ -119,6 +119,22 @@ void commandBufferExecuteCommands (ZCommandBuffer primary, std::initializer_list
 	VTF_CALL_CHECK(di.vkCmdExecuteCommands, *primary, static_cast<uint32_t>(secondaryCommands.size()), commands);
 }
 
+void commandBufferExecuteCommands (ZCommandBuffer primary, add_cref<std::vector<ZCommandBuffer>> secondaryCommands)
+{
+	ASSERTMSG(false == secondaryCommands.empty(), "\"secondaryCommands\" must not be empty");
+	ASSERTMSG(primary.getParam<bool>(), "The first \"primary\" param must be primary command buffer");
+	std::vector<VkCommandBuffer> commands(secondaryCommands.size());
+	for (std::size_t i = 0u; i < secondaryCommands.size(); ++i)
+	{
+		commands[i] = *secondaryCommands[i];
+		ASSERTMSG((false == secondaryCommands[i].getParam<bool>()),
+			"\"secondaryCommands\" elements must be secondary command buffers");
+	}
+
+	add_cref<ZDeviceInterface> di = primary.getParam<ZDevice>().getInterface();
+	VTF_CALL_CHECK(di.vkCmdExecuteCommands, *primary, data_count(commands), commands.data());
+}
+
 VkResult commandBufferSubmitAndWait (ZCommandBuffer commandBuffer, ZFence hintFence, uint64_t timeout, bool assertWaitResult)
 {
 	ZDevice			device		= commandBuffer.getParam<ZDevice>();
@@ -148,20 +164,35 @@ void commandBufferBindDescriptorSets (ZCommandBuffer cmd, ZPipelineLayout layout
 		= layout.getParamRef<std::vector<ZDescriptorSetLayout>>();
 	if (uint32_t setCount = data_count(descriptorLayouts); setCount)
 	{
-		std::vector<VkDescriptorSet> sets(setCount, VK_NULL_HANDLE);
-		std::transform(descriptorLayouts.begin(), descriptorLayouts.end(), sets.begin(),
-			[](const ZDescriptorSetLayout& dsl) { return *dsl.getParam<ZDescriptorSet>(); });
-
 		add_cref<ZDeviceInterface> di = cmd.getParamRef<ZDevice>().getInterface();
-		VTF_CALL_CHECK(di.vkCmdBindDescriptorSets,
-			*cmd,
-			bindingPoint,
-			*layout,
-			0u,			//firstSet
-			setCount,
-			sets.data(),
-			0u,			//dynamicOffsetCount
-			nullptr);	//pDynamicOffsets
+		std::vector<VkDescriptorSet> sets;
+		sets.reserve(setCount);
+		auto bindSets = [&](uint32_t endSet)
+		{
+			if (sets.empty()) return;
+			VTF_CALL_CHECK(di.vkCmdBindDescriptorSets,
+				*cmd,
+				bindingPoint,
+				*layout,
+				(endSet - data_count(sets)),	//firstSet
+				data_count(sets),
+				sets.data(),
+				0u,			//dynamicOffsetCount
+				nullptr);	//pDynamicOffsets
+			sets.clear();
+		};
+		for (uint32_t set = 0u; set < setCount; ++set)
+		{
+			add_cref<ZDescriptorSetLayout> dsl = descriptorLayouts[set];
+			// Push descriptor sets have no VkDescriptorSet, they come from DescriptorSetBindingManager::pushDescriptorSet()
+			if (dsl.getParam<VkDescriptorSetLayoutCreateFlags>() & VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR)
+			{
+				bindSets(set);
+				continue;
+			}
+			sets.push_back(*dsl.getParam<ZDescriptorSet>());
+		}
+		bindSets(setCount);
 	}
 }
 
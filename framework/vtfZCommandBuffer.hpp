@@ -60,6 +60,7 @@ void			commandBufferBegin (ZCommandBuffer commandBuffer, ZFramebuffer fb, ZRende
 									VkCommandBufferUsageFlags usage = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
 									add_ptr<void> pNext = nullptr, add_ptr<void> pInhNext = nullptr);
 void			commandBufferExecuteCommands (ZCommandBuffer primary, std::initializer_list<ZCommandBuffer> secondaryCommands);
+void			commandBufferExecuteCommands (ZCommandBuffer primary, add_cref<std::vector<ZCommandBuffer>> secondaryCommands);
 VkResult		commandBufferSubmitAndWait (ZCommandBuffer commandBuffer, ZFence hintFence = ZFence(), uint64_t timeout = INVALID_UINT64,
 											bool assertWaitResult = true);
 /**
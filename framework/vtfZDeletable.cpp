@@ -8,6 +8,7 @@
 #include "vtfZInstanceDeviceInterface.hpp"
 #include "vtfDebugMessenger.hpp"
 #include "vtfZPipeline.hpp"
+#include "vtfZDeviceMemory.hpp"
 
 #include <iterator>
 #include <sstream>
@@ -83,6 +84,8 @@ void vtfDestroySurfaceKHR(void_cptr obj, VkInstance instance, VkSurfaceKHR surfa
 
 void vtfDestroyDevice (VkDevice dev, VkAllocationCallbacksPtr cb, uint32_t undeletable)
 {
+	deviceReleasePipelineCache(dev);
+	deviceReleaseMemory(dev);
 	if (undeletable) return;
 	add_cref<ZDeviceInterface> di = ZDeviceSingleton().getInterface();
 	VTF_CALL_CHECK(di.vkDestroyDevice, dev, cb);
@@ -184,6 +187,12 @@ void vtfDestroyDescriptorSetLayout(void_cptr obj, VkDevice dev, VkDescriptorSetL
 	VTF_CALL_CHECK(di.vkDestroyDescriptorSetLayout, dev, dsl, cbs);
 }
 
+void vtfDestroyDescriptorUpdateTemplate(void_cptr obj, VkDevice dev, VkDescriptorUpdateTemplate dut, const VkAllocationCallbacks* cbs)
+{
+	add_cref<ZDeviceInterface> di = reinterpret_cast<add_cptr<ZDevice>>(obj)->getInterface();
+	VTF_CALL_CHECK(di.vkDestroyDescriptorUpdateTemplate, dev, dut, cbs);
+}
+
 void vtfDestroyPipelineLayout(void_cptr obj, VkDevice dev, VkPipelineLayout pl, const VkAllocationCallbacks* cbs)
 {
 	add_cref<ZDeviceInterface> di = reinterpret_cast<add_cptr<ZDevice>>(obj)->getInterface();
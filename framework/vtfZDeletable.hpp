@@ -2,6 +2,7 @@
 #define __VTF_ZDELETABLE_HPP_INCLUDED__
 
 #include <any>
+#include <array>
 #include <atomic>
 #include <bitset>
 #include <functional>
@@ -392,7 +393,7 @@ enum ZDistName
 	None, Undeletable,
 	RequiredLayers,				AvailableLayers,
 	RequiredLayerExtensions,	AvailableLayerExtensions,
-	RequiredDeviceExtensions,	AvailableDeviceExtensions,
+	RequiredDeviceExtensions,	AvailableDeviceExtensions,	EnabledDeviceExtensions,
 	Width, Height, Depth, ViewMask, PatchControlPoints, SubpassIndex,
 	LayoutIdentifier, PrimitiveRestart,
 	Count, SizeFirst, SizeSecond, SizeThird,
@@ -404,6 +405,7 @@ enum ZDistName
 	LineWidth, AttachmentCount, SubpassCount, ViewportCount, ScissorCount,
 	SpecConstants, BlendAttachmentState, BlendConstants, PipelineCreateFlags,
 	RenderingAttachmentLocations, RenderingInpuAttachmentIndices, RasterizerDiscardEnable,
+	MemoryOffset,
 };
 template<ZDistName name, typename CType_>
 struct ZDistType
@@ -482,7 +484,8 @@ typedef ZDeletable<VkDevice,
 	VkAllocationCallbacksPtr,
 	ZPhysicalDevice,
 	ZDistType<Undeletable, uint32_t>,
-	std::vector<ZDeviceQueueCreateInfo>
+	std::vector<ZDeviceQueueCreateInfo>,
+	ZDistType<EnabledDeviceExtensions, strings>
 > ZDevice;
 
 typedef std::tuple<	ZDistType<QueueFamilyIndex, uint32_t>
@@ -516,7 +519,8 @@ typedef ZDeletable<VkShaderModule,
 	swizzle_four_params, ZDeletableBase, ZDevice, VkAllocationCallbacksPtr,
 	VkShaderStageFlagBits, std::string,
 	// <Collection:id, SBTShaderGroup:index, pipelineGroupIndex, pipelineShaderIndex>
-	std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>
+	std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>,
+	std::array<uint8_t, 32> // SHA-256 of the SPIR-V code, see vtfDigest.hpp
 >
 ZShaderModule;
 
@@ -555,7 +559,10 @@ typedef ZDeletable<VkDeviceMemory,
 	VkMemoryPropertyFlags, 
 	VkDeviceSize,							// VkMemoryRequirements::size
 	ZDistType<SizeSecond, VkDeviceSize>,	// requested size (buffer|image)
-	add_ptr<uint8_t>>
+	add_ptr<uint8_t>,
+	ZDistType<MemoryOffset, VkDeviceSize>,	// offset within VkDeviceMemory, non-zero if sub-allocated
+	ZDistType<SomeOne, std::any>,			// range of a shared memory block, see vtfZDeviceMemory.cpp
+	std::pair<VkDeviceSize, VkDeviceSize>>	// written but not flushed yet [begin, end), empty if begin == end
 ZDeviceMemory;
 
 void vtfDestroyImage(void_cptr, VkDevice, VkImage, const VkAllocationCallbacks*);
@@ -590,6 +597,7 @@ typedef ZDeletable<VkRenderPass,
 	, std::vector<VkClearValue>
 	, ZDistType<SomeOne, std::any> // ZAttachmentPool
 	, std::vector<ZDistType<SomeTwo, std::any>> // ZSubpassDescription2's
+	, ZDistType<SomeThree, std::any> // shared render pass that actually owns the handle
 >
 ZRenderPass;
 
@@ -646,9 +654,17 @@ typedef ZDeletable<VkDescriptorSetLayout,
 	decltype(&vtfDestroyDescriptorSetLayout), &vtfDestroyDescriptorSetLayout,
 	swizzle_four_params, ZDeletableBase, ZDevice, VkAllocationCallbacksPtr,
 	VkDescriptorSetLayoutCreateFlags, ZDescriptorSet,
-	ZDistType<LayoutIdentifier, uint32_t>>
+	ZDistType<LayoutIdentifier, uint32_t>,
+	ZDistType<SomeOne, std::any>> // shared layout that actually owns the handle
 ZDescriptorSetLayout;
 
+void vtfDestroyDescriptorUpdateTemplate(void_cptr, VkDevice, VkDescriptorUpdateTemplate, const VkAllocationCallbacks*);
+typedef ZDeletable<VkDescriptorUpdateTemplate,
+	decltype(&vtfDestroyDescriptorUpdateTemplate), &vtfDestroyDescriptorUpdateTemplate,
+	swizzle_four_params, ZDeletableBase, ZDevice, VkAllocationCallbacksPtr,
+	VkDescriptorUpdateTemplateType>
+ZDescriptorUpdateTemplate;
+
 void vtfDestroyPipelineLayout(void_cptr, VkDevice, VkPipelineLayout, const VkAllocationCallbacks*);
 typedef ZDeletable<VkPipelineLayout,
 	decltype(&vtfDestroyPipelineLayout), &vtfDestroyPipelineLayout,
@@ -657,7 +673,8 @@ typedef ZDeletable<VkPipelineLayout,
 	std::vector<ZDescriptorSetLayout>,
 	std::vector<VkPushConstantRange>,
 	std::vector<type_index_with_default>,
-	bool /*enableDescriptorBuffer*/>
+	bool /*enableDescriptorBuffer*/,
+	ZDistType<SomeOne, std::any>> // shared layout that actually owns the handle
 ZPipelineLayout;
 
 void vtfDestroyPipeline(void_cptr, VkDevice, VkPipeline, const VkAllocationCallbacks*);
@@ -667,7 +684,8 @@ typedef ZDeletable<VkPipeline,
 	ZPipelineLayout, ZRenderPass, VkPipelineBindPoint, VkPipelineCreateFlags,
 	std::vector<ZShaderModule>, // ray-tracing shaders
 	ZDistType<LayoutIdentifier, uint32_t>, // ray-tracing pipeline shader group order
-	ZDistType<Count, uint32_t> // ray-tracing pipeline shader group count
+	ZDistType<Count, uint32_t>, // ray-tracing pipeline shader group count
+	ZDistType<SomeOne, std::any> // pipeline that actually owns the handle, see vtfZPipeline.cpp
 >
 ZPipeline;
 
@@ -2,17 +2,256 @@
 #include "vtfStructUtils.hpp"
 #include "vtfZBuffer.hpp"
 
+#include <algorithm>
+#include <mutex>
+#include <set>
+
 namespace vtf
 {
 
-uint32_t findMemoryTypeIndex (ZDevice device, uint32_t memoryTypeBits, VkMemoryPropertyFlags properties)
+namespace
+{
+
+constexpr VkDeviceSize	maxBlockSize		= VkDeviceSize(64u) * 1024u * 1024u;
+constexpr VkDeviceSize	minBlockSize		= VkDeviceSize(1u) * 1024u * 1024u;
+constexpr VkDeviceSize	minBuddySize		= 256u;
+
+VkDeviceSize floorPow2 (VkDeviceSize x)
+{
+	VkDeviceSize p = 1u;
+	while ((p << 1) <= x) p <<= 1;
+	return p;
+}
+
+VkDeviceSize ceilPow2 (VkDeviceSize x)
+{
+	VkDeviceSize p = 1u;
+	while (p < x) p <<= 1;
+	return p;
+}
+
+uint32_t log2Pow2 (VkDeviceSize x)
+{
+	uint32_t n = 0u;
+	while (x > 1u) { x >>= 1; ++n; }
+	return n;
+}
+
+// Maps the whole memory unless it is mapped already, the caller synchronizes access
+add_ptr<uint8_t> mapWholeMemory (ZDeviceMemory memory)
+{
+	add_ref<add_ptr<uint8_t>> pointer = memory.getParamRef<add_ptr<uint8_t>>();
+	if (nullptr == pointer)
+	{
+		ZDevice						device	= memory.getParam<ZDevice>();
+		add_cref<ZDeviceInterface>	di		= device.getInterface();
+		ASSERTION(memory.getParam<VkMemoryPropertyFlags>() & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		VKASSERTMSG(VTF_CALL_CHECK(di.vkMapMemory, *device, *memory, 0u, memory.getParam<VkDeviceSize>(),
+			(VkMemoryMapFlags)0, reinterpret_cast<void**>(&pointer)), "Failed to map memory");
+	}
+	return pointer;
+}
+
+// memory type index, optimal tiling image, device address, strategy
+typedef std::tuple<uint32_t, bool, bool, MemoryStrategy> PoolKey;
+
+// Single VkDeviceMemory shared by many resources, it is freed along with the last of them
+// unless it is kept by the allocator as the spare block of its pool
+struct MemoryBlock
+{
+	MemoryBlock (ZDeviceMemory memory, VkDeviceSize size, add_cref<PoolKey> key);
+	bool				allocate		(VkDeviceSize size, VkDeviceSize alignment,
+										 add_ref<VkDeviceSize> offset, add_ref<VkDeviceSize> reserved);
+	void				release			(VkDeviceSize offset, VkDeviceSize reserved);
+	add_ptr<uint8_t>	map				();
+	VkDeviceSize		largestFree		() const;
+
+	ZDeviceMemory		memory;
+	const VkDeviceSize	size;
+	const PoolKey		key;
+	const MemoryStrategy strategy;
+	VkDeviceSize		used;
+	uint32_t			count;
+	add_ptr<uint8_t>	mapped;
+	VkDeviceSize		top;								// Linear
+	std::vector<std::set<VkDeviceSize>>	freeRanges;		// Buddy, free offsets per order
+};
+
+MemoryBlock::MemoryBlock (ZDeviceMemory memory_, VkDeviceSize size_, add_cref<PoolKey> key_)
+	: memory	(memory_)
+	, size		(size_)
+	, key		(key_)
+	, strategy	(std::get<MemoryStrategy>(key_))
+	, used		(0u)
+	, count		(0u)
+	, mapped	(nullptr)
+	, top		(0u)
+	, freeRanges()
+{
+	if (MemoryStrategy::Buddy == strategy)
+	{
+		freeRanges.resize(log2Pow2(size / minBuddySize) + 1u);
+		freeRanges.back().insert(0u);
+	}
+}
+
+bool MemoryBlock::allocate (VkDeviceSize size_, VkDeviceSize alignment,
+							add_ref<VkDeviceSize> offset, add_ref<VkDeviceSize> reserved)
+{
+	if (MemoryStrategy::Linear == strategy)
+	{
+		const VkDeviceSize start = ROUNDUP(top, alignment);
+		if (start + size_ > size) return false;
+		offset		= start;
+		reserved	= start + size_ - top;
+		top			= start + size_;
+	}
+	else
+	{
+		// Ranges of a given order are aligned to their size, so the alignment comes for free
+		reserved = ceilPow2(std::max(std::max(size_, alignment), minBuddySize));
+		if (reserved > size) return false;
+		const uint32_t order = log2Pow2(reserved / minBuddySize);
+		uint32_t avail = order;
+		while (avail < freeRanges.size() && freeRanges[avail].empty()) ++avail;
+		if (avail == freeRanges.size()) return false;
+		offset = *freeRanges[avail].begin();
+		freeRanges[avail].erase(freeRanges[avail].begin());
+		while (avail > order)
+		{
+			--avail;
+			freeRanges[avail].insert(offset + (minBuddySize << avail));
+		}
+	}
+	used += reserved;
+	count += 1u;
+	return true;
+}
+
+void MemoryBlock::release (VkDeviceSize offset, VkDeviceSize reserved)
+{
+	used -= reserved;
+	count -= 1u;
+	if (MemoryStrategy::Linear == strategy)
+	{
+		if (0u == count) top = 0u;
+	}
+	else
+	{
+		uint32_t order = log2Pow2(reserved / minBuddySize);
+		while ((order + 1u) < freeRanges.size())
+		{
+			const VkDeviceSize buddy = offset ^ (minBuddySize << order);
+			auto i = freeRanges[order].find(buddy);
+			if (i == freeRanges[order].end()) break;
+			freeRanges[order].erase(i);
+			offset = std::min(offset, buddy);
+			++order;
+		}
+		freeRanges[order].insert(offset);
+	}
+}
+
+add_ptr<uint8_t> MemoryBlock::map ()
+{
+	// vkMapMemory() must not be called twice on the same memory, so all the ranges share one mapping
+	if (nullptr == mapped)
+	{
+		mapped = mapWholeMemory(memory);
+	}
+	return mapped;
+}
+
+VkDeviceSize MemoryBlock::largestFree () const
+{
+	if (MemoryStrategy::Linear == strategy)
+	{
+		return size - top;
+	}
+	for (auto i = freeRanges.size(); i > 0u; --i)
+	{
+		if (false == freeRanges[i - 1u].empty())
+			return (minBuddySize << (i - 1u));
+	}
+	return 0u;
+}
+
+struct DeviceMemoryAllocator;
+// Owned by ZDeviceMemory of a sub-allocated resource, gives the range back to its block when destroyed
+struct MemoryRange
+{
+	std::shared_ptr<DeviceMemoryAllocator>	allocator;
+	std::shared_ptr<MemoryBlock>			block;
+	VkDeviceSize							offset;
+	VkDeviceSize							reserved;
+	~MemoryRange ();
+};
+
+struct DeviceMemoryAllocator
+{
+	// An emptied block kept to be reused by its pool, it is held by its raw handle
+	// because its ZDeviceMemory would keep the device alive, see deviceReleaseMemory()
+	struct SpareBlock
+	{
+		VkDeviceMemory				memory;
+		VkDeviceSize				size;
+		add_ptr<uint8_t>			mapped;
+		VkAllocationCallbacksPtr	callbacks;
+	};
+
+	std::mutex											mutex;
+	std::weak_ptr<ZDevice::AnObject>					device;
+	VkPhysicalDeviceMemoryProperties					properties;
+	VkDeviceSize										nonCoherentAtomSize;
+	MemoryStrategy										strategy;
+	std::map<PoolKey, std::vector<std::weak_ptr<MemoryBlock>>>	pools;
+	std::map<PoolKey, SpareBlock>						spares;
+	std::vector<std::weak_ptr<ZDeviceMemory::AnObject>>	dedicated;
+};
+
+MemoryRange::~MemoryRange ()
 {
-	auto physicalDevice = device.getParam<ZPhysicalDevice>();
-	add_cref<ZInstanceInterface> ii = physicalDevice.getParam<ZInstance>().getInterface();
+	if (block)
+	{
+		std::lock_guard<std::mutex> lock(allocator->mutex);
+		block->release(offset, reserved);
+		// The block goes away along with this range, one empty block per pool outlives it
+		// so that creating and destroying resources in a loop doesn't allocate a block each time
+		if (0u == block->count && 0u == allocator->spares.count(block->key))
+		{
+			allocator->spares[block->key] = { *block->memory, block->size, block->mapped,
+											  block->memory.getParam<VkAllocationCallbacksPtr>() };
+			block->memory.asSharedPtr()->routine = nullptr;
+		}
+	}
+}
+
+std::mutex allocatorsMutex;
+std::map<VkDevice, std::shared_ptr<DeviceMemoryAllocator>> allocators;
 
-	VkPhysicalDeviceMemoryProperties memProperties;
-	VTF_CALL_CHECK(ii.vkGetPhysicalDeviceMemoryProperties, *physicalDevice, &memProperties);
+// Properties of the memory are queried once per device instead of each time they are needed
+std::shared_ptr<DeviceMemoryAllocator> getAllocator (ZDevice device)
+{
+	std::lock_guard<std::mutex> lock(allocatorsMutex);
+	std::shared_ptr<DeviceMemoryAllocator>& allocator = allocators[*device];
+	if (!allocator || allocator->device.expired())
+	{
+		ZPhysicalDevice							physicalDevice	= device.getParam<ZPhysicalDevice>();
+		add_cref<ZInstanceInterface>			ii				= physicalDevice.getParam<ZInstance>().getInterface();
+		add_cref<VkPhysicalDeviceProperties>	pdp				= physicalDevice.getParamRef<VkPhysicalDeviceProperties>();
+
+		allocator = std::make_shared<DeviceMemoryAllocator>();
+		allocator->device				= device.asSharedPtr();
+		allocator->nonCoherentAtomSize	= std::max(pdp.limits.nonCoherentAtomSize, VkDeviceSize(1u));
+		allocator->strategy				= MemoryStrategy::Buddy;
+		VTF_CALL_CHECK(ii.vkGetPhysicalDeviceMemoryProperties, *physicalDevice, &allocator->properties);
+	}
+	return allocator;
+}
 
+uint32_t findMemoryTypeIndex (add_cref<VkPhysicalDeviceMemoryProperties> memProperties,
+							  uint32_t memoryTypeBits, VkMemoryPropertyFlags properties)
+{
 	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
 		if ((memoryTypeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
 			return i;
@@ -22,38 +261,146 @@ uint32_t findMemoryTypeIndex (ZDevice device, uint32_t memoryTypeBits, VkMemoryP
 	throw std::runtime_error("failed to find suitable memory type!");
 }
 
+VkResult allocateMemory (ZDevice device, VkDeviceSize allocationSize, uint32_t memoryTypeIndex,
+						 bool deviceAddress, add_ref<VkDeviceMemory> memory)
+{
+	add_cref<ZDeviceInterface> di = device.getInterface();
+
+	VkMemoryAllocateFlagsInfo allocFlagsInfo = makeVkStruct();
+	allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+	void_ptr pNext = deviceAddress ? &allocFlagsInfo : nullptr;
+
+	VkStruct<VkMemoryAllocateInfo>	allocInfo(pNext);
+	allocInfo.allocationSize = allocationSize;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	return VTF_CALL_CHECK(di.vkAllocateMemory, *device, &allocInfo, device.getParam<VkAllocationCallbacksPtr>(), &memory);
+}
+
+// Mirrors ZNonDeletableImage, VkDeviceMemory belongs to the block so the routine must not free it
+struct ZSubAllocatedMemory : ZDeviceMemory
+{
+	ZSubAllocatedMemory (add_cref<MemoryBlock> block, add_cref<std::shared_ptr<MemoryRange>> range,
+						 VkMemoryPropertyFlags properties, VkDeviceSize allocationSize, VkDeviceSize desiredSize)
+		: ZDeviceMemory(*block.memory, block.memory.getParam<ZDevice>(), block.memory.getParam<VkAllocationCallbacksPtr>(),
+						properties, allocationSize,
+						ZDistType<SizeSecond, VkDeviceSize>(desiredSize), nullptr,
+						ZDistType<MemoryOffset, VkDeviceSize>(range->offset), ZDistType<SomeOne, std::any>(range),
+						std::pair<VkDeviceSize, VkDeviceSize>())
+	{
+		super::get()->routine = nullptr;
+	}
+};
+
+std::optional<ZDeviceMemory> subAllocate (ZDevice device, std::shared_ptr<DeviceMemoryAllocator> allocator,
+										  add_cref<VkMemoryRequirements> requirements, uint32_t memoryTypeIndex,
+										  VkMemoryPropertyFlags properties, VkDeviceSize desiredSize,
+										  bool deviceAddress, bool optimalImage)
+{
+	add_cref<VkMemoryType>	memoryType	= allocator->properties.memoryTypes[memoryTypeIndex];
+	const VkDeviceSize		heapSize	= allocator->properties.memoryHeaps[memoryType.heapIndex].size;
+	const VkDeviceSize		blockSize	= std::max(minBlockSize, floorPow2(std::min(maxBlockSize, heapSize / 8u)));
+	// Host visible ranges get whole atoms, so flushing one never touches its neighbours
+	const VkDeviceSize		alignment	= (memoryType.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+											? std::max(requirements.alignment, allocator->nonCoherentAtomSize)
+											: requirements.alignment;
+	const VkDeviceSize		allocationSize = ROUNDUP(requirements.size, alignment);
+
+	// Large resources are not worth sharing a block with anything
+	if (allocationSize > blockSize / 2u)
+	{
+		return {};
+	}
+
+	std::lock_guard<std::mutex> lock(allocator->mutex);
+	const MemoryStrategy strategy = allocator->strategy;
+	const PoolKey key(memoryTypeIndex, optimalImage, deviceAddress, strategy);
+	auto& pool = allocator->pools[key];
+
+	auto range = std::make_shared<MemoryRange>();
+	range->allocator = allocator;
+	for (auto i = pool.begin(); i != pool.end();)
+	{
+		if (auto block = i->lock(); block)
+		{
+			if (block->allocate(allocationSize, alignment, range->offset, range->reserved))
+			{
+				range->block = block;
+				break;
+			}
+			++i;
+		}
+		else i = pool.erase(i);
+	}
+
+	if (!range->block)
+	{
+		VkDeviceMemory		memory	= VK_NULL_HANDLE;
+		add_ptr<uint8_t>	mapped	= nullptr;
+		if (auto spare = allocator->spares.find(key); spare != allocator->spares.end())
+		{
+			// Still mapped if it was before, vkMapMemory() must not be called on it again
+			memory	= spare->second.memory;
+			mapped	= spare->second.mapped;
+			allocator->spares.erase(spare);
+		}
+		else if (VK_SUCCESS != allocateMemory(device, blockSize, memoryTypeIndex, deviceAddress, memory))
+		{
+			return {};
+		}
+		// The block is shared by resources that may have requested different properties
+		ZDeviceMemory blockMemory = ZDeviceMemory::create(memory, device, device.getParam<VkAllocationCallbacksPtr>(),
+			memoryType.propertyFlags, blockSize, ZDistType<SizeSecond, VkDeviceSize>(blockSize), mapped, {}, {}, {});
+		auto block = std::make_shared<MemoryBlock>(blockMemory, blockSize, key);
+		block->mapped = mapped;
+		ASSERTION(block->allocate(allocationSize, alignment, range->offset, range->reserved));
+		range->block = block;
+		pool.push_back(block);
+	}
+
+	return ZSubAllocatedMemory(*range->block, range, properties, allocationSize, desiredSize);
+}
+
+add_ptr<MemoryRange> getMemoryRange (ZDeviceMemory memory)
+{
+	add_cref<std::any> range = memory.getParamRef<ZDistType<SomeOne, std::any>>().get();
+	add_cptr<std::shared_ptr<MemoryRange>> ptr = std::any_cast<std::shared_ptr<MemoryRange>>(&range);
+	return ptr ? ptr->get() : nullptr;
+}
+
+} // unnamed namespace
+
+uint32_t findMemoryTypeIndex (ZDevice device, uint32_t memoryTypeBits, VkMemoryPropertyFlags properties)
+{
+	return findMemoryTypeIndex(getAllocator(device)->properties, memoryTypeBits, properties);
+}
+
 std::vector<ZDeviceMemory> createMemory (ZDevice device, add_cref<VkMemoryRequirements> requirements,
 										VkMemoryPropertyFlags properties, VkDeviceSize desiredSize,
-										bool sparse, bool deviceAddress)
+										bool sparse, bool deviceAddress, bool optimalImage)
 {
+	auto						allocator		= getAllocator(device);
 	auto						callbacks		= device.getParam<VkAllocationCallbacksPtr>();
 	const uint32_t				chunkCount		= (uint32_t)(sparse ? ROUNDUP(desiredSize, requirements.alignment) / requirements.alignment : 1u);
 	const VkDeviceSize			allocationSize	= sparse ? requirements.alignment : ROUNDUP(requirements.size, requirements.alignment);
-	const uint32_t				memoryTypeIndex = findMemoryTypeIndex(device, requirements.memoryTypeBits, properties);
-	//add_ptr<void>				pNext			{ /* VkExternalMemoryBufferCreateInfo, VkExternalMemoryImageCreateInfo */ };
+	const uint32_t				memoryTypeIndex = findMemoryTypeIndex(allocator->properties, requirements.memoryTypeBits, properties);
 	std::vector<ZDeviceMemory>	allocations		(chunkCount);
-	add_cref<ZDeviceInterface>	di				= device.getInterface();
-
-	VkExternalMemoryImageCreateInfo ici{};
-	VkExternalMemoryBufferCreateInfo ibi{};
-	ibi.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
-	UNREF(ici);
-	UNREF(ibi);
 
-	VkMemoryAllocateFlagsInfo allocFlagsInfo = makeVkStruct();
-	allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
-	void_ptr pNext = deviceAddress ? &allocFlagsInfo : nullptr;
+	if (false == sparse && MemoryStrategy::Dedicated != allocator->strategy)
+	{
+		if (auto memory = subAllocate(device, allocator, requirements, memoryTypeIndex, properties,
+									  desiredSize, deviceAddress, optimalImage); memory)
+		{
+			allocations.at(0) = *memory;
+			return allocations;
+		}
+	}
 
 	for (uint32_t chunk = 0u; chunk < chunkCount; ++chunk)
 	{
 		VkDeviceMemory		memory = VK_NULL_HANDLE;
-		VkStruct<VkMemoryAllocateInfo>	allocInfo(pNext);
-
-		allocInfo.allocationSize = allocationSize;
-		allocInfo.memoryTypeIndex = memoryTypeIndex;
-
-		VKASSERTMSG(VTF_CALL_CHECK(di.vkAllocateMemory,
-			*device, &allocInfo, callbacks, &memory), "failed to allocate buffer memory!");
+		VKASSERTMSG(allocateMemory(device, allocationSize, memoryTypeIndex, deviceAddress, memory),
+			"failed to allocate buffer memory!");
 
 		ZDistType<SizeSecond, VkDeviceSize> chunkSize = allocationSize;
 		if (false == sparse)
@@ -61,64 +408,252 @@ std::vector<ZDeviceMemory> createMemory (ZDevice device, add_cref<VkMemoryRequir
 		else if (chunk + 1u == chunkCount)
 			chunkSize = desiredSize % allocationSize;
 
-		allocations.at(chunk) = ZDeviceMemory::create(memory, device, callbacks, properties, allocationSize, chunkSize, nullptr);
+		allocations.at(chunk) = ZDeviceMemory::create(memory, device, callbacks, properties, allocationSize, chunkSize, nullptr, {}, {}, {});
+	}
+
+	std::lock_guard<std::mutex> lock(allocator->mutex);
+	auto& dedicated = allocator->dedicated;
+	dedicated.erase(std::remove_if(dedicated.begin(), dedicated.end(),
+		[](add_cref<std::weak_ptr<ZDeviceMemory::AnObject>> memory) { return memory.expired(); }), dedicated.end());
+	for (add_cref<ZDeviceMemory> allocation : allocations)
+	{
+		dedicated.push_back(allocation.asSharedPtr());
 	}
 
 	return allocations;
 }
 
-add_ptr<uint8_t> mapMemory (ZDeviceMemory memory)
+void setMemoryStrategy (ZDevice device, MemoryStrategy strategy)
+{
+	auto allocator = getAllocator(device);
+	std::lock_guard<std::mutex> lock(allocator->mutex);
+	allocator->strategy = strategy;
+}
+
+MemoryStats getMemoryStats (ZDevice device)
 {
-	add_cref<ZDeviceInterface> di = memory.getParam<ZDevice>().getInterface();
-	const VkMemoryPropertyFlags	props = memory.getParam<VkMemoryPropertyFlags>();
-	ASSERTION(props & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	auto allocator = getAllocator(device);
+	std::lock_guard<std::mutex> lock(allocator->mutex);
+
+	MemoryStats stats{};
+	VkDeviceSize largestFree = 0u;
+	for (add_cref<std::pair<const PoolKey, std::vector<std::weak_ptr<MemoryBlock>>>> pool : allocator->pools)
+	{
+		for (add_cref<std::weak_ptr<MemoryBlock>> weakBlock : pool.second)
+		{
+			if (auto block = weakBlock.lock(); block)
+			{
+				stats.blockCount			+= 1u;
+				stats.blockBytes			+= block->size;
+				stats.usedBytes				+= block->used;
+				stats.subAllocationCount	+= block->count;
+				largestFree					= std::max(largestFree, block->largestFree());
+			}
+		}
+	}
+	for (add_cref<std::pair<const PoolKey, DeviceMemoryAllocator::SpareBlock>> spare : allocator->spares)
+	{
+		stats.blockCount	+= 1u;
+		stats.blockBytes	+= spare.second.size;
+		largestFree			= std::max(largestFree, spare.second.size);
+	}
+	for (add_cref<std::weak_ptr<ZDeviceMemory::AnObject>> weakMemory : allocator->dedicated)
+	{
+		if (auto memory = weakMemory.lock(); memory)
+		{
+			stats.dedicatedCount += 1u;
+			stats.dedicatedBytes += std::get<VkDeviceSize>(memory->params);
+		}
+	}
+	const VkDeviceSize freeBytes = stats.blockBytes - stats.usedBytes;
+	stats.fragmentation = freeBytes ? (1.0f - float(largestFree) / float(freeBytes)) : 0.0f;
+
+	return stats;
+}
+
+void deviceReleaseMemory (VkDevice device)
+{
+	std::shared_ptr<DeviceMemoryAllocator> allocator;
+	{
+		std::lock_guard<std::mutex> lock(allocatorsMutex);
+		auto entry = allocators.find(device);
+		if (entry == allocators.end()) return;
+		allocator = entry->second;
+		allocators.erase(entry);
+	}
+
+	// Everything else has been freed along with its ZDeviceMemory, the mappings go with the memory
+	add_cref<ZDeviceInterface> di = ZDeviceSingleton().getInterface();
+	std::lock_guard<std::mutex> lock(allocator->mutex);
+	for (add_cref<std::pair<const PoolKey, DeviceMemoryAllocator::SpareBlock>> spare : allocator->spares)
+	{
+		VTF_CALL_CHECK(di.vkFreeMemory, device, spare.second.memory, spare.second.callbacks);
+	}
+	allocator->spares.clear();
+}
+
+VkDeviceSize getMemoryOffset (ZDeviceMemory memory)
+{
+	return memory.getParam<ZDistType<MemoryOffset, VkDeviceSize>>();
+}
 
-	ZDevice			device	= memory.getParam<ZDevice>();
-	VkDeviceSize	size	= memory.getParam<VkDeviceSize>();
-	uint8_t**		pointer	= &memory.getParamRef<add_ptr<uint8_t>>();
-	VKASSERTMSG(VTF_CALL_CHECK(di.vkMapMemory,
-        *device, *memory, 0u, size, (VkMemoryMapFlags)0, reinterpret_cast<void**>(pointer)),
-		"Failed to map memory");
+add_ptr<uint8_t> mapMemory (ZDeviceMemory memory)
+{
+	if (add_ptr<MemoryRange> range = getMemoryRange(memory); range)
+	{
+		std::lock_guard<std::mutex> lock(range->allocator->mutex);
+		memory.getParamRef<add_ptr<uint8_t>>() = range->block->map() + range->offset;
+		return memory.getParam<add_ptr<uint8_t>>();
+	}
 
-	return memory.getParam<add_ptr<uint8_t>>();
+	auto allocator = getAllocator(memory.getParam<ZDevice>());
+	std::lock_guard<std::mutex> lock(allocator->mutex);
+	return mapWholeMemory(memory);
 }
 
 void unmapMemory (ZDeviceMemory memory)
 {
-	ZDevice	device = memory.getParam<ZDevice>();
-	add_cref<ZDeviceInterface> di = device.getInterface();
-	VTF_CALL_CHECK(di.vkUnmapMemory, *device, *memory);
-	memory.getParamRef<add_ptr<uint8_t>>() = nullptr;
+	// The mapping is released implicitly along with the memory, so there is nothing to do here.
+	// Keeping it saves a pair of vkMapMemory/vkUnmapMemory each time the memory is accessed.
+	UNREF(memory);
 }
 
-void flushMemory (ZDeviceMemory memory)
+static VkMemoryPropertyFlags getMemoryTypeFlags (ZDeviceMemory memory)
+{
+	// A sub-allocated range has the actual flags of its memory type known
+	add_ptr<MemoryRange> range = getMemoryRange(memory);
+	return range
+		? range->block->memory.getParam<VkMemoryPropertyFlags>()
+		: memory.getParam<VkMemoryPropertyFlags>();
+}
+
+bool isMemoryCoherent (ZDeviceMemory memory)
+{
+	return (getMemoryTypeFlags(memory) & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+void markMemoryDirty (ZDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size)
+{
+	const VkDeviceSize	memorySize	= memory.getParam<VkDeviceSize>();
+	const VkDeviceSize	end			= (VK_WHOLE_SIZE == size) ? memorySize : std::min(offset + size, memorySize);
+	auto				allocator	= getAllocator(memory.getParam<ZDevice>());
+
+	std::lock_guard<std::mutex> lock(allocator->mutex);
+	add_ref<std::pair<VkDeviceSize, VkDeviceSize>> dirty = memory.getParamRef<std::pair<VkDeviceSize, VkDeviceSize>>();
+	if (dirty.first == dirty.second)
+		dirty = { offset, end };
+	else
+		dirty = { std::min(dirty.first, offset), std::max(dirty.second, end) };
+}
+
+static VkStruct<VkMappedMemoryRange> makeMappedRange (ZDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size)
 {
-	ZDevice						device	= memory.getParam<ZDevice>();
-	add_cref<ZDeviceInterface>	di		= device.getInterface();
-	VkDeviceSize				size	= memory.getParam<VkDeviceSize>();
+	const VkDeviceSize	atomSize	= getAllocator(memory.getParam<ZDevice>())->nonCoherentAtomSize;
+	const VkDeviceSize	memorySize	= memory.getParam<VkDeviceSize>();
+	const VkDeviceSize	base		= getMemoryOffset(memory);
+	ASSERTMSG(offset < memorySize, "Offset ", offset, " exceeds memory size ", memorySize);
+	const VkDeviceSize	end			= (VK_WHOLE_SIZE == size) ? memorySize : std::min(offset + size, memorySize);
+
+	const VkDeviceSize	alignedEnd	= ROUNDUP(end, atomSize);
 
 	VkStruct<VkMappedMemoryRange>	range;
 	range.memory	= *memory;
-	range.offset	= 0u;
-	range.size		= size;
+	range.offset	= base + ROUNDDOWN(offset, atomSize);
+	// Sub-allocated ranges have whole atoms, a dedicated one whose size is not a multiple of the atom
+	// must not be rounded past its end, so anything reaching its last atom goes to the memory end
+	range.size		= (alignedEnd >= memorySize && 0u == base) ? VK_WHOLE_SIZE : (alignedEnd - ROUNDDOWN(offset, atomSize));
+	return range;
+}
+
+void flushMemory (ZDeviceMemory memory)
+{
+	memory.getParamRef<std::pair<VkDeviceSize, VkDeviceSize>>() = {};
+	flushMemory(memory, 0u, VK_WHOLE_SIZE);
+}
+
+void flushMemory (ZDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size)
+{
+	ZDevice							device	= memory.getParam<ZDevice>();
+	add_cref<ZDeviceInterface>		di		= device.getInterface();
+	VkStruct<VkMappedMemoryRange>	range	= makeMappedRange(memory, offset, size);
 
 	VTF_CALL_CHECK(di.vkFlushMappedMemoryRanges, *device, 1u, &range);
 }
 
+void flushMemory (add_cref<std::vector<ZDeviceMemory>> memories)
+{
+	if (memories.empty()) return;
+
+	ZDevice									device = memories.front().getParam<ZDevice>();
+	std::vector<VkMappedMemoryRange>		ranges;
+	std::vector<std::pair<VkDeviceSize, VkDeviceSize>>	dirties;
+	{
+		auto allocator = getAllocator(device);
+		std::lock_guard<std::mutex> lock(allocator->mutex);
+		for (ZDeviceMemory memory : memories)
+		{
+			add_ref<std::pair<VkDeviceSize, VkDeviceSize>> dirty = memory.getParamRef<std::pair<VkDeviceSize, VkDeviceSize>>();
+			if (dirty.first != dirty.second)
+			{
+				dirties.push_back(dirty);
+				dirty = {};
+			}
+			else dirties.emplace_back();
+		}
+	}
+	for (uint32_t i = 0u; i < data_count(memories); ++i)
+	{
+		add_cref<ZDeviceMemory> memory = memories.at(i);
+		ASSERTMSG(memory.getParam<ZDevice>() == device, "All memories must come from the same device");
+		if (dirties.at(i).first == dirties.at(i).second || isMemoryCoherent(memory))
+			continue;
+		ranges.push_back(makeMappedRange(memory, dirties.at(i).first, (dirties.at(i).second - dirties.at(i).first)));
+	}
+	if (false == ranges.empty())
+	{
+		add_cref<ZDeviceInterface> di = device.getInterface();
+		VTF_CALL_CHECK(di.vkFlushMappedMemoryRanges, *device, data_count(ranges), ranges.data());
+	}
+}
+
 void invalidateMemory (ZDeviceMemory memory)
 {
-	ZDevice			device	= memory.getParam<ZDevice>();
-	add_cref<ZDeviceInterface> di = device.getInterface();
-	VkDeviceSize	size	= memory.getParam<VkDeviceSize>();
+	invalidateMemory(memory, 0u, VK_WHOLE_SIZE);
+}
 
-	VkStruct<VkMappedMemoryRange>	range;
-	range.memory	= *memory;
-	range.offset	= 0u;
-	range.size		= size;
+void invalidateMemory (ZDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size)
+{
+	ZDevice							device	= memory.getParam<ZDevice>();
+	add_cref<ZDeviceInterface>		di		= device.getInterface();
+	VkStruct<VkMappedMemoryRange>	range	= makeMappedRange(memory, offset, size);
 
 	VTF_CALL_CHECK(di.vkInvalidateMappedMemoryRanges, *device, 1u, &range);
 }
 
+void invalidateMemory (add_cref<std::vector<ZDeviceMemory>> memories)
+{
+	if (memories.empty()) return;
+
+	ZDevice								device = memories.front().getParam<ZDevice>();
+	std::vector<VkMappedMemoryRange>	ranges;
+	for (add_cref<ZDeviceMemory> memory : memories)
+	{
+		ASSERTMSG(memory.getParam<ZDevice>() == device, "All memories must come from the same device");
+		// Only mapped memory can be invalidated, device local memory is never mapped
+		const bool mapped = (getMemoryTypeFlags(memory) & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+							&& (nullptr != memory.getParam<add_ptr<uint8_t>>());
+		if (mapped && false == isMemoryCoherent(memory))
+		{
+			ranges.push_back(makeMappedRange(memory, 0u, VK_WHOLE_SIZE));
+		}
+	}
+	if (false == ranges.empty())
+	{
+		add_cref<ZDeviceInterface> di = device.getInterface();
+		VTF_CALL_CHECK(di.vkInvalidateMappedMemoryRanges, *device, data_count(ranges), ranges.data());
+	}
+}
+
 Alloc::Alloc (add_cref<std::vector<ZDeviceMemory>> allocs)
 	: m_allocs		(allocs)
 	, m_count		(data_count(allocs))
@@ -11,14 +11,52 @@
 namespace vtf
 {
 
+// How createMemory() places non-sparse resources, the strategy may be changed
+// at any time and it applies to allocations made afterwards.
+enum class MemoryStrategy
+{
+	Dedicated,	// every resource gets its own VkDeviceMemory
+	Linear,		// bump allocation, a block is reused after all its resources are gone
+	Buddy		// power-of-two ranges merged with their neighbours on release (default)
+};
+
+struct MemoryStats
+{
+	uint32_t		blockCount;			// including one empty block per pool kept for reuse
+	VkDeviceSize	blockBytes;			// total size of the blocks sub-allocations are taken from
+	VkDeviceSize	usedBytes;			// occupied within the blocks, alignment padding included
+	uint32_t		subAllocationCount;
+	uint32_t		dedicatedCount;		// resources which have their own VkDeviceMemory
+	VkDeviceSize	dedicatedBytes;
+	float			fragmentation;		// 0 when the free space is contiguous, approaches 1 as it gets scattered
+};
+
 uint32_t	findMemoryTypeIndex	(ZDevice device, uint32_t memoryTypeBits, VkMemoryPropertyFlags properties);
 auto		createMemory		(ZDevice device, add_cref<VkMemoryRequirements> requirements,
 								 VkMemoryPropertyFlags properties, VkDeviceSize desiredSize,
-								 bool sparse, bool deviceAddress) -> std::vector<ZDeviceMemory>;
+								 bool sparse, bool deviceAddress, bool optimalImage = false) -> std::vector<ZDeviceMemory>;
+// Host visible memory is mapped on the first call and stays mapped until it is freed,
+// subsequent calls return the same pointer and unmapMemory() doesn't release the mapping.
 auto		mapMemory			(ZDeviceMemory memory) -> add_ptr<uint8_t>;
 void		unmapMemory			(ZDeviceMemory memory);
 void		flushMemory			(ZDeviceMemory memory);
 void		invalidateMemory	(ZDeviceMemory memory);
+// Offset and size are relative to the memory, they are aligned to nonCoherentAtomSize internally
+void		flushMemory			(ZDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size);
+void		invalidateMemory	(ZDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size);
+// Extends the range that has been written by the host since the last flush
+void		markMemoryDirty		(ZDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size);
+// Flushes dirty ranges, or invalidates whole memories, of all non-coherent memories with a single call,
+// memories which are not mapped are skipped
+void		flushMemory			(add_cref<std::vector<ZDeviceMemory>> memories);
+void		invalidateMemory	(add_cref<std::vector<ZDeviceMemory>> memories);
+bool		isMemoryCoherent	(ZDeviceMemory memory);
+// Where the memory starts within its VkDeviceMemory, must be used when binding resources
+auto		getMemoryOffset		(ZDeviceMemory memory) -> VkDeviceSize;
+void		setMemoryStrategy	(ZDevice device, MemoryStrategy strategy);
+auto		getMemoryStats		(ZDevice device) -> MemoryStats;
+// Frees the empty blocks kept for reuse, called right before the device is destroyed.
+void		deviceReleaseMemory	(VkDevice device);
 
 
 /*
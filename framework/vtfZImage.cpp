@@ -9,9 +9,11 @@
 #include "vtfFormatUtils.hpp"
 #include "vtfStructUtils.hpp"
 #include "vtfBacktrace.hpp"
+#include "vtfObjectCache.hpp"
 #include "stb_image.hpp"
 #include "vulkan/vulkan_to_string.hpp"
 #include <algorithm>
+#include <cstddef>
 
 namespace vtf
 {
@@ -108,11 +110,17 @@ ZSampler createSampler (
 	samplerInfo.compareOp				= VK_COMPARE_OP_NEVER;
 	samplerInfo.unnormalizedCoordinates	= normalized ? VK_FALSE : VK_TRUE;
 
-	ZSampler sampler(VK_NULL_HANDLE, device, callbacks, samplerInfo);
-	VKASSERTMSG(VTF_CALL_CHECK(di.vkCreateSampler,
-		*device, &samplerInfo, callbacks, sampler.setter()), "Failed to create sampler");
+	Digest digest;
+	digest.update(VK_OBJECT_TYPE_SAMPLER)
+		  .update(&samplerInfo.flags, (sizeof(samplerInfo) - offsetof(VkSamplerCreateInfo, flags)));
 
-	return sampler;
+	return objectCacheFindOrCreate<ZSampler>(device, digest.finish(), [&]()
+	{
+		ZSampler sampler(VK_NULL_HANDLE, device, callbacks, samplerInfo);
+		VKASSERTMSG(VTF_CALL_CHECK(di.vkCreateSampler,
+			*device, &samplerInfo, callbacks, sampler.setter()), "Failed to create sampler");
+		return sampler;
+	});
 }
 
 ZSampler createSampler (
@@ -198,9 +206,10 @@ ZImage createImage (ZDevice device, VkFormat format, VkImageType type, uint32_t
 	VkMemoryRequirements memRequirements;
 	VTF_CALL_CHECK(di.vkGetImageMemoryRequirements, *device, image, &memRequirements);
 
-	auto allocations = createMemory(device, memRequirements, properties(), memRequirements.size, false, deviceAddress);
+	auto allocations = createMemory(device, memRequirements, properties(), memRequirements.size, false, deviceAddress,
+									(VK_IMAGE_TILING_OPTIMAL == tiling));
 
-    VKASSERT(VTF_CALL_CHECK(di.vkBindImageMemory, *device, image, *allocations.at(0), 0u));
+    VKASSERT(VTF_CALL_CHECK(di.vkBindImageMemory, *device, image, *allocations.at(0), getMemoryOffset(allocations.at(0))));
 
 	return ZImage::create(image, device, callbacks, imageInfo, allocations.at(0), memRequirements.size);
 }
@@ -514,10 +523,20 @@ ZImageView createImageView (ZImage image, VkFormat format,
 	viewInfo.components			= components;
 	viewInfo.subresourceRange	= subresourceRange;
 
-	add_cref<ZDeviceInterface> di = device.getInterface();
-	VKASSERTMSG(VTF_CALL_CHECK(di.vkCreateImageView, *device, &viewInfo, callbacks, &imageView), "");
+	// The view keeps its image alive, so neither the object nor its handle can be reused by another image
+	const auto imageObject = image.object().first;
+	Digest digest;
+	digest.update(VK_OBJECT_TYPE_IMAGE_VIEW).update(&imageObject, sizeof(imageObject))
+		  .update(&viewInfo.image, sizeof(viewInfo.image)).update(viewInfo.flags).update(viewInfo.viewType)
+		  .update(viewInfo.format).update(&viewInfo.components, sizeof(viewInfo.components))
+		  .update(&viewInfo.subresourceRange, sizeof(viewInfo.subresourceRange));
 
-	return ZImageView::create(imageView, device, callbacks, viewInfo, image);
+	return objectCacheFindOrCreate<ZImageView>(device, digest.finish(), [&]()
+	{
+		add_cref<ZDeviceInterface> di = device.getInterface();
+		VKASSERTMSG(VTF_CALL_CHECK(di.vkCreateImageView, *device, &viewInfo, callbacks, &imageView), "");
+		return ZImageView::create(imageView, device, callbacks, viewInfo, image);
+	});
 }
 
 std::pair<VkDeviceSize, VkDeviceSize>
@@ -4,10 +4,20 @@
 #include "vtfZImage.hpp"
 #include "demangle.hpp"
 #include "vtfZRenderPass2.hpp"
+#include "vtfDigest.hpp"
+#include "vtfTaskScheduler.hpp"
 
 #include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <numeric>
+#include <sstream>
+#include <thread>
 
 namespace vtf
 {
@@ -110,6 +120,7 @@ struct GraphicPipelineSettings
 	ZPipelineCache		m_pipelineCache;
 
 	SpecializationInfoPerStageMap						m_shaderPerStageSpecs;
+	std::map<VkShaderStageFlagBits, ZShaderModule>		m_shaderModules;
 	std::vector<VkPipelineShaderStageCreateInfo>		m_shaderStages;
 	std::vector<VkSpecializationInfo>					m_shaderSpecs;
 	VkPipelineInputAssemblyStateCreateInfo				m_assemblyState;
@@ -149,6 +160,7 @@ GraphicPipelineSettings::GraphicPipelineSettings (ZPipelineLayout layout)
 	, m_renderPass			()
 	, m_pipelineCache		()
 	, m_shaderPerStageSpecs	()
+	, m_shaderModules		()
 	, m_shaderStages		()
 	, m_shaderSpecs			()
 	, m_assemblyState		(makeInputAssemblyStateCreateInfo())
@@ -318,6 +330,111 @@ static void dumpPipeline (VkPipeline pipeline, add_cref<VkGraphicsPipelineCreate
 	}
 }
 
+namespace
+{
+
+struct PipelineRegistry
+{
+	std::mutex															mutex;
+	std::weak_ptr<ZDevice::AnObject>									device;
+	std::map<Digest::value_type, std::weak_ptr<ZPipeline::AnObject>>	pipelines;
+	std::size_t															pruneSize = 64u;
+	PipelineRegistryStats												stats{};
+};
+
+std::mutex pipelineRegistriesMutex;
+std::map<VkDevice, std::shared_ptr<PipelineRegistry>> pipelineRegistries;
+
+std::shared_ptr<PipelineRegistry> getPipelineRegistry (ZDevice device)
+{
+	std::lock_guard<std::mutex> lock(pipelineRegistriesMutex);
+	std::shared_ptr<PipelineRegistry>& registry = pipelineRegistries[*device];
+	if (!registry || registry->device.expired())
+	{
+		registry = std::make_shared<PipelineRegistry>();
+		registry->device = device.asSharedPtr();
+	}
+	return registry;
+}
+
+// The handle belongs to the pipeline kept in the last parameter, the layout and the render pass
+// are the ones of the current request, so their descriptor sets are still found through the pipeline.
+struct ZSharedPipeline : ZPipeline
+{
+	ZSharedPipeline (ZPipeline owner, ZPipelineLayout layout, ZRenderPass renderPass)
+		: ZPipeline(*owner, owner.getParam<ZDevice>(), owner.getParam<VkAllocationCallbacksPtr>(), layout, renderPass,
+					owner.getParam<VkPipelineBindPoint>(), owner.getParam<VkPipelineCreateFlags>(),
+					owner.getParam<std::vector<ZShaderModule>>(), owner.getParam<ZDistType<LayoutIdentifier, uint32_t>>(),
+					owner.getParam<ZDistType<Count, uint32_t>>(), ZDistType<SomeOne, std::any>(owner))
+	{
+		super::get()->routine = nullptr;
+	}
+};
+
+template<class Create>
+ZPipeline findOrCreatePipeline (ZDevice device, add_cref<Digest::value_type> key,
+								ZPipelineLayout layout, ZRenderPass renderPass, Create&& create, bool library = false)
+{
+	std::shared_ptr<PipelineRegistry>	registry	= getPipelineRegistry(device);
+	std::unique_lock<std::mutex>		lock		(registry->mutex);
+	if (auto existing = registry->pipelines[key].lock())
+	{
+		if (false == library) registry->stats.hits += 1u;
+		return ZSharedPipeline(ZPipeline(existing), layout, renderPass);
+	}
+	lock.unlock();
+
+	// Created outside of the lock, the worst case is the same pipeline created twice in parallel
+	const auto start = std::chrono::steady_clock::now();
+	ZPipeline pipeline = create();
+	const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+	lock.lock();
+	registry->stats.seconds += duration.count();
+	registry->pipelines[key] = pipeline.asSharedPtr();
+	(library ? registry->stats.libraries : registry->stats.created) += 1u;
+	if (registry->pipelines.size() >= registry->pruneSize)
+	{
+		for (auto i = registry->pipelines.begin(); i != registry->pipelines.end();)
+		{
+			i = i->second.expired() ? registry->pipelines.erase(i) : std::next(i);
+		}
+		registry->pruneSize = std::max(std::size_t(64u), (registry->pipelines.size() * 2u));
+	}
+	return pipeline;
+}
+
+// Hashes the structure itself, pNext and the other pointers must be cleared by the caller
+// and what they point to hashed separately, otherwise equal states would never match.
+template<class State>
+void updateState (add_ref<Digest> digest, State state)
+{
+	state.pNext = nullptr;
+	digest.update(&state, sizeof(state));
+}
+
+void updateShaderStage (add_ref<Digest> digest, add_cref<VkPipelineShaderStageCreateInfo> stage, ZShaderModule module)
+{
+	ASSERTMSG(module.has_handle() && *module == stage.module, "Shader module of the stage is unknown");
+	add_cref<std::array<uint8_t, 32>> code = module.getParamRef<std::array<uint8_t, 32>>();
+	digest.update(stage.stage).update(stage.flags).update(std::string(stage.pName)).update(code.data(), code.size());
+	if (add_cptr<VkSpecializationInfo> spec = stage.pSpecializationInfo; spec)
+	{
+		digest.update(spec->mapEntryCount).update(spec->pMapEntries, (spec->mapEntryCount * sizeof(VkSpecializationMapEntry)));
+		digest.update(spec->dataSize).update(spec->pData, spec->dataSize);
+	}
+	else digest.update(0u);
+}
+
+} // unnamed namespace
+
+PipelineRegistryStats getPipelineRegistryStats (ZDevice device)
+{
+	std::shared_ptr<PipelineRegistry> registry = getPipelineRegistry(device);
+	std::lock_guard<std::mutex> lock(registry->mutex);
+	return registry->stats;
+}
+
 ZPipeline createGraphicsPipeline (GraphicPipelineSettings& settings)
 {
 	VkGraphicsPipelineCreateInfo& info = settings.m_createInfo;
@@ -432,28 +549,187 @@ ZPipeline createGraphicsPipeline (GraphicPipelineSettings& settings)
 	info.basePipelineHandle	= VK_NULL_HANDLE;
 	info.basePipelineIndex	= -1;
 
-	VkPipeline					pipelineHandle	= VK_NULL_HANDLE;
-	VkPipelineCache				pipelineCache	= settings.m_pipelineCache.has_handle()
-													? *settings.m_pipelineCache
-													: VkPipelineCache(VK_NULL_HANDLE);
 	ZDevice						device			= settings.m_layout.getParam<ZDevice>();
 	add_cref<ZDeviceInterface>	di				= device.getInterface();
 	auto						callbacks		= settings.m_layout.getParam<VkAllocationCallbacksPtr>();
-	const VkResult				createStatus	=
-		VTF_CALL_CHECK(di.vkCreateGraphicsPipelines,
-							*device,
-							pipelineCache,
-							1u, &info,
-							callbacks,
-							&pipelineHandle);
-	dumpPipeline(pipelineHandle, info, std::cout);
+	add_cref<strings>			extensions		= device.getParamRef<ZDistType<EnabledDeviceExtensions, strings>>().get();
+
+	// Mesh pipelines have no vertex input state and pipelines that discard all primitives
+	// have no fragment states, neither of them is worth splitting into libraries.
+	const bool useLibraries = containsString(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME, extensions)
+		&& (0 == (info.flags & VK_PIPELINE_CREATE_LIBRARY_BIT_KHR))
+		&& (settings.findShader(VK_SHADER_STAGE_MESH_BIT_EXT) == settings.m_shaderStages.end())
+		&& (settings.findShader(VK_SHADER_STAGE_TASK_BIT_EXT) == settings.m_shaderStages.end())
+		&& (VK_FALSE == settings.m_rasterizationState.rasterizerDiscardEnable);
+	if (false == useLibraries)
+	{
+		info.flags &= ~VkPipelineCreateFlags(VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT);
+	}
+	const VkPipelineCreateFlags libraryFlags = (info.flags & ~VkPipelineCreateFlags(VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT))
+		| VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+	// The state is hashed in the four parts VK_EXT_graphics_pipeline_library splits it into,
+	// each of them also gets what its library depends on, the whole pipeline is keyed by all four.
+	const std::array<VkGraphicsPipelineLibraryFlagBitsEXT, 4> parts
+	{
+		VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT
+	};
+	std::array<Digest, 4> partDigests;
+	for (uint32_t part = 0u; part < parts.size(); ++part)
+	{
+		partDigests[part].update(parts[part]).update(libraryFlags)
+			.update(settings.m_dynamicState.dynamicStateCount)
+			.update(settings.m_dynamicStates.data(), (settings.m_dynamicState.dynamicStateCount * sizeof(VkDynamicState)))
+			.update(&info.layout, sizeof(info.layout)).update(&info.renderPass, sizeof(info.renderPass))
+			.update(info.subpass).update(settings.m_drViewMask);
+	}
+	add_ref<Digest> vertexInput			= partDigests[0];
+	add_ref<Digest> preRasterization	= partDigests[1];
+	add_ref<Digest> fragmentShader		= partDigests[2];
+	add_ref<Digest> fragmentOutput		= partDigests[3];
+	auto isFragmentStage = [](add_cref<VkPipelineShaderStageCreateInfo> stage)
+	{
+		return VK_SHADER_STAGE_FRAGMENT_BIT == stage.stage;
+	};
+
+	for (add_cref<VkPipelineShaderStageCreateInfo> stage : settings.m_shaderStages)
+	{
+		updateShaderStage((isFragmentStage(stage) ? fragmentShader : preRasterization),
+						  stage, settings.m_shaderModules.at(stage.stage));
+	}
+	{
+		add_cref<VkPipelineVertexInputStateCreateInfo> vi = settings.m_vertexInputState;
+		vertexInput.update(vi.flags)
+			  .update(vi.vertexBindingDescriptionCount)
+			  .update(vi.pVertexBindingDescriptions,
+					  (vi.vertexBindingDescriptionCount * sizeof(VkVertexInputBindingDescription)))
+			  .update(vi.vertexAttributeDescriptionCount)
+			  .update(vi.pVertexAttributeDescriptions,
+					  (vi.vertexAttributeDescriptionCount * sizeof(VkVertexInputAttributeDescription)));
+	}
+	updateState(vertexInput, settings.m_assemblyState);
+	if (info.pTessellationState)
+	{
+		updateState(preRasterization, settings.m_tessellationState);
+	}
+	{
+		VkPipelineViewportStateCreateInfo viewportState = settings.m_viewportState;
+		if (viewportState.pViewports) preRasterization.update(&settings.m_viewport, sizeof(settings.m_viewport));
+		if (viewportState.pScissors) preRasterization.update(&settings.m_scissor, sizeof(settings.m_scissor));
+		viewportState.pViewports = nullptr;
+		viewportState.pScissors = nullptr;
+		updateState(preRasterization, viewportState);
+	}
+	updateState(preRasterization, settings.m_rasterizationState);
+	{
+		VkPipelineMultisampleStateCreateInfo multisampleState = settings.m_multisampleState;
+		if (multisampleState.pSampleMask)
+		{
+			const uint32_t words = (uint32_t(multisampleState.rasterizationSamples) + 31u) / 32u;
+			fragmentShader.update(multisampleState.pSampleMask, (words * sizeof(VkSampleMask)));
+			fragmentOutput.update(multisampleState.pSampleMask, (words * sizeof(VkSampleMask)));
+			multisampleState.pSampleMask = nullptr;
+		}
+		updateState(fragmentShader, multisampleState);
+		updateState(fragmentOutput, multisampleState);
+	}
+	updateState(fragmentShader, settings.m_depthStencilState);
+	fragmentShader.update(settings.m_drInputAttachmentIndices);
+	{
+		VkPipelineColorBlendStateCreateInfo blendState = settings.m_blendState;
+		blendState.pAttachments = nullptr;
+		updateState(fragmentOutput, blendState);
+		fragmentOutput.update(settings.m_blendAttachments);
+	}
+	fragmentOutput.update(drFormats).update(settings.m_drAttachmentLocations);
+
+	std::array<Digest::value_type, 4> partKeys;
+	Digest digest;
+	digest.update(VK_PIPELINE_BIND_POINT_GRAPHICS).update(info.flags).update(info.stageCount);
+	for (uint32_t part = 0u; part < parts.size(); ++part)
+	{
+		partKeys[part] = partDigests[part].finish();
+		digest.update(partKeys[part].data(), partKeys[part].size());
+	}
 
-	VKASSERT(createStatus);
+	auto createPipeline = [&](add_cref<VkGraphicsPipelineCreateInfo> createInfo, add_cref<std::any> owner)
+	{
+		VkPipeline					pipelineHandle	= VK_NULL_HANDLE;
+		VkPipelineCache				pipelineCache	= settings.m_pipelineCache.has_handle()
+														? *settings.m_pipelineCache
+														: deviceGetPipelineCache(device);
+		const VkResult				createStatus	=
+			VTF_CALL_CHECK(di.vkCreateGraphicsPipelines,
+								*device,
+								pipelineCache,
+								1u, &createInfo,
+								callbacks,
+								&pipelineHandle);
+		dumpPipeline(pipelineHandle, createInfo, std::cout);
+
+		VKASSERT(createStatus);
+
+		return ZPipeline::create(pipelineHandle, device, callbacks, settings.m_layout,
+								 settings.m_renderPass, VK_PIPELINE_BIND_POINT_GRAPHICS, createInfo.flags,
+								 {/*ray-tracing shaders*/}, {/*uint32_t:ray-tracing pipeline shader group order*/},
+								 {/*uint32_t:rau-tracing pipeline shader group count*/}, owner);
+	};
 
-	return ZPipeline::create(pipelineHandle, device, callbacks, settings.m_layout,
-							 settings.m_renderPass, VK_PIPELINE_BIND_POINT_GRAPHICS, info.flags,
-							 {/*ray-tracing shaders*/}, {/*uint32_t:ray-tracing pipeline shader group order*/},
-							 {/*uint32_t:rau-tracing pipeline shader group count*/});
+	return findOrCreatePipeline(device, digest.finish(), settings.m_layout, settings.m_renderPass, [&]()
+	{
+		if (false == useLibraries)
+		{
+			return createPipeline(info, std::any());
+		}
+
+		// Every library is created from the whole state, the part it describes is selected by its flags,
+		// only the shader stages have to be filtered. The same library is reused by all pipelines
+		// whose state of that part is identical, so only the parts that differ are compiled again.
+		std::vector<ZPipeline> libraries;
+		for (uint32_t part = 0u; part < parts.size(); ++part)
+		{
+			libraries.push_back(findOrCreatePipeline(device, partKeys[part], settings.m_layout, settings.m_renderPass, [&]()
+			{
+				std::vector<VkPipelineShaderStageCreateInfo> stages;
+				for (add_cref<VkPipelineShaderStageCreateInfo> stage : settings.m_shaderStages)
+				{
+					if ((VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT == parts[part] && !isFragmentStage(stage))
+						|| (VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT == parts[part] && isFragmentStage(stage)))
+					{
+						stages.push_back(stage);
+					}
+				}
+				VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo = makeVkStruct();
+				libraryInfo.pNext	= info.pNext;
+				libraryInfo.flags	= VkGraphicsPipelineLibraryFlagsEXT(parts[part]);
+
+				VkGraphicsPipelineCreateInfo createInfo = info;
+				createInfo.pNext		= &libraryInfo;
+				createInfo.flags		= libraryFlags;
+				createInfo.stageCount	= data_count(stages);
+				createInfo.pStages		= data_or_null(stages);
+				return createPipeline(createInfo, std::any());
+			}, true));
+		}
+
+		std::vector<VkPipeline> handles(libraries.size());
+		std::transform(libraries.begin(), libraries.end(), handles.begin(), [](ZPipeline library) { return *library; });
+		VkPipelineLibraryCreateInfoKHR linkInfo = makeVkStruct();
+		linkInfo.libraryCount	= data_count(handles);
+		linkInfo.pLibraries		= handles.data();
+
+		// Linking is cheap unless link time optimization has been requested with the flags
+		VkGraphicsPipelineCreateInfo createInfo = makePipelineCreateInfo();
+		createInfo.pNext				= &linkInfo;
+		createInfo.flags				= info.flags;
+		createInfo.layout				= info.layout;
+		createInfo.basePipelineHandle	= VK_NULL_HANDLE;
+		createInfo.basePipelineIndex	= -1;
+		return createPipeline(createInfo, std::any(libraries));
+	});
 }
 
 void updateSettings (add_ref<GraphicPipelineSettings>) { /* end of template recursion */ }
@@ -467,6 +743,7 @@ void updateKnownSettings (add_ref<GraphicPipelineSettings> settings, ZShaderModu
 {
 	if (false == shaderModule.has_handle()) return;
 	const VkShaderStageFlagBits stage = shaderModule.getParam<VkShaderStageFlagBits>();
+	settings.m_shaderModules[stage] = shaderModule;
 	auto i = settings.findShader(stage);
 	if (i != settings.m_shaderStages.end())
 	{
@@ -773,15 +1050,22 @@ ZPipeline createComputePipelineImpl (
 	ci.basePipelineHandle	= VK_NULL_HANDLE;
 	ci.basePipelineIndex	= 0;
 
-	VkPipelineCache cache = pipelineCache.has_handle() ? *pipelineCache : VK_NULL_HANDLE;
-	ZPipeline	computePipeline (VK_NULL_HANDLE, aDevice, callbacks, layout, ZRenderPass(),
-								 VK_PIPELINE_BIND_POINT_COMPUTE, ci.flags,
-								 {/*ray-tracing shaders*/}, {/*uint32_t:ray-tracing pipeline shader group order*/},
-								 {/*uint32_t:ray-tracing pipeline shader group count*/});
-	VKASSERTMSG(VTF_CALL_CHECK(di.vkCreateComputePipelines, *aDevice, cache, 1u, &ci, callbacks,
-				computePipeline.setter("vkCreateComputePipelines")), "Unable to create compute pipeline");
+	Digest digest;
+	digest.update(VK_PIPELINE_BIND_POINT_COMPUTE).update(ci.flags).update(&ci.layout, sizeof(ci.layout));
+	updateShaderStage(digest, sci, computeShaderModule);
 
-	return computePipeline;
+	return findOrCreatePipeline(aDevice, digest.finish(), layout, ZRenderPass(), [&]()
+	{
+		VkPipelineCache cache = pipelineCache.has_handle() ? *pipelineCache : deviceGetPipelineCache(aDevice);
+		ZPipeline	computePipeline (VK_NULL_HANDLE, aDevice, callbacks, layout, ZRenderPass(),
+									 VK_PIPELINE_BIND_POINT_COMPUTE, ci.flags,
+									 {/*ray-tracing shaders*/}, {/*uint32_t:ray-tracing pipeline shader group order*/},
+									 {/*uint32_t:ray-tracing pipeline shader group count*/}, {/*owner*/});
+		VKASSERTMSG(VTF_CALL_CHECK(di.vkCreateComputePipelines, *aDevice, cache, 1u, &ci, callbacks,
+					computePipeline.setter("vkCreateComputePipelines")), "Unable to create compute pipeline");
+
+		return computePipeline;
+	});
 }
 
 ZPipeline createComputePipeline (ZPipelineCache pipelineCache, ZPipelineLayout layout, ZShaderModule computeShaderModule,
@@ -795,6 +1079,58 @@ ZPipelineLayout	pipelineGetLayout (ZPipeline pipeline)
 	return pipeline.getParam<ZPipelineLayout>();
 }
 
+PipelineVariants::PipelineVariants (add_ref<TaskScheduler> scheduler)
+	: m_mutex		()
+	, m_pipelines	()
+	, m_group		(scheduler)
+{
+}
+
+void PipelineVariants::add (std::function<ZPipeline()>&& create)
+{
+	// Elements of a deque stay where they are when others are appended
+	add_ptr<ZPipeline> pipeline = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		pipeline = &m_pipelines.emplace_back();
+	}
+	m_group.run([this, pipeline, create = std::move(create)]()
+	{
+		ZPipeline result = create();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		*pipeline = result;
+	});
+}
+
+void PipelineVariants::addCompute (ZPipelineLayout layout, ZShaderModule module, add_cref<ZSpecializationInfo> specInfo)
+{
+	add([layout, module, specInfo]() mutable
+	{
+		return createComputePipeline(layout, module, specInfo);
+	});
+}
+
+void PipelineVariants::addGraphics (std::shared_ptr<GraphicPipelineSettings> settings)
+{
+	add([settings]()
+	{
+		return createGraphicsPipeline(*settings);
+	});
+}
+
+uint32_t PipelineVariants::count () const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return data_count(m_pipelines);
+}
+
+auto PipelineVariants::wait () -> std::vector<ZPipeline>
+{
+	m_group.wait();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return std::vector<ZPipeline>(m_pipelines.begin(), m_pipelines.end());
+}
+
 ZPipelineCache createPipelineCache (
 	ZDevice device,
 	add_cref<std::string> cacheFileName,
@@ -836,4 +1172,181 @@ ZPipelineCache createPipelineCache (
 	return cache;
 }
 
+namespace
+{
+
+struct DevicePipelineCache
+{
+	VkPipelineCache					handle;
+	VkAllocationCallbacksPtr		callbacks;
+	VkPipelineCacheHeaderVersionOne	header;
+	fs::path						path;
+	bool							verbose;
+};
+struct DevicePipelineCaches
+{
+	std::mutex								mutex;
+	std::map<VkDevice, DevicePipelineCache>	caches;
+};
+// Never destroyed, devices kept in static objects may go away at exit after this translation unit
+add_ref<DevicePipelineCaches> getDevicePipelineCaches ()
+{
+	static add_ptr<DevicePipelineCaches> caches = new DevicePipelineCaches;
+	return *caches;
+}
+
+// Returns the content of the cache file only if it was saved by the same device and driver
+std::vector<char> readPipelineCacheFile (add_cref<DevicePipelineCache> cache)
+{
+	std::vector<char> data;
+	if (readFile(cache.path, data) == INVALID_UINT32)
+	{
+		return {};
+	}
+
+	VkPipelineCacheHeaderVersionOne header{};
+	if (data.size() >= sizeof(header))
+	{
+		std::memcpy(&header, data.data(), sizeof(header));
+	}
+	const bool matches = header.headerSize >= sizeof(header)
+		&& header.headerSize <= data.size()
+		&& header.headerVersion == cache.header.headerVersion
+		&& header.vendorID == cache.header.vendorID
+		&& header.deviceID == cache.header.deviceID
+		&& 0 == std::memcmp(header.pipelineCacheUUID, cache.header.pipelineCacheUUID, VK_UUID_SIZE);
+	if (false == matches)
+	{
+		if (cache.verbose)
+		{
+			std::cout << "[INFO] Pipeline cache " << cache.path << " does not match the device, ignored" << std::endl;
+		}
+		return {};
+	}
+	return data;
+}
+
+} // unnamed namespace
+
+VkPipelineCache deviceGetPipelineCache (ZDevice device)
+{
+	add_cref<GlobalAppFlags> gf = getGlobalAppFlags();
+	if (false == gf.pipelineCache)
+	{
+		return VK_NULL_HANDLE;
+	}
+
+	add_ref<DevicePipelineCaches> registry = getDevicePipelineCaches();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	if (auto entry = registry.caches.find(*device); entry != registry.caches.end())
+	{
+		return entry->second.handle;
+	}
+
+	add_cref<VkPhysicalDeviceProperties> props = deviceGetPhysicalProperties(device);
+	DevicePipelineCache cache{};
+	cache.callbacks = device.getParam<VkAllocationCallbacksPtr>();
+	cache.header.headerSize = uint32_t(sizeof(VkPipelineCacheHeaderVersionOne));
+	cache.header.headerVersion = VK_PIPELINE_CACHE_HEADER_VERSION_ONE;
+	cache.header.vendorID = props.vendorID;
+	cache.header.deviceID = props.deviceID;
+	std::memcpy(cache.header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE);
+	cache.verbose = gf.verbose != 0u;
+
+	std::ostringstream name;
+	name << "vtf-pipeline-cache-" << std::hex << std::setfill('0')
+		 << std::setw(4) << props.vendorID << '-' << std::setw(4) << props.deviceID << '-'
+		 << std::setw(8) << props.driverVersion << '-';
+	for (uint32_t i = 0u; i < VK_UUID_SIZE; ++i)
+	{
+		name << std::setw(2) << uint32_t(props.pipelineCacheUUID[i]);
+	}
+	name << ".bin";
+	const fs::path tmpPath = std::strlen(gf.tmpDir) ? fs::path(gf.tmpDir) : fs::temp_directory_path();
+	cache.path = tmpPath / name.str();
+
+	const std::vector<char> data = readPipelineCacheFile(cache);
+	VkPipelineCacheCreateInfo pcci{};
+	pcci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	pcci.initialDataSize = data.size();
+	pcci.pInitialData = data_or_null(data);
+
+	add_cref<ZDeviceInterface> di = device.getInterface();
+	VKASSERT(VTF_CALL_CHECK(di.vkCreatePipelineCache, *device, &pcci, cache.callbacks, &cache.handle));
+	registry.caches.emplace(*device, cache);
+
+	return cache.handle;
+}
+
+void deviceReleasePipelineCache (VkDevice device)
+{
+	DevicePipelineCache cache{};
+	{
+		add_ref<DevicePipelineCaches> registry = getDevicePipelineCaches();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		auto entry = registry.caches.find(device);
+		if (entry == registry.caches.end()) return;
+		cache = entry->second;
+		registry.caches.erase(entry);
+	}
+
+	// The device is being destroyed, so failures are reported rather than thrown
+	add_cref<ZDeviceInterface> di = ZDeviceSingleton().getInterface();
+
+	// Other runs could have saved their pipelines since this cache was loaded, they are kept too
+	if (const std::vector<char> saved = readPipelineCacheFile(cache); saved.size())
+	{
+		VkPipelineCacheCreateInfo pcci{};
+		pcci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		pcci.initialDataSize = saved.size();
+		pcci.pInitialData = saved.data();
+		VkPipelineCache savedCache = VK_NULL_HANDLE;
+		if (VK_SUCCESS == VTF_CALL_CHECK(di.vkCreatePipelineCache, device, &pcci, cache.callbacks, &savedCache))
+		{
+			VTF_CALL_CHECK(di.vkMergePipelineCaches, device, cache.handle, 1u, &savedCache);
+			VTF_CALL_CHECK(di.vkDestroyPipelineCache, device, savedCache, cache.callbacks);
+		}
+	}
+
+	size_t dataSize = 0u;
+	std::vector<char> data;
+	VkResult result = VTF_CALL_CHECK(di.vkGetPipelineCacheData, device, cache.handle, &dataSize, nullptr);
+	if (VK_SUCCESS == result && dataSize)
+	{
+		data.resize(dataSize);
+		result = VTF_CALL_CHECK(di.vkGetPipelineCacheData, device, cache.handle, &dataSize, data.data());
+	}
+	VTF_CALL_CHECK(di.vkDestroyPipelineCache, device, cache.handle, cache.callbacks);
+
+	if (VK_SUCCESS != result || 0u == dataSize)
+	{
+		return;
+	}
+
+	// Written aside and renamed, so concurrent runs never load half of the file
+	std::ostringstream suffix;
+	suffix << '.' << std::this_thread::get_id() << '.'
+		   << std::chrono::high_resolution_clock::now().time_since_epoch().count() << ".tmp";
+	const fs::path tmpPath(cache.path.string() + suffix.str());
+	bool written = false;
+	{
+		std::ofstream file(tmpPath, std::ios::binary);
+		if (file.is_open())
+		{
+			file.write(data.data(), std::streamsize(dataSize));
+			written = file.good();
+		}
+	}
+	std::error_code ec;
+	if (written)
+	{
+		fs::rename(tmpPath, cache.path, ec);
+	}
+	if (false == written || ec)
+	{
+		fs::remove(tmpPath, ec);
+		std::cout << "[WARNING] Unable to save pipeline cache to " << cache.path << std::endl;
+	}
+}
+
 } // namespace vtf
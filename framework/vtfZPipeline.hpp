@@ -6,6 +6,8 @@
 #include "vtfDSBMgr.hpp"
 #include "vtfVertexInput.hpp"
 #include "vtfZSpecializationInfo.hpp"
+#include "vtfTaskScheduler.hpp"
+#include <deque>
 #include <memory>
 #include <tuple>
 
@@ -131,8 +133,25 @@ void updateSettings (add_ref<GraphicPipelineSettings> settings, Y&& param, X&&..
 
 std::shared_ptr<GraphicPipelineSettings> makeGraphicsPipelineSettings (ZPipelineLayout layout);
 
+// Graphics and compute pipelines are registered per device under a digest of their whole create state,
+// shader modules are represented by their SPIR-V digest, layouts and render passes by their handles.
+// Requesting an identical pipeline again returns the existing one as long as it is alive,
+// the returned object carries the layout and render pass of the current request though.
+// With VK_EXT_graphics_pipeline_library enabled on the device a graphics pipeline is linked from
+// vertex input, pre-rasterization, fragment shader and fragment output libraries registered the same
+// way per their part of the state, VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT in the create
+// flags makes the link optimized, otherwise the flag is ignored and the pipeline is created at once.
 ZPipeline createGraphicsPipeline (add_ref<GraphicPipelineSettings> settings);
 
+struct PipelineRegistryStats
+{
+	uint32_t	created;	// pipelines actually created by the driver
+	uint32_t	hits;		// requests satisfied by an existing pipeline
+	uint32_t	libraries;	// graphics pipeline libraries created for the pipelines above
+	double		seconds;	// spent creating all of them, summed over the threads that did it
+};
+PipelineRegistryStats getPipelineRegistryStats (ZDevice device);
+
 template<class... X>
 ZPipeline createGraphicsPipeline (ZPipelineLayout layout, X&&... params)
 {
@@ -199,6 +218,44 @@ ZPipeline createComputePipeline (
 
 ZPipelineLayout	pipelineGetLayout (ZPipeline pipeline);
 
+/**
+ * @brief Pipeline variants compiled in advance on the shared TaskScheduler.
+ * @note  Variants are created through the same per device registry as any other pipeline,
+ *        hence once a variant is ready the regular createComputePipeline() or createGraphicsPipeline()
+ *        call with the same shader, specialization data and state returns it without compiling.
+ *        The registry refers to pipelines weakly, so this object keeps the variants alive.
+ *        Compilation runs while the calling thread records commands, wait() is only needed
+ *        to get the pipelines or the first exception thrown while creating them.
+ */
+class PipelineVariants
+{
+public:
+	PipelineVariants (add_ref<TaskScheduler> scheduler = TaskScheduler::instance());
+
+	// Each variant gets its own copy of the specialization info
+	void	addCompute	(ZPipelineLayout layout, ZShaderModule module, add_cref<ZSpecializationInfo> specInfo);
+	// Neither the settings nor the specialization infos they refer to may change until wait() returns
+	void	addGraphics	(std::shared_ptr<GraphicPipelineSettings> settings);
+	template<class... X>
+	void	addGraphics	(ZPipelineLayout layout, X&&... params)
+	{
+		std::shared_ptr<GraphicPipelineSettings> settings = makeGraphicsPipelineSettings(layout);
+		updateSettings(*settings, std::forward<X>(params)...);
+		addGraphics(settings);
+	}
+
+	uint32_t	count	() const;
+	// Pipelines in the order the variants were added
+	auto		wait	() -> std::vector<ZPipeline>;
+
+private:
+	void		add		(std::function<ZPipeline()>&& create);
+
+	mutable std::mutex		m_mutex;
+	std::deque<ZPipeline>	m_pipelines;
+	TaskGroup				m_group;	// the last one, it waits for the tasks before the rest is gone
+};
+
 ZPipelineCache createPipelineCache (
 	ZDevice						device,
 	add_cref<std::string>		cacheFileName,
@@ -206,6 +263,15 @@ ZPipelineCache createPipelineCache (
 	bool						saveOnDestroy = true,
 	VkPipelineCacheCreateFlags	flags = VkPipelineCacheCreateFlags(0));
 
+// Pipeline cache of the device used by all pipeline creation paths whenever no cache is given explicitly.
+// It is loaded from the temp directory when the device is created, the file name is made from vendor,
+// device, driver version and pipelineCacheUUID, and data with a mismatched header is ignored.
+// Returns VK_NULL_HANDLE if disabled with -nopipecache.
+VkPipelineCache deviceGetPipelineCache (ZDevice device);
+// Merges the cache with the file saved by other runs in the meantime, saves and destroys it,
+// called right before the device is destroyed.
+void deviceReleasePipelineCache (VkDevice device);
+
 } // namespace vtf
 
 #endif // __VTF_ZPIPELINE_HPP_INCLUDED__
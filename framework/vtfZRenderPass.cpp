@@ -197,7 +197,7 @@ ZRenderPass createRenderPassImpl (ZDevice device, ZAttachmentPool pool,
 
     const VkAllocationCallbacksPtr	callbacks = device.getParam<VkAllocationCallbacksPtr>();
     ZRenderPass	renderPass = ZRenderPass::create(VK_NULL_HANDLE, device, callbacks, 1,
-        c.attachmentCount, c.subpassCount, clearValues, std::any(pool), {/*subpassDescriptions*/ });
+        c.attachmentCount, c.subpassCount, clearValues, std::any(pool), {/*subpassDescriptions*/ }, {/*owner*/});
 
     renderPass.verbose(getGlobalAppFlags().verbose);
     add_ref<std::vector<ZDistType<SomeTwo, std::any>>> ss =
@@ -207,11 +207,7 @@ ZRenderPass createRenderPassImpl (ZDevice device, ZAttachmentPool pool,
         ss.push_back(std::any(pSubpasses[i]));
     }
 
-    add_cref<ZDeviceInterface> di = device.getInterface();
-    ASSERTMSG(di.vkCreateRenderPass, "vkCreateRenderPass() must not be null");
-    VKASSERT(di.vkCreateRenderPass(*device, &c, callbacks, renderPass.setter()));
-
-    return renderPass;
+    return details::findOrCreateRenderPass(renderPass, c);
 }
 
 ZFramebuffer _createFramebuffer (VkImage presentImage, ZRenderPass renderpass,
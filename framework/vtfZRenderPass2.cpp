@@ -3,6 +3,7 @@
 #include "vtfStructUtils.hpp"
 #include "vtfZImage.hpp"
 #include "vtfBacktrace.hpp"
+#include "vtfObjectCache.hpp"
 
 namespace vtf
 {
@@ -400,8 +401,111 @@ return createRenderPassImpl(device, descriptions, ARRAY_LENGTH_CAST(descriptions
 const std::array<VkSubpassDescription, 1 + sizeof...(SubpassDescClass)> a{desc(), others()...};
 */
 
+namespace
+{
+// Skips sType and pNext, the framework chains nothing to render pass structures
+template<class S, class M>
+void updateFrom (add_ref<Digest> digest, add_cref<S> s, add_cref<M> first)
+{
+    const std::size_t offset = std::size_t(reinterpret_cast<add_cptr<uint8_t>>(&first) - reinterpret_cast<add_cptr<uint8_t>>(&s));
+    digest.update(&first, (sizeof(S) - offset));
+}
+
+template<class Reference>
+void updateReferences (add_ref<Digest> digest, uint32_t count, add_cptr<Reference> references)
+{
+    digest.update(count);
+    for (uint32_t i = 0u; i < count; ++i)
+    {
+        updateFrom(digest, references[i], references[i].attachment);
+    }
+}
+
+template<class RenderPassCreateInfo>
+Digest::value_type makeRenderPassKey (int version, add_cref<RenderPassCreateInfo> info)
+{
+    constexpr bool v2 = std::is_same_v<RenderPassCreateInfo, VkRenderPassCreateInfo2>;
+    Digest digest;
+    digest.update(VK_OBJECT_TYPE_RENDER_PASS).update(version).update(info.flags).update(info.attachmentCount);
+    for (uint32_t i = 0u; i < info.attachmentCount; ++i)
+    {
+        updateFrom(digest, info.pAttachments[i], info.pAttachments[i].flags);
+    }
+    digest.update(info.subpassCount);
+    for (uint32_t i = 0u; i < info.subpassCount; ++i)
+    {
+        add_cref<std::remove_pointer_t<decltype(info.pSubpasses)>> subpass = info.pSubpasses[i];
+        digest.update(subpass.flags).update(subpass.pipelineBindPoint);
+        if constexpr (v2) digest.update(subpass.viewMask);
+        updateReferences(digest, subpass.inputAttachmentCount, subpass.pInputAttachments);
+        updateReferences(digest, subpass.colorAttachmentCount, subpass.pColorAttachments);
+        updateReferences(digest, (subpass.pResolveAttachments ? subpass.colorAttachmentCount : 0u), subpass.pResolveAttachments);
+        updateReferences(digest, (subpass.pDepthStencilAttachment ? 1u : 0u), subpass.pDepthStencilAttachment);
+        digest.update(subpass.preserveAttachmentCount)
+              .update(subpass.pPreserveAttachments, (subpass.preserveAttachmentCount * sizeof(uint32_t)));
+    }
+    digest.update(info.dependencyCount);
+    for (uint32_t i = 0u; i < info.dependencyCount; ++i)
+    {
+        updateFrom(digest, info.pDependencies[i], info.pDependencies[i].srcSubpass);
+    }
+    if constexpr (v2)
+    {
+        digest.update(info.correlatedViewMaskCount)
+              .update(info.pCorrelatedViewMasks, (info.correlatedViewMaskCount * sizeof(uint32_t)));
+    }
+    return digest.finish();
+}
+
+struct ZSharedRenderPass : ZRenderPass
+{
+    ZSharedRenderPass (ZRenderPass renderPass, ZRenderPass owner)
+        : ZRenderPass(renderPass)
+    {
+        // The handle is destroyed by the owner, which is kept alive by this render pass
+        getParamRef<ZDistType<SomeThree, std::any>>() = ZDistType<SomeThree, std::any>(std::any(owner));
+        super::get()->routine = nullptr;
+        super::get()->handle = *owner;
+    }
+};
+
+template<class RenderPassCreateInfo, class Create>
+ZRenderPass findOrCreateRenderPassImpl (ZRenderPass renderPass, add_cref<RenderPassCreateInfo> info, Create&& create)
+{
+    ZDevice device = renderPass.getParam<ZDevice>();
+    const Digest::value_type key = makeRenderPassKey(renderPass.getParam<int>(), info);
+    ZRenderPass owner = objectCacheFindOrCreate<ZRenderPass>(device, key, [&]()
+    {
+        create(device, renderPass);
+        return renderPass;
+    });
+    return renderPass.has_handle() ? renderPass : ZSharedRenderPass(renderPass, owner);
+}
+} // unnamed namespace
+
 namespace details
 {
+ZRenderPass findOrCreateRenderPass (ZRenderPass renderPass, add_cref<VkRenderPassCreateInfo> info)
+{
+    return findOrCreateRenderPassImpl(renderPass, info, [&](ZDevice device, ZRenderPass rp)
+    {
+        add_cref<ZDeviceInterface> di = device.getInterface();
+        ASSERTMSG(di.vkCreateRenderPass, "vkCreateRenderPass() must not be null");
+        VKASSERT(di.vkCreateRenderPass(*device, &info, device.getParam<VkAllocationCallbacksPtr>(), rp.setter()));
+    });
+}
+
+ZRenderPass findOrCreateRenderPass (ZRenderPass renderPass, add_cref<VkRenderPassCreateInfo2> info)
+{
+    return findOrCreateRenderPassImpl(renderPass, info, [&](ZDevice device, ZRenderPass rp)
+    {
+        add_cref<ZDeviceInterface> di = device.getInterface();
+        ASSERTMSG(di.vkCreateRenderPass2, "vkCreateRenderPass2() must not be null, "
+            "you need ", VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME, " or Vulkan 1.2");
+        VKASSERT(di.vkCreateRenderPass2(*device, &info, device.getParam<VkAllocationCallbacksPtr>(), rp.setter()));
+    });
+}
+
 void pushRenderpassParams (
     add_ref<std::vector<ZSubpassDescription2>> descs,
     add_ref<std::vector<ZSubpassDependency2>> deps)
@@ -552,7 +656,7 @@ ZRenderPass createRenderPassImpl2 (ZDevice device, ZAttachmentPool pool,
     const VkAllocationCallbacksPtr	callbacks = device.getParam<VkAllocationCallbacksPtr>();
     ZRenderPass	renderPass = ZRenderPass::create(VK_NULL_HANDLE, device, callbacks, 2,
                                                     c.attachmentCount, c.subpassCount,
-                                                    clearValues, std::any(pool), {/*subpassDescriptions*/});
+                                                    clearValues, std::any(pool), {/*subpassDescriptions*/}, {/*owner*/});
 
     renderPass.verbose(getGlobalAppFlags().verbose);
     add_ref<std::vector<ZDistType<SomeTwo, std::any>>> ss =
@@ -562,12 +666,7 @@ ZRenderPass createRenderPassImpl2 (ZDevice device, ZAttachmentPool pool,
         ss.push_back(std::any(pSubpasses[i]));
     }
 
-    add_cref<ZDeviceInterface> di = device.getInterface();
-    ASSERTMSG(di.vkCreateRenderPass2, "vkCreateRenderPass2() must not be null, "
-        "you need ", VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME, " or Vulkan 1.2");
-    VKASSERT(di.vkCreateRenderPass2(*device, &c, callbacks, renderPass.setter()));
-
-    return renderPass;
+    return details::findOrCreateRenderPass(renderPass, c);
 }
 
 uint32_t renderPassGetAttachmentCount (ZRenderPass renderPass, uint32_t subpass)
@@ -140,6 +140,10 @@ void pushRenderpassParam (
 void pushRenderpassParams(
 	add_ref<std::vector<ZSubpassDescription2>> descs,
 	add_ref<std::vector<ZSubpassDependency2>> deps);
+// Creates the render pass or makes it share the handle of an existing one created from an identical
+// create info, the render pass keeps its own clear values, attachment pool and subpasses either way.
+ZRenderPass findOrCreateRenderPass (ZRenderPass renderPass, add_cref<VkRenderPassCreateInfo> info);
+ZRenderPass findOrCreateRenderPass (ZRenderPass renderPass, add_cref<VkRenderPassCreateInfo2> info);
 
 template<class SubpassDescOrDep, class... SubpassDescsOrDeps>
 void pushRenderpassParams (
@@ -43,7 +43,7 @@ ZDevice getSharedDevice()
 		qs[1].queueCount = 1;
 		qs[1].queues.set(0);
 
-		ZDevice device(p->device, getAllocationCallbacks(), phys, 1, qs);
+		ZDevice device(p->device, getAllocationCallbacks(), phys, 1, qs, {/*enabled extensions are unknown*/});
 
 		struct AInstance : public ZInstance {
 			struct ADevice : public ZDevice {
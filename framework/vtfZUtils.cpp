@@ -7,9 +7,12 @@
 #include "vtfZImage.hpp"
 #include "vtfZBuffer.hpp"
 #include "vtfZDeviceMemory.hpp"
+#include "vtfZPipeline.hpp"
 #include "vtfZCommandBuffer.hpp"
 #include "vtfDebugMessenger.hpp"
 #include "vtfBacktrace.hpp"
+#include "vtfDigest.hpp"
+#include "vtfObjectCache.hpp"
 #include "vtfThreadSafeLogger.hpp"
 #include "vtfProgressRecorder.hpp"
 #include "vtfVulkanDriver.hpp"
@@ -91,7 +94,8 @@ ZShaderModule createShaderModule (
 
 	// If this is RT shader then last tuple consists of <shader-collection-id, shader-group-index>
 	return ZShaderModule::create(shaderModule, device, callbacks, stage, entryName,
-								{ INVALID_UINT32, INVALID_UINT32, INVALID_UINT32, INVALID_UINT32 });
+								{ INVALID_UINT32, INVALID_UINT32, INVALID_UINT32, INVALID_UINT32 },
+								Digest::make(pCode, codeSize));
 }
 
 ZFramebuffer createFramebuffer (ZRenderPass renderPass, add_cref<VkExtent2D> size,
@@ -131,10 +135,25 @@ ZFramebuffer createFramebuffer (ZRenderPass renderPass, uint32_t width, uint32_t
 	framebufferInfo.height			= height;
 	framebufferInfo.layers			= 1;
 
-	add_cref<ZDeviceInterface> di = device.getInterface();
-	VKASSERT(VTF_CALL_CHECK(di.vkCreateFramebuffer, *device, &framebufferInfo, allocationCallbacks, &framebuffer));
+	// The render pass object is a part of the key, its parameters are those of the request it has been created for
+	const auto renderPassObject = renderPass.object().first;
+	Digest digest;
+	digest.update(VK_OBJECT_TYPE_FRAMEBUFFER).update(&renderPassObject, sizeof(renderPassObject))
+		  .update(&framebufferInfo.renderPass, sizeof(framebufferInfo.renderPass))
+		  .update(width).update(height).update(attachmentCount).update(data_count(attachments));
+	for (add_cref<ZImageView> attachment : attachments)
+	{
+		const auto viewObject = attachment.object().first;
+		const VkImageView view = attachment.handle();
+		digest.update(&viewObject, sizeof(viewObject)).update(&view, sizeof(view));
+	}
 
-	return ZFramebuffer::create(framebuffer, device, allocationCallbacks, width, height, renderPass, attachments, attachmentCount);
+	return objectCacheFindOrCreate<ZFramebuffer>(device, digest.finish(), [&]()
+	{
+		add_cref<ZDeviceInterface> di = device.getInterface();
+		VKASSERT(VTF_CALL_CHECK(di.vkCreateFramebuffer, *device, &framebufferInfo, allocationCallbacks, &framebuffer));
+		return ZFramebuffer::create(framebuffer, device, allocationCallbacks, width, height, renderPass, attachments, attachmentCount);
+	});
 }
 
 ZRenderPassBeginInfo::ZRenderPassBeginInfo (ZCommandBuffer cmd, ZFramebuffer framebuffer,
@@ -690,6 +709,32 @@ ZDevice createLogicalDevice	(
 	}
 	deviceCaps.addUpdateFeatureIf(&VkPhysicalDeviceFeatures::fragmentStoresAndAtomics);
 	deviceCaps.addUpdateFeatureIf(&VkPhysicalDeviceFeatures::vertexPipelineStoresAndAtomics);
+	// Graphics pipelines are then linked from libraries cached per stage state, see vtfZPipeline.cpp
+	if (containsString(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME, requiredExtensions))
+	{
+		if (deviceCaps.addUpdateFeatureIf(&VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT::graphicsPipelineLibrary))
+		{
+			mergeStringsDistinct(requiredExtensions, strings{ VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME });
+		}
+		else
+		{
+			// Advertised but not usable, pipelines are created monolithically then
+			removeStrings({ VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME }, requiredExtensions);
+		}
+	}
+	// Canvas paces its frames in flight with a timeline semaphore if it is there, see vtfCanvas.cpp
+	if (false == containsString(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, gf.excludedDevExtensions)
+		&& containsString(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, availableExtensions))
+	{
+		VkPhysicalDeviceVulkan12Features vulkan12Features = makeVkStruct();
+		const bool enabled = deviceCaps.getFeature(vulkan12Features)
+			? deviceCaps.addUpdateFeatureIf(&VkPhysicalDeviceVulkan12Features::timelineSemaphore)
+			: deviceCaps.addUpdateFeatureIf(&VkPhysicalDeviceTimelineSemaphoreFeatures::timelineSemaphore);
+		if (enabled)
+		{
+			mergeStringsDistinct(requiredExtensions, strings{ VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME });
+		}
+	}
 
 
 	//if (enableDebugPrintf)
@@ -772,7 +817,8 @@ ZDevice createLogicalDevice	(
 	const VkResult createResult = pfnInstanceCreateDevice(*physDevice, &createInfo, callbacks, &deviceHandle);
 	recorder.stamp("After vkCreateDevice()");
 	VKASSERTMSG(createResult, "Failed to create logical device");
-	ZDevice logicalDevice(deviceHandle, callbacks, physDevice, 0/*!undeletable*/, std::move(queueCreateExInfos));
+	ZDevice logicalDevice(deviceHandle, callbacks, physDevice, 0/*!undeletable*/, std::move(queueCreateExInfos),
+						  requiredExtensions);
 	logicalDevice.verbose(getGlobalAppFlags().verbose != 0);
 
 	struct AInstance : public ZInstance	{
@@ -789,6 +835,9 @@ ZDevice createLogicalDevice	(
 	};
 	AInstance(instance).initInterface(logicalDevice);
 
+	// Loaded up front, so the first pipeline doesn't pay for reading the file
+	deviceGetPipelineCache(logicalDevice);
+
 	return logicalDevice;
 }
 
@@ -1084,6 +1133,48 @@ ZSemaphore createSemaphore (ZDevice device)
 	return ZSemaphore::create(handle, device, callbacks);
 }
 
+ZSemaphore createTimelineSemaphore (ZDevice device, uint64_t initialValue)
+{
+	VkSemaphore handle = VK_NULL_HANDLE;
+	auto callbacks = device.getParam<VkAllocationCallbacksPtr>();
+
+	VkSemaphoreTypeCreateInfo typeInfo = makeVkStruct();
+	typeInfo.semaphoreType	= VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue	= initialValue;
+	VkSemaphoreCreateInfo semInfo = makeVkStruct(&typeInfo);
+	semInfo.flags = VkSemaphoreCreateFlags(0);
+
+	add_cref<ZDeviceInterface> di = device.getInterface();
+	VKASSERT(VTF_CALL_CHECK(di.vkCreateSemaphore, *device, &semInfo, callbacks, &handle));
+
+	return ZSemaphore::create(handle, device, callbacks);
+}
+
+uint64_t semaphoreGetCounterValue (ZSemaphore timeline)
+{
+	ZDevice device = timeline.getParam<ZDevice>();
+	add_cref<ZDeviceInterface> di = device.getInterface();
+	const auto getCounterValue = di.vkGetSemaphoreCounterValue ? di.vkGetSemaphoreCounterValue : di.vkGetSemaphoreCounterValueKHR;
+	uint64_t value = 0u;
+	VKASSERT(VTF_CALL_CHECK(getCounterValue, *device, *timeline, &value));
+	return value;
+}
+
+VkResult semaphoreWait (ZSemaphore timeline, uint64_t value, uint64_t timeout, bool assertOnFail)
+{
+	ZDevice device = timeline.getParam<ZDevice>();
+	add_cref<ZDeviceInterface> di = device.getInterface();
+	const auto waitSemaphores = di.vkWaitSemaphores ? di.vkWaitSemaphores : di.vkWaitSemaphoresKHR;
+	VkSemaphoreWaitInfo waitInfo = makeVkStruct();
+	waitInfo.flags			= VkSemaphoreWaitFlags(0);
+	waitInfo.semaphoreCount	= 1u;
+	waitInfo.pSemaphores	= timeline.ptr();
+	waitInfo.pValues		= &value;
+	const VkResult res = VTF_CALL_CHECK(waitSemaphores, *device, &waitInfo, timeout);
+	if (assertOnFail) VKASSERT(res);
+	return res;
+}
+
 ZQueryPool createQueryPool (ZDevice device, VkQueryType type, VkQueryPipelineStatisticFlags stats,
 							uint32_t count, VkQueryPoolCreateFlags flags)
 {
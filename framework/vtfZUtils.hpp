@@ -116,6 +116,10 @@ void			waitForFences	(std::vector<ZFence> fences, uint64_t timeout = UINT64_MAX)
 void			resetFences		(std::vector<ZFence> fences);
 bool			fenceStatus		(ZFence fence);
 ZSemaphore		createSemaphore	(ZDevice device);
+// Requires timelineSemaphore feature, the functions below pick the core or the KHR entry point
+ZSemaphore		createTimelineSemaphore		(ZDevice device, uint64_t initialValue = 0u);
+uint64_t		semaphoreGetCounterValue	(ZSemaphore timeline);
+VkResult		semaphoreWait				(ZSemaphore timeline, uint64_t value, uint64_t timeout = UINT64_MAX, bool assertOnFail = true);
 
 ZQueryPool		createQueryPool	(ZDevice device, VkQueryType type, VkQueryPipelineStatisticFlags stats,
 								 uint32_t count = 1u, VkQueryPoolCreateFlags flags = 0);
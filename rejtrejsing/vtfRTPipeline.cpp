@@ -3,6 +3,7 @@
 #include "vtfTemplateUtils.hpp"
 #include "vtfBacktrace.hpp"
 #include "vtfZUtils.hpp"
+#include "vtfZPipeline.hpp"
 
 #include <algorithm>
 #include <iostream>
@@ -885,7 +886,7 @@ ZPipeline createRayTracingPipeline (
 
 	ZPipeline pipeline(VK_NULL_HANDLE, device, callbacks, layout,
 		{/*renderpass*/ }, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, VkPipelineCreateFlags(0),
-		rtShaders, pipelineShaderGroupOrder.toInt(), {/*shader group count*/});
+		rtShaders, pipelineShaderGroupOrder.toInt(), {/*shader group count*/}, {/*owner*/});
 	add_ref<std::vector<ZShaderModule>> pipelineShaders = pipeline.getParamRef<std::vector<ZShaderModule>>();
 	std::vector<VkPipelineShaderStageCreateInfo> pipelineStages(pipelineShaders.size());
 
@@ -1000,7 +1001,7 @@ ZPipeline createRayTracingPipeline (
 	info.maxPipelineRayRecursionDepth	= pSettings->maxPipelineRayRecursionDepth;
 
 	VKASSERTMSG(VTF_CALL_CHECK(di.vkCreateRayTracingPipelinesKHR, *device,
-						VK_NULL_HANDLE, VK_NULL_HANDLE, 1u,
+						VK_NULL_HANDLE, deviceGetPipelineCache(device), 1u,
 						&info, callbacks, pipeline.setter("vkCreateRayTracingPipelinesKHR")),
 						"Fail to cretae ray tracing pipeline");
 
@@ -67,6 +67,7 @@ enum TestIdentifier
 	INT_MATRIX,
 	//INT_CIPHER,
 	INT_THREADPOOL,
+	INT_WAKEUPQUEUE,
 	INT_SYNCHRONIZATION2,
 	INT_GEOM,
 	COGWHEELS,
@@ -9,6 +9,7 @@
 #include "vtfShaderObjectCollection.hpp"
 #include "vtfDSBMgr.hpp"
 #include "vtfZPipeline.hpp"
+#include "vtfObjectCache.hpp"
 #include "vtfZCommandBuffer.hpp"
 #include "vtfStructUtils.hpp"
 #include "vtfCopyUtils.hpp"
@@ -16,6 +17,7 @@
 #include "vtfFloat16.hpp"
 
 #include <array>
+#include <set>
 #include <sstream>
 #include <string>
 #include <string_view>
@@ -85,6 +87,7 @@ struct TestParams
 	bool					printBlendFactors;
 	bool					printColorFormats;
 	bool					printCppCode;
+	bool					printPipelineStats;
 
 	static inline const Map mapVkBlendOp
 	{
@@ -159,6 +162,7 @@ TestParams::TestParams (ZPhysicalDevice physicalDevice, add_cref<std::string> as
 	, printBlendFactors		(false)
 	, printColorFormats		(false)
 	, printCppCode			(false)
+	, printPipelineStats	(false)
 {
 }
 void TestParams::print (add_ref<std::ostream> log, bool availableDualSourceBlend, add_cref<OptionParserStateX> state) const
@@ -257,7 +261,7 @@ void onResize (add_ref<Canvas>, void* userData, int, int)
 
 TriLogicInt runTests (add_ref<Canvas> ctx, add_cref<std::string> assets,
 						add_cref<std::vector<TestParamsState>> set, bool fromFile,
-						bool availableDualSourceBlend, bool needShaderObject);
+						bool availableDualSourceBlend, bool needShaderObject, bool printPipelineStats);
 
 bool TestParams::operator==	(add_cref<TestParams> other) const
 {
@@ -280,6 +284,7 @@ constexpr Option optionPrintBlenOps("-print-blend-ops", 0);
 constexpr Option optionPrintBlendFactors("-print-blend-factors", 0);
 constexpr Option optionPrintColorFormats("-print-color-formats", 0);
 constexpr Option optionPrintCppCode("-print-cpp-code", 0);
+constexpr Option optionPrintPipelineStats("-print-pipeline-stats", 0);
 constexpr Option optionFile("-file", 1);
 constexpr Option optionDualSource("-dual-source", 0);
 constexpr Option optionShaderObject("-shader-object", 0);
@@ -689,6 +694,9 @@ OptionParser<TestParams, OptionParserStateX> TestParams::getParser (bool include
 			"Print available VkFormat enum values", { params.printColorFormats }, flags);
 		parser.addOption(&TestParams::printCppCode, optionPrintCppCode,
 			"Print blending params as CPP code", { params.printCppCode }, flags);
+		parser.addOption(&TestParams::printPipelineStats, optionPrintPipelineStats,
+			"Print how long compiling the pipelines of all tests took and how many requests reused them",
+			{ params.printPipelineStats }, flags);
 	}
 
 	if (includeFile)
@@ -812,6 +820,7 @@ TriLogicInt prepareTests (add_cref<TestRecord> record, add_ref<CommandLine> cmdL
 		make_signed(appFlags.physicalDeviceIndex), instance, upgradeDeviceExtensions(strings()));
 
 	bool							fromFile	(false);
+	bool							printStats	(false);
 	std::vector<TestParamsState>	set			{ std::make_tuple(TestParams(physicalDevice, record.assets),
 													OptionParserStateX(), std::string()) };
 	{
@@ -821,6 +830,7 @@ TriLogicInt prepareTests (add_cref<TestRecord> record, add_ref<CommandLine> cmdL
 		parser.parse(cmdLine, true, std::bind(&TestParams::parsing, &params,
 											  std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
 		state = parser.getState();
+		printStats = params.printPipelineStats;
 
 		if (state.hasHelp)
 		{
@@ -922,7 +932,7 @@ TriLogicInt prepareTests (add_cref<TestRecord> record, add_ref<CommandLine> cmdL
 
 	Canvas cs(physicalDevice, canvasStyle, onEnablingFeatures, appFlags.debugPrintfEnabled);
 
-	return runTests(cs, record.assets, set, fromFile, availableDualSourceBlend, needShaderObject);
+	return runTests(cs, record.assets, set, fromFile, availableDualSourceBlend, needShaderObject, printStats);
 }
 
 std::tuple<ZShaderModule, ZShaderModule, ZShaderModule>
@@ -1090,8 +1100,17 @@ void printFlatnizeWarning (add_ref<std::ostream> log, add_cref<TestParams> param
 }
 */
 
-ZPipeline makeBlendPipeline	(
-	add_cref<TestParamsState>	test,
+ZRenderPass createColorRenderPass (ZDevice device, VkFormat colorFormat)
+{
+	const std::vector<RPA>		colors{ RPA(AttachmentDesc::Color, colorFormat, {},
+											VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL) };
+	const ZAttachmentPool		attachmentPool(colors);
+	const ZSubpassDescription2	subpass({ RPAR(0u, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) });
+	return createRenderPass(device, attachmentPool, subpass);
+}
+
+std::shared_ptr<GraphicPipelineSettings> makeBlendPipelineSettings (
+	add_cref<TestParams>		p,
 	ZPipelineLayout				layout,
 	ZRenderPass					renderPass,
 	add_cref<VertexInput>		vertices,
@@ -1100,15 +1119,29 @@ ZPipeline makeBlendPipeline	(
 	ZShaderModule				dualFragment,
 	bool						availableDualSourceBlend)
 {
-	add_cref<TestParams> p(std::get<0>(test));
-	std::cout << std::get<1>(test).messagesText();
-
 	const bool useDualSource = p.enableDualSrcBlending && availableDualSourceBlend;
 	const VkPipelineColorBlendAttachmentState s = p.getState();
 	ZShaderModule blendFragment = useDualSource ? dualFragment : genericFragment;
-	return createGraphicsPipeline(layout, renderPass, vertices, vertex, blendFragment, TestParams::defaultExtent,
-									gpp::BlendAttachmentState(std::make_pair(0u, s)),
-									gpp::BlendConstants(p.constColor));
+	std::shared_ptr<GraphicPipelineSettings> settings = makeGraphicsPipelineSettings(layout);
+	updateSettings(*settings, renderPass, vertices, vertex, blendFragment, TestParams::defaultExtent,
+				   gpp::BlendAttachmentState(std::make_pair(0u, s)),
+				   gpp::BlendConstants(p.constColor));
+	return settings;
+}
+
+ZPipeline makeBlendPipeline	(
+	add_cref<TestParamsState>	test,
+	ZPipelineLayout				layout,
+	ZRenderPass					renderPass,
+	add_cref<VertexInput>		vertices,
+	ZShaderModule				vertex,
+	ZShaderModule				genericFragment,
+	ZShaderModule				dualFragment,
+	bool						availableDualSourceBlend)
+{
+	std::cout << std::get<1>(test).messagesText();
+	return createGraphicsPipeline(*makeBlendPipelineSettings(std::get<0>(test), layout, renderPass, vertices,
+										vertex, genericFragment, dualFragment, availableDualSourceBlend));
 }
 
 void readColors (
@@ -1586,7 +1619,7 @@ public:
 
 TriLogicInt runTests (add_ref<Canvas> ctx, add_cref<std::string> assets,
 						add_cref<std::vector<TestParamsState>> set, bool fromFile,
-						bool availableDualSourceBlend, bool needShaderObject)
+						bool availableDualSourceBlend, bool needShaderObject, bool printPipelineStats)
 {
 	add_cref<ZDeviceInterface>	di = ctx.device.getInterface();
 
@@ -1630,6 +1663,31 @@ TriLogicInt runTests (add_ref<Canvas> ctx, add_cref<std::string> assets,
 	ZShaderObject				backgroundShader;
 	ZShaderObject				blendShader;
 
+	// Pipelines of all the tests are compiled in parallel up front, switching to the next test
+	// then finds its pipelines in the registry instead of compiling them while the user waits
+	PipelineVariants			variants;
+	std::set<VkFormat>			backgroundFormats;
+	for (add_cref<TestParamsState> test : set)
+	{
+		add_cref<TestParams> params(std::get<0>(test));
+		if (params.enableShaderObject) continue;
+		const VkFormat	colorFormat = VkFormat(params.colorFormat);
+		ZRenderPass		renderPass	= createColorRenderPass(ctx.device, colorFormat);
+		if (backgroundFormats.insert(colorFormat).second)
+		{
+			variants.addGraphics(colorLayout, renderPass, TestParams::defaultExtent, vertexInput, commonVert, genericFrag);
+		}
+		variants.addGraphics(makeBlendPipelineSettings(params, colorLayout, renderPass, vertexInput, commonVert,
+							 genericFrag, dualFrag, (availableDualSourceBlend && params.enableDualSrcBlending)));
+	}
+	variants.wait();
+	if (printPipelineStats)
+	{
+		const PipelineRegistryStats stats = getPipelineRegistryStats(ctx.device);
+		std::cout << "Compiled " << variants.count() << " pipeline variants, created: " << stats.created
+				  << ", libraries: " << stats.libraries << ", seconds: " << stats.seconds << std::endl;
+	}
+
 	EventData ev(data_count(set));
 	ctx.events().cbKey.set(onKey, &ev);
 	ctx.events().cbWindowSize.set(onResize, &ev);
@@ -1660,14 +1718,10 @@ TriLogicInt runTests (add_ref<Canvas> ctx, add_cref<std::string> assets,
 		}
 
 		const VkFormat colorFormat = VkFormat(currParams.colorFormat);
-		const std::vector<RPA>		colors{ RPA(AttachmentDesc::Color, colorFormat, {},
-												VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL) };
-		const ZAttachmentPool		attachmentPool(colors);
-		const ZSubpassDescription2	subpass({ RPAR(0u, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) });
 		colorImage			= ctx.createColorImage2D(colorFormat, TestParams::defaultExtent);
 		colorView			= createImageView(colorImage);
 		colorAttachment		= gpp::Attachment(colorView, gpp::AttachmentDesc::Color);
-		colorRenderPass		= createRenderPass(ctx.device, attachmentPool, subpass);
+		colorRenderPass		= createColorRenderPass(ctx.device, colorFormat);
 		colorFB				= createFramebuffer(colorRenderPass, TestParams::defaultExtent, { colorView });
 		colorBuffer			= createBuffer(colorImage, ZBufferUsageStorageFlags, ZMemoryPropertyHostFlags);
 
@@ -1792,6 +1846,19 @@ TriLogicInt runTests (add_ref<Canvas> ctx, add_cref<std::string> assets,
 
 	ctx.run(onCommandRecording, swapRenderPass, std::ref(ev.swapTrigger), {/*onIdle()*/ }, onAfterRecording);
 
+	if (printPipelineStats)
+	{
+		const PipelineRegistryStats	pipelineStats	= getPipelineRegistryStats(ctx.device);
+		const DescriptorCacheStats	descriptorStats	= getDescriptorCacheStats(ctx.device);
+		const ObjectCacheStats		objectStats		= getObjectCacheStats(ctx.device);
+		std::cout << "Pipelines created: " << pipelineStats.created << ", hits: " << pipelineStats.hits
+				  << ", seconds: " << pipelineStats.seconds << std::endl;
+		std::cout << "Pipeline layouts created: " << descriptorStats.pipelineLayouts
+				  << ", hits: " << descriptorStats.pipelineLayoutHits << std::endl;
+		std::cout << "Shared objects created: " << objectStats.created
+				  << ", hits: " << objectStats.hits << std::endl;
+	}
+
 	uint32_t failCount = 0u;
 	for (add_cref<BoolVec4> res : results)
 	{
@@ -14,6 +14,7 @@
 #include "vtfZPipeline.hpp"
 #include "vtfStructUtils.hpp"
 #include "vtfCopyUtils.hpp"
+#include "vtfUploadEngine.hpp"
 #include "vtfTemplateUtils.hpp"
 #include "vtfCommandLine.hpp"
 
@@ -387,51 +388,6 @@ struct GearOutlineInfo
 	std::pair<uint32_t, uint32_t> surf;
 };
 
-template<class X>
-void copyByStaging(const std::vector<X>& src, ZBuffer dst, uint32_t startIndex, ZQueue queue, uint32_t chunkSize = 1048576u)
-{
-	static_assert(std::is_reference_v<decltype(src)>, "???");
-	const uint32_t chunkOptimalSize = ROUNDUP(chunkSize, uint32_t(sizeof(X)));
-	const uint32_t elemsPerChunk = chunkOptimalSize / sizeof(X);
-	const uint32_t numChunks = uint32_t(data_byte_length(src) / chunkOptimalSize);
-	const uint32_t dstOffset = uint32_t(startIndex * sizeof(X));
-	const auto dstSize = bufferGetSize(dst);
-
-	ZDevice device = dst.getParam<ZDevice>();
-	add_cref<ZDeviceInterface> di = device.getInterface();
-	ZBuffer staging = createBuffer<X>(device, elemsPerChunk);
-	ZBufferMemoryBarrier host(staging, VK_ACCESS_HOST_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
-
-	for (uint32_t chunk = 0u, srcIndex = 0u; chunk < numChunks; ++chunk, srcIndex += elemsPerChunk)
-	{
-		ASSERTION(((chunk + 1u) * chunkOptimalSize + dstOffset) <= dstSize);
-		bufferWrite(staging, src, 0u, srcIndex, elemsPerChunk);
-		//commandBufferPipelineBarriers(cmd, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, host);
-
-		VkBufferCopy copy{};
-		copy.srcOffset = 0u;
-		copy.dstOffset = chunk * chunkOptimalSize + dstOffset;
-		copy.size = chunkOptimalSize;
-		OneShotCommandBuffer cmd(device, queue);
-		VTF_CALL_CHECK(di.vkCmdCopyBuffer, *(ZCommandBuffer)cmd, *staging, *dst, 1u, &copy);
-	}
-
-	const uint32_t chunkRestSize = uint32_t(data_byte_length(src) % chunkOptimalSize);
-	if (chunkRestSize)
-	{
-		ASSERTION((numChunks * chunkOptimalSize + chunkRestSize + dstOffset) <= dstSize);
-		bufferWrite(staging, src, 0u, (numChunks * elemsPerChunk), (chunkRestSize / sizeof(X)));
-		//commandBufferPipelineBarriers(cmd, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, host);
-
-		VkBufferCopy copy{};
-		copy.srcOffset = 0u;
-		copy.dstOffset = numChunks * chunkOptimalSize + dstOffset;
-		copy.size = chunkRestSize;
-		OneShotCommandBuffer cmd(device, queue);
-		VTF_CALL_CHECK(di.vkCmdCopyBuffer, *(ZCommandBuffer)cmd, *staging, *dst, 1u, &copy);
-	}
-}
-
 typedef VecX<float, 7> Vec7;
 std::vector<Vec7> resizeWithNormals (add_cref<std::vector<Vec4>> srcTriangleList)
 {
@@ -490,12 +446,13 @@ createVertexAndIndexBuffers (add_ref<VertexInput> input, add_cref<Params> params
 	GearOutlineInfo infoBig;
 	GearOutlineInfo infoSmall;
 	uint32_t startIndex = 0;
+	UploadEngine engine(input.device, queue);
 
 	// big front
 	{
 		const std::vector<Vec4> front = generateCogwheelPrimitives(outBig, 0.0f, topo, VK_FRONT_FACE_CLOCKWISE);
 		const auto frontWithNormals = resizeWithNormals(front);
-		copyByStaging(frontWithNormals, vertices, startIndex, queue);
+		engine.upload(vertices, frontWithNormals, startIndex);
 		infoBig.front = { startIndex, data_count(frontWithNormals) };
 		startIndex += infoBig.front.second;
 	}
@@ -503,7 +460,7 @@ createVertexAndIndexBuffers (add_ref<VertexInput> input, add_cref<Params> params
 	{
 		const std::vector<Vec4> back = generateCogwheelPrimitives(outBig, -10.0f, topo, VK_FRONT_FACE_COUNTER_CLOCKWISE);
 		const auto backWithNormals = resizeWithNormals(back);
-		copyByStaging(backWithNormals, vertices, startIndex, queue);
+		engine.upload(vertices, backWithNormals, startIndex);
 		infoBig.back = { startIndex, data_count(backWithNormals) };
 		startIndex += infoBig.back.second;
 	}
@@ -511,7 +468,7 @@ createVertexAndIndexBuffers (add_ref<VertexInput> input, add_cref<Params> params
 	{
 		const std::vector<Vec4> surf = generateCogwheelToothSurface(outBig, 0.0f, -10.0f, topo, VK_FRONT_FACE_CLOCKWISE);
 		const auto surfWithNormals = resizeWithNormals(surf);
-		copyByStaging(surfWithNormals, vertices, startIndex, queue);
+		engine.upload(vertices, surfWithNormals, startIndex);
 		infoBig.surf = { startIndex, data_count(surfWithNormals) };
 		startIndex += infoBig.surf.second;
 	}
@@ -520,7 +477,7 @@ createVertexAndIndexBuffers (add_ref<VertexInput> input, add_cref<Params> params
 	{
 		const std::vector<Vec4> front = generateCogwheelPrimitives(outSmall, 0.0f, topo, VK_FRONT_FACE_CLOCKWISE);
 		const auto frontWithNormals = resizeWithNormals(front);
-		copyByStaging(frontWithNormals, vertices, startIndex, queue);
+		engine.upload(vertices, frontWithNormals, startIndex);
 		infoSmall.front = { startIndex, data_count(frontWithNormals) };
 		startIndex += infoSmall.front.second;
 	}
@@ -528,7 +485,7 @@ createVertexAndIndexBuffers (add_ref<VertexInput> input, add_cref<Params> params
 	{
 		const std::vector<Vec4> back = generateCogwheelPrimitives(outSmall, -10.0f, topo, VK_FRONT_FACE_COUNTER_CLOCKWISE);
 		const auto backWithNormals = resizeWithNormals(back);
-		copyByStaging(backWithNormals, vertices, startIndex, queue);
+		engine.upload(vertices, backWithNormals, startIndex);
 		infoSmall.back = { startIndex, data_count(backWithNormals) };
 		startIndex += infoSmall.back.second;
 	}
@@ -536,10 +493,11 @@ createVertexAndIndexBuffers (add_ref<VertexInput> input, add_cref<Params> params
 	{
 		const std::vector<Vec4> surf = generateCogwheelToothSurface(outSmall, 0.0f, -10.0f, topo, VK_FRONT_FACE_CLOCKWISE);
 		const auto surfWithNormals = resizeWithNormals(surf);
-		copyByStaging(surfWithNormals, vertices, startIndex, queue);
+		engine.upload(vertices, surfWithNormals, startIndex);
 		infoSmall.surf = { startIndex, data_count(surfWithNormals) };
 		startIndex += infoSmall.surf.second;
 	}
+	engine.wait();
 
 	input.binding(0).declareAttributes<Fmt_<Vec4>, Fmt_<Vec3>>();
 
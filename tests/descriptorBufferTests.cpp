@@ -11,7 +11,9 @@
 #include "vtfZPipeline.hpp"
 #include "vtfCopyUtils.hpp"
 #include "vtfMatrix.hpp"
+#include "vtfGpuProfiler.hpp"
 
+#include <chrono>
 #include <numeric>
 
 namespace
@@ -32,14 +34,18 @@ struct Params
 	bool					m_set;
 	bool					m_fps;
 	bool					m_cache;
+	bool					m_gpuTime;
 	bool					m_samplerAnisotropy;
+	int						m_writes;
 	Params(add_cref<std::string> assets, add_ref<CommandLine> cmdLine)
 		: m_assets				(assets)
 		, m_cmdLine				(cmdLine)
 		, m_set					(false)
 		, m_fps					(false)
 		, m_cache				(false)
+		, m_gpuTime				(false)
 		, m_samplerAnisotropy	(false)
+		, m_writes				(0)
 	{
 	}
 
@@ -97,6 +103,8 @@ TriLogicInt prepareTests (const TestRecord& record, add_ref<CommandLine> cmdLine
 constexpr Option optionSet("-set", 0);
 constexpr Option optionFps("-fps", 0);
 constexpr Option optionCache("-cache", 0);
+constexpr Option optionGpuTime("-gpu-time", 0);
+constexpr Option optionWrites("-writes", 1);
 OptionParser<Params> Params::getParser ()
 {
 	OptionFlags				flags	(OptionFlag::None);
@@ -106,6 +114,9 @@ OptionParser<Params> Params::getParser ()
 	parser.addOption(&Params::m_set, optionSet,	"Use descriptor set", { params.m_set }, flags);
 	parser.addOption(&Params::m_fps, optionFps, "Enable FPS", { params.m_fps }, flags);
 	parser.addOption(&Params::m_cache, optionCache, "Use pipeline cache", { params.m_cache }, flags);
+	parser.addOption(&Params::m_gpuTime, optionGpuTime, "Measure GPU time of the passes", { params.m_gpuTime }, flags);
+	parser.addOption(&Params::m_writes, optionWrites,
+		"Rewrite all descriptors of the first set N times and print the CPU time it took", { params.m_writes }, flags);
 
 	return parser;
 }
@@ -412,6 +423,33 @@ TriLogicInt runTests (add_ref<Canvas> canvas, add_cref<Params> params)
 	ZPipeline				compPline	= createComputePipeline(pLayout, compShader);
 	ZBuffer					desc0Buffer	= useDescriptorSet ? ZBuffer() : set0.createDescriptorBuffer(ds0Layout);
 	ZBuffer					desc1Buffer = useDescriptorSet ? ZBuffer() : set1.createDescriptorBuffer(ds1Layout);
+
+	if (params.m_writes > 0)
+	{
+		// Done before any command buffer uses the set, UNDEFINED keeps the layouts given to addBinding()
+		ZDescriptorSet ds0 = useDescriptorSet ? LayoutManager::getDescriptorSet(ds0Layout) : ZDescriptorSet();
+		auto write = [&](uint32_t binding, auto&&... resources)
+		{
+			if (useDescriptorSet)
+				set0.updateDescriptorSet(ds0, binding, resources...);
+			else set0.updateDescriptorBuffer(desc0Buffer, ds0Layout, binding, resources...);
+		};
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < params.m_writes; ++i)
+		{
+			write(inBinding1, inBuffer1);
+			write(imgBinding, face1View, VK_IMAGE_LAYOUT_UNDEFINED);
+			write(outBinding1, outBuffer1);
+			write(compBinding, face1View, sampler, VK_IMAGE_LAYOUT_UNDEFINED);
+			write(outBinding2, outBuffer2);
+			write(samBinding, sampler);
+			write(inBinding2, inBuffer2);
+			write(stoBinding, stoView, VK_IMAGE_LAYOUT_UNDEFINED);
+		}
+		const std::chrono::duration<double, std::micro> duration = std::chrono::steady_clock::now() - start;
+		std::cout << "Descriptor " << (useDescriptorSet ? "set" : "buffer") << " writes: "
+				  << (duration.count() / params.m_writes) << " us per rewrite of the whole set" << std::endl;
+	}
 	ZRenderPass				renderPass	= createSinglePresentationRenderPass(canvas.device, canvas.surfaceFormat,
 																				makeClearColor(Vec4(0,0,0,1)));
 	ZPipelineCache			graphCache = params.m_cache
@@ -462,6 +500,7 @@ TriLogicInt runTests (add_ref<Canvas> canvas, add_cref<Params> params)
 
 	UserData userData{ matBuffer, 1u };
 	bool swapchainRecretaed = false;
+	GpuProfiler profiler(canvas.device);
 	canvas.events().cbKey.set(onKey, &userData);
 	canvas.events().cbScroll.set(onScroll, &userData);
 
@@ -469,10 +508,20 @@ TriLogicInt runTests (add_ref<Canvas> canvas, add_cref<Params> params)
 	{
 		swapchainRecretaed = swapchain.recreateFlag;
 		commandBufferBegin(cmd);
+		if (params.m_gpuTime)
+		{
+			profiler.beginFrame(cmd);
+			profiler.beginRegion(cmd, "compute");
+		}
 		if (useDescriptorSet)
 			commandBufferBindPipeline(cmd, compPline, useDescriptorSet);
 		else commandBufferBindDescriptorBuffers(cmd, compPline, { desc0Buffer, desc1Buffer });
 		commandBufferDispatch(cmd);
+		if (params.m_gpuTime)
+		{
+			profiler.endRegion(cmd);
+			profiler.beginRegion(cmd, "graphics");
+		}
 		imageCopyToBuffer(cmd, stoImage, outStoBuffer,
 			VK_ACCESS_SHADER_WRITE_BIT, (VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
 			VK_ACCESS_NONE, VK_ACCESS_NONE,
@@ -489,6 +538,10 @@ TriLogicInt runTests (add_ref<Canvas> canvas, add_cref<Params> params)
 			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_NONE,
 			VK_ACCESS_NONE, VK_ACCESS_NONE,
 			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		if (params.m_gpuTime)
+		{
+			profiler.endRegion(cmd);
+		}
 		commandBufferMakeImagePresentationReady(cmd, framebufferGetImage(framebuffer));
 		commandBufferEnd(cmd);
 	};
@@ -578,6 +631,13 @@ TriLogicInt runTests (add_ref<Canvas> canvas, add_cref<Params> params)
 
 	const int runResult = canvas.run(onCommandRecording, renderPass, std::ref(userData.drawTrigger), {}, onAfterRecording);
 
+	if (params.m_gpuTime)
+	{
+		profiler.collect();
+		profiler.report(recorder);
+		recorder.print(std::cout);
+	}
+
 	return (runResult + compareBuffersResult);
 }
 
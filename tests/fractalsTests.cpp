@@ -213,7 +213,8 @@ struct UserInput : UserInput_
 		pc.yMax = +2.0f;
 		ctrlPressed = leftCtrlPressed = rightCtrlPressed = false;
 		micePressed	= leftMicePressed = rightMicePressed = false;
-		glfwGetCursorPos(*swapchain.canvas.window, &xCursor, &yCursor);
+		if (swapchain.canvas.window.has_handle())
+			glfwGetCursorPos(*swapchain.canvas.window, &xCursor, &yCursor);
 	}
 	virtual void updateDim (add_cref<Canvas::Swapchain> swapchain) override
 	{
@@ -515,24 +516,21 @@ TriLogicInt performTest (add_ref<Canvas> cs, add_cref<std::string> assets,
 	std::chrono::time_point<std::chrono::steady_clock>
 			start = std::chrono::steady_clock::now(); // in nanoseconds
 
-	auto onIdle = [&](add_ref<Canvas> canvas, add_ref<int>)
+	// The canvas sleeps between events so the animation is driven by its timer
+	auto onTimer = [&](add_ref<Canvas> canvas)
 	{
 		const auto now = std::chrono::steady_clock::now();
-		const auto tickCount = make_unsigned(std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count());
-
-		if (tickCount > config.ticks)
+		ui.animationTicks = make_unsigned(std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count());
+		start = now;
+		if (ui.ctrlPressed || ui.micePressed)
 		{
-			start = now;
-			ui.animationTicks = tickCount;
-			if (ui.ctrlPressed || ui.micePressed)
-			{
-				if (config.float32)
-					onScroll<float>(canvas, &ui, 0.0, ((ui.leftCtrlPressed || ui.leftMicePressed) ? +1.0 : -1.0));
-				else
-					onScroll<double>(canvas, &ui, 0.0, ((ui.leftCtrlPressed || ui.leftMicePressed) ? +1.0 : -1.0));
-			}
+			if (config.float32)
+				onScroll<float>(canvas, &ui, 0.0, ((ui.leftCtrlPressed || ui.leftMicePressed) ? +1.0 : -1.0));
+			else
+				onScroll<double>(canvas, &ui, 0.0, ((ui.leftCtrlPressed || ui.leftMicePressed) ? +1.0 : -1.0));
 		}
 	};
+	cs.setTimer(config.ticks, onTimer);
 
 	auto onCommandRecording = [&](add_ref<Canvas>, add_cref<Canvas::Swapchain> swapchain, ZCommandBuffer cmdBuffer, ZFramebuffer framebuffer)
 	{
@@ -550,7 +548,7 @@ TriLogicInt performTest (add_ref<Canvas> cs, add_cref<std::string> assets,
 		commandBufferEnd(cmdBuffer);
 	};
 
-	return cs.run(onCommandRecording, renderPass, std::ref(ui.drawTrigger), (config.ticks ? onIdle : Canvas::OnIdle()));
+	return cs.run(onCommandRecording, renderPass, std::ref(ui.drawTrigger));
 }
 
 } // unnamed namespace
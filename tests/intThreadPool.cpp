@@ -1,14 +1,375 @@
 #include "intThreadPool.hpp"
 #include "vtfThreadPool.hpp"
+#include "vtfTaskScheduler.hpp"
+#include "vtfCommandLine.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
 
 namespace
 {
 using namespace vtf;
 
+typedef std::chrono::steady_clock Clock;
+
+void printUsage (add_ref<std::ostream> log)
+{
+	log << "Description:\n"
+		<< "  Without parameters the test verifies ThreadPool works properly.\n"
+		<< "  In benchmark mode ThreadPool and TaskScheduler are measured on 1..N threads:\n"
+		<< "  * dispatch: latency of waking all threads with an empty routine\n"
+		<< "  * tiny, large: throughput of many cheap and of a few expensive tasks\n"
+		<< "  * scaling: speedup of large tasks compared to a single thread\n"
+		<< "  * wakeup: delay between a dispatch and the start of each task when threads are idle\n"
+		<< "Parameters:\n"
+		<< "  --h         print help\n"
+		<< "  --help      print help\n"
+		<< "  [-bench]    run benchmarks instead of verification\n"
+		<< "  [-format    <json|csv>], default json\n"
+		<< "  [-out       <file>], default standard output\n"
+		<< "  [-threads   <max_thread_count>], default and at most as many as the hardware has\n"
+		<< "  [-iterations <count>], number of dispatches measured, default 1000"
+		<< std::endl;
+}
+
+struct TestParams
+{
+	bool		benchmark;
+	bool		csv;
+	std::string	outFile;
+	uint32_t	maxThreads;
+	uint32_t	iterations;
+};
+
+TestParams userReadParams (add_ref<CommandLine> cmdLine, add_ref<std::ostream> log, add_ref<int> ok)
+{
+	TestParams			p{};
+	strings				sink;
+	Option				optBenchmark	{ "-bench", 0 };
+	Option				optFormat		{ "-format", 1 };
+	Option				optOutFile		{ "-out", 1 };
+	Option				optThreads		{ "-threads", 1 };
+	Option				optIterations	{ "-iterations", 1 };
+	Option				optHelpShort	{ "-h", 0 };
+	Option				optHelpLong		{ "--help", 0 };
+	std::vector<Option>	options { optBenchmark, optFormat, optOutFile, optThreads, optIterations,
+									optHelpShort, optHelpLong };
+
+	if (cmdLine.consumeOptions(optHelpShort, options, sink) > 0
+		|| cmdLine.consumeOptions(optHelpLong, options, sink) > 0)
+	{
+		ok = 2 - 3;
+		return p;
+	}
+
+	p.benchmark		= (cmdLine.consumeOptions(optBenchmark, options, sink) > 0);
+	p.csv			= false;
+	p.maxThreads	= std::max(1u, std::thread::hardware_concurrency());
+	p.iterations	= 1000u;
+
+	if (cmdLine.consumeOptions(optFormat, options, sink) > 0)
+	{
+		if (sink.back() == "csv" || sink.back() == "json")
+			p.csv = (sink.back() == "csv");
+		else
+			log << "[WARNING] Unknown format " << std::quoted(sink.back()) << ", apply default json" << std::endl;
+	}
+
+	if (cmdLine.consumeOptions(optOutFile, options, sink) > 0)
+	{
+		p.outFile = sink.back();
+	}
+
+	if (cmdLine.consumeOptions(optThreads, options, sink) > 0)
+	{
+		bool status = false;
+		const uint32_t maxThreads = fromText(sink.back(), p.maxThreads, status);
+		if (status && maxThreads != 0u)
+			p.maxThreads = std::min(maxThreads, p.maxThreads);
+		else
+			log << "[WARNING] Unable to parse thread count, apply default " << p.maxThreads << std::endl;
+	}
+
+	if (cmdLine.consumeOptions(optIterations, options, sink) > 0)
+	{
+		bool status = false;
+		const uint32_t iterations = fromText(sink.back(), p.iterations, status);
+		if (status && iterations != 0u)
+			p.iterations = iterations;
+		else
+			log << "[WARNING] Unable to parse iteration count, apply default " << p.iterations << std::endl;
+	}
+
+	const auto unconsumed = cmdLine.getUnconsumedTokens();
+	if (ok = unconsumed.empty(); false == ok)
+	{
+		log << "[ERROR] Unrecognized parameter " << std::quoted(unconsumed[0]) << std::endl;
+	}
+
+	return p;
+}
+
+struct Result
+{
+	std::string	benchmark;
+	std::string	pool;
+	uint32_t	threads;
+	std::string	metric;
+	double		value;
+	std::string	unit;
+};
+
+struct Results : std::vector<Result>
+{
+	// Adds median, 99th percentile and maximum of the samples
+	void addStats (add_cref<std::string> benchmark, add_cref<std::string> pool, uint32_t threads,
+				   std::vector<double> samples)
+	{
+		if (samples.empty()) return;
+		std::sort(samples.begin(), samples.end());
+		const auto at = [&](double q) { return samples.at(std::size_t(q * double(samples.size() - 1u))); };
+		push_back({ benchmark, pool, threads, "median", at(0.5), "us" });
+		push_back({ benchmark, pool, threads, "p99", at(0.99), "us" });
+		push_back({ benchmark, pool, threads, "max", samples.back(), "us" });
+	}
+	double find (add_cref<std::string> benchmark, add_cref<std::string> pool, uint32_t threads) const
+	{
+		for (add_cref<Result> r : *this)
+			if (r.benchmark == benchmark && r.pool == pool && r.threads == threads) return r.value;
+		return 0.0;
+	}
+	void write (add_ref<std::ostream> str, bool csv) const
+	{
+		if (csv)
+		{
+			str << "benchmark,pool,threads,metric,value,unit\n";
+			for (add_cref<Result> r : *this)
+			{
+				str << r.benchmark << ',' << r.pool << ',' << r.threads << ','
+					<< r.metric << ',' << r.value << ',' << r.unit << '\n';
+			}
+		}
+		else
+		{
+			str << "[\n";
+			for (std::size_t i = 0u; i < size(); ++i)
+			{
+				add_cref<Result> r = at(i);
+				str << "  { \"benchmark\": \"" << r.benchmark << "\", \"pool\": \"" << r.pool
+					<< "\", \"threads\": " << r.threads << ", \"metric\": \"" << r.metric
+					<< "\", \"value\": " << r.value << ", \"unit\": \"" << r.unit << "\" }"
+					<< ((i + 1u) < size() ? ",\n" : "\n");
+			}
+			str << "]\n";
+		}
+		str.flush();
+	}
+};
+
+double microseconds (Clock::time_point start, Clock::time_point end)
+{
+	return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+// Work of a task, it can't be optimized away because the result is accumulated by the caller
+uint32_t spin (uint32_t iterations, uint32_t seed)
+{
+	uint32_t x = seed | 1u;
+	for (uint32_t i = 0u; i < iterations; ++i)
+	{
+		x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+	}
+	return x;
+}
+
+constexpr uint32_t tinyTaskWork		= 16u;
+constexpr uint32_t tinyTaskCount	= 100000u;
+constexpr uint32_t largeTaskWork	= 200000u;
+constexpr uint32_t largeTaskCount	= 256u;
+// Long enough for the threads to fall asleep before the next dispatch
+constexpr auto idlePeriod			= std::chrono::milliseconds(2);
+
+// Everything ThreadPool runs, each thread of the pool calls the same method
+struct PoolBench
+{
+	std::atomic<uint32_t>			next	{ 0u };
+	std::atomic<uint32_t>			sink	{ 0u };
+	uint32_t						taskCount	= 0u;
+	uint32_t						taskWork	= 0u;
+	std::vector<Clock::time_point>	starts;
+
+	void noop () { }
+	void stamp (add_cref<ThreadPool::ThreadIndex> index)
+	{
+		starts.at(index().first) = Clock::now();
+	}
+	void drain ()
+	{
+		uint32_t local = 0u;
+		for (uint32_t t = next++; t < taskCount; t = next++)
+		{
+			local += spin(taskWork, t);
+		}
+		sink += local;
+	}
+};
+
+void benchThreadPool (uint32_t threads, add_cref<TestParams> params, add_ref<Results> results)
+{
+	const std::string name("threadpool");
+	// Zero threads means the whole hardware, so a single thread is a worker that the caller waits for
+	const bool callInMain = (threads > 1u);
+	ThreadPool pool(callInMain ? (threads - 1u) : 1u);
+	PoolBench bench;
+	bench.starts.resize(threads);
+	auto noop	= pool.getInterface(&PoolBench::noop, &bench, callInMain);
+	auto stamp	= pool.getInterface(&PoolBench::stamp, &bench, callInMain);
+	auto drain	= pool.getInterface(&PoolBench::drain, &bench, callInMain);
+
+	std::vector<double> samples(params.iterations);
+	for (add_ref<double> sample : samples)
+	{
+		const auto start = Clock::now();
+		noop->waitContinue();
+		sample = microseconds(start, Clock::now());
+	}
+	results.addStats("dispatch", name, threads, samples);
+
+	for (const bool tiny : { true, false })
+	{
+		bench.next		= 0u;
+		bench.taskCount	= tiny ? tinyTaskCount : largeTaskCount;
+		bench.taskWork	= tiny ? tinyTaskWork : largeTaskWork;
+		const auto start = Clock::now();
+		drain->waitContinue();
+		const double seconds = microseconds(start, Clock::now()) / 1e6;
+		results.push_back({ (tiny ? "tiny" : "large"), name, threads, "throughput", (bench.taskCount / seconds), "tasks/s" });
+	}
+
+	samples.clear();
+	for (uint32_t i = 0u; i < std::max(1u, (params.iterations / 10u)); ++i)
+	{
+		std::fill(bench.starts.begin(), bench.starts.end(), Clock::time_point());
+		std::this_thread::sleep_for(idlePeriod);
+		const auto start = Clock::now();
+		stamp->waitContinue({/* substituted */});
+		// The calling thread is the last one and it doesn't need to be woken up
+		for (uint32_t t = 0u; t < (callInMain ? (threads - 1u) : threads); ++t)
+			if (bench.starts.at(t) != Clock::time_point())
+				samples.push_back(microseconds(start, bench.starts.at(t)));
+	}
+	results.addStats("wakeup", name, threads, samples);
+
+	pool.waitFinish();
+}
+
+void benchTaskScheduler (uint32_t threads, add_cref<TestParams> params, add_ref<Results> results)
+{
+	const std::string name("scheduler");
+	// The calling thread takes part in parallelFor, so it is one of the threads measured
+	TaskScheduler scheduler(std::max(1u, (threads - 1u)));
+	std::atomic<uint32_t> sink(0u);
+
+	std::vector<double> samples(params.iterations);
+	for (add_ref<double> sample : samples)
+	{
+		const auto start = Clock::now();
+		scheduler.parallelFor(0u, threads, 1u, [](uint32_t, uint32_t) {}, threads);
+		sample = microseconds(start, Clock::now());
+	}
+	results.addStats("dispatch", name, threads, samples);
+
+	for (const bool tiny : { true, false })
+	{
+		const uint32_t taskCount	= tiny ? tinyTaskCount : largeTaskCount;
+		const uint32_t taskWork		= tiny ? tinyTaskWork : largeTaskWork;
+		const auto start = Clock::now();
+		scheduler.parallelFor(0u, taskCount, 1u, [&](uint32_t first, uint32_t last)
+		{
+			for (uint32_t t = first; t < last; ++t) sink += spin(taskWork, t);
+		}, threads);
+		const double seconds = microseconds(start, Clock::now()) / 1e6;
+		results.push_back({ (tiny ? "tiny" : "large"), name, threads, "throughput", (taskCount / seconds), "tasks/s" });
+	}
+
+	samples.clear();
+	std::vector<Clock::time_point> starts(threads);
+	for (uint32_t i = 0u; i < std::max(1u, (params.iterations / 10u)); ++i)
+	{
+		std::this_thread::sleep_for(idlePeriod);
+		const auto start = Clock::now();
+		scheduler.parallelFor(0u, threads, 1u, [&](uint32_t first, uint32_t) { starts.at(first) = Clock::now(); }, threads);
+		for (add_cref<Clock::time_point> t : starts)
+			samples.push_back(microseconds(start, t));
+	}
+	results.addStats("wakeup", name, threads, samples);
+}
+
+TriLogicInt runBenchmark (add_cref<TestParams> params)
+{
+	// 1, 2, 4, ... and the maximum itself
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t threads = 1u; threads < params.maxThreads; threads *= 2u)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(params.maxThreads);
+
+	Results results;
+	for (const std::string pool : { "threadpool", "scheduler" })
+	{
+		for (const uint32_t threads : threadCounts)
+		{
+			std::cerr << "[APP] Benchmark " << pool << " on " << threads << " thread(s)" << std::endl;
+			if (pool == "threadpool")
+				benchThreadPool(threads, params, results);
+			else
+				benchTaskScheduler(threads, params, results);
+		}
+		const double single = results.find("large", pool, 1u);
+		for (const uint32_t threads : threadCounts)
+		{
+			const double speedup = (single > 0.0) ? (results.find("large", pool, threads) / single) : 0.0;
+			results.push_back({ "scaling", pool, threads, "speedup", speedup, "x" });
+		}
+	}
+
+	if (params.outFile.empty())
+	{
+		results.write(std::cout, params.csv);
+	}
+	else
+	{
+		std::ofstream file(params.outFile);
+		if (false == file.is_open())
+		{
+			std::cout << "[ERROR] Unable to open " << std::quoted(params.outFile) << std::endl;
+			return 1;
+		}
+		results.write(file, params.csv);
+	}
+	return 0;
+}
+
 TriLogicInt runTest (add_cref<TestRecord> record, add_ref<CommandLine> cmdLine)
 {
 	UNREF(record);
-	UNREF(cmdLine);
+	int ok = 0;
+	const TestParams params = userReadParams(cmdLine, std::cout, ok);
+	if (ok == 0)
+	{
+		return 1;
+	}
+	else if (ok < 0)
+	{
+		printUsage(std::cout);
+		return {};
+	}
+
+	if (params.benchmark)
+	{
+		return runBenchmark(params);
+	}
 	return ThreadPool::selfTest() ? 0 : 1;
 }
 
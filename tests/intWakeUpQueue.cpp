@@ -0,0 +1,199 @@
+#include "intWakeUpQueue.hpp"
+#include "vtfWakeUpQueue.hpp"
+#include "vtfCommandLine.hpp"
+#include "GLFW/glfw3.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+using namespace vtf;
+
+typedef WakeUpQueue::clock Clock;
+typedef std::chrono::milliseconds ms;
+
+void printUsage (add_ref<std::ostream> log)
+{
+	log << "Description:\n"
+		<< "  Verifies how WakeUpQueue, which Canvas::run() sleeps on, schedules its wake ups:\n"
+		<< "  * posted tasks are dispatched once and in order, also from other threads\n"
+		<< "  * the timer is re-armed without catching missed periods up and can be replaced\n"
+		<< "  * sleepUntil() reaches its point in time or returns early when told to stop\n"
+		<< "  * waiting for GLFW events ends on a posted task, the timer or the idle timeout,\n"
+		<< "    this part is skipped if GLFW can't be initialized\n"
+		<< "Parameters:\n"
+		<< "  --h         print help\n"
+		<< "  --help      print help"
+		<< std::endl;
+}
+
+uint32_t elapsedMS (Clock::time_point since)
+{
+	return uint32_t(std::chrono::duration_cast<ms>(Clock::now() - since).count());
+}
+
+struct Checker
+{
+	uint32_t failures = 0u;
+	void operator() (bool condition, add_cptr<char> what)
+	{
+		std::cout << (condition ? "[PASS] " : "[FAIL] ") << what << std::endl;
+		failures += condition ? 0u : 1u;
+	}
+};
+
+void testTasks (add_ref<Checker> check)
+{
+	WakeUpQueue queue(false);
+	check(false == queue.dispatch(), "Nothing is dispatched from an empty queue");
+
+	std::vector<int> order;
+	queue.postTask([&]() { order.push_back(1); });
+	queue.postTask([&]() { order.push_back(2); });
+	check(queue.dispatch() && order == std::vector<int>({ 1, 2 }), "Posted tasks are dispatched in order");
+	check(false == queue.dispatch() && order.size() == 2u, "Posted tasks are dispatched only once");
+
+	std::atomic<uint32_t> calls(0u);
+	std::thread poster([&]()
+	{
+		for (uint32_t i = 0u; i < 1000u; ++i) queue.postTask([&]() { calls += 1u; });
+	});
+	const Clock::time_point start = Clock::now();
+	while (calls < 1000u && elapsedMS(start) < 5000u) queue.dispatch();
+	poster.join();
+	queue.dispatch();
+	check(calls == 1000u, "Tasks posted from another thread are all dispatched");
+
+	queue.postTask([&]() { queue.postTask([&]() { calls += 1u; }); });
+	queue.dispatch();
+	check(calls == 1000u && queue.dispatch() && calls == 1001u, "A task posted by a task waits for the next dispatch");
+}
+
+void testTimer (add_ref<Checker> check)
+{
+	WakeUpQueue queue(false);
+	uint32_t ticks = 0u;
+	queue.setTimer(100u, [&]() { ticks += 1u; });
+	check(false == queue.dispatch() && ticks == 0u, "The timer is not due before its period");
+
+	std::this_thread::sleep_for(ms(110));
+	check(queue.dispatch() && ticks == 1u, "The timer is due after its period");
+	check(false == queue.dispatch() && ticks == 1u, "The timer is re-armed after it has fired");
+
+	std::this_thread::sleep_for(ms(450));
+	queue.dispatch();
+	check(ticks == 2u, "Missed periods are not caught up");
+	check(false == queue.dispatch(), "The timer is re-armed after missed periods");
+
+	uint32_t replaced = 0u;
+	queue.setTimer(10u, [&]() { queue.setTimer(10u, [&]() { replaced += 1u; }); });
+	std::this_thread::sleep_for(ms(20));
+	queue.dispatch();
+	std::this_thread::sleep_for(ms(20));
+	queue.dispatch();
+	check(replaced == 1u && ticks == 2u, "The timer can replace itself");
+
+	queue.setTimer(0u, [&]() { ticks += 1u; });
+	std::this_thread::sleep_for(ms(20));
+	check(false == queue.dispatch() && ticks == 2u && replaced == 1u, "Zero period removes the timer");
+}
+
+void testSleep (add_ref<Checker> check)
+{
+	WakeUpQueue queue(false);
+	Clock::time_point start = Clock::now();
+	check(queue.sleepUntil(start + ms(50), []() { return false; }) && elapsedMS(start) >= 50u,
+		  "sleepUntil() reaches its point in time");
+
+	start = Clock::now();
+	check(false == queue.sleepUntil(start + ms(1000), []() { return true; }) && elapsedMS(start) < 500u,
+		  "sleepUntil() returns early when told to stop");
+
+	start = Clock::now();
+	check(queue.sleepUntil(start - ms(10), []() { return false; }) && elapsedMS(start) < 50u,
+		  "sleepUntil() does not sleep for a point in the past");
+
+	start = Clock::now();
+	queue.wait();
+	check(elapsedMS(start) < 50u, "Without GLFW events wait() never blocks");
+}
+
+void testWaitEvents (add_ref<Checker> check)
+{
+	if (GLFW_TRUE != glfwInit())
+	{
+		std::cout << "[SKIP] GLFW can't be initialized, waiting for events is not verified" << std::endl;
+		return;
+	}
+	{
+		WakeUpQueue queue(true);
+		Clock::time_point start = Clock::now();
+		queue.wait(100u);
+		uint32_t elapsed = elapsedMS(start);
+		check(elapsed >= 90u && elapsed < 1000u, "Idle wait ends at the idle timeout");
+
+		bool ran = false;
+		std::thread poster([&]()
+		{
+			std::this_thread::sleep_for(ms(50));
+			queue.postTask([&]() { ran = true; });
+		});
+		start = Clock::now();
+		queue.wait();
+		elapsed = elapsedMS(start);
+		poster.join();
+		check(elapsed < 2000u && queue.dispatch() && ran, "A task posted from another thread wakes the wait up");
+
+		queue.setTimer(100u, []() {});
+		start = Clock::now();
+		queue.wait();
+		elapsed = elapsedMS(start);
+		check(elapsed >= 90u && elapsed < 1000u && queue.dispatch(), "The timer wakes the wait up");
+
+		queue.setTimer(500u, []() {});
+		start = Clock::now();
+		queue.wait(50u);
+		elapsed = elapsedMS(start);
+		check(elapsed >= 40u && elapsed < 400u, "The idle timeout ends the wait before a later timer");
+		queue.setTimer(0u, {});
+	}
+	glfwTerminate();
+}
+
+TriLogicInt runTest (add_cref<TestRecord> record, add_ref<CommandLine> cmdLine)
+{
+	UNREF(record);
+	strings				sink;
+	Option				optHelpShort	{ "-h", 0 };
+	Option				optHelpLong		{ "--help", 0 };
+	std::vector<Option>	options			{ optHelpShort, optHelpLong };
+	if (cmdLine.consumeOptions(optHelpShort, options, sink) > 0
+		|| cmdLine.consumeOptions(optHelpLong, options, sink) > 0)
+	{
+		printUsage(std::cout);
+		return {};
+	}
+
+	Checker check;
+	testTasks(check);
+	testTimer(check);
+	testSleep(check);
+	testWaitEvents(check);
+	return check.failures ? 1 : 0;
+}
+
+} // unnamed namespace
+
+template<> struct TestRecorder<INT_WAKEUPQUEUE>
+{
+	static bool record(TestRecord&);
+};
+bool TestRecorder<INT_WAKEUPQUEUE>::record (TestRecord& record)
+{
+	record.name = "int_wakeupqueue";
+	record.call = &runTest;
+	return true;
+}
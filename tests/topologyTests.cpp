@@ -974,6 +974,7 @@ void draw(add_ref<Canvas> cs, ZImage img, add_cref<Params> params)
 	const ZSubpassDescription2	subpass			({ RPAR(0u, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) });
 	ZRenderPass					renderPass		= createRenderPass(cs.device, attachmentPool, subpass);
 
+	if (cs.window.has_handle())
 	{
 		std::ostringstream title;
 		title << params.topo;
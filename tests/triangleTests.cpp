@@ -11,6 +11,7 @@
 #include "vtfZPipeline.hpp"
 #include "vtfZRenderPass2.hpp"
 #include "vtfZRenderPass.hpp"
+#include "vtfParallelCommandRecorder.hpp"
 #include <type_traits>
 #include <thread>
 
@@ -51,24 +52,6 @@ bool userInfinityRepeat (const strings& params)
 	return (consumeOptions(runOnThreads, options, args, sink) > 0);
 }
 
-std::vector<ZQueue> buildQueues (ZDevice device, uint32_t queueCount)
-{
-	std::vector<ZQueue> queues;
-	for (uint32_t i = 0; i < queueCount; ++i)
-		queues.emplace_back(deviceGetNextQueue(device, VK_QUEUE_GRAPHICS_BIT, false));
-	return queues;
-}
-
-bool verifyQueues (add_cref<std::vector<ZQueue>> queues)
-{
-	for (ZQueue q : queues)
-	{
-		if (!q.has_handle())
-			return false;
-	}
-	return true;
-}
-
 TriLogicInt runTriangeSingleThread (Canvas& canvas, const std::string& assets, bool infinityRepeat, bool vulkan12);
 TriLogicInt runTriangleMultipleThreads (Canvas& canvas, const std::string& assets, uint32_t threadCount);
 TriLogicInt prepareTests (const TestRecord& record, add_ref<CommandLine> cmdLine)
@@ -92,6 +75,8 @@ TriLogicInt prepareTests (const TestRecord& record, add_ref<CommandLine> cmdLine
 		}
 	};
 	canvasStyle.surfaceFormatFlags |= (VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT);
+	// Nothing is written by the host while drawing, frames can be recorded ahead
+	canvasStyle.submitRenderWithFence = false;
 	Canvas cs(record.name, gf.layers, strings(), strings(), canvasStyle,
 				onEnablingFeatures, vulkan12 ? Version(1, 2) : gf.apiVer);
 	std::cout << VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME << " enabled: " << boolean(vulkan12) << std::endl;
@@ -155,18 +140,18 @@ TriLogicInt runTriangeSingleThread (Canvas& cs, const std::string& assets, bool
 		commandBufferEnd(cmdBuffer);
 	};
 
-	return cs.run(onCommandRecording, renderPass, std::ref(drawTrigger));
+	const int result = cs.run(onCommandRecording, renderPass, std::ref(drawTrigger));
+
+	add_cref<Canvas::FrameStats> stats = cs.frameStats;
+	std::cout << "Frames: " << stats.latency.count << ", in flight: " << stats.framesInFlight
+			  << ", cpu record: " << stats.cpuRecord.average() << " ms, gpu: " << stats.gpu.average()
+			  << " ms, latency: " << stats.latency.average() << " ms" << std::endl;
+
+	return result;
 }
 
 TriLogicInt runTriangleMultipleThreads (Canvas& cs, const std::string& assets, const uint32_t threadCount)
 {
-	std::vector<ZQueue> queues	= buildQueues(cs.device, threadCount);
-	if (!verifyQueues(queues))
-	{
-		std::cout << "[ERROR} Unable to test on threads due to lack of hardware threads." << std::endl;
-		return (1);
-	}
-
 	add_cref<ZDeviceInterface>	di(cs.device.getInterface());
 	ProgramCollection			programs(cs.device, assets);
 	programs.addFromFile(VK_SHADER_STAGE_VERTEX_BIT, "shader.vert");
@@ -185,49 +170,53 @@ TriLogicInt runTriangleMultipleThreads (Canvas& cs, const std::string& assets, c
 	}
 
 	const VkClearValue			clearColor			{ { { 0.5f, 0.5f, 0.5f, 0.5f } } };
+	ZRenderPass					renderPass			= cs.createSinglePresentationRenderPass(clearColor);
 	ZPipelineLayout				pipelineLayout		= LayoutManager(cs.device).createPipelineLayout();
+	ZPipeline					pipeline			= createGraphicsPipeline(pipelineLayout, renderPass,
+															vertexInput, vertShaderModule, fragShaderModule,
+															VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR);
+
+	// Every tile is a chunk recorded into its own secondary command buffer by one of the threads
+	const uint32_t				tilesPerRow			= 16u;
+	const uint32_t				tileCount			= tilesPerRow * tilesPerRow;
+	ParallelCommandRecorder		recorder			(cs.device, cs.graphicsQueue, cs.style.framesInFlight);
 
 	int drawTrigger = 1;
 	cs.events().setDefault(drawTrigger);
 
-	const uint32_t	blitImageWidth	= 1024;
-	const uint32_t	blitImageHeight	= 1024;
-	ZRenderPass		renderPass		= cs.createSinglePresentationRenderPass(clearColor);
-	struct ThreadLocal
-	{
-		ZPipeline		pipeline;
-		ZImage			image;
-		ZImageView		view;
-		ZFramebuffer	framebuffer;
-	};
-	auto createThreadLocal = [&]() -> ThreadLocal
-	{
-		ThreadLocal data;
-		data.pipeline		= createGraphicsPipeline(pipelineLayout, renderPass,
-													 vertexInput, vertShaderModule, fragShaderModule,
-													 makeExtent2D(blitImageWidth, blitImageHeight));
-		data.image			= cs.createColorImage2D(VK_FORMAT_R32G32B32A32_SFLOAT, blitImageWidth, blitImageHeight);
-		data.view			= createImageView(data.image);
-		data.framebuffer	= createFramebuffer(renderPass, blitImageWidth, blitImageHeight, {data.view});
-		return data;
-
-	};
-	auto threadsData = createVector(threadCount, createThreadLocal);
-
-	auto onCommandRecordingThenBlit = [&](add_ref<Canvas>, add_cref<Canvas::Swapchain>, ZCommandBuffer cmdBuffer, uint32_t threadID)
+	auto onCommandRecording = [&](add_ref<Canvas>, add_cref<Canvas::Swapchain> swapchain,
+									ZCommandBuffer cmdBuffer, ZFramebuffer framebuffer)
 	{
+		const float tileWidth	= float(swapchain.extent.width) / float(tilesPerRow);
+		const float tileHeight	= float(swapchain.extent.height) / float(tilesPerRow);
+		auto onChunkRecording = [&](ZCommandBuffer cmd, uint32_t tile)
+		{
+			const VkViewport viewport { (float(tile % tilesPerRow) * tileWidth), (float(tile / tilesPerRow) * tileHeight),
+										tileWidth, tileHeight, 0.0f, 1.0f };
+			const VkRect2D scissor { { int32_t(viewport.x), int32_t(viewport.y) },
+									 { uint32_t(tileWidth + 0.5f), uint32_t(tileHeight + 0.5f) } };
+			commandBufferBindPipeline(cmd, pipeline);
+			commandBufferBindVertexBuffers(cmd, vertexInput);
+			VTF_CALL_CHECK(di.vkCmdSetViewport, *cmd, 0u, 1u, &viewport);
+			VTF_CALL_CHECK(di.vkCmdSetScissor, *cmd, 0u, 1u, &scissor);
+			VTF_CALL_CHECK(di.vkCmdDraw, *cmd, vertexInput.getVertexCount(0), 1u, 0u, 0u);
+		};
+
+		recorder.beginFrame();
 		commandBufferBegin(cmdBuffer);
-			commandBufferBindPipeline(cmdBuffer, threadsData[threadID].pipeline);
-			commandBufferBindVertexBuffers(cmdBuffer, vertexInput);
-			auto rpbi = commandBufferBeginRenderPass(cmdBuffer, threadsData[threadID].framebuffer);
-                VTF_CALL_CHECK(di.vkCmdDraw, *cmdBuffer, 3u, 1u, 0u, 0u);
+			auto rpbi = commandBufferBeginRenderPass(cmdBuffer, framebuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+				recorder.record(rpbi, tileCount, onChunkRecording, threadCount);
 			commandBufferEndRenderPass(rpbi);
 		commandBufferEnd(cmdBuffer);
-
-		return threadsData[threadID].image;
 	};
 
-	return cs.run(onCommandRecordingThenBlit, queues);
+	const int result = cs.run(onCommandRecording, renderPass, std::ref(drawTrigger));
+
+	add_cref<ParallelCommandRecorder::Stats> stats = recorder.stats();
+	std::cout << "Frames: " << stats.frames << ", chunks: " << stats.chunks << ", threads: " << stats.maxThreads
+			  << ", recording: " << stats.wallMilliseconds << " ms, speedup: " << stats.speedup() << std::endl;
+
+	return result;
 }
 
 } // unnamed namespace
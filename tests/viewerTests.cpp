@@ -113,7 +113,12 @@ TriLogicInt prepareTests (add_cref<TestRecord> record, add_ref<CommandLine> cmdL
 	add_cref<GlobalAppFlags> gf = getGlobalAppFlags();
 	CanvasStyle canvasStyle = Canvas::DefaultStyle;
 	canvasStyle.surfaceFormatFlags |= (VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT);
-	Canvas cs(record.name, gf.layers, {}, {}, canvasStyle, nullptr, gf.apiVer);
+	// The panorama's descriptors are pushed if the extension is there, otherwise written through a template
+	auto onGetEnabledFeatures = [](add_ref<DeviceCaps> caps)
+	{
+		caps.addExtension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+	};
+	Canvas cs(record.name, gf.layers, {}, {}, canvasStyle, onGetEnabledFeatures, gf.apiVer);
 
 	TriLogicInt	result			(1);
 	int32_t		regularCount	= 0;
@@ -638,6 +643,8 @@ TriLogicInt runViewerSingleThread (add_ref<Canvas> cs, add_cref<std::string> ass
 		populateVertexInput(vertexInput);
 		sampler	= createSampler(cs.device);
 		layoutMgr.addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		// Without push descriptors every frame recorded ahead writes its own set
+		layoutMgr.setFrequentlyUpdated(true, std::max(1u, cs.style.framesInFlight));
 		ZDescriptorSetLayout	dsLayout	= layoutMgr.createDescriptorSetLayout(false);
 		ZPipelineLayout			panLayout	= layoutMgr.createPipelineLayout({ dsLayout }, ZPushRange<PushConstant>());
 		panPipeline = createGraphicsPipeline(panLayout, renderPass, vertShader, fragShader, vertexInput,
@@ -677,15 +684,17 @@ TriLogicInt runViewerSingleThread (add_ref<Canvas> cs, add_cref<std::string> ass
 
 		}
 
+		// This frame has completed before its command buffer is recorded again
+		layoutMgr.beginFrame();
 		commandBufferBegin(cmdBuffer);
 		if (!status && fileInfo.panorama)
 		{
 			auto pipeLayout		= pipelineGetLayout(panPipeline);
-			auto dsLayout		= layoutMgr.getDescriptorSetLayout(pipeLayout);
-			auto descriptorSet	= layoutMgr.getDescriptorSet(dsLayout);
-			layoutMgr.updateDescriptorSet(descriptorSet, 0u, srcImage.view, sampler);
+			// Only remembered here, there is no set if the layout is a push descriptor one
+			layoutMgr.updateDescriptorSet(ZDescriptorSet(), 0u, srcImage.view, sampler);
 			commandBufferClearColorImage(cmdBuffer, dstImage, makeClearColorValue(Vec4()));
-			commandBufferBindPipeline(cmdBuffer, panPipeline);
+			commandBufferBindPipeline(cmdBuffer, panPipeline, false);
+			layoutMgr.pushDescriptorSet(cmdBuffer, panPipeline);
 			commandBufferPushConstants(cmdBuffer, pipeLayout, srcImage.pc);
 			commandBufferBindVertexBuffers(cmdBuffer, vertexInput);
 			vkCmdSetViewport(*cmdBuffer, 0, 1, &swapchain.viewport);